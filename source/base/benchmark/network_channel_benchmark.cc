@@ -0,0 +1,229 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/logging.h"
+#include "base/crypto/message_decryptor_openssl.h"
+#include "base/crypto/message_encryptor_openssl.h"
+#include "base/crypto/random.h"
+#include "base/memory/buffer_pool.h"
+#include "base/message_loop/message_loop.h"
+#include "base/net/network_channel.h"
+#include "base/net/network_server.h"
+#include "proto/desktop.pb.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+const uint16_t kPort = 18099;
+
+// Number of messages that the sender keeps in the queue of the channel.
+const size_t kQueueDepth = 256;
+
+// Amount of data sent for each message size.
+const size_t kBytesPerRun = 512 * 1024 * 1024; // 512 MB
+const size_t kMaxMessagesPerRun = 1024 * 1024;
+
+const size_t kMessageSizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, 1024 * 1024 };
+
+using Clock = std::chrono::steady_clock;
+
+enum class SendMode
+{
+    COPY,    // The message is serialized into a new buffer, then encrypted into the write buffer.
+    IN_PLACE // The message is serialized with room for the header and encrypted in place.
+};
+
+// Sends video packets through an encrypted loopback connection within one thread, as a host sends
+// them to a client. The sender keeps |kQueueDepth| messages queued and adds a new one for each
+// written message.
+class ThroughputTest
+    : public base::NetworkServer::Delegate,
+      public base::NetworkChannel::Listener
+{
+public:
+    ThroughputTest(SendMode mode, size_t message_size, size_t message_count)
+        : mode_(mode),
+          message_count_(message_count),
+          key_(base::Random::byteArray(32)),
+          iv_(base::Random::byteArray(12))
+    {
+        packet_.set_data(std::string(message_size, 'x'));
+        message_size_ = packet_.ByteSizeLong();
+    }
+
+    // Returns the time taken to receive all messages.
+    std::chrono::duration<double> run()
+    {
+        base::MessageLoop message_loop(base::MessageLoop::Type::ASIO);
+        task_runner_ = message_loop.taskRunner();
+
+        base::NetworkServer server;
+        server.start(kPort, this);
+
+        sender_ = std::make_unique<base::NetworkChannel>();
+        sender_->setListener(this);
+        sender_->setEncryptor(
+            base::MessageEncryptorOpenssl::createForChaCha20Poly1305(key_, iv_));
+        sender_->connect(u"127.0.0.1", kPort);
+
+        message_loop.run();
+
+        receiver_.reset();
+        sender_.reset();
+        server.stop();
+
+        return end_time_ - start_time_;
+    }
+
+    bool isCompleted() const { return received_ == message_count_; }
+
+protected:
+    // base::NetworkServer::Delegate implementation.
+    void onNewConnection(std::unique_ptr<base::NetworkChannel> channel) override
+    {
+        receiver_ = std::move(channel);
+        receiver_->setListener(this);
+        receiver_->setDecryptor(
+            base::MessageDecryptorOpenssl::createForChaCha20Poly1305(key_, iv_));
+        receiver_->resume();
+    }
+
+    // base::NetworkChannel::Listener implementation.
+    void onConnected() override
+    {
+        sender_->setNoDelay(true);
+        start_time_ = Clock::now();
+
+        while (sent_ < kQueueDepth && sent_ < message_count_)
+            sendMessage();
+    }
+
+    void onDisconnected(base::NetworkChannel::ErrorCode error_code) override
+    {
+        std::cout << "  Disconnected: " << base::NetworkChannel::errorToString(error_code)
+                  << std::endl;
+        task_runner_->postQuit();
+    }
+
+    void onMessageReceived(const base::ByteArray& buffer) override
+    {
+        if (buffer.size() != message_size_)
+        {
+            std::cout << "  Invalid message size: " << buffer.size() << std::endl;
+            task_runner_->postQuit();
+            return;
+        }
+
+        if (++received_ == message_count_)
+        {
+            end_time_ = Clock::now();
+            task_runner_->postQuit();
+        }
+    }
+
+    void onMessageWritten(size_t /* pending */) override
+    {
+        if (sent_ < message_count_)
+            sendMessage();
+    }
+
+private:
+    void sendMessage()
+    {
+        if (mode_ == SendMode::COPY)
+            sender_->send(base::serialize(packet_));
+        else
+            sender_->send(packet_);
+
+        ++sent_;
+    }
+
+    const SendMode mode_;
+    const size_t message_count_;
+    proto::VideoPacket packet_;
+    size_t message_size_;
+    const base::ByteArray key_;
+    const base::ByteArray iv_;
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    std::unique_ptr<base::NetworkChannel> sender_;
+    std::unique_ptr<base::NetworkChannel> receiver_;
+
+    size_t sent_ = 0;
+    size_t received_ = 0;
+
+    Clock::time_point start_time_;
+    Clock::time_point end_time_;
+
+    DISALLOW_COPY_AND_ASSIGN(ThroughputTest);
+};
+
+} // namespace
+
+int main(int /* argc */, const char* const* /* argv */)
+{
+    base::LoggingSettings logging_settings;
+    logging_settings.min_log_level = base::LOG_LS_ERROR;
+    base::initLogging(logging_settings);
+
+    std::cout << "NetworkChannel throughput over loopback (ChaCha20-Poly1305, queue depth "
+              << kQueueDepth << ")" << std::endl;
+
+    for (size_t message_size : kMessageSizes)
+    {
+        const size_t message_count =
+            std::min(kBytesPerRun / message_size, kMaxMessagesPerRun);
+
+        std::cout << "Size " << message_size << ":";
+
+        for (SendMode mode : { SendMode::COPY, SendMode::IN_PLACE })
+        {
+            const base::BufferPool::Stat pool_before = base::BufferPool::stat();
+
+            ThroughputTest test(mode, message_size, message_count);
+            std::chrono::duration<double> elapsed = test.run();
+
+            const base::BufferPool::Stat pool_after = base::BufferPool::stat();
+
+            std::cout << (mode == SendMode::COPY ? " copy " : ", in place ");
+
+            if (!test.isCompleted())
+            {
+                std::cout << "failed";
+                continue;
+            }
+
+            const double seconds = elapsed.count();
+            const double megabytes =
+                static_cast<double>(message_size * message_count) / (1024.0 * 1024.0);
+
+            std::cout << static_cast<double>(message_count) / seconds << " messages/s ("
+                      << megabytes / seconds << " MB/s, "
+                      << pool_after.allocated - pool_before.allocated << " buffers allocated, "
+                      << pool_after.reused - pool_before.reused << " reused)";
+        }
+
+        std::cout << std::endl;
+    }
+
+    base::shutdownLogging();
+    return 0;
+}
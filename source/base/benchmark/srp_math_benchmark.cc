@@ -0,0 +1,193 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/logging.h"
+#include "base/crypto/random.h"
+#include "base/crypto/srp_constants.h"
+#include "base/crypto/srp_math.h"
+
+#include <openssl/bn.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Less iterations for large groups, so that each group takes about the same time.
+const size_t kIterationsBase = 1024;
+
+using Clock = std::chrono::steady_clock;
+
+struct Group
+{
+    const char* name;
+    const base::SrpNgPair* pair;
+};
+
+const Group kGroups[] =
+{
+    { "1024", &base::kSrpNgPair_1024 },
+    { "1536", &base::kSrpNgPair_1536 },
+    { "2048", &base::kSrpNgPair_2048 },
+    { "3072", &base::kSrpNgPair_3072 },
+    { "4096", &base::kSrpNgPair_4096 },
+    { "6144", &base::kSrpNgPair_6144 },
+    { "8192", &base::kSrpNgPair_8192 }
+};
+
+struct Parameters
+{
+    base::BigNum N;
+    base::BigNum g;
+    base::BigNum v;
+    base::BigNum A;
+};
+
+Parameters makeParameters(const base::SrpNgPair& pair)
+{
+    Parameters parameters;
+    parameters.N = base::BigNum::fromStdString(pair.first);
+    parameters.g = base::BigNum::fromStdString(pair.second);
+    parameters.v = base::SrpMath::calc_v(
+        u"user", u"password", base::BigNum::fromByteArray(base::Random::byteArray(64)),
+        parameters.N, parameters.g);
+    parameters.A = base::SrpMath::calc_A(
+        base::BigNum::fromByteArray(base::Random::byteArray(128)), parameters.N, parameters.g);
+    return parameters;
+}
+
+// Server side of the handshake as in ServerAuthenticator: B, u and the session key.
+bool serverHandshake(const Parameters& parameters)
+{
+    base::BigNum b = base::BigNum::fromByteArray(base::Random::byteArray(128)); // 1024 bits.
+    base::BigNum B = base::SrpMath::calc_B(b, parameters.N, parameters.g, parameters.v);
+    if (!base::SrpMath::verify_A_mod_N(parameters.A, parameters.N))
+        return false;
+
+    base::BigNum u = base::SrpMath::calc_u(parameters.A, B, parameters.N);
+    base::BigNum key = base::SrpMath::calcServerKey(parameters.A, parameters.v, u, b, parameters.N);
+    return key.isValid();
+}
+
+// The previous implementation for comparison: a new context for every operation and a generic
+// exponentiation, as it was before the fixed-base tables.
+bool legacyServerHandshake(const Parameters& parameters)
+{
+    base::BigNum b = base::BigNum::fromByteArray(base::Random::byteArray(128));
+
+    base::BigNum::Context ctx = base::BigNum::Context::create();
+    base::BigNum gb = base::BigNum::create();
+    if (!BN_mod_exp(gb, parameters.g, b, parameters.N, ctx))
+        return false;
+
+    base::BigNum k = base::SrpMath::calc_u(parameters.N, parameters.g, parameters.N);
+    base::BigNum B = base::BigNum::create();
+    if (!BN_mod_mul(B, parameters.v, k, parameters.N, ctx) ||
+        !BN_mod_add(B, gb, B, parameters.N, ctx))
+    {
+        return false;
+    }
+
+    base::BigNum u = base::SrpMath::calc_u(parameters.A, B, parameters.N);
+
+    base::BigNum::Context ctx2 = base::BigNum::Context::create();
+    base::BigNum tmp = base::BigNum::create();
+    base::BigNum key = base::BigNum::create();
+
+    return BN_mod_exp(tmp, parameters.v, u, parameters.N, ctx2) &&
+           BN_mod_mul(tmp, parameters.A, tmp, parameters.N, ctx2) &&
+           BN_mod_exp(key, tmp, b, parameters.N, ctx2);
+}
+
+using HandshakeFunction = bool(*)(const Parameters&);
+
+// Runs |iterations| handshakes on each of |thread_count| threads. Returns handshakes per second
+// per thread.
+double measure(HandshakeFunction function, const Parameters& parameters, size_t iterations,
+               size_t thread_count)
+{
+    std::atomic<size_t> failed = 0;
+    std::vector<std::thread> threads;
+
+    Clock::time_point start_time = Clock::now();
+
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back([&]()
+        {
+            for (size_t j = 0; j < iterations; ++j)
+            {
+                if (!function(parameters))
+                    ++failed;
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> elapsed = Clock::now() - start_time;
+
+    if (failed)
+        std::cout << "  " << failed << " handshakes failed" << std::endl;
+
+    return static_cast<double>(iterations) / elapsed.count();
+}
+
+} // namespace
+
+int main(int /* argc */, const char* const* /* argv */)
+{
+    base::LoggingSettings logging_settings;
+    logging_settings.min_log_level = base::LOG_LS_ERROR;
+    base::initLogging(logging_settings);
+
+    const size_t thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+    std::cout << "Server handshakes per second per core (" << thread_count << " threads)"
+              << std::endl;
+
+    for (const Group& group : kGroups)
+    {
+        Parameters parameters = makeParameters(*group.pair);
+        size_t bits = static_cast<size_t>(BN_num_bits(parameters.N));
+
+        // The cost of exponentiation grows as the cube of the size.
+        size_t iterations = std::max<size_t>(
+            kIterationsBase * 1024 / bits * 1024 / bits * 1024 / bits, 4);
+
+        // The first handshake creates the table of the group.
+        Clock::time_point start_time = Clock::now();
+        serverHandshake(parameters);
+        std::chrono::duration<double, std::milli> setup_time = Clock::now() - start_time;
+
+        double legacy_single = measure(&legacyServerHandshake, parameters, iterations, 1);
+        double single = measure(&serverHandshake, parameters, iterations, 1);
+        double multi = measure(&serverHandshake, parameters, iterations, thread_count);
+
+        std::cout << "Group " << group.name << ": " << single << " (legacy " << legacy_single
+                  << ", x" << single / legacy_single << "), all threads: " << multi
+                  << ", first handshake: " << setup_time.count() << " ms" << std::endl;
+    }
+
+    base::shutdownLogging();
+    return 0;
+}
@@ -106,6 +106,48 @@ void wrongKey(MessageEncryptor* client_encryptor, MessageDecryptor* host_decrypt
     ASSERT_FALSE(ret);
 }
 
+void inPlace(MessageEncryptor* encryptor, MessageEncryptor* in_place_encryptor,
+             MessageDecryptor* decryptor, MessageDecryptor* in_place_decryptor)
+{
+    ByteArray message = fromHex(
+        "6006ee8029610876ec2facd5fc9ce6bd6dc03d4a5ddb4d6c28f2ff048d4f7eb7bcf5048c901a4adaa7fd");
+
+    ByteArray encrypted_msg;
+    encrypted_msg.resize(encryptor->encryptedDataSize(message.size()));
+
+    ASSERT_TRUE(encryptor->encrypt(message.data(), message.size(), encrypted_msg.data()));
+
+    // The message is encrypted after the space for the header.
+    const size_t header_size = encrypted_msg.size() - message.size();
+    ASSERT_EQ(header_size, 16);
+
+    ByteArray buffer(header_size);
+    buffer.insert(buffer.end(), message.begin(), message.end());
+
+    ASSERT_TRUE(in_place_encryptor->encryptInPlace(
+        buffer.data(), buffer.data() + header_size, message.size()));
+    ASSERT_EQ(buffer, encrypted_msg);
+
+    // The header is separate from the encrypted data.
+    ByteArray header(buffer.begin(), buffer.begin() + header_size);
+    ByteArray data(buffer.begin() + header_size, buffer.end());
+
+    ASSERT_TRUE(in_place_decryptor->decryptInPlace(header.data(), data.data(), data.size()));
+    ASSERT_EQ(data, message);
+
+    ByteArray decrypted_msg;
+    decrypted_msg.resize(decryptor->decryptedDataSize(encrypted_msg.size()));
+
+    ASSERT_TRUE(decryptor->decrypt(encrypted_msg.data(), encrypted_msg.size(),
+                                   decrypted_msg.data()));
+    ASSERT_EQ(decrypted_msg, message);
+
+    // A damaged message is not accepted.
+    data = ByteArray(buffer.begin() + header_size, buffer.end());
+    data.back() ^= 1;
+    ASSERT_FALSE(in_place_decryptor->decryptInPlace(header.data(), data.data(), data.size()));
+}
+
 TEST(CryptorAes256GcmTest, TestVector)
 {
     const ByteArray key =
@@ -218,4 +260,50 @@ TEST(CryptorChaCha20Poly1305Test, WrongKey)
     wrongKey(client_encryptor.get(), host_decryptor.get());
 }
 
+TEST(CryptorAes256GcmTest, InPlace)
+{
+    const ByteArray key =
+        fromHex("5ce26794165a808ec425684e9384c27c22499512a513da8b455bd39746dc5014");
+    const ByteArray iv = fromHex("ee7eb0e6fb24d445597f3e6f");
+
+    std::unique_ptr<MessageEncryptor> encryptor =
+        MessageEncryptorOpenssl::createForAes256Gcm(key, iv);
+    std::unique_ptr<MessageEncryptor> in_place_encryptor =
+        MessageEncryptorOpenssl::createForAes256Gcm(key, iv);
+    std::unique_ptr<MessageDecryptor> decryptor =
+        MessageDecryptorOpenssl::createForAes256Gcm(key, iv);
+    std::unique_ptr<MessageDecryptor> in_place_decryptor =
+        MessageDecryptorOpenssl::createForAes256Gcm(key, iv);
+
+    ASSERT_NE(encryptor, nullptr);
+    ASSERT_NE(in_place_encryptor, nullptr);
+    ASSERT_NE(decryptor, nullptr);
+    ASSERT_NE(in_place_decryptor, nullptr);
+
+    inPlace(encryptor.get(), in_place_encryptor.get(), decryptor.get(), in_place_decryptor.get());
+}
+
+TEST(CryptorChaCha20Poly1305Test, InPlace)
+{
+    const ByteArray key =
+        fromHex("5ce26794165a808ec425684e9384c27c22499512a513da8b455bd39746dc5014");
+    const ByteArray iv = fromHex("924988304848184805f07167");
+
+    std::unique_ptr<MessageEncryptor> encryptor =
+        MessageEncryptorOpenssl::createForChaCha20Poly1305(key, iv);
+    std::unique_ptr<MessageEncryptor> in_place_encryptor =
+        MessageEncryptorOpenssl::createForChaCha20Poly1305(key, iv);
+    std::unique_ptr<MessageDecryptor> decryptor =
+        MessageDecryptorOpenssl::createForChaCha20Poly1305(key, iv);
+    std::unique_ptr<MessageDecryptor> in_place_decryptor =
+        MessageDecryptorOpenssl::createForChaCha20Poly1305(key, iv);
+
+    ASSERT_NE(encryptor, nullptr);
+    ASSERT_NE(in_place_encryptor, nullptr);
+    ASSERT_NE(decryptor, nullptr);
+    ASSERT_NE(in_place_decryptor, nullptr);
+
+    inPlace(encryptor.get(), in_place_encryptor.get(), decryptor.get(), in_place_decryptor.get());
+}
+
 } // namespace base
@@ -30,6 +30,10 @@ public:
 
     virtual size_t decryptedDataSize(size_t in_size) = 0;
     virtual bool decrypt(const void* in, size_t in_size, void* out) = 0;
+
+    // Decrypts |size| bytes of |data| in place. |header| contains the first bytes of the encrypted
+    // message that precede the data (in_size - decryptedDataSize(in_size) bytes).
+    virtual bool decryptInPlace(const void* header, void* data, size_t size) = 0;
 };
 
 } // namespace base
@@ -33,6 +33,7 @@ public:
     // MessageDecryptor implementation.
     size_t decryptedDataSize(size_t in_size) override;
     bool decrypt(const void* in, size_t in_size, void* out) override;
+    bool decryptInPlace(const void* header, void* data, size_t size) override;
 
 private:
     DISALLOW_COPY_AND_ASSIGN(MessageDecryptorFake);
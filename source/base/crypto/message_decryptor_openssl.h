@@ -40,10 +40,13 @@ public:
     // MessageDecryptor implementation.
     size_t decryptedDataSize(size_t in_size) override;
     bool decrypt(const void* in, size_t in_size, void* out) override;
+    bool decryptInPlace(const void* header, void* data, size_t size) override;
 
 private:
     MessageDecryptorOpenssl(EVP_CIPHER_CTX_ptr ctx, const ByteArray& iv);
 
+    bool decrypt(const void* tag, const void* in, size_t in_size, void* out);
+
     EVP_CIPHER_CTX_ptr ctx_;
     ByteArray iv_;
 
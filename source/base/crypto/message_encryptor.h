@@ -30,6 +30,10 @@ public:
 
     virtual size_t encryptedDataSize(size_t in_size) = 0;
     virtual bool encrypt(const void* in, size_t in_size, void* out) = 0;
+
+    // Encrypts |size| bytes of |data| in place. The rest of the encrypted message (the first
+    // encryptedDataSize(size) - size bytes) is written to |header|.
+    virtual bool encryptInPlace(void* header, void* data, size_t size) = 0;
 };
 
 } // namespace base
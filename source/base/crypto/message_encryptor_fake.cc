@@ -37,4 +37,10 @@ bool MessageEncryptorFake::encrypt(const void* in, size_t in_size, void* out)
     return true;
 }
 
+bool MessageEncryptorFake::encryptInPlace(
+    void* /* header */, void* /* data */, size_t /* size */)
+{
+    return true;
+}
+
 } // namespace base
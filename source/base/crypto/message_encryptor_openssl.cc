@@ -85,6 +85,17 @@ size_t MessageEncryptorOpenssl::encryptedDataSize(size_t in_size)
 }
 
 bool MessageEncryptorOpenssl::encrypt(const void* in, size_t in_size, void* out)
+{
+    // The tag goes before the encrypted data.
+    return encrypt(in, in_size, reinterpret_cast<uint8_t*>(out) + kTagSize, out);
+}
+
+bool MessageEncryptorOpenssl::encryptInPlace(void* header, void* data, size_t size)
+{
+    return encrypt(data, size, data, header);
+}
+
+bool MessageEncryptorOpenssl::encrypt(const void* in, size_t in_size, void* out, void* tag)
 {
     if (EVP_EncryptInit_ex(ctx_.get(), nullptr, nullptr, nullptr, iv_.data()) != 1)
     {
@@ -95,22 +106,20 @@ bool MessageEncryptorOpenssl::encrypt(const void* in, size_t in_size, void* out)
     int length;
 
     if (EVP_EncryptUpdate(ctx_.get(),
-                          reinterpret_cast<uint8_t*>(out) + kTagSize, &length,
+                          reinterpret_cast<uint8_t*>(out), &length,
                           reinterpret_cast<const uint8_t*>(in), static_cast<int>(in_size)) != 1)
     {
         LOG(LS_WARNING) << "EVP_EncryptUpdate failed";
         return false;
     }
 
-    if (EVP_EncryptFinal_ex(ctx_.get(),
-                            reinterpret_cast<uint8_t*>(out) + kTagSize + length,
-                            &length) != 1)
+    if (EVP_EncryptFinal_ex(ctx_.get(), reinterpret_cast<uint8_t*>(out) + length, &length) != 1)
     {
         LOG(LS_WARNING) << "EVP_EncryptFinal_ex failed";
         return false;
     }
 
-    if (EVP_CIPHER_CTX_ctrl(ctx_.get(), EVP_CTRL_AEAD_GET_TAG, kTagSize, out) != 1)
+    if (EVP_CIPHER_CTX_ctrl(ctx_.get(), EVP_CTRL_AEAD_GET_TAG, kTagSize, tag) != 1)
     {
         LOG(LS_WARNING) << "EVP_CIPHER_CTX_ctrl failed";
         return false;
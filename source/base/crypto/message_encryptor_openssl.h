@@ -40,10 +40,13 @@ public:
     // MessageEncryptor implementation.
     size_t encryptedDataSize(size_t in_size) override;
     bool encrypt(const void* in, size_t in_size, void* out) override;
+    bool encryptInPlace(void* header, void* data, size_t size) override;
 
 private:
     MessageEncryptorOpenssl(EVP_CIPHER_CTX_ptr ctx, const ByteArray& iv);
 
+    bool encrypt(const void* in, size_t in_size, void* out, void* tag);
+
     EVP_CIPHER_CTX_ptr ctx_;
     ByteArray iv_;
 
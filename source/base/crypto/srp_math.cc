@@ -20,16 +20,44 @@
 
 #include "base/logging.h"
 #include "base/crypto/generic_hash.h"
+#include "base/crypto/srp_constants.h"
 #include "base/strings/string_util.h"
 #include "base/strings/unicode.h"
 
 #include <openssl/opensslv.h>
 #include <openssl/bn.h>
+#include <openssl/crypto.h>
+
+#include <cstring>
+#include <mutex>
+#include <vector>
 
 namespace base {
 
 namespace {
 
+struct MontContextDeleter
+{
+    void operator()(BN_MONT_CTX* mont) { BN_MONT_CTX_free(mont); }
+};
+
+using MontContextPtr = std::unique_ptr<BN_MONT_CTX, MontContextDeleter>;
+
+// Creating BN_CTX for each operation is expensive. The context is not thread-safe, so each thread
+// has its own.
+BN_CTX* threadContext()
+{
+    thread_local BigNum::Context ctx = BigNum::Context::create();
+    return ctx;
+}
+
+// r = a^p % N. The exponent is secret, so the time does not depend on its value.
+bool modExpSecret(BIGNUM* r, const BIGNUM* a, const BIGNUM* p, const BIGNUM* N, BN_CTX* ctx,
+                  BN_MONT_CTX* mont = nullptr)
+{
+    return BN_mod_exp_mont_consttime(r, a, p, N, ctx, mont) == 1;
+}
+
 // xy = BLAKE2b512(PAD(x) || PAD(y))
 BigNum calc_xy(const BigNum& x, const BigNum& y, const BigNum& N)
 {
@@ -62,6 +90,233 @@ BigNum calc_k(const BigNum& N, const BigNum& g)
     return calc_xy(N, g, N);
 }
 
+// Precomputed values for a group from srp_constants.h. The groups are created once and shared
+// by all threads; after creation they are read-only.
+class SrpGroup
+{
+public:
+    // Returns the group with modulus |N| (and generator |g| if specified) or nullptr if it is not
+    // one of the known groups.
+    static const SrpGroup* find(const BigNum& N, const BigNum* g = nullptr);
+
+    const BigNum& k() const { return k_; }
+    BN_MONT_CTX* montgomery() const { return mont_.get(); }
+
+    // r = g^e % N for a secret exponent |e|, which must be less than 2^kExponentBits.
+    // The exponent is split into 4-bit digits, digit i selects the power g^(digit * 16^i) from
+    // row i of the table, and the selected powers are multiplied. This takes one multiplication
+    // per digit instead of a square and a multiplication per bit. Every row is read completely
+    // for each lookup, so memory access does not depend on the exponent.
+    bool modExpG(BIGNUM* r, const BIGNUM* e, BN_CTX* ctx) const;
+
+    static constexpr int kExponentBits = 1024;
+
+private:
+    static constexpr int kWindowBits = 4;
+    static constexpr size_t kEntryCount = 1 << kWindowBits;
+    static constexpr size_t kRowCount = kExponentBits / kWindowBits;
+
+    explicit SrpGroup(const SrpNgPair& pair);
+
+    bool createTable();
+    void selectEntry(size_t row, uint32_t digit, uint64_t* out) const;
+    uint8_t* entryBytes(size_t row, size_t index);
+
+    BigNum N_;
+    BigNum g_;
+    BigNum k_;
+    MontContextPtr mont_;
+
+    // Powers of g in Montgomery form, |kEntryCount| entries of |entry_words_| words per row. An
+    // entry is stored as little-endian bytes; the words are used only to select entries faster.
+    // The table is large (up to 4 MB for 8192-bit group), so it is created on first use.
+    mutable std::once_flag table_once_;
+    mutable std::vector<uint64_t> table_;
+    mutable bool table_valid_ = false;
+    size_t entry_size_ = 0;
+    size_t entry_words_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(SrpGroup);
+};
+
+// static
+const SrpGroup* SrpGroup::find(const BigNum& N, const BigNum* g)
+{
+    static const std::vector<std::unique_ptr<SrpGroup>> groups = []()
+    {
+        const SrpNgPair* pairs[] =
+        {
+            &kSrpNgPair_1024, &kSrpNgPair_1536, &kSrpNgPair_2048, &kSrpNgPair_3072,
+            &kSrpNgPair_4096, &kSrpNgPair_6144, &kSrpNgPair_8192
+        };
+
+        std::vector<std::unique_ptr<SrpGroup>> result;
+        for (const SrpNgPair* pair : pairs)
+        {
+            std::unique_ptr<SrpGroup> group(new SrpGroup(*pair));
+            if (group->mont_ && group->k_.isValid())
+                result.emplace_back(std::move(group));
+        }
+
+        return result;
+    }();
+
+    if (!N.isValid())
+        return nullptr;
+
+    for (const auto& group : groups)
+    {
+        if (BN_cmp(group->N_, N) != 0)
+            continue;
+
+        if (g && (!g->isValid() || BN_cmp(group->g_, *g) != 0))
+            return nullptr;
+
+        return group.get();
+    }
+
+    return nullptr;
+}
+
+SrpGroup::SrpGroup(const SrpNgPair& pair)
+    : N_(BigNum::fromStdString(pair.first)),
+      g_(BigNum::fromStdString(pair.second)),
+      k_(calc_k(N_, g_)),
+      entry_size_(static_cast<size_t>(BN_num_bytes(N_))),
+      entry_words_((entry_size_ + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+{
+    BN_CTX* ctx = threadContext();
+    if (!ctx)
+        return;
+
+    mont_.reset(BN_MONT_CTX_new());
+    if (mont_ && !BN_MONT_CTX_set(mont_.get(), N_, ctx))
+        mont_.reset();
+}
+
+bool SrpGroup::modExpG(BIGNUM* r, const BIGNUM* e, BN_CTX* ctx) const
+{
+    std::call_once(table_once_, [this]()
+    {
+        table_valid_ = const_cast<SrpGroup*>(this)->createTable();
+        if (!table_valid_)
+            LOG(LS_ERROR) << "Unable to create table for SRP group " << BN_num_bits(N_);
+    });
+
+    if (!table_valid_)
+        return false;
+
+    uint8_t digits[kExponentBits / 8];
+    if (BN_bn2lebinpad(e, digits, sizeof(digits)) < 0)
+        return false;
+
+    std::vector<uint64_t> entry(entry_words_);
+    const uint8_t* entry_bytes = reinterpret_cast<const uint8_t*>(entry.data());
+    const int entry_size = static_cast<int>(entry_size_);
+
+    BN_CTX_start(ctx);
+
+    BIGNUM* result = BN_CTX_get(ctx);
+    BIGNUM* power = BN_CTX_get(ctx);
+    bool succeeded = result && power;
+
+    for (size_t row = 0; succeeded && row < kRowCount; ++row)
+    {
+        uint32_t digit = static_cast<uint32_t>(
+            (digits[row / 2] >> ((row % 2) * kWindowBits)) & (kEntryCount - 1));
+
+        selectEntry(row, digit, entry.data());
+
+        if (!row)
+        {
+            succeeded = BN_lebin2bn(entry_bytes, entry_size, result) != nullptr;
+        }
+        else
+        {
+            succeeded = BN_lebin2bn(entry_bytes, entry_size, power) != nullptr &&
+                BN_mod_mul_montgomery(result, result, power, mont_.get(), ctx);
+        }
+    }
+
+    if (succeeded)
+        succeeded = BN_from_montgomery(r, result, mont_.get(), ctx);
+
+    BN_CTX_end(ctx);
+
+    OPENSSL_cleanse(digits, sizeof(digits));
+    OPENSSL_cleanse(entry.data(), entry.size() * sizeof(uint64_t));
+    return succeeded;
+}
+
+bool SrpGroup::createTable()
+{
+    BN_CTX* ctx = threadContext();
+    if (!ctx || !mont_ || !entry_size_)
+        return false;
+
+    BigNum one = BigNum::create();
+    BigNum base = BigNum::create();
+    BigNum power = BigNum::create();
+
+    if (!one.isValid() || !base.isValid() || !power.isValid())
+        return false;
+
+    if (!BN_to_montgomery(one, BN_value_one(), mont_.get(), ctx) ||
+        !BN_to_montgomery(base, g_, mont_.get(), ctx))
+    {
+        return false;
+    }
+
+    const int entry_size = static_cast<int>(entry_size_);
+    table_.assign(kRowCount * kEntryCount * entry_words_, 0);
+
+    // Row i contains g^(j * 16^i) for j from 0 to 15.
+    for (size_t row = 0; row < kRowCount; ++row)
+    {
+        if (BN_bn2lebinpad(one, entryBytes(row, 0), entry_size) < 0 || !BN_copy(power, base))
+            return false;
+
+        for (size_t j = 1; j < kEntryCount; ++j)
+        {
+            if (BN_bn2lebinpad(power, entryBytes(row, j), entry_size) < 0)
+                return false;
+
+            if (!BN_mod_mul_montgomery(power, power, base, mont_.get(), ctx))
+                return false;
+        }
+
+        // The base of the next row: g^(16^(i + 1)).
+        if (!BN_copy(base, power))
+            return false;
+    }
+
+    return true;
+}
+
+void SrpGroup::selectEntry(size_t row, uint32_t digit, uint64_t* out) const
+{
+    const uint64_t* entries = table_.data() + row * kEntryCount * entry_words_;
+
+    std::memset(out, 0, entry_words_ * sizeof(uint64_t));
+
+    // The inner loop has no branches and is vectorized by the compiler.
+    for (uint32_t i = 0; i < kEntryCount; ++i)
+    {
+        // All bits are set for the requested entry and cleared for the others.
+        const uint64_t mask = 0ULL - static_cast<uint64_t>(((i ^ digit) - 1U) >> 31);
+        const uint64_t* entry = entries + i * entry_words_;
+
+        for (size_t j = 0; j < entry_words_; ++j)
+            out[j] |= entry[j] & mask;
+    }
+}
+
+uint8_t* SrpGroup::entryBytes(size_t row, size_t index)
+{
+    return reinterpret_cast<uint8_t*>(
+        table_.data() + (row * kEntryCount + index) * entry_words_);
+}
+
 } // namespace
 
 // static
@@ -78,20 +333,35 @@ BigNum SrpMath::calc_B(const BigNum& b, const BigNum& N, const BigNum& g, const
     if (!b.isValid() || !N.isValid() || !g.isValid() || !v.isValid())
         return BigNum();
 
-    BigNum::Context ctx = BigNum::Context::create();
-    if (!ctx.isValid())
+    BN_CTX* ctx = threadContext();
+    if (!ctx)
         return BigNum();
 
     BigNum gb = BigNum::create();
     if (!gb.isValid())
         return BigNum();
 
-    if (!BN_mod_exp(gb, g, b, N, ctx))
-        return BigNum();
+    const SrpGroup* group = SrpGroup::find(N, &g);
+    if (group && BN_num_bits(b) <= SrpGroup::kExponentBits)
+    {
+        if (!group->modExpG(gb, b, ctx))
+            return BigNum();
+    }
+    else
+    {
+        if (!modExpSecret(gb, g, b, N, ctx, group ? group->montgomery() : nullptr))
+            return BigNum();
+    }
 
-    BigNum k = calc_k(N, g);
-    if (!k.isValid())
-        return BigNum();
+    BigNum k_temp;
+    if (!group)
+    {
+        k_temp = calc_k(N, g);
+        if (!k_temp.isValid())
+            return BigNum();
+    }
+
+    const BigNum& k = group ? group->k() : k_temp;
 
     BigNum kv = BigNum::create();
     if (!kv.isValid())
@@ -147,13 +417,14 @@ BigNum SrpMath::calc_A(const BigNum& a, const BigNum& N, const BigNum& g)
     if (!a.isValid() || !N.isValid() || !g.isValid())
         return BigNum();
 
-    BigNum::Context ctx = BigNum::Context::create();
+    BN_CTX* ctx = threadContext();
     BigNum A = BigNum::create();
 
-    if (!A.isValid() || !ctx.isValid())
+    if (!A.isValid() || !ctx)
         return BigNum();
 
-    if (!BN_mod_exp(A, g, a, N, ctx))
+    const SrpGroup* group = SrpGroup::find(N);
+    if (!modExpSecret(A, g, a, N, ctx, group ? group->montgomery() : nullptr))
         return BigNum();
 
     return A;
@@ -170,13 +441,17 @@ BigNum SrpMath::calcServerKey(const BigNum& A, const BigNum& v, const BigNum& u,
         return BigNum();
     }
 
-    BigNum::Context ctx = BigNum::Context::create();
+    BN_CTX* ctx = threadContext();
     BigNum tmp = BigNum::create();
 
-    if (!ctx.isValid() || !tmp.isValid())
+    if (!ctx || !tmp.isValid())
         return BigNum();
 
-    if (!BN_mod_exp(tmp, v, u, N, ctx))
+    const SrpGroup* group = SrpGroup::find(N);
+    BN_MONT_CTX* mont = group ? group->montgomery() : nullptr;
+
+    // u is public, so the faster variable-time exponentiation is used.
+    if (!BN_mod_exp_mont(tmp, v, u, N, ctx, mont))
         return BigNum();
 
     if (!BN_mod_mul(tmp, A, tmp, N, ctx))
@@ -186,7 +461,7 @@ BigNum SrpMath::calcServerKey(const BigNum& A, const BigNum& v, const BigNum& u,
     if (!S.isValid())
         return BigNum();
 
-    if (!BN_mod_exp(S, tmp, b, N, ctx))
+    if (!modExpSecret(S, tmp, b, N, ctx, mont))
         return BigNum();
 
     return S;
@@ -200,8 +475,8 @@ BigNum SrpMath::calcClientKey(const BigNum& N, const BigNum& B, const BigNum& g,
     if (!N.isValid() || !B.isValid() || !g.isValid() || !x.isValid() || !a.isValid() || !u.isValid())
         return BigNum();
 
-    BigNum::Context ctx = BigNum::Context::create();
-    if (!ctx.isValid())
+    BN_CTX* ctx = threadContext();
+    if (!ctx)
         return BigNum();
 
     BigNum tmp = BigNum::create();
@@ -211,7 +486,10 @@ BigNum SrpMath::calcClientKey(const BigNum& N, const BigNum& B, const BigNum& g,
     if (!tmp.isValid() || !tmp2.isValid() || !tmp3.isValid())
         return BigNum();
 
-    if (!BN_mod_exp(tmp, g, x, N, ctx))
+    const SrpGroup* group = SrpGroup::find(N);
+    BN_MONT_CTX* mont = group ? group->montgomery() : nullptr;
+
+    if (!modExpSecret(tmp, g, x, N, ctx, mont))
         return BigNum();
 
     BigNum k = calc_k(N, g);
@@ -234,7 +512,7 @@ BigNum SrpMath::calcClientKey(const BigNum& N, const BigNum& B, const BigNum& g,
     if (!K.isValid())
         return BigNum();
 
-    if (!BN_mod_exp(K, tmp, tmp2, N, ctx))
+    if (!modExpSecret(K, tmp, tmp2, N, ctx, mont))
         return BigNum();
 
     return K;
@@ -246,10 +524,10 @@ bool SrpMath::verify_B_mod_N(const BigNum& B, const BigNum& N)
     if (!B.isValid() || !N.isValid())
         return false;
 
-    BigNum::Context ctx = BigNum::Context::create();
+    BN_CTX* ctx = threadContext();
     BigNum result = BigNum::create();
 
-    if (!ctx.isValid() || !result.isValid())
+    if (!ctx || !result.isValid())
         return false;
 
     if (!BN_nnmod(result, B, N, ctx))
@@ -271,15 +549,17 @@ BigNum SrpMath::calc_v(std::u16string_view I, std::u16string_view p, const BigNu
     if (I.empty() || p.empty() || !N.isValid() || !g.isValid() || !s.isValid())
         return BigNum();
 
-    BigNum::Context ctx = BigNum::Context::create();
+    BN_CTX* ctx = threadContext();
     BigNum v = BigNum::create();
 
-    if (!ctx.isValid() || !v.isValid())
+    if (!ctx || !v.isValid())
         return BigNum();
 
     BigNum x = calc_x(s, I, p);
+    if (!x.isValid())
+        return BigNum();
 
-    if (!BN_mod_exp(v, g, x, N, ctx))
+    if (!modExpSecret(v, g, x, N, ctx))
         return BigNum();
 
     return v;
@@ -292,15 +572,17 @@ BigNum SrpMath::calc_v(std::u16string_view I, const ByteArray& p, const BigNum&
     if (I.empty() || p.empty() || !N.isValid() || !g.isValid() || !s.isValid())
         return BigNum();
 
-    BigNum::Context ctx = BigNum::Context::create();
+    BN_CTX* ctx = threadContext();
     BigNum v = BigNum::create();
 
-    if (!ctx.isValid() || !v.isValid())
+    if (!ctx || !v.isValid())
         return BigNum();
 
     BigNum x = calc_x(s, I, p);
+    if (!x.isValid())
+        return BigNum();
 
-    if (!BN_mod_exp(v, g, x, N, ctx))
+    if (!modExpSecret(v, g, x, N, ctx))
         return BigNum();
 
     return v;
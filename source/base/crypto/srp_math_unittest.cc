@@ -16,10 +16,12 @@
 // along with this program. If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include "base/crypto/random.h"
 #include "base/crypto/srp_constants.h"
 #include "base/crypto/srp_math.h"
 
 #include <gtest/gtest.h>
+#include <openssl/bn.h>
 
 namespace base {
 
@@ -190,4 +192,46 @@ TEST(srp_math_test, test_vector)
     ASSERT_EQ(memcmp(client_key_string.c_str(), key_ref_buf, sizeof(key_ref_buf)), 0);
 }
 
+TEST(srp_math_test, calc_B_groups)
+{
+    const SrpNgPair* pairs[] =
+    {
+        &kSrpNgPair_1024, &kSrpNgPair_1536, &kSrpNgPair_2048, &kSrpNgPair_3072,
+        &kSrpNgPair_4096, &kSrpNgPair_6144, &kSrpNgPair_8192
+    };
+
+    BigNum::Context ctx = BigNum::Context::create();
+    ASSERT_TRUE(ctx.isValid());
+
+    for (const SrpNgPair* pair : pairs)
+    {
+        BigNum N = BigNum::fromStdString(pair->first);
+        BigNum g = BigNum::fromStdString(pair->second);
+        BigNum v = BigNum::fromByteArray(Random::byteArray(64));
+        ASSERT_TRUE(N.isValid() && g.isValid() && v.isValid());
+
+        BigNum k = SrpMath::calc_u(N, g, N); // k = BLAKE2b512(N | PAD(g))
+        ASSERT_TRUE(k.isValid());
+
+        // Exponents with the precomputed table (up to 1024 bits) and without it.
+        for (size_t b_size : { 1, 32, 128, 129, 256 })
+        {
+            BigNum b = BigNum::fromByteArray(Random::byteArray(b_size));
+            ASSERT_TRUE(b.isValid());
+
+            BigNum B = SrpMath::calc_B(b, N, g, v);
+            ASSERT_TRUE(B.isValid());
+
+            BigNum expected = BigNum::create();
+            BigNum kv = BigNum::create();
+            ASSERT_TRUE(BN_mod_exp(expected, g, b, N, ctx));
+            ASSERT_TRUE(BN_mod_mul(kv, v, k, N, ctx));
+            ASSERT_TRUE(BN_mod_add(expected, expected, kv, N, ctx));
+
+            EXPECT_EQ(BN_cmp(B, expected), 0) << "N bits: " << BN_num_bits(N)
+                                               << ", b bytes: " << b_size;
+        }
+    }
+}
+
 } // namespace base
@@ -21,6 +21,7 @@
 #include "base/location.h"
 #include "base/logging.h"
 #include "base/ipc/ipc_channel_proxy.h"
+#include "base/memory/buffer_pool.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_pump_asio.h"
 #include "base/strings/unicode.h"
@@ -358,6 +359,7 @@ void IpcChannel::doWrite()
             DCHECK(!write_queue_.empty());
 
             // Delete the sent message from the queue.
+            BufferPool::release(std::move(write_queue_.front()));
             write_queue_.pop();
 
             // If the queue is not empty, then we send the following message.
@@ -0,0 +1,345 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/memory/buffer_pool.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace base {
+
+namespace {
+
+const size_t kMinClassShift = 8; // 256 bytes.
+const size_t kMaxClassShift = 19; // 512 kB.
+const size_t kClassCount = kMaxClassShift - kMinClassShift + 1;
+
+// Memory that may be kept in one thread cache and in the shared cache, for all size classes.
+// Buffers larger than the largest class are rare (key frames) and are not pooled, so that a
+// burst of them does not stay in memory.
+const size_t kThreadCacheBytes = 2 * 1024 * 1024;
+const size_t kSharedCacheBytes = 8 * 1024 * 1024;
+
+using FreeList = std::vector<ByteArray>;
+using FreeLists = std::array<FreeList, kClassCount>;
+
+size_t classSize(size_t index)
+{
+    return size_t(1) << (index + kMinClassShift);
+}
+
+// Returns the smallest size class which holds |size| bytes or kClassCount if there is none.
+size_t classForSize(size_t size)
+{
+    for (size_t index = 0; index < kClassCount; ++index)
+    {
+        if (size <= classSize(index))
+            return index;
+    }
+
+    return kClassCount;
+}
+
+// Returns the largest size class which fits into |capacity| bytes or kClassCount if there is none.
+size_t classForCapacity(size_t capacity)
+{
+    if (capacity < classSize(0) || capacity >= classSize(kClassCount))
+        return kClassCount;
+
+    size_t index = 0;
+    while (index + 1 < kClassCount && classSize(index + 1) <= capacity)
+        ++index;
+
+    return index;
+}
+
+// Moves |count| buffers from the end of |from| to |to|.
+void moveBuffers(FreeList* from, size_t count, FreeList* to)
+{
+    DCHECK_LE(count, from->size());
+
+    std::move(from->end() - count, from->end(), std::back_inserter(*to));
+    from->resize(from->size() - count);
+}
+
+struct Counters
+{
+    std::atomic<int64_t> allocated { 0 };
+    std::atomic<int64_t> reused { 0 };
+    std::atomic<int64_t> recycled { 0 };
+    std::atomic<int64_t> dropped { 0 };
+};
+
+Counters g_counters;
+
+void increment(std::atomic<int64_t>& counter, int64_t value = 1)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+class SharedCache
+{
+public:
+    // Moves up to |count| buffers of the size class to |list|. Returns the number of buffers.
+    size_t take(size_t index, size_t count, FreeList* list)
+    {
+        std::scoped_lock lock(lock_);
+
+        FreeList& shared = lists_[index];
+        count = std::min(count, shared.size());
+
+        moveBuffers(&shared, count, list);
+        bytes_ -= count * classSize(index);
+        return count;
+    }
+
+    // Moves the buffers from |lists| to the cache. The buffers that do not fit are freed.
+    void put(FreeLists* lists)
+    {
+        int64_t dropped = 0;
+
+        {
+            std::scoped_lock lock(lock_);
+
+            for (size_t index = 0; index < kClassCount; ++index)
+            {
+                FreeList* list = &(*lists)[index];
+                const size_t count =
+                    std::min(list->size(), (kSharedCacheBytes - bytes_) / classSize(index));
+
+                moveBuffers(list, count, &lists_[index]);
+                bytes_ += count * classSize(index);
+
+                dropped += static_cast<int64_t>(list->size());
+            }
+        }
+
+        // The memory is freed outside the lock.
+        for (FreeList& list : *lists)
+            list.clear();
+
+        if (dropped)
+            increment(g_counters.dropped, dropped);
+    }
+
+    void clear()
+    {
+        FreeLists lists;
+
+        {
+            std::scoped_lock lock(lock_);
+            lists.swap(lists_);
+            bytes_ = 0;
+        }
+
+        int64_t dropped = 0;
+        for (const FreeList& list : lists)
+            dropped += static_cast<int64_t>(list.size());
+
+        if (dropped)
+            increment(g_counters.dropped, dropped);
+    }
+
+private:
+    std::mutex lock_;
+    FreeLists lists_;
+    size_t bytes_ = 0;
+};
+
+// Set when the cache of the current thread is destroyed. Objects destroyed after it at the exit of
+// the thread do not use the pool.
+thread_local bool thread_cache_destroyed = false;
+
+SharedCache& sharedCache()
+{
+    // The cache is never destroyed, because thread caches are flushed to it when threads exit,
+    // which may happen after the destruction of static objects.
+    static SharedCache* cache = new SharedCache();
+    return *cache;
+}
+
+class ThreadCache
+{
+public:
+    ThreadCache() = default;
+
+    ~ThreadCache()
+    {
+        thread_cache_destroyed = true;
+        sharedCache().put(&lists_);
+    }
+
+    bool take(size_t index, ByteArray* buffer)
+    {
+        FreeList& list = lists_[index];
+        const size_t size = classSize(index);
+
+        // Several buffers are taken at once, so that the shared cache is locked rarely.
+        if (list.empty())
+        {
+            const size_t count = std::max((kThreadCacheBytes - bytes_) / size / 8, size_t(1));
+            bytes_ += sharedCache().take(index, count, &list) * size;
+        }
+
+        if (list.empty())
+            return false;
+
+        *buffer = std::move(list.back());
+        list.pop_back();
+        bytes_ -= size;
+        return true;
+    }
+
+    void put(size_t index, ByteArray&& buffer)
+    {
+        const size_t size = classSize(index);
+
+        // Buffers that are allocated on one thread and released on another accumulate in the
+        // cache of the second one. When the cache is full, a half of each size class is moved to
+        // the shared cache for other threads.
+        if (bytes_ + size > kThreadCacheBytes)
+        {
+            FreeLists excess;
+
+            for (size_t i = 0; i < kClassCount; ++i)
+            {
+                const size_t count = (lists_[i].size() + 1) / 2;
+
+                moveBuffers(&lists_[i], count, &excess[i]);
+                bytes_ -= count * classSize(i);
+            }
+
+            sharedCache().put(&excess);
+        }
+
+        lists_[index].emplace_back(std::move(buffer));
+        bytes_ += size;
+    }
+
+    void clear()
+    {
+        int64_t dropped = 0;
+
+        for (FreeList& list : lists_)
+        {
+            dropped += static_cast<int64_t>(list.size());
+            list.clear();
+            list.shrink_to_fit();
+        }
+
+        bytes_ = 0;
+
+        if (dropped)
+            increment(g_counters.dropped, dropped);
+    }
+
+private:
+    FreeLists lists_;
+    size_t bytes_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(ThreadCache);
+};
+
+ThreadCache* threadCache()
+{
+    if (thread_cache_destroyed)
+        return nullptr;
+
+    thread_local ThreadCache cache;
+    return &cache;
+}
+
+} // namespace
+
+// static
+ByteArray BufferPool::acquire(size_t size)
+{
+    ByteArray buffer;
+    if (!size)
+        return buffer;
+
+    const size_t index = classForSize(size);
+    ThreadCache* cache = index < kClassCount ? threadCache() : nullptr;
+
+    if (cache && cache->take(index, &buffer))
+    {
+        increment(g_counters.reused);
+    }
+    else
+    {
+        if (index < kClassCount)
+            buffer.reserve(classSize(index));
+
+        increment(g_counters.allocated);
+    }
+
+    buffer.resize(size);
+    return buffer;
+}
+
+// static
+void BufferPool::release(ByteArray&& buffer)
+{
+    ByteArray local(std::move(buffer));
+    buffer.clear();
+
+    if (!local.capacity())
+        return;
+
+    const size_t index = classForCapacity(local.capacity());
+    ThreadCache* cache = index < kClassCount ? threadCache() : nullptr;
+
+    if (!cache)
+    {
+        increment(g_counters.dropped);
+        return;
+    }
+
+    local.clear();
+    cache->put(index, std::move(local));
+
+    increment(g_counters.recycled);
+}
+
+// static
+void BufferPool::trim()
+{
+    if (ThreadCache* cache = threadCache())
+        cache->clear();
+
+    sharedCache().clear();
+}
+
+// static
+BufferPool::Stat BufferPool::stat()
+{
+    Stat stat;
+    stat.allocated = g_counters.allocated.load(std::memory_order_relaxed);
+    stat.reused = g_counters.reused.load(std::memory_order_relaxed);
+    stat.recycled = g_counters.recycled.load(std::memory_order_relaxed);
+    stat.dropped = g_counters.dropped.load(std::memory_order_relaxed);
+    return stat;
+}
+
+} // namespace base
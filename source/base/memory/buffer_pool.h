@@ -0,0 +1,64 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__MEMORY__BUFFER_POOL_H
+#define BASE__MEMORY__BUFFER_POOL_H
+
+#include "base/macros_magic.h"
+#include "base/memory/byte_array.h"
+
+#include <cstdint>
+
+namespace base {
+
+// Recycles the memory of message buffers. Buffers are grouped in size classes (powers of two from
+// 256 bytes to 512 kB); larger buffers are not pooled. Each thread has its own cache of free
+// buffers. A buffer can be released on any thread: the excess of a thread cache is moved to a
+// cache shared by all threads, from which other threads take buffers when their own cache is
+// empty. Each cache has a limit on the total size of the buffers in it.
+class BufferPool
+{
+public:
+    struct Stat
+    {
+        int64_t allocated = 0; // Buffers allocated from the heap.
+        int64_t reused = 0;    // Buffers taken from the pool.
+        int64_t recycled = 0;  // Buffers returned to the pool.
+        int64_t dropped = 0;   // Buffers freed instead of being kept in the pool.
+    };
+
+    // Returns a buffer of |size| bytes. The capacity of the buffer is rounded up to the size class.
+    static ByteArray acquire(size_t size);
+
+    // Returns the memory of |buffer| to the pool. |buffer| is left empty.
+    static void release(ByteArray&& buffer);
+
+    // Frees the buffers cached for the current thread and the shared cache. Called when a large
+    // amount of buffers is no longer needed, for example when a session is closed.
+    static void trim();
+
+    // Counters for all threads since the start of the process.
+    static Stat stat();
+
+private:
+    DISALLOW_IMPLICIT_CONSTRUCTORS(BufferPool);
+};
+
+} // namespace base
+
+#endif // BASE__MEMORY__BUFFER_POOL_H
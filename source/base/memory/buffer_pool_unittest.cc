@@ -0,0 +1,114 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/memory/buffer_pool.h"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace base {
+
+TEST(BufferPool, Reuse)
+{
+    ByteArray buffer = BufferPool::acquire(1000);
+    EXPECT_EQ(buffer.size(), 1000U);
+    EXPECT_GE(buffer.capacity(), 1000U);
+
+    const uint8_t* data = buffer.data();
+    BufferPool::release(std::move(buffer));
+    EXPECT_TRUE(buffer.empty());
+
+    BufferPool::Stat before = BufferPool::stat();
+
+    // The buffer of the same size class is taken from the pool.
+    buffer = BufferPool::acquire(600);
+    EXPECT_EQ(buffer.size(), 600U);
+    EXPECT_EQ(buffer.data(), data);
+
+    BufferPool::Stat after = BufferPool::stat();
+    EXPECT_EQ(after.allocated, before.allocated);
+    EXPECT_EQ(after.reused, before.reused + 1);
+
+    BufferPool::release(std::move(buffer));
+}
+
+TEST(BufferPool, LargeBuffer)
+{
+    const size_t kSize = 2 * 1024 * 1024;
+
+    BufferPool::Stat before = BufferPool::stat();
+
+    ByteArray buffer = BufferPool::acquire(kSize);
+    EXPECT_EQ(buffer.size(), kSize);
+
+    // Buffers larger than the largest size class are not pooled.
+    BufferPool::release(std::move(buffer));
+
+    BufferPool::Stat after = BufferPool::stat();
+    EXPECT_EQ(after.allocated, before.allocated + 1);
+    EXPECT_EQ(after.recycled, before.recycled);
+    EXPECT_EQ(after.dropped, before.dropped + 1);
+}
+
+TEST(BufferPool, CrossThread)
+{
+    const size_t kSize = 100 * 1024;
+
+    ByteArray buffer = BufferPool::acquire(kSize);
+    const uint8_t* data = buffer.data();
+
+    // The buffer is released on another thread and moved to the shared cache when it exits.
+    std::thread thread([&buffer]()
+    {
+        BufferPool::release(std::move(buffer));
+    });
+    thread.join();
+
+    BufferPool::Stat before = BufferPool::stat();
+
+    buffer = BufferPool::acquire(kSize);
+    EXPECT_EQ(buffer.data(), data);
+
+    BufferPool::Stat after = BufferPool::stat();
+    EXPECT_EQ(after.allocated, before.allocated);
+    EXPECT_EQ(after.reused, before.reused + 1);
+
+    BufferPool::release(std::move(buffer));
+}
+
+TEST(BufferPool, Trim)
+{
+    ByteArray buffer = BufferPool::acquire(3000);
+    BufferPool::release(std::move(buffer));
+
+    BufferPool::Stat before = BufferPool::stat();
+    BufferPool::trim();
+
+    // The cached buffer is freed, so a new one is allocated.
+    buffer = BufferPool::acquire(3000);
+
+    BufferPool::Stat after = BufferPool::stat();
+    EXPECT_GE(after.dropped, before.dropped + 1);
+    EXPECT_EQ(after.allocated, before.allocated + 1);
+    EXPECT_EQ(after.reused, before.reused);
+
+    BufferPool::release(std::move(buffer));
+}
+
+} // namespace base
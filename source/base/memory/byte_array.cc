@@ -19,6 +19,7 @@
 #include "base/memory/byte_array.h"
 
 #include "base/logging.h"
+#include "base/memory/buffer_pool.h"
 
 namespace base {
 
@@ -128,13 +129,18 @@ base::ByteArray serialize(const google::protobuf::MessageLite& message)
     if (!size)
         return base::ByteArray();
 
-    base::ByteArray buffer;
-    buffer.resize(size);
-
+    base::ByteArray buffer = BufferPool::acquire(size);
     message.SerializeWithCachedSizesToArray(buffer.data());
     return buffer;
 }
 
+base::ByteArray serialize(const google::protobuf::MessageLite& message, size_t headroom)
+{
+    base::ByteArray buffer = BufferPool::acquire(headroom + message.ByteSizeLong());
+    message.SerializeWithCachedSizesToArray(buffer.data() + headroom);
+    return buffer;
+}
+
 int compare(const base::ByteArray& first, const base::ByteArray& second)
 {
     if (first.empty() && second.empty())
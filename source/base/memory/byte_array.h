@@ -37,8 +37,13 @@ std::string toStdString(const ByteArray& in);
 ByteArray fromHex(std::string_view in);
 std::string toHex(const ByteArray& in);
 
+// The buffers returned by serialize() are taken from BufferPool. They can be returned to it with
+// BufferPool::release() when they are no longer needed.
 base::ByteArray serialize(const google::protobuf::MessageLite& message);
 
+// Serializes |message| after |headroom| bytes that are left free for a header.
+base::ByteArray serialize(const google::protobuf::MessageLite& message, size_t headroom);
+
 template <class T>
 bool parse(const base::ByteArray& buffer, T* message)
 {
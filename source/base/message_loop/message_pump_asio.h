@@ -20,6 +20,7 @@
 #define BASE__MESSAGE_LOOP__MESSAGE_PUMP_ASIO_H
 
 #include "base/macros_magic.h"
+#include "base/timing_wheel.h"
 #include "base/message_loop/message_pump.h"
 
 #include <asio/io_context.hpp>
@@ -40,11 +41,15 @@ public:
 
     asio::io_context& ioContext() { return io_context_; }
 
+    // Timing wheel for coarse timers (timeouts, keep alive) of this thread.
+    TimingWheel& timingWheel() { return timing_wheel_; }
+
 private:
     // This flag is set to false when run() should return.
     bool keep_running_ = true;
 
     asio::io_context io_context_;
+    TimingWheel timing_wheel_ { &io_context_ };
 
     // The time at which we should call doDelayedWork.
     TimePoint delayed_work_time_;
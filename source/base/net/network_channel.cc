@@ -30,16 +30,30 @@
 #include "base/strings/string_printf.h"
 #include "base/strings/unicode.h"
 
+#include <asio/buffer.hpp>
 #include <asio/connect.hpp>
-#include <asio/read.hpp>
 #include <asio/write.hpp>
 
+#include <algorithm>
+#include <array>
+
 namespace base {
 
 namespace {
 
 static const size_t kMaxMessageSize = 16 * 1024 * 1024; // 16 MB
 
+// Size of the read buffer of a thread. One read takes as much data from the socket as fits in the
+// buffer, and all complete messages are processed at once.
+static const size_t kReadBufferSize = 64 * 1024; // 64 kB
+
+// Queued messages are gathered into one write until it reaches this size.
+static const size_t kWriteBatchSize = 256 * 1024; // 256 kB
+
+// Smaller messages are copied into one buffer when encrypted, so that a write does not consist of
+// many small pieces. Larger messages are encrypted in place if they have room for the header.
+static const size_t kMinInPlaceSize = 4 * 1024; // 4 kB
+
 int calculateSpeed(int last_speed, const std::chrono::milliseconds& duration, int64_t bytes)
 {
     static const double kAlpha = 0.1;
@@ -61,6 +75,15 @@ void resizeBuffer(ByteArray* buffer, size_t new_size)
     buffer->resize(new_size);
 }
 
+// Data is read into a buffer shared by all channels of the thread and only the unprocessed rest
+// is copied into the channel, so idle channels do not keep read buffers. Asio handlers of a thread
+// do not nest, so the buffer is used by one channel at a time.
+uint8_t* threadReadBuffer()
+{
+    thread_local std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(kReadBufferSize);
+    return buffer.get();
+}
+
 } // namespace
 
 NetworkChannel::NetworkChannel()
@@ -178,29 +201,35 @@ void NetworkChannel::resume()
 
     paused_ = false;
 
-    switch (state_)
-    {
-        // We already have an incomplete read operation.
-        case ReadState::READ_SIZE:
-        case ReadState::READ_USER_DATA:
-        case ReadState::READ_SERVICE_HEADER:
-        case ReadState::READ_SERVICE_DATA:
-            return;
+    // We already have an incomplete read operation.
+    if (state_ == ReadState::READ)
+        return;
 
-        default:
-            break;
+    // If we have messages that were received before the pause command.
+    if (state_ == ReadState::PENDING)
+    {
+        processReadBuffer();
+        return;
     }
 
-    // If we have a message that was received before the pause command.
-    if (state_ == ReadState::PENDING)
-        onMessageReceived();
+    doRead();
+}
 
-    doReadSize();
+void NetworkChannel::send(ByteArray&& buffer, Priority priority, bool replace_pending)
+{
+    addWriteTask(
+        WriteTask(WriteTask::Type::USER_DATA, priority, replace_pending, std::move(buffer)));
 }
 
-void NetworkChannel::send(ByteArray&& buffer)
+void NetworkChannel::send(const google::protobuf::MessageLite& message,
+                          Priority priority,
+                          bool replace_pending)
 {
-    addWriteTask(WriteTask::Type::USER_DATA, std::move(buffer));
+    addWriteTask(WriteTask(WriteTask::Type::USER_DATA,
+                           priority,
+                           replace_pending,
+                           serialize(message, WriteTask::kHeadroom),
+                           WriteTask::kHeadroom));
 }
 
 bool NetworkChannel::setNoDelay(bool enable)
@@ -251,11 +280,7 @@ bool NetworkChannel::setOwnKeepAlive(bool enable, const Seconds& interval, const
     {
         keep_alive_counter_.clear();
 
-        if (keep_alive_timer_)
-        {
-            keep_alive_timer_->cancel();
-            keep_alive_timer_.reset();
-        }
+        keep_alive_timer_.reset();
     }
     else
     {
@@ -265,10 +290,11 @@ bool NetworkChannel::setOwnKeepAlive(bool enable, const Seconds& interval, const
         keep_alive_counter_.resize(sizeof(uint32_t));
         memset(keep_alive_counter_.data(), 0, keep_alive_counter_.size());
 
-        keep_alive_timer_ = std::make_unique<asio::high_resolution_timer>(io_context_);
-        keep_alive_timer_->expires_after(keep_alive_interval_);
-        keep_alive_timer_->async_wait(
-            std::bind(&NetworkChannel::onKeepAliveInterval, this, std::placeholders::_1));
+        // Keep alive timers of all channels of the thread are served by one timing wheel.
+        keep_alive_timer_ = std::make_unique<TimingWheel::Timer>(
+            &MessageLoop::current()->pumpAsio()->timingWheel());
+        keep_alive_timer_->start(keep_alive_interval_,
+                                 std::bind(&NetworkChannel::onKeepAliveInterval, this));
     }
 
     return true;
@@ -334,6 +360,11 @@ int NetworkChannel::speedTx()
     return speed_tx_;
 }
 
+WriteQueue::Stat NetworkChannel::writeQueueStat(Priority priority) const
+{
+    return write_queue_.stat(priority);
+}
+
 // static
 std::string NetworkChannel::errorToString(ErrorCode error_code)
 {
@@ -396,6 +427,9 @@ void NetworkChannel::disconnect()
 
     connected_ = false;
 
+    if (keep_alive_timer_)
+        keep_alive_timer_->stop();
+
     std::error_code ignored_code;
 
     socket_.cancel(ignored_code);
@@ -443,17 +477,17 @@ void NetworkChannel::onErrorOccurred(const Location& location, ErrorCode error_c
     }
 }
 
-void NetworkChannel::onMessageWritten()
+void NetworkChannel::onMessageWritten(size_t batch_pending)
 {
     if (listener_)
-        listener_->onMessageWritten(write_queue_.size());
+        listener_->onMessageWritten(write_queue_.size() + batch_pending);
 }
 
-void NetworkChannel::onMessageReceived()
+void NetworkChannel::onMessageReceived(const uint8_t* data, size_t size)
 {
-    resizeBuffer(&decrypt_buffer_, decryptor_->decryptedDataSize(read_buffer_.size()));
+    resizeBuffer(&decrypt_buffer_, decryptor_->decryptedDataSize(size));
 
-    if (!decryptor_->decrypt(read_buffer_.data(), read_buffer_.size(), decrypt_buffer_.data()))
+    if (!decryptor_->decrypt(data, size, decrypt_buffer_.data()))
     {
         onErrorOccurred(FROM_HERE, ErrorCode::ACCESS_DENIED);
         return;
@@ -463,72 +497,158 @@ void NetworkChannel::onMessageReceived()
         listener_->onMessageReceived(decrypt_buffer_);
 }
 
-void NetworkChannel::addWriteTask(WriteTask::Type type, ByteArray&& data)
+void NetworkChannel::addWriteTask(WriteTask&& task)
 {
-    const bool schedule_write = write_queue_.empty();
+    // Add the task to the queue for sending.
+    write_queue_.push(std::move(task));
 
-    // Add the buffer to the queue for sending.
-    write_queue_.emplace(type, std::move(data));
-
-    if (schedule_write)
+    // If a write is in progress, the task is sent after it is complete.
+    if (write_batch_.empty())
         doWrite();
 }
 
 void NetworkChannel::doWrite()
 {
-    const ByteArray& source_buffer = write_queue_.front().data();
-    if (source_buffer.empty())
-    {
-        onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
-        return;
-    }
+    DCHECK(!write_queue_.empty());
+    DCHECK(write_batch_.empty());
 
-    if (write_queue_.front().type() == WriteTask::Type::USER_DATA)
-    {
-        // Calculate the size of the encrypted message.
-        const size_t target_data_size = encryptor_->encryptedDataSize(source_buffer.size());
+    // Take the messages from the queue in the order of priority while they fit into one write.
+    // Messages that are not encrypted in place are copied into |write_buffer_|, so its size is
+    // calculated too.
+    size_t batch_bytes = 0;
+    size_t copy_bytes = 0;
 
-        if (target_data_size > kMaxMessageSize)
+    while (!write_queue_.empty())
+    {
+        const WriteTask& task = write_queue_.front();
+        if (!task.size())
         {
             onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
             return;
         }
 
-        asio::const_buffer variable_size = variable_size_writer_.variableSize(target_data_size);
+        size_t message_size = task.size();
+        bool in_place = false;
 
-        resizeBuffer(&write_buffer_, variable_size.size() + target_data_size);
+        if (task.type() == WriteTask::Type::USER_DATA)
+        {
+            // Calculate the size of the encrypted message.
+            const size_t target_data_size = encryptor_->encryptedDataSize(task.size());
 
-        // Copy the size of the message to the buffer.
-        memcpy(write_buffer_.data(), variable_size.data(), variable_size.size());
+            if (target_data_size > kMaxMessageSize)
+            {
+                onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
+                return;
+            }
 
-        // Encrypt the message.
-        if (!encryptor_->encrypt(source_buffer.data(),
-                                 source_buffer.size(),
-                                 write_buffer_.data() + variable_size.size()))
-        {
-            onErrorOccurred(FROM_HERE, ErrorCode::ACCESS_DENIED);
-            return;
+            message_size = variable_size_writer_.variableSize(target_data_size).size() +
+                target_data_size;
+            in_place = isInPlace(task, message_size);
         }
+
+        // The first message is always sent, even if it is larger than the batch.
+        if (!write_batch_.empty() && batch_bytes + message_size > kWriteBatchSize)
+            break;
+
+        batch_bytes += message_size;
+        if (!in_place)
+            copy_bytes += message_size;
+
+        write_batch_.emplace_back(write_queue_.pop());
     }
-    else
+
+    resizeBuffer(&write_buffer_, copy_bytes);
+    write_buffers_.clear();
+
+    // The second pass prepares each message where it will be sent from.
+    uint8_t* target = write_buffer_.data();
+
+    for (WriteTask& task : write_batch_)
     {
-        DCHECK_EQ(write_queue_.front().type(), WriteTask::Type::SERVICE_DATA);
+        if (task.type() == WriteTask::Type::USER_DATA)
+        {
+            const size_t target_data_size = encryptor_->encryptedDataSize(task.size());
+            const size_t header_size = target_data_size - task.size();
+            asio::const_buffer variable_size = variable_size_writer_.variableSize(target_data_size);
+            const size_t message_size = variable_size.size() + target_data_size;
 
-        resizeBuffer(&write_buffer_, source_buffer.size());
+            if (isInPlace(task, message_size))
+            {
+                // The size and the header are written before the data and the message is
+                // encrypted without copying.
+                uint8_t* header = task.data() - header_size;
+                uint8_t* message = header - variable_size.size();
+
+                memcpy(message, variable_size.data(), variable_size.size());
+
+                if (!encryptor_->encryptInPlace(header, task.data(), task.size()))
+                {
+                    onErrorOccurred(FROM_HERE, ErrorCode::ACCESS_DENIED);
+                    return;
+                }
+
+                write_buffers_.emplace_back(message, message_size);
+                continue;
+            }
+
+            // Copy the size of the message to the buffer.
+            memcpy(target, variable_size.data(), variable_size.size());
+
+            // Encrypt the message.
+            if (!encryptor_->encrypt(task.data(), task.size(), target + variable_size.size()))
+            {
+                onErrorOccurred(FROM_HERE, ErrorCode::ACCESS_DENIED);
+                return;
+            }
+
+            addWriteBuffer(target, message_size);
+            target += message_size;
+        }
+        else
+        {
+            DCHECK_EQ(task.type(), WriteTask::Type::SERVICE_DATA);
 
-        // Service data does not need encryption. Copy the source buffer.
-        memcpy(write_buffer_.data(), source_buffer.data(), source_buffer.size());
+            // Service data does not need encryption. Copy the source buffer.
+            memcpy(target, task.data(), task.size());
+            addWriteBuffer(target, task.size());
+            target += task.size();
+        }
     }
 
-    // Send the buffer to the recipient.
+    DCHECK_EQ(target, write_buffer_.data() + write_buffer_.size());
+
+    // Send the messages to the recipient with one gathered write.
     asio::async_write(socket_,
-                      asio::buffer(write_buffer_.data(), write_buffer_.size()),
+                      write_buffers_,
                       std::bind(&NetworkChannel::onWrite,
                                 this,
                                 std::placeholders::_1,
                                 std::placeholders::_2));
 }
 
+// static
+bool NetworkChannel::isInPlace(const WriteTask& task, size_t message_size)
+{
+    DCHECK_EQ(task.type(), WriteTask::Type::USER_DATA);
+    return task.size() >= kMinInPlaceSize && task.headroom() >= message_size - task.size();
+}
+
+void NetworkChannel::addWriteBuffer(const uint8_t* data, size_t size)
+{
+    // Adjacent pieces of |write_buffer_| are sent as one buffer.
+    if (!write_buffers_.empty())
+    {
+        asio::const_buffer& last = write_buffers_.back();
+        if (reinterpret_cast<const uint8_t*>(last.data()) + last.size() == data)
+        {
+            last = asio::const_buffer(last.data(), last.size() + size);
+            return;
+        }
+    }
+
+    write_buffers_.emplace_back(data, size);
+}
+
 void NetworkChannel::onWrite(const std::error_code& error_code, size_t bytes_transferred)
 {
     if (error_code)
@@ -537,320 +657,393 @@ void NetworkChannel::onWrite(const std::error_code& error_code, size_t bytes_tra
         return;
     }
 
-    DCHECK(!write_queue_.empty());
+    DCHECK(!write_batch_.empty());
 
     // Update TX statistics.
     addTxBytes(bytes_transferred);
 
-    WriteTask::Type task_type = write_queue_.front().type();
+    // Take the messages sent from other threads, so that they are counted as pending.
+    proxy_->reloadWriteQueue(&write_queue_);
 
-    // Delete the sent message from the queue.
-    write_queue_.pop();
-
-    // If the queue is not empty, then we send the following message.
-    bool schedule_write = !write_queue_.empty() || proxy_->reloadWriteQueue(&write_queue_);
+    // Listeners are notified about each message separately, as if they were written one by one.
+    for (size_t i = 0; i < write_batch_.size(); ++i)
+    {
+        if (write_batch_[i].type() == WriteTask::Type::USER_DATA)
+            onMessageWritten(write_batch_.size() - i - 1);
+    }
 
-    if (task_type == WriteTask::Type::USER_DATA)
-        onMessageWritten();
+    write_batch_.clear();
+    write_buffers_.clear();
 
-    if (schedule_write)
+    // If the queue is not empty, then we send the following messages.
+    if (!write_queue_.empty())
         doWrite();
 }
 
-void NetworkChannel::doReadSize()
+void NetworkChannel::doRead()
 {
-    state_ = ReadState::READ_SIZE;
-    asio::async_read(socket_,
-                     variable_size_reader_.buffer(),
-                     std::bind(&NetworkChannel::onReadSize,
-                               this,
-                               std::placeholders::_1,
-                               std::placeholders::_2));
+    state_ = ReadState::READ;
+
+    // The handler is called when the socket has data, then the data is taken with one
+    // non-blocking read.
+    socket_.async_wait(asio::ip::tcp::socket::wait_read,
+                       std::bind(&NetworkChannel::onReadReady, this, std::placeholders::_1));
 }
 
-void NetworkChannel::onReadSize(const std::error_code& error_code, size_t bytes_transferred)
+void NetworkChannel::onReadReady(const std::error_code& error_code)
 {
+    DCHECK_EQ(state_, ReadState::READ);
+
     if (error_code)
     {
         onErrorOccurred(FROM_HERE, error_code);
         return;
     }
 
+    if (message_size_)
+    {
+        readMessage();
+        return;
+    }
+
+    // The unprocessed rest is always smaller than the buffer of the thread. Larger messages are
+    // read directly into their buffer.
+    DCHECK_LT(read_buffer_.size(), kReadBufferSize);
+
+    uint8_t* buffer = threadReadBuffer();
+    size_t size = read_buffer_.size();
+
+    if (size)
+        memcpy(buffer, read_buffer_.data(), size);
+
+    size += readSome(asio::buffer(buffer + size, kReadBufferSize - size));
+    if (!connected_)
+        return;
+
+    size_t next_size = 0;
+    size_t processed = processMessages(buffer, size, &next_size);
+    if (!connected_)
+        return;
+
+    saveReadBuffer(buffer + processed, size - processed, next_size);
+    continueRead();
+}
+
+template <typename MutableBufferSequence>
+size_t NetworkChannel::readSome(const MutableBufferSequence& buffers)
+{
+    std::error_code error_code;
+
+    if (!socket_.non_blocking())
+        socket_.non_blocking(true, error_code);
+
+    size_t bytes_transferred = socket_.read_some(buffers, error_code);
+    if (error_code)
+    {
+        // The readiness notification may be spurious.
+        if (error_code == asio::error::would_block || error_code == asio::error::try_again)
+            return 0;
+
+        onErrorOccurred(FROM_HERE, error_code);
+        return 0;
+    }
+
     // Update RX statistics.
     addRxBytes(bytes_transferred);
+    return bytes_transferred;
+}
 
-    std::optional<size_t> size = variable_size_reader_.messageSize();
-    if (size.has_value())
+size_t NetworkChannel::processMessages(const uint8_t* data, size_t size, size_t* next_size)
+{
+    size_t pos = 0;
+    *next_size = 0;
+
+    while (pos < size && connected_ && !paused_)
     {
-        size_t message_size = size.value();
+        const uint8_t* message = data + pos;
+        const size_t available = size - pos;
+
+        size_t message_size;
+        size_t size_length = VariableSizeReader::read(message, available, &message_size);
+        if (!size_length)
+            break;
 
         if (message_size > kMaxMessageSize)
         {
             onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
-            return;
+            break;
         }
 
-        // If the message size is 0 (in other words, the first received byte is 0), then you need
-        // to start reading the service message.
+        // If the message size is 0 (in other words, the first received byte is 0), then it is a
+        // service message.
         if (!message_size)
         {
-            doReadServiceHeader();
-            return;
+            if (available < size_length + sizeof(ServiceHeader))
+                break;
+
+            ServiceHeader header;
+            memcpy(&header, message + size_length, sizeof(header));
+
+            // Keep alive is the only service message and it must always contain data.
+            if (header.type != KEEP_ALIVE || !header.length || header.length > kMaxMessageSize)
+            {
+                onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
+                break;
+            }
+
+            // Service messages are small and always fit into the read buffer.
+            const size_t total_size = size_length + sizeof(ServiceHeader) + header.length;
+            if (total_size > kReadBufferSize)
+            {
+                onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
+                break;
+            }
+
+            if (available < total_size)
+            {
+                *next_size = total_size;
+                break;
+            }
+
+            onServiceMessage(header, message + size_length + sizeof(ServiceHeader));
+            pos += total_size;
         }
+        else
+        {
+            const size_t total_size = size_length + message_size;
+            if (available < total_size)
+            {
+                *next_size = total_size;
+                break;
+            }
 
-        doReadUserData(message_size);
-    }
-    else
-    {
-        doReadSize();
+            onMessageReceived(message + size_length, message_size);
+            pos += total_size;
+        }
     }
-}
-
-void NetworkChannel::doReadUserData(size_t length)
-{
-    resizeBuffer(&read_buffer_, length);
 
-    state_ = ReadState::READ_USER_DATA;
-    asio::async_read(socket_,
-                     asio::buffer(read_buffer_.data(), read_buffer_.size()),
-                     std::bind(&NetworkChannel::onReadUserData,
-                               this,
-                               std::placeholders::_1,
-                               std::placeholders::_2));
+    return pos;
 }
 
-void NetworkChannel::onReadUserData(const std::error_code& error_code, size_t bytes_transferred)
+void NetworkChannel::processReadBuffer()
 {
-    DCHECK_EQ(state_, ReadState::READ_USER_DATA);
+    state_ = ReadState::READ;
 
-    if (error_code)
+    if (message_size_)
     {
-        onErrorOccurred(FROM_HERE, error_code);
+        // A large message was received before the pause command.
+        DCHECK_EQ(message_received_, message_size_);
+        DCHECK(read_buffer_.empty());
+
+        onMessageRead();
+        if (!connected_)
+            return;
+
+        continueRead();
         return;
     }
 
-    // Update RX statistics.
-    addRxBytes(bytes_transferred);
+    size_t next_size = 0;
+    size_t processed = processMessages(read_buffer_.data(), read_buffer_.size(), &next_size);
+    if (!connected_)
+        return;
 
-    DCHECK_EQ(bytes_transferred, read_buffer_.size());
+    // The rest is moved to the beginning of the buffer.
+    read_buffer_.erase(read_buffer_.begin(), read_buffer_.begin() + processed);
 
-    if (paused_)
+    if (!paused_ && next_size > kReadBufferSize)
     {
-        state_ = ReadState::PENDING;
-        return;
+        beginMessage(read_buffer_.data(), read_buffer_.size());
+        read_buffer_.clear();
     }
 
-    onMessageReceived();
+    continueRead();
+}
 
-    if (paused_)
+void NetworkChannel::saveReadBuffer(const uint8_t* data, size_t size, size_t next_size)
+{
+    // If the next message does not fit in the buffer of the thread, then the rest of it will be
+    // read directly into the buffer of the message.
+    if (!paused_ && next_size > kReadBufferSize)
     {
-        state_ = ReadState::IDLE;
+        beginMessage(data, size);
+        read_buffer_.clear();
         return;
     }
 
-    doReadSize();
+    resizeBuffer(&read_buffer_, size);
+    if (size)
+        memcpy(read_buffer_.data(), data, size);
 }
 
-void NetworkChannel::doReadServiceHeader()
+void NetworkChannel::beginMessage(const uint8_t* data, size_t size)
 {
-    resizeBuffer(&read_buffer_, sizeof(ServiceHeader));
+    size_t message_size = 0;
+    size_t size_length = VariableSizeReader::read(data, size, &message_size);
+    DCHECK_NE(size_length, 0U);
+    DCHECK_GT(message_size, kReadBufferSize - size_length);
+
+    data += size_length;
+    size -= size_length;
+
+    // The encrypted data is read into |decrypt_buffer_| and decrypted there. The bytes before it
+    // (the authentication tag) are kept separately.
+    const size_t data_size = decryptor_->decryptedDataSize(message_size);
 
-    state_ = ReadState::READ_SERVICE_HEADER;
-    asio::async_read(socket_,
-                     asio::buffer(read_buffer_.data(), read_buffer_.size()),
-                     std::bind(&NetworkChannel::onReadServiceHeader,
-                               this,
-                               std::placeholders::_1,
-                               std::placeholders::_2));
+    resizeBuffer(&message_header_, message_size - data_size);
+    resizeBuffer(&decrypt_buffer_, data_size);
+
+    message_size_ = message_size;
+    message_received_ = size;
+
+    // Copy the beginning of the message that is already received.
+    const size_t header_part = std::min(size, message_header_.size());
+    if (header_part)
+        memcpy(message_header_.data(), data, header_part);
+
+    if (size > header_part)
+        memcpy(decrypt_buffer_.data(), data + header_part, size - header_part);
 }
 
-void NetworkChannel::onReadServiceHeader(const std::error_code& error_code, size_t bytes_transferred)
+void NetworkChannel::readMessage()
 {
-    DCHECK_EQ(state_, ReadState::READ_SERVICE_HEADER);
-    DCHECK_EQ(read_buffer_.size(), sizeof(ServiceHeader));
+    DCHECK_LT(message_received_, message_size_);
 
-    if (error_code)
+    const size_t header_size = message_header_.size();
+    std::array<asio::mutable_buffer, 2> buffers;
+
+    if (message_received_ < header_size)
     {
-        onErrorOccurred(FROM_HERE, error_code);
-        return;
+        buffers[0] = asio::buffer(message_header_.data() + message_received_,
+                                  header_size - message_received_);
+        buffers[1] = asio::buffer(decrypt_buffer_.data(), decrypt_buffer_.size());
+    }
+    else
+    {
+        const size_t offset = message_received_ - header_size;
+        buffers[0] = asio::buffer(decrypt_buffer_.data() + offset, decrypt_buffer_.size() - offset);
     }
 
-    DCHECK_EQ(bytes_transferred, read_buffer_.size());
-
-    // Update RX statistics.
-    addRxBytes(bytes_transferred);
+    message_received_ += readSome(buffers);
+    if (!connected_)
+        return;
 
-    ServiceHeader* header = reinterpret_cast<ServiceHeader*>(read_buffer_.data());
-    if (header->length > kMaxMessageSize)
+    if (message_received_ < message_size_)
     {
-        onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
+        doRead();
         return;
     }
 
-    if (header->type == KEEP_ALIVE)
-    {
-        // Keep alive packet must always contain data.
-        if (!header->length)
-        {
-            onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
-            return;
-        }
-
-        doReadServiceData(header->length);
-    }
-    else
+    if (paused_)
     {
-        onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
+        // The listener will be notified after resume().
+        state_ = ReadState::PENDING;
         return;
     }
-}
 
-void NetworkChannel::doReadServiceData(size_t length)
-{
-    DCHECK_EQ(read_buffer_.size(), sizeof(ServiceHeader));
-    DCHECK_EQ(state_, ReadState::READ_SERVICE_HEADER);
-    DCHECK_GT(length, 0u);
-
-    read_buffer_.resize(read_buffer_.size() + length);
+    onMessageRead();
+    if (!connected_)
+        return;
 
-    // Now we read the data after the header.
-    state_ = ReadState::READ_SERVICE_DATA;
-    asio::async_read(socket_,
-                     asio::buffer(read_buffer_.data() + sizeof(ServiceHeader),
-                                  read_buffer_.size() - sizeof(ServiceHeader)),
-                     std::bind(&NetworkChannel::onReadServiceData,
-                               this,
-                               std::placeholders::_1,
-                               std::placeholders::_2));
+    continueRead();
 }
 
-void NetworkChannel::onReadServiceData(const std::error_code& error_code, size_t bytes_transferred)
+void NetworkChannel::onMessageRead()
 {
-    DCHECK_EQ(state_, ReadState::READ_SERVICE_DATA);
-    DCHECK_GT(read_buffer_.size(), sizeof(ServiceHeader));
+    message_size_ = 0;
+    message_received_ = 0;
 
-    if (error_code)
+    // The message is decrypted in the buffer where it was read and is passed to the listener
+    // without copying.
+    if (!decryptor_->decryptInPlace(
+            message_header_.data(), decrypt_buffer_.data(), decrypt_buffer_.size()))
     {
-        onErrorOccurred(FROM_HERE, error_code);
+        onErrorOccurred(FROM_HERE, ErrorCode::ACCESS_DENIED);
         return;
     }
 
-    // Update RX statistics.
-    addRxBytes(bytes_transferred);
-
-    // Incoming buffer contains a service header.
-    ServiceHeader* header = reinterpret_cast<ServiceHeader*>(read_buffer_.data());
-
-    DCHECK_EQ(bytes_transferred, read_buffer_.size() - sizeof(ServiceHeader));
-    DCHECK_LE(header->length, kMaxMessageSize);
+    if (listener_)
+        listener_->onMessageReceived(decrypt_buffer_);
+}
 
-    if (header->type == KEEP_ALIVE)
+void NetworkChannel::continueRead()
+{
+    if (paused_)
     {
-        if (header->flags & KEEP_ALIVE_PING)
-        {
-            // Send pong.
-            sendKeepAlive(KEEP_ALIVE_PONG,
-                          read_buffer_.data() + sizeof(ServiceHeader),
-                          read_buffer_.size() - sizeof(ServiceHeader));
-        }
-        else
-        {
-            if (read_buffer_.size() < (sizeof(ServiceHeader) + header->length))
-            {
-                onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
-                return;
-            }
-
-            if (header->length != keep_alive_counter_.size())
-            {
-                onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
-                return;
-            }
-
-            // Pong must contain the same data as ping.
-            if (memcmp(read_buffer_.data() + sizeof(ServiceHeader),
-                       keep_alive_counter_.data(),
-                       keep_alive_counter_.size()) != 0)
-            {
-                onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
-                return;
-            }
-
-            if (DCHECK_IS_ON())
-            {
-                Milliseconds ping_time = std::chrono::duration_cast<Milliseconds>(
-                    Clock::now() - keep_alive_timestamp_);
-
-                DLOG(LS_INFO) << "Ping result: " << ping_time.count() << " ms ("
-                              << keep_alive_counter_.size() << " bytes)";
-            }
+        // Messages received after the pause command will be processed after resume().
+        state_ = read_buffer_.empty() ? ReadState::IDLE : ReadState::PENDING;
+        return;
+    }
 
-            // The user can disable keep alive. Restart the timer only if keep alive is enabled.
-            if (keep_alive_timer_)
-            {
-                DCHECK(!keep_alive_counter_.empty());
+    doRead();
+}
 
-                // Increase the counter of sent packets.
-                largeNumberIncrement(&keep_alive_counter_);
+void NetworkChannel::onServiceMessage(const ServiceHeader& header, const uint8_t* data)
+{
+    DCHECK_EQ(header.type, KEEP_ALIVE);
+    DCHECK_LE(header.length, kMaxMessageSize);
 
-                // Restart keep alive timer.
-                keep_alive_timer_->expires_after(keep_alive_interval_);
-                keep_alive_timer_->async_wait(
-                    std::bind(&NetworkChannel::onKeepAliveInterval, this, std::placeholders::_1));
-            }
-        }
+    if (header.flags & KEEP_ALIVE_PING)
+    {
+        // Send pong.
+        sendKeepAlive(KEEP_ALIVE_PONG, data, header.length);
+        return;
     }
-    else
+
+    if (header.length != keep_alive_counter_.size())
     {
         onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
         return;
     }
 
-    doReadSize();
-}
-
-void NetworkChannel::onKeepAliveInterval(const std::error_code& error_code)
-{
-    if (error_code == asio::error::operation_aborted)
+    // Pong must contain the same data as ping.
+    if (memcmp(data, keep_alive_counter_.data(), keep_alive_counter_.size()) != 0)
+    {
+        onErrorOccurred(FROM_HERE, ErrorCode::INVALID_PROTOCOL);
         return;
+    }
 
-    DCHECK(keep_alive_timer_);
-
-    if (error_code)
+    if (DCHECK_IS_ON())
     {
-        LOG(LS_ERROR) << "Keep alive timer error: " << utf16FromLocal8Bit(error_code.message());
+        Milliseconds ping_time = std::chrono::duration_cast<Milliseconds>(
+            Clock::now() - keep_alive_timestamp_);
 
-        // Restarting the timer.
-        keep_alive_timer_->expires_after(keep_alive_interval_);
-        keep_alive_timer_->async_wait(
-            std::bind(&NetworkChannel::onKeepAliveInterval, this, std::placeholders::_1));
+        DLOG(LS_INFO) << "Ping result: " << ping_time.count() << " ms ("
+                      << keep_alive_counter_.size() << " bytes)";
     }
-    else
+
+    // The user can disable keep alive. Restart the timer only if keep alive is enabled.
+    if (keep_alive_timer_)
     {
-        // Save sending time.
-        keep_alive_timestamp_ = Clock::now();
+        DCHECK(!keep_alive_counter_.empty());
 
-        // Send ping.
-        sendKeepAlive(KEEP_ALIVE_PING, keep_alive_counter_.data(), keep_alive_counter_.size());
+        // Increase the counter of sent packets.
+        largeNumberIncrement(&keep_alive_counter_);
 
-        // If a response is not received within the specified interval, the connection will be
-        // terminated.
-        keep_alive_timer_->expires_after(keep_alive_timeout_);
-        keep_alive_timer_->async_wait(
-            std::bind(&NetworkChannel::onKeepAliveTimeout, this, std::placeholders::_1));
+        // Restart keep alive timer.
+        keep_alive_timer_->start(keep_alive_interval_,
+                                 std::bind(&NetworkChannel::onKeepAliveInterval, this));
     }
 }
 
-void NetworkChannel::onKeepAliveTimeout(const std::error_code& error_code)
+void NetworkChannel::onKeepAliveInterval()
 {
-    if (error_code == asio::error::operation_aborted)
-        return;
+    DCHECK(keep_alive_timer_);
 
-    if (error_code)
-    {
-        LOG(LS_ERROR) << "Keep alive timer error: " << utf16FromLocal8Bit(error_code.message());
-    }
+    // Save sending time.
+    keep_alive_timestamp_ = Clock::now();
+
+    // Send ping.
+    sendKeepAlive(KEEP_ALIVE_PING, keep_alive_counter_.data(), keep_alive_counter_.size());
 
+    // If a response is not received within the specified interval, the connection will be
+    // terminated.
+    keep_alive_timer_->start(keep_alive_timeout_,
+                             std::bind(&NetworkChannel::onKeepAliveTimeout, this));
+}
+
+void NetworkChannel::onKeepAliveTimeout()
+{
     // No response came within the specified period of time. We forcibly terminate the connection.
     onErrorOccurred(FROM_HERE, ErrorCode::SOCKET_TIMEOUT);
 }
@@ -874,8 +1067,9 @@ void NetworkChannel::sendKeepAlive(uint8_t flags, const void* data, size_t size)
     memcpy(buffer.data() + sizeof(uint8_t), &header, sizeof(header));
     memcpy(buffer.data() + sizeof(uint8_t) + sizeof(header), data, size);
 
-    // Add a task to the queue.
-    addWriteTask(WriteTask::Type::SERVICE_DATA, std::move(buffer));
+    // Add a task to the queue. Service messages have the highest priority.
+    addWriteTask(WriteTask(
+        WriteTask::Type::SERVICE_DATA, Priority::REALTIME, false, std::move(buffer)));
 }
 
 void NetworkChannel::addTxBytes(size_t bytes_count)
@@ -19,14 +19,12 @@
 #ifndef BASE__NET__NETWORK_CHANNEL_H
 #define BASE__NET__NETWORK_CHANNEL_H
 
+#include "base/timing_wheel.h"
 #include "base/memory/byte_array.h"
 #include "base/net/variable_size.h"
-#include "base/net/write_task.h"
+#include "base/net/write_queue.h"
 
 #include <asio/ip/tcp.hpp>
-#include <asio/high_resolution_timer.hpp>
-
-#include <queue>
 
 namespace base {
 
@@ -47,6 +45,7 @@ public:
     using TimePoint = std::chrono::time_point<Clock>;
     using Milliseconds = std::chrono::milliseconds;
     using Seconds = std::chrono::seconds;
+    using Priority = WriteTask::Priority;
 
     enum class ErrorCode
     {
@@ -129,8 +128,18 @@ public:
     void resume();
 
     // Sending a message. The method call is thread safe. After the call, the message will be added
-    // to the queue to be sent.
-    void send(ByteArray&& buffer);
+    // to the queue to be sent. Queued messages with a higher |priority| are sent first.
+    // If |replace_pending| is true, the unsent messages with the same priority are dropped (for
+    // example, video packets that are no longer needed after a key frame).
+    void send(ByteArray&& buffer,
+              Priority priority = Priority::REALTIME,
+              bool replace_pending = false);
+
+    // Same as above, but |message| is serialized directly into the buffer to be sent. The buffer
+    // has room for the header, so large messages are encrypted in place without copying.
+    void send(const google::protobuf::MessageLite& message,
+              Priority priority = Priority::REALTIME,
+              bool replace_pending = false);
 
     // Disable or enable the algorithm of Nagle.
     bool setNoDelay(bool enable);
@@ -157,6 +166,9 @@ public:
     int speedRx();
     int speedTx();
 
+    // Returns statistics of the send queue for messages with |priority|.
+    WriteQueue::Stat writeQueueStat(Priority priority) const;
+
     // Converts an error code to a human readable string.
     // Does not support localization. Used for logs.
     static std::string errorToString(ErrorCode error_code);
@@ -177,12 +189,9 @@ private:
 
     enum class ReadState
     {
-        IDLE,                // No reads are in progress right now.
-        READ_SIZE,           // Reading the message size.
-        READ_SERVICE_HEADER, // Reading the contents of the service header.
-        READ_SERVICE_DATA,   // Reading the contents of the service data.
-        READ_USER_DATA,      // Reading the contents of the user data.
-        PENDING              // There is a message about which we did not notify.
+        IDLE,   // No reads are in progress right now.
+        READ,   // Waiting for data or processing the received messages.
+        PENDING // There are received messages about which we did not notify.
     };
 
     enum ServiceMessageType
@@ -207,28 +216,39 @@ private:
 
     void onErrorOccurred(const Location& location, const std::error_code& error_code);
     void onErrorOccurred(const Location& location, ErrorCode error_code);
-    void onMessageWritten();
-    void onMessageReceived();
+    void onMessageWritten(size_t batch_pending);
+    void onMessageReceived(const uint8_t* data, size_t size);
+    void onServiceMessage(const ServiceHeader& header, const uint8_t* data);
 
-    void addWriteTask(WriteTask::Type type, ByteArray&& data);
+    void addWriteTask(WriteTask&& task);
 
     void doWrite();
+    static bool isInPlace(const WriteTask& task, size_t message_size);
+    void addWriteBuffer(const uint8_t* data, size_t size);
     void onWrite(const std::error_code& error_code, size_t bytes_transferred);
 
-    void doReadSize();
-    void onReadSize(const std::error_code& error_code, size_t bytes_transferred);
+    void doRead();
+    void onReadReady(const std::error_code& error_code);
 
-    void doReadUserData(size_t length);
-    void onReadUserData(const std::error_code& error_code, size_t bytes_transferred);
+    template <typename MutableBufferSequence>
+    size_t readSome(const MutableBufferSequence& buffers);
 
-    void doReadServiceHeader();
-    void onReadServiceHeader(const std::error_code& error_code, size_t bytes_transferred);
+    // Notifies about all complete messages in |data| until the channel is paused or closed.
+    // Returns the number of processed bytes. |next_size| receives the full size of the next
+    // incomplete message or 0 if it is not known yet.
+    size_t processMessages(const uint8_t* data, size_t size, size_t* next_size);
+    void processReadBuffer();
+    void saveReadBuffer(const uint8_t* data, size_t size, size_t next_size);
+    void continueRead();
 
-    void doReadServiceData(size_t length);
-    void onReadServiceData(const std::error_code& error_code, size_t bytes_transferred);
+    // A message that does not fit in the read buffer of the thread is read directly into the
+    // buffer where it is decrypted. |data| contains the beginning of the message.
+    void beginMessage(const uint8_t* data, size_t size);
+    void readMessage();
+    void onMessageRead();
 
-    void onKeepAliveInterval(const std::error_code& error_code);
-    void onKeepAliveTimeout(const std::error_code& error_code);
+    void onKeepAliveInterval();
+    void onKeepAliveTimeout();
     void sendKeepAlive(uint8_t flags, const void* data, size_t size);
 
     void addTxBytes(size_t bytes_count);
@@ -239,7 +259,7 @@ private:
     asio::ip::tcp::socket socket_;
     std::unique_ptr<asio::ip::tcp::resolver> resolver_;
 
-    std::unique_ptr<asio::high_resolution_timer> keep_alive_timer_;
+    std::unique_ptr<TimingWheel::Timer> keep_alive_timer_;
     Seconds keep_alive_interval_;
     Seconds keep_alive_timeout_;
     ByteArray keep_alive_counter_;
@@ -252,15 +272,28 @@ private:
     std::unique_ptr<MessageEncryptor> encryptor_;
     std::unique_ptr<MessageDecryptor> decryptor_;
 
-    std::queue<WriteTask> write_queue_;
+    // Messages that are taken from the queue and written with one write. The batch is not empty
+    // while the write is in progress.
+    WriteQueue write_queue_;
+    std::vector<WriteTask> write_batch_;
+    std::vector<asio::const_buffer> write_buffers_;
     VariableSizeWriter variable_size_writer_;
     ByteArray write_buffer_;
 
     ReadState state_ = ReadState::IDLE;
-    VariableSizeReader variable_size_reader_;
+
+    // Received data that is not processed yet: the beginning of a message or messages received
+    // while the channel is paused.
     ByteArray read_buffer_;
     ByteArray decrypt_buffer_;
 
+    // A message larger than the read buffer of the thread: |message_received_| of |message_size_|
+    // bytes are received. The header of the encrypted message is read into |message_header_| and
+    // the encrypted data into |decrypt_buffer_|.
+    ByteArray message_header_;
+    size_t message_size_ = 0;
+    size_t message_received_ = 0;
+
     int64_t total_tx_ = 0;
     int64_t total_rx_ = 0;
 
@@ -31,13 +31,33 @@ NetworkChannelProxy::NetworkChannelProxy(
     // Nothing
 }
 
-void NetworkChannelProxy::send(ByteArray&& buffer)
+void NetworkChannelProxy::send(ByteArray&& buffer,
+                               NetworkChannel::Priority priority,
+                               bool replace_pending)
+{
+    addWriteTask(
+        WriteTask(WriteTask::Type::USER_DATA, priority, replace_pending, std::move(buffer)));
+}
+
+void NetworkChannelProxy::send(const google::protobuf::MessageLite& message,
+                               NetworkChannel::Priority priority,
+                               bool replace_pending)
+{
+    // The message is serialized on the calling thread.
+    addWriteTask(WriteTask(WriteTask::Type::USER_DATA,
+                           priority,
+                           replace_pending,
+                           serialize(message, WriteTask::kHeadroom),
+                           WriteTask::kHeadroom));
+}
+
+void NetworkChannelProxy::addWriteTask(WriteTask&& task)
 {
     std::scoped_lock lock(incoming_queue_lock_);
 
     bool schedule_write = incoming_queue_.empty();
 
-    incoming_queue_.emplace(WriteTask::Type::USER_DATA, std::move(buffer));
+    incoming_queue_.emplace_back(std::move(task));
 
     if (!schedule_write)
         return;
@@ -58,22 +78,24 @@ void NetworkChannelProxy::scheduleWrite()
     if (!reloadWriteQueue(&channel_->write_queue_))
         return;
 
-    channel_->doWrite();
+    // If a write is in progress, the messages are sent after it is complete.
+    if (channel_->write_batch_.empty())
+        channel_->doWrite();
 }
 
-bool NetworkChannelProxy::reloadWriteQueue(std::queue<WriteTask>* work_queue)
+bool NetworkChannelProxy::reloadWriteQueue(WriteQueue* work_queue)
 {
-    if (!work_queue->empty())
-        return false;
-
     std::scoped_lock lock(incoming_queue_lock_);
 
     if (incoming_queue_.empty())
         return false;
 
-    incoming_queue_.swap(*work_queue);
-    DCHECK(incoming_queue_.empty());
+    // The tasks are added one by one, because a task can replace messages that are already in
+    // the work queue.
+    for (WriteTask& task : incoming_queue_)
+        work_queue->push(std::move(task));
 
+    incoming_queue_.clear();
     return true;
 }
 
@@ -30,7 +30,12 @@ class TaskRunner;
 class NetworkChannelProxy : public std::enable_shared_from_this<NetworkChannelProxy>
 {
 public:
-    void send(ByteArray&& buffer);
+    void send(ByteArray&& buffer,
+              NetworkChannel::Priority priority = NetworkChannel::Priority::REALTIME,
+              bool replace_pending = false);
+    void send(const google::protobuf::MessageLite& message,
+              NetworkChannel::Priority priority = NetworkChannel::Priority::REALTIME,
+              bool replace_pending = false);
 
 private:
     friend class NetworkChannel;
@@ -39,14 +44,15 @@ private:
     // Called directly by NetworkChannel::~NetworkChannel.
     void willDestroyCurrentChannel();
 
+    void addWriteTask(WriteTask&& task);
     void scheduleWrite();
-    bool reloadWriteQueue(std::queue<WriteTask>* work_queue);
+    bool reloadWriteQueue(WriteQueue* work_queue);
 
     std::shared_ptr<TaskRunner> task_runner_;
 
     NetworkChannel* channel_;
 
-    std::queue<WriteTask> incoming_queue_;
+    std::vector<WriteTask> incoming_queue_;
     std::mutex incoming_queue_lock_;
 
     DISALLOW_COPY_AND_ASSIGN(NetworkChannelProxy);
@@ -23,15 +23,27 @@
 #include "base/message_loop/message_pump_asio.h"
 #include "base/net/network_channel.h"
 #include "base/strings/unicode.h"
+#include "build/build_config.h"
 
 namespace base {
 
+namespace {
+
+#if defined(OS_LINUX)
+using ReusePortOption = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif // defined(OS_LINUX)
+
+} // namespace
+
 class NetworkServer::Impl : public std::enable_shared_from_this<Impl>
 {
 public:
     explicit Impl(asio::io_context& io_context);
     ~Impl();
 
+#if defined(OS_LINUX)
+    void setReusePort(bool enable);
+#endif // defined(OS_LINUX)
     void start(uint16_t port, Delegate* delegate);
     void stop();
     uint16_t port() const;
@@ -44,6 +56,9 @@ private:
     std::unique_ptr<asio::ip::tcp::acceptor> acceptor_;
     Delegate* delegate_ = nullptr;
     uint16_t port_ = 0;
+#if defined(OS_LINUX)
+    bool reuse_port_ = false;
+#endif // defined(OS_LINUX)
 
     DISALLOW_COPY_AND_ASSIGN(Impl);
 };
@@ -59,6 +74,14 @@ NetworkServer::Impl::~Impl()
     DCHECK(!acceptor_);
 }
 
+#if defined(OS_LINUX)
+void NetworkServer::Impl::setReusePort(bool enable)
+{
+    DCHECK(!acceptor_);
+    reuse_port_ = enable;
+}
+#endif // defined(OS_LINUX)
+
 void NetworkServer::Impl::start(uint16_t port, Delegate* delegate)
 {
     delegate_ = delegate;
@@ -67,7 +90,22 @@ void NetworkServer::Impl::start(uint16_t port, Delegate* delegate)
     DCHECK(delegate_);
 
     asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port);
-    acceptor_ = std::make_unique<asio::ip::tcp::acceptor>(io_context_, endpoint);
+
+#if defined(OS_LINUX)
+    if (reuse_port_)
+    {
+        acceptor_ = std::make_unique<asio::ip::tcp::acceptor>(io_context_);
+        acceptor_->open(endpoint.protocol());
+        acceptor_->set_option(asio::ip::tcp::acceptor::reuse_address(true));
+        acceptor_->set_option(ReusePortOption(true));
+        acceptor_->bind(endpoint);
+        acceptor_->listen();
+    }
+    else
+#endif // defined(OS_LINUX)
+    {
+        acceptor_ = std::make_unique<asio::ip::tcp::acceptor>(io_context_, endpoint);
+    }
 
     doAccept();
 }
@@ -123,6 +161,13 @@ NetworkServer::~NetworkServer()
     impl_->stop();
 }
 
+#if defined(OS_LINUX)
+void NetworkServer::setReusePort(bool enable)
+{
+    impl_->setReusePort(enable);
+}
+#endif // defined(OS_LINUX)
+
 void NetworkServer::start(uint16_t port, Delegate* delegate)
 {
     impl_->start(port, delegate);
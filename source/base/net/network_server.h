@@ -20,6 +20,7 @@
 #define BASE__NET__NETWORK_SERVER_H
 
 #include "base/macros_magic.h"
+#include "build/build_config.h"
 
 #include <cstdint>
 #include <memory>
@@ -42,6 +43,12 @@ public:
         virtual void onNewConnection(std::unique_ptr<NetworkChannel> channel) = 0;
     };
 
+#if defined(OS_LINUX)
+    // Allows several servers (for example, one per thread) to listen on the same port. The kernel
+    // distributes incoming connections between them. Must be called before start().
+    void setReusePort(bool enable);
+#endif // defined(OS_LINUX)
+
     void start(uint16_t port, Delegate* delegate);
     void stop();
     uint16_t port() const;
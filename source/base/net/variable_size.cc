@@ -22,45 +22,38 @@
 
 namespace base {
 
-VariableSizeReader::VariableSizeReader() = default;
-
-VariableSizeReader::~VariableSizeReader() = default;
-
-asio::mutable_buffer VariableSizeReader::buffer()
+// static
+size_t VariableSizeReader::read(const uint8_t* buffer, size_t buffer_size, size_t* message_size)
 {
-    DCHECK_LT(pos_, std::size(buffer_));
+    DCHECK(message_size);
 
-    return asio::mutable_buffer(&buffer_[pos_], sizeof(uint8_t));
-}
+    size_t result = 0;
 
-std::optional<size_t> VariableSizeReader::messageSize()
-{
-    DCHECK_LT(pos_, std::size(buffer_));
-
-    if (pos_ == 3 || !(buffer_[pos_] & 0x80))
+    for (size_t i = 0; i < 4; ++i)
     {
-        size_t result = buffer_[0] & 0x7F;
-
-        if (pos_ >= 1)
-            result += (buffer_[1] & 0x7F) << 7;
-
-        if (pos_ >= 2)
-            result += (buffer_[2] & 0x7F) << 14;
+        if (i >= buffer_size)
+            return 0;
 
-        if (pos_ >= 3)
-            result += buffer_[3] << 21;
+        // The first three bytes contain 7 bits of the size and a flag of the next byte. The fourth
+        // byte contains 8 bits.
+        if (i == 3)
+        {
+            result += static_cast<size_t>(buffer[i]) << 21;
+        }
+        else
+        {
+            result += static_cast<size_t>(buffer[i] & 0x7F) << (7 * i);
 
-        memset(buffer_, 0, std::size(buffer_));
-        pos_ = 0;
+            if (buffer[i] & 0x80)
+                continue;
+        }
 
-        return result;
+        *message_size = result;
+        return i + 1;
     }
-    else
-    {
-        ++pos_;
 
-        return std::nullopt;
-    }
+    NOTREACHED();
+    return 0;
 }
 
 VariableSizeWriter::VariableSizeWriter() = default;
@@ -24,24 +24,18 @@
 #include <asio/buffer.hpp>
 
 #include <cstdint>
-#include <optional>
 
 namespace base {
 
 class VariableSizeReader
 {
 public:
-    VariableSizeReader();
-    ~VariableSizeReader();
-
-    asio::mutable_buffer buffer();
-    std::optional<size_t> messageSize();
+    // Reads the message size from the beginning of |buffer|. Returns the number of bytes taken by
+    // the size (1 to 4) or 0 if |buffer| does not yet contain the whole size.
+    static size_t read(const uint8_t* buffer, size_t buffer_size, size_t* message_size);
 
 private:
-    uint8_t buffer_[4] = { 0 };
-    size_t pos_ = 0;
-
-    DISALLOW_COPY_AND_ASSIGN(VariableSizeReader);
+    DISALLOW_IMPLICIT_CONSTRUCTORS(VariableSizeReader);
 };
 
 class VariableSizeWriter
@@ -0,0 +1,63 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/net/variable_size.h"
+
+#include <gtest/gtest.h>
+
+namespace base {
+
+TEST(VariableSizeTest, RoundTrip)
+{
+    const size_t kSizes[] = { 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFF, 0x20000, 16 * 1024 * 1024 };
+    const size_t kLengths[] = { 1, 1, 2, 2, 3, 3, 4, 4 };
+
+    for (size_t i = 0; i < std::size(kSizes); ++i)
+    {
+        VariableSizeWriter writer;
+        asio::const_buffer buffer = writer.variableSize(kSizes[i]);
+        ASSERT_EQ(buffer.size(), kLengths[i]);
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+
+        size_t message_size = 0;
+        EXPECT_EQ(VariableSizeReader::read(data, buffer.size(), &message_size), buffer.size());
+        EXPECT_EQ(message_size, kSizes[i]);
+
+        // Incomplete size.
+        for (size_t length = 0; length < buffer.size(); ++length)
+            EXPECT_EQ(VariableSizeReader::read(data, length, &message_size), 0U);
+    }
+}
+
+TEST(VariableSizeTest, ReadFromStream)
+{
+    // The size is followed by the message and other data.
+    const uint8_t kData[] = { 0x85, 0x01, 0xAA, 0xBB, 0xCC };
+
+    size_t message_size = 0;
+    EXPECT_EQ(VariableSizeReader::read(kData, sizeof(kData), &message_size), 2U);
+    EXPECT_EQ(message_size, 0x85U);
+
+    // Service message.
+    const uint8_t kServiceData[] = { 0x00, 0x01 };
+    EXPECT_EQ(VariableSizeReader::read(kServiceData, sizeof(kServiceData), &message_size), 1U);
+    EXPECT_EQ(message_size, 0U);
+}
+
+} // namespace base
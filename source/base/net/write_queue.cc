@@ -0,0 +1,100 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/net/write_queue.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace base {
+
+WriteQueue::WriteQueue() = default;
+
+WriteQueue::~WriteQueue() = default;
+
+void WriteQueue::push(WriteTask&& task)
+{
+    const size_t index = static_cast<size_t>(task.priority());
+    DCHECK_LT(index, queues_.size());
+
+    std::deque<WriteTask>& queue = queues_[index];
+    Stat& stat = stats_[index];
+
+    if (task.replacePending() && !queue.empty())
+    {
+        stat.dropped += static_cast<int64_t>(queue.size());
+        size_ -= queue.size();
+        queue.clear();
+    }
+
+    queue.emplace_back(std::move(task));
+    ++size_;
+
+    stat.depth = queue.size();
+    stat.peak_depth = std::max(stat.peak_depth, stat.depth);
+}
+
+const WriteTask& WriteQueue::front() const
+{
+    return queues_[frontIndex()].front();
+}
+
+WriteTask WriteQueue::pop()
+{
+    std::deque<WriteTask>& queue = queues_[frontIndex()];
+
+    WriteTask task = std::move(queue.front());
+    queue.pop_front();
+    --size_;
+
+    Stat& stat = stats_[static_cast<size_t>(task.priority())];
+
+    std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        WriteTask::Clock::now() - task.time());
+
+    stat.depth = queue.size();
+    ++stat.sent;
+    stat.total_latency += latency;
+    stat.max_latency = std::max(stat.max_latency, latency);
+
+    return task;
+}
+
+WriteQueue::Stat WriteQueue::stat(Priority priority) const
+{
+    const size_t index = static_cast<size_t>(priority);
+    DCHECK_LT(index, stats_.size());
+    return stats_[index];
+}
+
+size_t WriteQueue::frontIndex() const
+{
+    DCHECK(!empty());
+
+    for (size_t i = 0; i < queues_.size(); ++i)
+    {
+        if (!queues_[i].empty())
+            return i;
+    }
+
+    NOTREACHED();
+    return queues_.size() - 1;
+}
+
+} // namespace base
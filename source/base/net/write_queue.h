@@ -0,0 +1,78 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__NET__WRITE_QUEUE_H
+#define BASE__NET__WRITE_QUEUE_H
+
+#include "base/net/write_task.h"
+
+#include <array>
+#include <deque>
+
+namespace base {
+
+// Queue of messages waiting to be sent. Each priority has its own queue and tasks are taken from
+// the queue with the highest priority first.
+class WriteQueue
+{
+public:
+    WriteQueue();
+    ~WriteQueue();
+
+    using Priority = WriteTask::Priority;
+
+    struct Stat
+    {
+        size_t depth = 0;      // Number of messages in the queue now.
+        size_t peak_depth = 0; // Maximum number of messages in the queue.
+        int64_t sent = 0;      // Number of messages taken from the queue for sending.
+        int64_t dropped = 0;   // Number of messages replaced before they were sent.
+
+        // Time that the messages spent in the queue.
+        std::chrono::microseconds total_latency { 0 };
+        std::chrono::microseconds max_latency { 0 };
+    };
+
+    // Adds a task to the queue of its priority. If the task replaces pending messages, all
+    // messages with the same priority that are still in the queue are dropped.
+    void push(WriteTask&& task);
+
+    // Returns the task that will be taken by the next call of pop(). The queue must not be empty.
+    const WriteTask& front() const;
+
+    // Removes the task with the highest priority from the queue and returns it.
+    WriteTask pop();
+
+    bool empty() const { return !size_; }
+    size_t size() const { return size_; }
+
+    Stat stat(Priority priority) const;
+
+private:
+    size_t frontIndex() const;
+
+    std::array<std::deque<WriteTask>, WriteTask::kPriorityCount> queues_;
+    std::array<Stat, WriteTask::kPriorityCount> stats_;
+    size_t size_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(WriteQueue);
+};
+
+} // namespace base
+
+#endif // BASE__NET__WRITE_QUEUE_H
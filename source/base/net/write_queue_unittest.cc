@@ -0,0 +1,128 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/net/write_queue.h"
+
+#include <gtest/gtest.h>
+
+namespace base {
+
+namespace {
+
+using Priority = WriteTask::Priority;
+
+WriteTask userTask(Priority priority, uint8_t id, bool replace_pending = false)
+{
+    return WriteTask(WriteTask::Type::USER_DATA, priority, replace_pending, ByteArray(1, id));
+}
+
+uint8_t popId(WriteQueue* queue)
+{
+    return queue->pop().data()[0];
+}
+
+} // namespace
+
+TEST(WriteQueueTest, PriorityOrder)
+{
+    WriteQueue queue;
+    EXPECT_TRUE(queue.empty());
+
+    queue.push(userTask(Priority::BULK, 1));
+    queue.push(userTask(Priority::VIDEO, 2));
+    queue.push(userTask(Priority::BULK, 3));
+    queue.push(userTask(Priority::REALTIME, 4));
+    queue.push(userTask(Priority::AUDIO, 5));
+    queue.push(userTask(Priority::REALTIME, 6));
+    EXPECT_EQ(queue.size(), 6U);
+
+    // Higher priority first, the order of adding within one priority.
+    EXPECT_EQ(queue.front().data()[0], 4);
+    EXPECT_EQ(popId(&queue), 4);
+    EXPECT_EQ(popId(&queue), 6);
+    EXPECT_EQ(popId(&queue), 5);
+
+    // A new message with a higher priority goes ahead of the queued ones.
+    queue.push(userTask(Priority::REALTIME, 7));
+    EXPECT_EQ(popId(&queue), 7);
+    EXPECT_EQ(popId(&queue), 2);
+    EXPECT_EQ(popId(&queue), 1);
+    EXPECT_EQ(popId(&queue), 3);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(WriteQueueTest, ReplacePending)
+{
+    WriteQueue queue;
+
+    queue.push(userTask(Priority::VIDEO, 1));
+    queue.push(userTask(Priority::AUDIO, 2));
+    queue.push(userTask(Priority::VIDEO, 3));
+    queue.push(userTask(Priority::VIDEO, 4, true));
+    queue.push(userTask(Priority::VIDEO, 5));
+
+    // Only the messages with the same priority are dropped.
+    EXPECT_EQ(queue.size(), 3U);
+    EXPECT_EQ(popId(&queue), 2);
+    EXPECT_EQ(popId(&queue), 4);
+    EXPECT_EQ(popId(&queue), 5);
+
+    // Nothing to replace.
+    queue.push(userTask(Priority::VIDEO, 6, true));
+    EXPECT_EQ(popId(&queue), 6);
+
+    WriteQueue::Stat stat = queue.stat(Priority::VIDEO);
+    EXPECT_EQ(stat.sent, 3);
+    EXPECT_EQ(stat.dropped, 2);
+    EXPECT_EQ(stat.depth, 0U);
+    EXPECT_EQ(stat.peak_depth, 2U);
+}
+
+TEST(WriteQueueTest, Stat)
+{
+    WriteQueue queue;
+
+    for (uint8_t i = 0; i < 4; ++i)
+        queue.push(userTask(Priority::BULK, i));
+    queue.push(userTask(Priority::AUDIO, 4));
+
+    WriteQueue::Stat stat = queue.stat(Priority::BULK);
+    EXPECT_EQ(stat.depth, 4U);
+    EXPECT_EQ(stat.peak_depth, 4U);
+    EXPECT_EQ(stat.sent, 0);
+
+    EXPECT_EQ(popId(&queue), 4);
+    EXPECT_EQ(popId(&queue), 0);
+
+    stat = queue.stat(Priority::BULK);
+    EXPECT_EQ(stat.depth, 3U);
+    EXPECT_EQ(stat.peak_depth, 4U);
+    EXPECT_EQ(stat.sent, 1);
+    EXPECT_GE(stat.max_latency.count(), 0);
+    EXPECT_LE(stat.max_latency, stat.total_latency);
+
+    stat = queue.stat(Priority::AUDIO);
+    EXPECT_EQ(stat.depth, 0U);
+    EXPECT_EQ(stat.sent, 1);
+
+    stat = queue.stat(Priority::REALTIME);
+    EXPECT_EQ(stat.peak_depth, 0U);
+    EXPECT_EQ(stat.sent, 0);
+}
+
+} // namespace base
@@ -19,28 +19,83 @@
 #ifndef BASE__NET__WRITE_TASK_H
 #define BASE__NET__WRITE_TASK_H
 
-#include "base/memory/byte_array.h"
+#include "base/logging.h"
+#include "base/macros_magic.h"
+#include "base/memory/buffer_pool.h"
+
+#include <chrono>
 
 namespace base {
 
 class WriteTask
 {
 public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
     enum class Type { SERVICE_DATA, USER_DATA };
 
-    WriteTask(Type type, ByteArray&& data)
+    // Messages with a higher priority (lower value) are sent before the queued messages with a
+    // lower priority. Messages of the same priority are sent in the order they were added.
+    enum class Priority
+    {
+        REALTIME = 0, // Service data, input and control messages.
+        AUDIO    = 1, // Audio packets.
+        VIDEO    = 2, // Video packets.
+        BULK     = 3  // File transfer and other large data.
+    };
+
+    static const size_t kPriorityCount = 4;
+
+    // Space reserved before a serialized user message for the size of the message and the header
+    // of the encrypted message. It allows to encrypt the message in place.
+    static const size_t kHeadroom = 32;
+
+    // The data of the message follows |headroom| free bytes at the beginning of |buffer|.
+    WriteTask(Type type,
+              Priority priority,
+              bool replace_pending,
+              ByteArray&& buffer,
+              size_t headroom = 0)
         : type_(type),
-          data_(std::move(data))
+          priority_(priority),
+          replace_pending_(replace_pending),
+          time_(Clock::now()),
+          buffer_(std::move(buffer)),
+          headroom_(headroom)
     {
-        // Nothing
+        DCHECK_LE(headroom_, buffer_.size());
     }
 
+    // The buffer of a sent or dropped message is returned to BufferPool.
+    ~WriteTask() { BufferPool::release(std::move(buffer_)); }
+
+    WriteTask(WriteTask&& other) = default;
+    WriteTask& operator=(WriteTask&& other) = default;
+
     Type type() const { return type_; }
-    const ByteArray& data() const { return data_; }
+    Priority priority() const { return priority_; }
+
+    // If true, the unsent messages with the same priority are dropped when the task is queued.
+    bool replacePending() const { return replace_pending_; }
+
+    // The time when the task was created.
+    TimePoint time() const { return time_; }
+
+    const uint8_t* data() const { return buffer_.data() + headroom_; }
+    uint8_t* data() { return buffer_.data() + headroom_; }
+    size_t size() const { return buffer_.size() - headroom_; }
+    size_t headroom() const { return headroom_; }
 
 private:
-    const Type type_;
-    const ByteArray data_;
+    Type type_;
+    Priority priority_;
+    bool replace_pending_;
+    TimePoint time_;
+    ByteArray buffer_;
+    size_t headroom_;
+
+    DISALLOW_COPY_AND_ASSIGN(WriteTask);
 };
 
 } // namespace base
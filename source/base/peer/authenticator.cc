@@ -32,11 +32,18 @@ constexpr std::chrono::minutes kTimeout{ 1 };
 } // namespace
 
 Authenticator::Authenticator(std::shared_ptr<TaskRunner> task_runner)
-    : timer_(WaitableTimer::Type::SINGLE_SHOT, std::move(task_runner))
+    : timer_(WaitableTimer::Type::SINGLE_SHOT, std::move(task_runner)),
+      timeout_(kTimeout)
 {
     // Nothing
 }
 
+void Authenticator::setTimeout(std::chrono::milliseconds timeout)
+{
+    DCHECK(state() == State::STOPPED);
+    timeout_ = timeout;
+}
+
 void Authenticator::start(std::unique_ptr<NetworkChannel> channel, Callback callback)
 {
     if (state() != State::STOPPED)
@@ -57,7 +64,7 @@ void Authenticator::start(std::unique_ptr<NetworkChannel> channel, Callback call
 
     // If authentication does not complete within the specified time interval, an error will be
     // raised.
-    timer_.start(kTimeout, std::bind(
+    timer_.start(timeout_, std::bind(
         &Authenticator::finish, this, FROM_HERE, ErrorCode::UNKNOWN_ERROR));
 
     channel_->setListener(this);
@@ -123,7 +130,7 @@ const char* Authenticator::errorToString(Authenticator::ErrorCode error_code)
 void Authenticator::sendMessage(const google::protobuf::MessageLite& message)
 {
     DCHECK(channel_);
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void Authenticator::finish(const Location& location, ErrorCode error_code)
@@ -54,6 +54,9 @@ public:
 
     using Callback = std::function<void(ErrorCode error_code)>;
 
+    // Sets the time in which the authentication must be completed. Must be called before start().
+    void setTimeout(std::chrono::milliseconds timeout);
+
     void start(std::unique_ptr<NetworkChannel> channel, Callback callback);
 
     [[nodiscard]] proto::Identify identify() const { return identify_; }
@@ -103,6 +106,7 @@ protected:
 
 private:
     WaitableTimer timer_;
+    std::chrono::milliseconds timeout_;
     std::unique_ptr<NetworkChannel> channel_;
     Callback callback_;
     State state_ = State::STOPPED;
@@ -0,0 +1,241 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/peer/handshake_limiter.h"
+
+#include "base/logging.h"
+#include "base/strings/unicode.h"
+
+#include <asio/ip/address.hpp>
+
+#include <algorithm>
+
+namespace base {
+
+namespace {
+
+// Buckets are removed only when there are many of them. Full buckets are removed not more often
+// than once per interval, so that the scan does not run for every connection during a flood.
+constexpr size_t kMaxBucketCount = 4096;
+constexpr std::chrono::seconds kCleanupInterval { 10 };
+
+} // namespace
+
+HandshakeLimiter::HandshakeLimiter()
+    : HandshakeLimiter(Options())
+{
+    // Nothing
+}
+
+HandshakeLimiter::HandshakeLimiter(const Options& options)
+    : options_(options)
+{
+    // Nothing
+}
+
+HandshakeLimiter::~HandshakeLimiter() = default;
+
+HandshakeLimiter::Result HandshakeLimiter::acquire(const std::u16string& address, TimePoint now)
+{
+    std::u16string key = isAddressTracked() ? addressKey(address) : std::u16string();
+
+    std::scoped_lock lock(lock_);
+
+    if (options_.max_pending && pending_ >= options_.max_pending)
+    {
+        ++rejected_by_limit_;
+        return Result::REJECTED_BY_LIMIT;
+    }
+
+    if (isAddressTracked())
+    {
+        auto it = buckets_.find(key);
+        if (it == buckets_.end())
+        {
+            if (buckets_.size() >= kMaxBucketCount)
+            {
+                removeIdleBuckets(now);
+
+                if (buckets_.size() >= kMaxBucketCount)
+                {
+                    // Buckets of addresses with handshakes in progress can not be removed. If all
+                    // buckets have them, then new addresses are rejected.
+                    if (idle_buckets_.empty())
+                    {
+                        ++rejected_by_limit_;
+                        return Result::REJECTED_BY_LIMIT;
+                    }
+
+                    // The least recently used address loses its bucket, so a flood from many
+                    // addresses does not lock out new peers.
+                    removeBucket(buckets_.find(*idle_buckets_.front()));
+                }
+            }
+
+            double burst = static_cast<double>(std::max(options_.address_burst, 1U));
+            it = buckets_.emplace(std::move(key), Bucket{ burst, now }).first;
+            it->second.idle_position = idle_buckets_.insert(idle_buckets_.end(), &it->first);
+        }
+
+        Bucket* bucket = &it->second;
+
+        if (!bucket->pending)
+        {
+            // The address is used now, it moves to the end of the idle list.
+            idle_buckets_.splice(idle_buckets_.end(), idle_buckets_, bucket->idle_position);
+        }
+
+        if (options_.max_address_pending && bucket->pending >= options_.max_address_pending)
+        {
+            ++rejected_by_address_;
+            return Result::REJECTED_BY_ADDRESS;
+        }
+
+        if (options_.address_rate > 0)
+        {
+            if (refill(bucket, now) < 1.0)
+            {
+                ++rejected_by_address_;
+                return Result::REJECTED_BY_ADDRESS;
+            }
+
+            bucket->tokens -= 1.0;
+        }
+
+        if (!bucket->pending)
+            idle_buckets_.erase(bucket->idle_position);
+
+        ++bucket->pending;
+    }
+
+    ++pending_;
+    peak_pending_ = std::max(peak_pending_, pending_);
+    return Result::ACCEPTED;
+}
+
+void HandshakeLimiter::release(const std::u16string& address, bool succeeded)
+{
+    std::u16string key = isAddressTracked() ? addressKey(address) : std::u16string();
+
+    std::scoped_lock lock(lock_);
+
+    DCHECK_GT(pending_, 0U);
+    --pending_;
+
+    if (isAddressTracked())
+    {
+        // Buckets with handshakes in progress are never removed.
+        auto it = buckets_.find(key);
+        DCHECK(it != buckets_.end());
+
+        if (it != buckets_.end())
+        {
+            Bucket* bucket = &it->second;
+
+            DCHECK_GT(bucket->pending, 0U);
+            if (!--bucket->pending)
+                bucket->idle_position = idle_buckets_.insert(idle_buckets_.end(), &it->first);
+        }
+    }
+
+    if (succeeded)
+        ++completed_;
+    else
+        ++failed_;
+}
+
+HandshakeLimiter::Stat HandshakeLimiter::stat() const
+{
+    std::scoped_lock lock(lock_);
+
+    Stat stat;
+    stat.pending = pending_;
+    stat.peak_pending = peak_pending_;
+    stat.address_count = buckets_.size();
+    stat.completed = completed_;
+    stat.failed = failed_;
+    stat.rejected_by_address = rejected_by_address_;
+    stat.rejected_by_limit = rejected_by_limit_;
+    return stat;
+}
+
+// static
+std::u16string HandshakeLimiter::addressKey(const std::u16string& address)
+{
+    std::error_code error_code;
+    asio::ip::address ip_address = asio::ip::make_address(utf8FromUtf16(address), error_code);
+    if (error_code || !ip_address.is_v6() || ip_address.to_v6().is_v4_mapped())
+        return address;
+
+    // The interface identifier (the lower 64 bits) is chosen by the host itself.
+    asio::ip::address_v6::bytes_type bytes = ip_address.to_v6().to_bytes();
+    std::fill(bytes.begin() + 8, bytes.end(), 0);
+
+    return utf16FromUtf8(asio::ip::make_address_v6(bytes).to_string()) + u"/64";
+}
+
+bool HandshakeLimiter::isAddressTracked() const
+{
+    return options_.address_rate > 0 || options_.max_address_pending;
+}
+
+double HandshakeLimiter::refill(Bucket* bucket, TimePoint now) const
+{
+    if (now > bucket->last_update)
+    {
+        std::chrono::duration<double> elapsed = now - bucket->last_update;
+        double burst = static_cast<double>(std::max(options_.address_burst, 1U));
+
+        bucket->tokens = std::min(burst, bucket->tokens + elapsed.count() * options_.address_rate);
+        bucket->last_update = now;
+    }
+
+    return bucket->tokens;
+}
+
+void HandshakeLimiter::removeIdleBuckets(TimePoint now)
+{
+    if (now - last_cleanup_ < kCleanupInterval)
+        return;
+
+    last_cleanup_ = now;
+
+    double burst = static_cast<double>(std::max(options_.address_burst, 1U));
+
+    // A full bucket without handshakes in progress is the same as a missing one.
+    for (auto it = buckets_.begin(); it != buckets_.end();)
+    {
+        Bucket* bucket = &it->second;
+
+        if (!bucket->pending && (options_.address_rate <= 0 || refill(bucket, now) >= burst))
+            it = removeBucket(it);
+        else
+            ++it;
+    }
+}
+
+HandshakeLimiter::BucketMap::iterator HandshakeLimiter::removeBucket(BucketMap::iterator it)
+{
+    DCHECK(it != buckets_.end());
+    DCHECK_EQ(it->second.pending, 0U);
+
+    idle_buckets_.erase(it->second.idle_position);
+    return buckets_.erase(it);
+}
+
+} // namespace base
@@ -0,0 +1,132 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__PEER__HANDSHAKE_LIMITER_H
+#define BASE__PEER__HANDSHAKE_LIMITER_H
+
+#include "base/macros_magic.h"
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace base {
+
+// Admission control for incoming handshakes. Each address has a token bucket that limits the
+// rate of new handshakes from it and a cap on its handshakes in progress, so a few addresses can
+// not take all places of the global cap. IPv6 addresses are counted by /64 prefix, because a
+// single host usually owns the whole prefix.
+// The check is made before any cryptographic work, so a flood of connections is rejected at the
+// cost of a map lookup. The class is thread-safe and can be shared between network threads.
+class HandshakeLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
+    struct Options
+    {
+        // Maximum number of handshakes in progress. 0 means no limit.
+        size_t max_pending = 256;
+
+        // Maximum number of handshakes in progress from one address. 0 means no limit.
+        size_t max_address_pending = 8;
+
+        // Rate of new handshakes per address (per second) and the size of the burst.
+        // 0 rate means no limit.
+        double address_rate = 2.0;
+        uint32_t address_burst = 16;
+    };
+
+    enum class Result
+    {
+        ACCEPTED,
+        REJECTED_BY_ADDRESS, // The address exceeded its rate or its handshakes in progress.
+        REJECTED_BY_LIMIT    // Too many handshakes in progress or too many addresses.
+    };
+
+    struct Stat
+    {
+        size_t pending = 0;
+        size_t peak_pending = 0;
+        size_t address_count = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        uint64_t rejected_by_address = 0;
+        uint64_t rejected_by_limit = 0;
+    };
+
+    HandshakeLimiter();
+    explicit HandshakeLimiter(const Options& options);
+    ~HandshakeLimiter();
+
+    // Checks whether a handshake from |address| can be started. If the result is ACCEPTED, the
+    // caller must call release() with the same address when the handshake is finished.
+    Result acquire(const std::u16string& address, TimePoint now = Clock::now());
+
+    // Finishes a handshake started with acquire().
+    void release(const std::u16string& address, bool succeeded);
+
+    Stat stat() const;
+
+private:
+    using IdleList = std::list<const std::u16string*>;
+
+    struct Bucket
+    {
+        double tokens;
+        TimePoint last_update;
+        size_t pending = 0;
+
+        // Position in |idle_buckets_|. Valid only if there are no handshakes in progress.
+        IdleList::iterator idle_position {};
+    };
+
+    static std::u16string addressKey(const std::u16string& address);
+
+    bool isAddressTracked() const;
+    double refill(Bucket* bucket, TimePoint now) const;
+    void removeIdleBuckets(TimePoint now);
+    using BucketMap = std::unordered_map<std::u16string, Bucket>;
+    BucketMap::iterator removeBucket(BucketMap::iterator it);
+
+    const Options options_;
+
+    mutable std::mutex lock_;
+    BucketMap buckets_;
+
+    // Keys of the buckets without handshakes in progress, the least recently used first.
+    IdleList idle_buckets_;
+
+    TimePoint last_cleanup_;
+
+    size_t pending_ = 0;
+    size_t peak_pending_ = 0;
+    uint64_t completed_ = 0;
+    uint64_t failed_ = 0;
+    uint64_t rejected_by_address_ = 0;
+    uint64_t rejected_by_limit_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(HandshakeLimiter);
+};
+
+} // namespace base
+
+#endif // BASE__PEER__HANDSHAKE_LIMITER_H
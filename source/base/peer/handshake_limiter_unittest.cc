@@ -0,0 +1,224 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/peer/handshake_limiter.h"
+
+#include "base/strings/unicode.h"
+
+#include <gtest/gtest.h>
+
+namespace base {
+
+namespace {
+
+const HandshakeLimiter::TimePoint kStartTime =
+    HandshakeLimiter::TimePoint() + std::chrono::hours(1);
+
+HandshakeLimiter::Options makeOptions(size_t max_pending,
+                                      double address_rate,
+                                      uint32_t burst,
+                                      size_t max_address_pending = 0)
+{
+    HandshakeLimiter::Options options;
+    options.max_pending = max_pending;
+    options.max_address_pending = max_address_pending;
+    options.address_rate = address_rate;
+    options.address_burst = burst;
+    return options;
+}
+
+} // namespace
+
+TEST(HandshakeLimiterTest, PendingLimit)
+{
+    HandshakeLimiter limiter(makeOptions(2, 0, 0));
+
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.2", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.3", kStartTime),
+              HandshakeLimiter::Result::REJECTED_BY_LIMIT);
+
+    limiter.release(u"10.0.0.1", true);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.3", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+
+    limiter.release(u"10.0.0.2", false);
+    limiter.release(u"10.0.0.3", true);
+
+    HandshakeLimiter::Stat stat = limiter.stat();
+    EXPECT_EQ(stat.pending, 0U);
+    EXPECT_EQ(stat.peak_pending, 2U);
+    EXPECT_EQ(stat.completed, 2U);
+    EXPECT_EQ(stat.failed, 1U);
+    EXPECT_EQ(stat.rejected_by_limit, 1U);
+    EXPECT_EQ(stat.rejected_by_address, 0U);
+}
+
+TEST(HandshakeLimiterTest, AddressRate)
+{
+    // One handshake per second with a burst of 3.
+    HandshakeLimiter limiter(makeOptions(0, 1.0, 3));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+        limiter.release(u"10.0.0.1", true);
+    }
+
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime),
+              HandshakeLimiter::Result::REJECTED_BY_ADDRESS);
+
+    // Other addresses have their own buckets.
+    EXPECT_EQ(limiter.acquire(u"10.0.0.2", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    limiter.release(u"10.0.0.2", true);
+
+    // Half a second is not enough for a new token.
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime + std::chrono::milliseconds(500)),
+              HandshakeLimiter::Result::REJECTED_BY_ADDRESS);
+
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime + std::chrono::seconds(1)),
+              HandshakeLimiter::Result::ACCEPTED);
+    limiter.release(u"10.0.0.1", true);
+
+    // The bucket does not grow above the burst.
+    HandshakeLimiter::TimePoint later = kStartTime + std::chrono::hours(1);
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(limiter.acquire(u"10.0.0.1", later), HandshakeLimiter::Result::ACCEPTED);
+        limiter.release(u"10.0.0.1", true);
+    }
+
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", later), HandshakeLimiter::Result::REJECTED_BY_ADDRESS);
+    EXPECT_EQ(limiter.stat().rejected_by_address, 3U);
+}
+
+TEST(HandshakeLimiterTest, LimitCheckedFirst)
+{
+    HandshakeLimiter limiter(makeOptions(1, 1.0, 1));
+
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+
+    // Rejection by the limit does not take a token of the address.
+    EXPECT_EQ(limiter.acquire(u"10.0.0.2", kStartTime),
+              HandshakeLimiter::Result::REJECTED_BY_LIMIT);
+
+    limiter.release(u"10.0.0.1", true);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.2", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    limiter.release(u"10.0.0.2", true);
+}
+
+TEST(HandshakeLimiterTest, AddressPendingLimit)
+{
+    HandshakeLimiter limiter(makeOptions(100, 0, 0, 2));
+
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+
+    // The address has used all its places, other addresses are still accepted.
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime),
+              HandshakeLimiter::Result::REJECTED_BY_ADDRESS);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.2", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+
+    limiter.release(u"10.0.0.1", false);
+    EXPECT_EQ(limiter.acquire(u"10.0.0.1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+
+    limiter.release(u"10.0.0.1", false);
+    limiter.release(u"10.0.0.1", false);
+    limiter.release(u"10.0.0.2", true);
+
+    HandshakeLimiter::Stat stat = limiter.stat();
+    EXPECT_EQ(stat.pending, 0U);
+    EXPECT_EQ(stat.rejected_by_address, 1U);
+    EXPECT_EQ(stat.rejected_by_limit, 0U);
+}
+
+TEST(HandshakeLimiterTest, Ipv6Prefix)
+{
+    HandshakeLimiter limiter(makeOptions(100, 0, 0, 2));
+
+    // Addresses of one /64 network share the limit.
+    EXPECT_EQ(limiter.acquire(u"2001:db8:1:2::1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    EXPECT_EQ(limiter.acquire(u"2001:db8:1:2::2", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    EXPECT_EQ(limiter.acquire(u"2001:db8:1:2:a:b:c:d", kStartTime),
+              HandshakeLimiter::Result::REJECTED_BY_ADDRESS);
+
+    EXPECT_EQ(limiter.acquire(u"2001:db8:1:3::1", kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    EXPECT_EQ(limiter.stat().address_count, 2U);
+
+    limiter.release(u"2001:db8:1:2::2", true);
+    limiter.release(u"2001:db8:1:2::1", true);
+    limiter.release(u"2001:db8:1:3::1", true);
+    EXPECT_EQ(limiter.stat().pending, 0U);
+}
+
+TEST(HandshakeLimiterTest, AddressCountLimit)
+{
+    HandshakeLimiter limiter(makeOptions(0, 0, 0, 1));
+
+    // Addresses with handshakes in progress can not be forgotten. When there are too many of
+    // them, new addresses are rejected.
+    size_t accepted = 0;
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        std::u16string address =
+            utf16FromAscii("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256));
+
+        if (limiter.acquire(address, kStartTime) == HandshakeLimiter::Result::ACCEPTED)
+            ++accepted;
+    }
+
+    HandshakeLimiter::Stat stat = limiter.stat();
+    EXPECT_LT(accepted, 5000U);
+    EXPECT_EQ(stat.address_count, accepted);
+    EXPECT_EQ(stat.rejected_by_limit, 5000U - accepted);
+}
+
+TEST(HandshakeLimiterTest, IdleAddressEviction)
+{
+    // One handshake per second without a burst.
+    HandshakeLimiter limiter(makeOptions(0, 1.0, 1));
+
+    auto makeAddress = [](uint32_t i)
+    {
+        return utf16FromAscii("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256));
+    };
+
+    // A flood from many addresses. The buckets are empty, so the cleanup does not remove them.
+    size_t accepted = 0;
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        if (limiter.acquire(makeAddress(i), kStartTime) == HandshakeLimiter::Result::ACCEPTED)
+        {
+            limiter.release(makeAddress(i), false);
+            ++accepted;
+        }
+    }
+
+    // Addresses without handshakes in progress are evicted, a new address is never rejected.
+    EXPECT_EQ(accepted, 5000U);
+    EXPECT_EQ(limiter.stat().rejected_by_limit, 0U);
+
+    // The most recent address keeps its bucket.
+    EXPECT_EQ(limiter.acquire(makeAddress(4999), kStartTime),
+              HandshakeLimiter::Result::REJECTED_BY_ADDRESS);
+
+    // The oldest address has lost its bucket and starts over.
+    EXPECT_EQ(limiter.acquire(makeAddress(0), kStartTime), HandshakeLimiter::Result::ACCEPTED);
+    limiter.release(makeAddress(0), true);
+}
+
+} // namespace base
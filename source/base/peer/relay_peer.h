@@ -48,11 +48,14 @@ public:
     void start(const proto::RelayCredentials& credentials, Delegate* delegate);
     bool isFinished() const { return is_finished_; }
 
+    // Creates the message that the peer sends to the relay after connecting (without the size
+    // prefix).
+    static ByteArray authenticationMessage(const proto::RelayKey& key, const std::string& secret);
+
 private:
     void onConnected();
     void onErrorOccurred(const Location& location, const std::error_code& error_code);
 
-    static ByteArray authenticationMessage(const proto::RelayKey& key, const std::string& secret);
 
     Delegate* delegate_ = nullptr;
     bool is_finished_ = false;
@@ -39,13 +39,39 @@ constexpr size_t kIvSize = 12;
 
 } // namespace
 
+struct ServerAuthenticator::SrpServerParameters
+{
+    uint32_t session_types = 0;
+    BigNum N;
+    BigNum g;
+    BigNum s;
+    BigNum v;
+    BigNum b;
+    BigNum B;
+};
+
+struct ServerAuthenticator::SrpKeyParameters
+{
+    BigNum A;
+    BigNum B;
+    BigNum N;
+    BigNum v;
+    BigNum b;
+    ByteArray srp_key;
+};
+
 ServerAuthenticator::ServerAuthenticator(std::shared_ptr<TaskRunner> task_runner)
-    : Authenticator(std::move(task_runner))
+    : Authenticator(task_runner),
+      task_runner_(std::move(task_runner)),
+      self_(std::make_shared<ServerAuthenticator*>(this))
 {
-    // Nothing
+    DCHECK(task_runner_);
 }
 
-ServerAuthenticator::~ServerAuthenticator() = default;
+ServerAuthenticator::~ServerAuthenticator()
+{
+    *self_ = nullptr;
+}
 
 void ServerAuthenticator::setUserList(std::shared_ptr<UserListBase> user_list)
 {
@@ -115,6 +141,11 @@ bool ServerAuthenticator::setAnonymousAccess(
     return true;
 }
 
+void ServerAuthenticator::setWorkerPool(std::shared_ptr<WorkerPool> worker_pool)
+{
+    worker_pool_ = std::move(worker_pool);
+}
+
 bool ServerAuthenticator::onStarted()
 {
     internal_state_ = InternalState::READ_CLIENT_HELLO;
@@ -175,6 +206,15 @@ void ServerAuthenticator::onReceived(const ByteArray& buffer)
             onSessionResponse(buffer);
             break;
 
+        case InternalState::CREATE_SERVER_KEY_EXCHANGE:
+        case InternalState::CREATE_SESSION_KEY:
+        {
+            // The peer must wait for our reply.
+            LOG(LS_ERROR) << "Unexpected message while computing keys";
+            finish(FROM_HERE, ErrorCode::PROTOCOL_ERROR);
+        }
+        break;
+
         default:
             NOTREACHED();
             break;
@@ -367,69 +407,31 @@ void ServerAuthenticator::onIdentify(const ByteArray& buffer)
 
     LOG(LS_INFO) << "Username: " << user_name_;
 
-    do
-    {
-        std::u16string user_name_utf16 = base::utf16FromUtf8(user_name_);
-        ByteArray seed_key;
-        User user;
-
-        if (user_list_)
-        {
-            user = user_list_->find(user_name_utf16);
-            seed_key = user_list_->seedKey();
-        }
-        else
-        {
-            LOG(LS_INFO) << "UserList is nullptr";
-        }
-
-        if (seed_key.empty())
-            seed_key = base::Random::byteArray(64);
-
-        if (user.isValid())
-        {
-            LOG(LS_INFO) << "User '" << user_name_ << "' found (enabled: "
-                         << ((user.flags & User::ENABLED) != 0) << ")";
-        }
-        else
-        {
-            LOG(LS_INFO) << "User '" << user_name_ << "' NOT found";
-        }
-
-        if (user.isValid() && (user.flags & User::ENABLED))
-        {
-            session_types_ = user.sessions;
+    // Looking up the user may block on the database and the generation of the server key takes
+    // several modular exponentiations.
+    internal_state_ = InternalState::CREATE_SERVER_KEY_EXCHANGE;
 
-            std::optional<SrpNgPair> Ng_pair = pairByGroup(user.group);
-            if (Ng_pair.has_value())
-            {
-                N_ = BigNum::fromStdString(Ng_pair->first);
-                g_ = BigNum::fromStdString(Ng_pair->second);
-                s_ = BigNum::fromByteArray(user.salt);
-                v_ = BigNum::fromByteArray(user.verifier);
-                break;
-            }
-            else
-            {
-                LOG(LS_ERROR) << "User '" << user.name << "' has an invalid SRP group";
-            }
-        }
-
-        session_types_ = 0;
-
-        GenericHash hash(GenericHash::BLAKE2b512);
-        hash.addData(seed_key);
-        hash.addData(user_name_);
+    std::shared_ptr<SrpServerParameters> parameters = std::make_shared<SrpServerParameters>();
 
-        N_ = BigNum::fromStdString(kSrpNgPair_8192.first);
-        g_ = BigNum::fromStdString(kSrpNgPair_8192.second);
-        s_ = BigNum::fromByteArray(hash.result());
-        v_ = SrpMath::calc_v(user_name_utf16, seed_key, s_, N_, g_);
-    }
-    while (false);
+    runInWorkerPool([parameters, user_name = user_name_, user_list = user_list_]()
+    {
+        createServerParameters(user_name, user_list.get(), parameters.get());
+    },
+    [this, parameters]()
+    {
+        onServerParametersCreated(parameters.get());
+    });
+}
 
-    b_ = BigNum::fromByteArray(Random::byteArray(128)); // 1024 bits.
-    B_ = SrpMath::calc_B(b_, N_, g_, v_);
+void ServerAuthenticator::onServerParametersCreated(SrpServerParameters* parameters)
+{
+    session_types_ = parameters->session_types;
+    N_ = std::move(parameters->N);
+    g_ = std::move(parameters->g);
+    s_ = std::move(parameters->s);
+    v_ = std::move(parameters->v);
+    b_ = std::move(parameters->b);
+    B_ = std::move(parameters->B);
 
     if (!N_.isValid() || !g_.isValid() || !s_.isValid() || !B_.isValid())
     {
@@ -474,7 +476,28 @@ void ServerAuthenticator::onClientKeyExchange(const ByteArray& buffer)
         return;
     }
 
-    ByteArray srp_key = createSrpKey();
+    internal_state_ = InternalState::CREATE_SESSION_KEY;
+
+    // The SRP numbers are not needed after the key is computed.
+    std::shared_ptr<SrpKeyParameters> parameters = std::make_shared<SrpKeyParameters>();
+    parameters->A = std::move(A_);
+    parameters->B = std::move(B_);
+    parameters->N = std::move(N_);
+    parameters->v = std::move(v_);
+    parameters->b = std::move(b_);
+
+    runInWorkerPool([parameters]()
+    {
+        parameters->srp_key = createSrpKey(*parameters);
+    },
+    [this, parameters]()
+    {
+        onSrpKeyCreated(parameters->srp_key);
+    });
+}
+
+void ServerAuthenticator::onSrpKeyCreated(const ByteArray& srp_key)
+{
     if (srp_key.empty())
     {
         finish(FROM_HERE, ErrorCode::UNKNOWN_ERROR);
@@ -570,18 +593,112 @@ void ServerAuthenticator::onSessionResponse(const ByteArray& buffer)
     finish(FROM_HERE, ErrorCode::SUCCESS);
 }
 
-ByteArray ServerAuthenticator::createSrpKey()
+// static
+void ServerAuthenticator::createServerParameters(const std::string& user_name,
+                                                 const UserListBase* user_list,
+                                                 SrpServerParameters* parameters)
 {
-    if (!SrpMath::verify_A_mod_N(A_, N_))
+    do
+    {
+        std::u16string user_name_utf16 = base::utf16FromUtf8(user_name);
+        ByteArray seed_key;
+        User user;
+
+        if (user_list)
+        {
+            user = user_list->find(user_name_utf16);
+            seed_key = user_list->seedKey();
+        }
+        else
+        {
+            LOG(LS_INFO) << "UserList is nullptr";
+        }
+
+        if (seed_key.empty())
+            seed_key = base::Random::byteArray(64);
+
+        if (user.isValid())
+        {
+            LOG(LS_INFO) << "User '" << user_name << "' found (enabled: "
+                         << ((user.flags & User::ENABLED) != 0) << ")";
+        }
+        else
+        {
+            LOG(LS_INFO) << "User '" << user_name << "' NOT found";
+        }
+
+        if (user.isValid() && (user.flags & User::ENABLED))
+        {
+            parameters->session_types = user.sessions;
+
+            std::optional<SrpNgPair> Ng_pair = pairByGroup(user.group);
+            if (Ng_pair.has_value())
+            {
+                parameters->N = BigNum::fromStdString(Ng_pair->first);
+                parameters->g = BigNum::fromStdString(Ng_pair->second);
+                parameters->s = BigNum::fromByteArray(user.salt);
+                parameters->v = BigNum::fromByteArray(user.verifier);
+                break;
+            }
+            else
+            {
+                LOG(LS_ERROR) << "User '" << user.name << "' has an invalid SRP group";
+            }
+        }
+
+        parameters->session_types = 0;
+
+        GenericHash hash(GenericHash::BLAKE2b512);
+        hash.addData(seed_key);
+        hash.addData(user_name);
+
+        parameters->N = BigNum::fromStdString(kSrpNgPair_8192.first);
+        parameters->g = BigNum::fromStdString(kSrpNgPair_8192.second);
+        parameters->s = BigNum::fromByteArray(hash.result());
+        parameters->v = SrpMath::calc_v(
+            user_name_utf16, seed_key, parameters->s, parameters->N, parameters->g);
+    }
+    while (false);
+
+    parameters->b = BigNum::fromByteArray(Random::byteArray(128)); // 1024 bits.
+    parameters->B = SrpMath::calc_B(parameters->b, parameters->N, parameters->g, parameters->v);
+}
+
+// static
+ByteArray ServerAuthenticator::createSrpKey(const SrpKeyParameters& parameters)
+{
+    if (!SrpMath::verify_A_mod_N(parameters.A, parameters.N))
     {
         LOG(LS_ERROR) << "SrpMath::verify_A_mod_N failed";
         return ByteArray();
     }
 
-    BigNum u = SrpMath::calc_u(A_, B_, N_);
-    BigNum server_key = SrpMath::calcServerKey(A_, v_, u, b_, N_);
+    BigNum u = SrpMath::calc_u(parameters.A, parameters.B, parameters.N);
+    BigNum server_key = SrpMath::calcServerKey(
+        parameters.A, parameters.v, u, parameters.b, parameters.N);
 
     return server_key.toByteArray();
 }
 
+void ServerAuthenticator::runInWorkerPool(WorkerPool::Task task, WorkerPool::Task reply)
+{
+    if (worker_pool_)
+    {
+        WorkerPool::Task guarded_reply = [self = self_, reply]()
+        {
+            // The authenticator can be destroyed or finished by timeout while the task is running.
+            if (*self && (*self)->state() == State::PENDING)
+                reply();
+        };
+
+        if (worker_pool_->postTaskAndReply(task, task_runner_, std::move(guarded_reply)))
+            return;
+
+        LOG(LS_WARNING) << "Worker pool is overloaded. The task is performed in place";
+    }
+
+    task();
+    reply();
+}
+
 } // namespace base
@@ -23,6 +23,7 @@
 #include "base/crypto/key_pair.h"
 #include "base/net/network_channel.h"
 #include "base/peer/authenticator.h"
+#include "base/threading/worker_pool.h"
 
 namespace base {
 
@@ -52,6 +53,10 @@ public:
     // By default, anonymous access is disabled.
     [[nodiscard]] bool setAnonymousAccess(AnonymousAccess anonymous_access, uint32_t session_types);
 
+    // Sets the pool for the user lookup and the SRP computations. If the pool is not set or its
+    // queue is full, they are performed on the thread of the authenticator.
+    void setWorkerPool(std::shared_ptr<WorkerPool> worker_pool);
+
 protected:
     // Authenticator implementation.
     bool onStarted() override;
@@ -59,13 +64,29 @@ protected:
     void onWritten() override;
 
 private:
+    struct SrpServerParameters;
+    struct SrpKeyParameters;
+
     void onClientHello(const ByteArray& buffer);
     void onIdentify(const ByteArray& buffer);
+    void onServerParametersCreated(SrpServerParameters* parameters);
     void onClientKeyExchange(const ByteArray& buffer);
+    void onSrpKeyCreated(const ByteArray& srp_key);
     void doSessionChallenge();
     void onSessionResponse(const ByteArray& buffer);
-    [[nodiscard]] ByteArray createSrpKey();
 
+    static void createServerParameters(const std::string& user_name,
+                                       const UserListBase* user_list,
+                                       SrpServerParameters* parameters);
+    [[nodiscard]] static ByteArray createSrpKey(const SrpKeyParameters& parameters);
+
+    // Runs |task| in the worker pool and then |reply| on the thread of the authenticator. |reply|
+    // is not called if the authenticator is destroyed or finished in the meantime.
+    void runInWorkerPool(WorkerPool::Task task, WorkerPool::Task reply);
+
+    std::shared_ptr<TaskRunner> task_runner_;
+    std::shared_ptr<WorkerPool> worker_pool_;
+    std::shared_ptr<ServerAuthenticator*> self_;
     std::shared_ptr<UserListBase> user_list_;
 
     enum class InternalState
@@ -73,8 +94,10 @@ private:
         READ_CLIENT_HELLO,
         SEND_SERVER_HELLO,
         READ_IDENTIFY,
+        CREATE_SERVER_KEY_EXCHANGE,
         SEND_SERVER_KEY_EXCHANGE,
         READ_CLIENT_KEY_EXCHANGE,
+        CREATE_SESSION_KEY,
         SEND_SESSION_CHALLENGE,
         READ_SESSION_RESPONSE
     };
@@ -24,15 +24,32 @@
 
 namespace base {
 
+namespace {
+
+// Rejected channels are not logged one by one, so that a flood does not flood the log too.
+constexpr std::chrono::minutes kRejectReportInterval { 1 };
+
+// A peer that opened a connection must complete the handshake quickly, otherwise it holds a
+// place of the limiter for nothing.
+constexpr std::chrono::seconds kHandshakeTimeout { 10 };
+
+} // namespace
+
 ServerAuthenticatorManager::ServerAuthenticatorManager(
     std::shared_ptr<TaskRunner> task_runner, Delegate* delegate)
     : task_runner_(std::move(task_runner)),
+      limiter_(std::make_shared<HandshakeLimiter>()),
       delegate_(delegate)
 {
     DCHECK(task_runner_ && delegate_);
 }
 
-ServerAuthenticatorManager::~ServerAuthenticatorManager() = default;
+ServerAuthenticatorManager::~ServerAuthenticatorManager()
+{
+    // Authentications in progress are not finished, return their places to the limiter.
+    for (const auto& pending : pending_)
+        limiter_->release(pending.address, false);
+}
 
 void ServerAuthenticatorManager::setUserList(std::unique_ptr<UserListBase> user_list)
 {
@@ -52,34 +69,75 @@ void ServerAuthenticatorManager::setAnonymousAccess(
     anonymous_session_types_ = session_types;
 }
 
+void ServerAuthenticatorManager::setWorkerPool(std::shared_ptr<WorkerPool> worker_pool)
+{
+    worker_pool_ = std::move(worker_pool);
+}
+
+void ServerAuthenticatorManager::setHandshakeLimiter(std::shared_ptr<HandshakeLimiter> limiter)
+{
+    DCHECK(pending_.empty());
+
+    limiter_ = std::move(limiter);
+    DCHECK(limiter_);
+}
+
 void ServerAuthenticatorManager::addNewChannel(std::unique_ptr<NetworkChannel> channel)
 {
     DCHECK(channel);
 
+    HandshakeLimiter::TimePoint now = HandshakeLimiter::Clock::now();
+    std::u16string address = channel->peerAddress();
+
+    // The check is made before the authenticator is created. The rejected channel is closed when
+    // it goes out of scope.
+    if (limiter_->acquire(address, now) != HandshakeLimiter::Result::ACCEPTED)
+    {
+        ++rejected_since_report_;
+
+        if (now - last_report_time_ >= kRejectReportInterval)
+        {
+            HandshakeLimiter::Stat stat = limiter_->stat();
+
+            LOG(LS_WARNING) << "Rejected " << rejected_since_report_ << " connections (total"
+                            << " by address: " << stat.rejected_by_address
+                            << ", by limit: " << stat.rejected_by_limit
+                            << ", pending: " << stat.pending << ")";
+
+            rejected_since_report_ = 0;
+            last_report_time_ = now;
+        }
+        return;
+    }
+
     std::unique_ptr<ServerAuthenticator> authenticator =
         std::make_unique<ServerAuthenticator>(task_runner_);
     authenticator->setUserList(user_list_);
+    authenticator->setWorkerPool(worker_pool_);
+    authenticator->setTimeout(kHandshakeTimeout);
 
     if (!private_key_.empty())
     {
         if (!authenticator->setPrivateKey(private_key_))
         {
             LOG(LS_ERROR) << "Failed to set private key for authenticator";
+            limiter_->release(address, false);
             return;
         }
 
         if (!authenticator->setAnonymousAccess(anonymous_access_, anonymous_session_types_))
         {
             LOG(LS_ERROR) << "Failed to set anonymous access settings";
+            limiter_->release(address, false);
             return;
         }
     }
 
     // Create a new authenticator for the connection and put it on the list.
-    pending_.emplace_back(std::move(authenticator));
+    pending_.push_back({ std::move(authenticator), std::move(address) });
 
     // Start the authentication process.
-    pending_.back()->start(
+    pending_.back().authenticator->start(
         std::move(channel), std::bind(&ServerAuthenticatorManager::onComplete, this));
 }
 
@@ -87,13 +145,15 @@ void ServerAuthenticatorManager::onComplete()
 {
     for (auto it = pending_.begin(); it != pending_.end();)
     {
-        ServerAuthenticator* current = it->get();
+        ServerAuthenticator* current = it->authenticator.get();
 
         switch (current->state())
         {
             case Authenticator::State::SUCCESS:
             case Authenticator::State::FAILED:
             {
+                limiter_->release(it->address, current->state() == Authenticator::State::SUCCESS);
+
                 if (current->state() == Authenticator::State::SUCCESS)
                 {
                     SessionInfo session_info;
@@ -109,7 +169,7 @@ void ServerAuthenticatorManager::onComplete()
                 }
 
                 // Authenticator not needed anymore.
-                task_runner_->deleteSoon(std::move(*it));
+                task_runner_->deleteSoon(std::move(it->authenticator));
                 it = pending_.erase(it);
             }
             break;
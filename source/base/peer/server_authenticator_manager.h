@@ -19,6 +19,7 @@
 #ifndef BASE__PEER__SERVER_AUTHENTICATOR_MANAGER_H
 #define BASE__PEER__SERVER_AUTHENTICATOR_MANAGER_H
 
+#include "base/peer/handshake_limiter.h"
 #include "base/peer/server_authenticator.h"
 
 namespace base {
@@ -63,17 +64,33 @@ public:
     void setAnonymousAccess(
         ServerAuthenticator::AnonymousAccess anonymous_access, uint32_t session_types);
 
+    // Sets the pool for blocking authentication steps. See ServerAuthenticator::setWorkerPool.
+    void setWorkerPool(std::shared_ptr<WorkerPool> worker_pool);
+
+    // Sets the admission control for new channels. The limiter can be shared by several
+    // managers. By default, each manager has its own limiter with default options.
+    void setHandshakeLimiter(std::shared_ptr<HandshakeLimiter> limiter);
+
     // Adds a channel to the authentication queue. After success completion, a session will be
     // created (in a stopped state) and method Delegate::onNewSession will be called.
-    // If authentication fails, the channel will be automatically deleted.
+    // If authentication fails or the channel is rejected by the limiter, the channel will be
+    // automatically deleted.
     void addNewChannel(std::unique_ptr<NetworkChannel> channel);
 
 private:
+    struct PendingAuthenticator
+    {
+        std::unique_ptr<ServerAuthenticator> authenticator;
+        std::u16string address;
+    };
+
     void onComplete();
 
     std::shared_ptr<TaskRunner> task_runner_;
     std::shared_ptr<UserListBase> user_list_;
-    std::vector<std::unique_ptr<ServerAuthenticator>> pending_;
+    std::shared_ptr<WorkerPool> worker_pool_;
+    std::shared_ptr<HandshakeLimiter> limiter_;
+    std::vector<PendingAuthenticator> pending_;
 
     ByteArray private_key_;
 
@@ -82,6 +99,9 @@ private:
 
     uint32_t anonymous_session_types_ = 0;
 
+    uint64_t rejected_since_report_ = 0;
+    HandshakeLimiter::TimePoint last_report_time_;
+
     Delegate* delegate_;
 
     DISALLOW_COPY_AND_ASSIGN(ServerAuthenticatorManager);
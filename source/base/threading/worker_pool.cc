@@ -0,0 +1,129 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/threading/worker_pool.h"
+
+#include "base/logging.h"
+#include "base/task_runner.h"
+
+#include <algorithm>
+
+namespace base {
+
+WorkerPool::WorkerPool(size_t thread_count, size_t max_queue_size)
+    : max_queue_size_(max_queue_size)
+{
+    DCHECK_GT(thread_count, 0U);
+    DCHECK_GT(max_queue_size_, 0U);
+
+    threads_.reserve(thread_count);
+
+    for (size_t i = 0; i < thread_count; ++i)
+        threads_.emplace_back(&WorkerPool::threadMain, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::scoped_lock lock(lock_);
+        stopping_ = true;
+        queue_.clear();
+    }
+
+    condition_.notify_all();
+
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+bool WorkerPool::postTask(Task task)
+{
+    DCHECK(task);
+
+    {
+        std::scoped_lock lock(lock_);
+
+        if (stopping_ || queue_.size() >= max_queue_size_)
+        {
+            ++rejected_;
+            return false;
+        }
+
+        queue_.emplace_back(std::move(task));
+        peak_queue_size_ = std::max(peak_queue_size_, queue_.size());
+    }
+
+    condition_.notify_one();
+    return true;
+}
+
+bool WorkerPool::postTaskAndReply(
+    Task task, std::shared_ptr<TaskRunner> reply_task_runner, Task reply)
+{
+    DCHECK(reply_task_runner);
+    DCHECK(reply);
+
+    return postTask([task = std::move(task),
+                     reply_task_runner = std::move(reply_task_runner),
+                     reply = std::move(reply)]()
+    {
+        task();
+        reply_task_runner->postTask(std::move(reply));
+    });
+}
+
+WorkerPool::Stat WorkerPool::stat() const
+{
+    std::scoped_lock lock(lock_);
+
+    Stat stat;
+    stat.thread_count = threads_.size();
+    stat.queue_size = queue_.size();
+    stat.peak_queue_size = peak_queue_size_;
+    stat.max_queue_size = max_queue_size_;
+    stat.completed = completed_;
+    stat.rejected = rejected_;
+
+    return stat;
+}
+
+void WorkerPool::threadMain()
+{
+    for (;;)
+    {
+        Task task;
+
+        {
+            std::unique_lock lock(lock_);
+
+            condition_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+                return;
+
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        task();
+
+        std::scoped_lock lock(lock_);
+        ++completed_;
+    }
+}
+
+} // namespace base
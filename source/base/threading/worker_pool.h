@@ -0,0 +1,90 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__THREADING__WORKER_POOL_H
+#define BASE__THREADING__WORKER_POOL_H
+
+#include "base/macros_magic.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace base {
+
+class TaskRunner;
+
+// A fixed set of threads that run blocking tasks (disk I/O, heavy cryptography) outside of the
+// network threads. The queue of tasks is bounded: when it is full, new tasks are rejected and the
+// caller decides how to proceed. The class is thread-safe.
+class WorkerPool
+{
+public:
+    WorkerPool(size_t thread_count, size_t max_queue_size);
+
+    // Pending tasks that have not started yet are dropped. Waits for the running tasks.
+    ~WorkerPool();
+
+    using Task = std::function<void()>;
+
+    struct Stat
+    {
+        size_t thread_count = 0;
+        size_t queue_size = 0;
+        size_t peak_queue_size = 0;
+        size_t max_queue_size = 0;
+        uint64_t completed = 0;
+        uint64_t rejected = 0;
+    };
+
+    // Queues |task| for execution on one of the worker threads. Returns false if the queue is
+    // full.
+    [[nodiscard]] bool postTask(Task task);
+
+    // Queues |task| and posts |reply| to |reply_task_runner| when the task is completed. If the
+    // queue is full, returns false and neither |task| nor |reply| is called.
+    [[nodiscard]] bool postTaskAndReply(
+        Task task, std::shared_ptr<TaskRunner> reply_task_runner, Task reply);
+
+    Stat stat() const;
+
+private:
+    void threadMain();
+
+    const size_t max_queue_size_;
+    std::vector<std::thread> threads_;
+
+    mutable std::mutex lock_;
+    std::condition_variable condition_;
+    std::deque<Task> queue_;
+    bool stopping_ = false;
+
+    size_t peak_queue_size_ = 0;
+    uint64_t completed_ = 0;
+    uint64_t rejected_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(WorkerPool);
+};
+
+} // namespace base
+
+#endif // BASE__THREADING__WORKER_POOL_H
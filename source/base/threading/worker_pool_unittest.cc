@@ -0,0 +1,112 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/threading/worker_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <memory>
+
+namespace base {
+
+TEST(WorkerPoolTest, RunsAllTasks)
+{
+    std::atomic<int> counter = 0;
+    std::promise<void> done;
+
+    {
+        WorkerPool pool(4, 1000);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            EXPECT_TRUE(pool.postTask([&]()
+            {
+                if (++counter == 100)
+                    done.set_value();
+            }));
+        }
+
+        done.get_future().wait();
+    }
+
+    EXPECT_EQ(counter, 100);
+}
+
+TEST(WorkerPoolTest, RejectsWhenQueueIsFull)
+{
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> release_future = release.get_future().share();
+
+    WorkerPool pool(1, 2);
+
+    // The only worker is blocked by the first task, so the next two fill the queue.
+    EXPECT_TRUE(pool.postTask([&]()
+    {
+        started.set_value();
+        release_future.wait();
+    }));
+    started.get_future().wait();
+
+    EXPECT_TRUE(pool.postTask([]() {}));
+    EXPECT_TRUE(pool.postTask([]() {}));
+    EXPECT_FALSE(pool.postTask([]() {}));
+
+    WorkerPool::Stat stat = pool.stat();
+    EXPECT_EQ(stat.thread_count, 1u);
+    EXPECT_EQ(stat.queue_size, 2u);
+    EXPECT_EQ(stat.peak_queue_size, 2u);
+    EXPECT_EQ(stat.max_queue_size, 2u);
+    EXPECT_EQ(stat.rejected, 1u);
+
+    release.set_value();
+}
+
+TEST(WorkerPoolTest, DropsPendingTasksOnDestruction)
+{
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> release_future = release.get_future().share();
+    std::atomic<int> counter = 0;
+
+    {
+        WorkerPool pool(1, 10);
+
+        EXPECT_TRUE(pool.postTask([&]()
+        {
+            started.set_value();
+            release_future.wait();
+        }));
+        started.get_future().wait();
+
+        // The running task is let go when the pending tasks are destroyed, that is, after the
+        // destructor has cleared the queue.
+        std::shared_ptr<void> guard(nullptr, [&](void*) { release.set_value(); });
+
+        for (int i = 0; i < 5; ++i)
+            EXPECT_TRUE(pool.postTask([&counter, guard]() { ++counter; }));
+
+        guard.reset();
+    }
+
+    EXPECT_EQ(counter, 0);
+}
+
+} // namespace base
@@ -0,0 +1,341 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/timing_wheel.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace base {
+
+TimingWheel::Timer::Timer(TimingWheel* wheel)
+    : wheel_(wheel)
+{
+    DCHECK(wheel_);
+}
+
+TimingWheel::Timer::~Timer()
+{
+    stop();
+}
+
+void TimingWheel::Timer::start(const Milliseconds& delay, TimeoutCallback callback)
+{
+    stop();
+
+    callback_ = std::move(callback);
+    wheel_->add(this, delay);
+}
+
+void TimingWheel::Timer::stop()
+{
+    if (!isActive())
+        return;
+
+    wheel_->remove(this);
+    callback_ = nullptr;
+}
+
+TimingWheel::TimingWheel(asio::io_context* io_context,
+                         const Milliseconds& tick_interval,
+                         const TimePoint& start_time)
+    : tick_interval_(tick_interval),
+      start_time_(start_time),
+      manual_time_(start_time)
+{
+    DCHECK(tick_interval_ > Milliseconds::zero());
+
+    for (int level = 0; level < kLevelCount; ++level)
+    {
+        for (size_t index = 0; index < kSlotCount; ++index)
+        {
+            Node* list = &slots_[level][index];
+            list->prev = list;
+            list->next = list;
+        }
+    }
+
+    if (io_context)
+        driver_ = std::make_unique<asio::steady_timer>(*io_context);
+}
+
+TimingWheel::~TimingWheel()
+{
+    if (driver_)
+        driver_->cancel();
+
+    // Detach the remaining timers so that they do not access the wheel in their destructors.
+    for (int level = 0; level < kLevelCount; ++level)
+    {
+        for (size_t index = 0; index < kSlotCount; ++index)
+        {
+            Node* list = &slots_[level][index];
+
+            while (!isEmpty(list))
+            {
+                Timer* timer = static_cast<Timer*>(list->next);
+                unlinkNode(timer);
+                timer->callback_ = nullptr;
+            }
+        }
+    }
+}
+
+size_t TimingWheel::advance(const TimePoint& current_time)
+{
+    if (!driver_)
+        manual_time_ = current_time;
+
+    const uint64_t current_tick = tickAt(current_time);
+    size_t expired = 0;
+
+    while (next_tick_ <= current_tick)
+    {
+        if (!count_)
+        {
+            // Nothing to expire. The empty ticks are skipped.
+            next_tick_ = current_tick + 1;
+            break;
+        }
+
+        expired += expireTick();
+    }
+
+    return expired;
+}
+
+void TimingWheel::add(Timer* timer, const Milliseconds& delay)
+{
+    const uint64_t current_tick = tickAt(currentTime());
+
+    if (!count_ && next_tick_ <= current_tick)
+    {
+        // The wheel was empty and has not been advanced. Bring it to the current time.
+        next_tick_ = current_tick + 1;
+    }
+
+    // The current tick has already begun. One more tick is added so that the timer expires no
+    // earlier than requested.
+    const uint64_t delay_ticks = static_cast<uint64_t>(
+        (delay.count() + tick_interval_.count() - 1) / tick_interval_.count());
+
+    timer->expire_tick_ = std::max(current_tick + delay_ticks + 1, next_tick_);
+    insert(timer);
+    ++count_;
+
+    if (driver_ && (!driver_active_ || timer->expire_tick_ < driver_tick_))
+        scheduleDriver();
+}
+
+void TimingWheel::remove(Timer* timer)
+{
+    DCHECK(timer->isActive());
+    DCHECK(count_);
+
+    unlinkNode(timer);
+    --count_;
+}
+
+void TimingWheel::insert(Timer* timer)
+{
+    const uint64_t expire_tick = timer->expire_tick_;
+    uint64_t delta = expire_tick - next_tick_;
+    Node* list;
+
+    if (expire_tick < next_tick_)
+    {
+        // The timer is already expired. It will be processed at the next tick.
+        list = &slots_[0][next_tick_ & kSlotMask];
+    }
+    else if (delta < (1ULL << kLevelBits))
+    {
+        list = &slots_[0][expire_tick & kSlotMask];
+    }
+    else if (delta < (1ULL << (2 * kLevelBits)))
+    {
+        list = &slots_[1][(expire_tick >> kLevelBits) & kSlotMask];
+    }
+    else if (delta < (1ULL << (3 * kLevelBits)))
+    {
+        list = &slots_[2][(expire_tick >> (2 * kLevelBits)) & kSlotMask];
+    }
+    else
+    {
+        // Timers beyond the range of the wheel are placed to the last slot.
+        const uint64_t max_delta = (1ULL << (kLevelCount * kLevelBits)) - 1;
+        if (delta > max_delta)
+        {
+            delta = max_delta;
+            timer->expire_tick_ = next_tick_ + delta;
+        }
+
+        list = &slots_[3][(timer->expire_tick_ >> (3 * kLevelBits)) & kSlotMask];
+    }
+
+    linkNode(list, timer);
+}
+
+void TimingWheel::cascade(int level, size_t index)
+{
+    Node* list = &slots_[level][index];
+
+    // Timers are placed again relative to the current tick. They go to the lower levels.
+    Node pending;
+    pending.prev = &pending;
+    pending.next = &pending;
+
+    if (!isEmpty(list))
+    {
+        pending.next = list->next;
+        pending.prev = list->prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        list->prev = list;
+        list->next = list;
+    }
+
+    while (!isEmpty(&pending))
+    {
+        Timer* timer = static_cast<Timer*>(pending.next);
+        unlinkNode(timer);
+        insert(timer);
+    }
+}
+
+size_t TimingWheel::expireTick()
+{
+    const size_t index = next_tick_ & kSlotMask;
+
+    if (!index)
+    {
+        // The first level has wrapped around. Move the timers of the upper levels down.
+        for (int level = 1; level < kLevelCount; ++level)
+        {
+            const size_t upper_index = (next_tick_ >> (level * kLevelBits)) & kSlotMask;
+            cascade(level, upper_index);
+
+            if (upper_index)
+                break;
+        }
+    }
+
+    Node* list = &slots_[0][index];
+    size_t expired = 0;
+
+    ++next_tick_;
+
+    // A callback can start and stop any timers, including itself. Timers are taken from the list
+    // one by one.
+    while (!isEmpty(list))
+    {
+        Timer* timer = static_cast<Timer*>(list->next);
+        unlinkNode(timer);
+        --count_;
+        ++expired;
+
+        // The timer can be restarted or destroyed by the callback.
+        TimeoutCallback callback = std::move(timer->callback_);
+        timer->callback_ = nullptr;
+
+        if (callback)
+            callback();
+    }
+
+    return expired;
+}
+
+uint64_t TimingWheel::tickAt(const TimePoint& time) const
+{
+    if (time <= start_time_)
+        return 0;
+
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<Milliseconds>(time - start_time_) / tick_interval_);
+}
+
+TimingWheel::TimePoint TimingWheel::currentTime() const
+{
+    return driver_ ? Clock::now() : manual_time_;
+}
+
+uint64_t TimingWheel::nextEventTick() const
+{
+    uint64_t tick = next_tick_;
+
+    // The upper levels are cascaded when the first level wraps around.
+    if (!(tick & kSlotMask))
+        return tick;
+
+    do
+    {
+        if (!isEmpty(&slots_[0][tick & kSlotMask]))
+            return tick;
+
+        ++tick;
+    }
+    while (tick & kSlotMask);
+
+    return tick;
+}
+
+void TimingWheel::scheduleDriver()
+{
+    DCHECK(driver_);
+
+    // The driver sleeps until the first non-empty slot or until the next cascade. Empty ticks do
+    // not wake up the thread.
+    driver_tick_ = nextEventTick();
+    driver_active_ = true;
+
+    driver_->expires_at(start_time_ + tick_interval_ * static_cast<int64_t>(driver_tick_));
+    driver_->async_wait(std::bind(&TimingWheel::onDriverTimeout, this, std::placeholders::_1));
+}
+
+// static
+void TimingWheel::onDriverTimeout(TimingWheel* self, const std::error_code& error_code)
+{
+    if (error_code == asio::error::operation_aborted)
+        return;
+
+    self->driver_active_ = false;
+    self->advance(Clock::now());
+
+    if (self->count_ && !self->driver_active_)
+        self->scheduleDriver();
+}
+
+// static
+void TimingWheel::linkNode(Node* list, Node* node)
+{
+    node->prev = list->prev;
+    node->next = list;
+    list->prev->next = node;
+    list->prev = node;
+}
+
+// static
+void TimingWheel::unlinkNode(Node* node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = nullptr;
+    node->next = nullptr;
+}
+
+} // namespace base
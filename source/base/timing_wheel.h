@@ -0,0 +1,141 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__TIMING_WHEEL_H
+#define BASE__TIMING_WHEEL_H
+
+#include "base/macros_magic.h"
+
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace base {
+
+// Hierarchical timing wheel. Serves a large number of coarse timers (timeouts, keep alive) of one
+// thread with a single system timer. Starting and stopping a timer is O(1). Timers expire in
+// batches once per tick.
+// The wheel has 4 levels of 256 slots. The first level holds timers that expire within 256 ticks,
+// each next level covers a 256 times longer range. When the first level wraps around, the timers
+// of the next slot of the upper level are moved down.
+// The class is not thread-safe. All timers must be used on the thread that owns the wheel.
+class TimingWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+    using Milliseconds = std::chrono::milliseconds;
+    using TimeoutCallback = std::function<void()>;
+
+    static constexpr Milliseconds kDefaultTickInterval { 100 };
+
+private:
+    struct Node
+    {
+        Node* prev = nullptr;
+        Node* next = nullptr;
+    };
+
+public:
+    class Timer : private Node
+    {
+    public:
+        explicit Timer(TimingWheel* wheel);
+        ~Timer();
+
+        // Starts execution |callback| after |delay|. The delay is rounded up to the tick of the
+        // wheel. If the timer is already running, it is restarted.
+        void start(const Milliseconds& delay, TimeoutCallback callback);
+
+        // Stops the timer. The callback will not be called.
+        void stop();
+
+        bool isActive() const { return next != nullptr; }
+
+    private:
+        friend class TimingWheel;
+
+        TimingWheel* wheel_;
+        TimeoutCallback callback_;
+        uint64_t expire_tick_ = 0;
+
+        DISALLOW_COPY_AND_ASSIGN(Timer);
+    };
+
+    // If |io_context| is not null, then the wheel is driven by a timer of |io_context|. Otherwise
+    // the wheel does not run by itself and time moves only with advance() calls.
+    explicit TimingWheel(asio::io_context* io_context,
+                         const Milliseconds& tick_interval = kDefaultTickInterval,
+                         const TimePoint& start_time = Clock::now());
+    ~TimingWheel();
+
+    // Calls the callbacks of all timers that have expired by |current_time|. Returns the number of
+    // expired timers.
+    size_t advance(const TimePoint& current_time);
+
+    // Returns the number of active timers.
+    size_t count() const { return count_; }
+
+    const Milliseconds& tickInterval() const { return tick_interval_; }
+
+private:
+    static const int kLevelBits = 8;
+    static const int kLevelCount = 4;
+    static const size_t kSlotCount = 1 << kLevelBits;
+    static const uint64_t kSlotMask = kSlotCount - 1;
+
+    void add(Timer* timer, const Milliseconds& delay);
+    void remove(Timer* timer);
+    void insert(Timer* timer);
+    void cascade(int level, size_t index);
+    size_t expireTick();
+
+    uint64_t tickAt(const TimePoint& time) const;
+    TimePoint currentTime() const;
+    uint64_t nextEventTick() const;
+    void scheduleDriver();
+    static void onDriverTimeout(TimingWheel* self, const std::error_code& error_code);
+
+    static void linkNode(Node* list, Node* node);
+    static void unlinkNode(Node* node);
+    static bool isEmpty(const Node* list) { return list->next == list; }
+
+    const Milliseconds tick_interval_;
+    const TimePoint start_time_;
+
+    // The next tick to be processed.
+    uint64_t next_tick_ = 0;
+
+    // The time of the last advance() call. Used only when the wheel has no io_context.
+    TimePoint manual_time_;
+
+    size_t count_ = 0;
+    Node slots_[kLevelCount][kSlotCount];
+
+    std::unique_ptr<asio::steady_timer> driver_;
+    uint64_t driver_tick_ = 0;
+    bool driver_active_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(TimingWheel);
+};
+
+} // namespace base
+
+#endif // BASE__TIMING_WHEEL_H
@@ -0,0 +1,240 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/timing_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace base {
+
+namespace {
+
+const TimingWheel::Milliseconds kTick { 100 };
+
+class TimingWheelTest : public testing::Test
+{
+protected:
+    TimingWheelTest()
+        : start_time_(TimingWheel::TimePoint() + std::chrono::hours(1)),
+          wheel_(nullptr, kTick, start_time_)
+    {
+        // Nothing
+    }
+
+    // Moves the time of the wheel forward by |ticks| ticks, one tick at a time.
+    size_t advanceTicks(uint64_t ticks)
+    {
+        size_t expired = 0;
+
+        for (uint64_t i = 0; i < ticks; ++i)
+        {
+            current_time_ += kTick;
+            expired += wheel_.advance(current_time_);
+        }
+
+        return expired;
+    }
+
+    const TimingWheel::TimePoint start_time_;
+    TimingWheel::TimePoint current_time_ = start_time_;
+    TimingWheel wheel_;
+};
+
+} // namespace
+
+TEST_F(TimingWheelTest, ExpiresAfterDelay)
+{
+    TimingWheel::Timer timer(&wheel_);
+    int called = 0;
+
+    timer.start(TimingWheel::Milliseconds(500), [&]() { ++called; });
+    EXPECT_TRUE(timer.isActive());
+    EXPECT_EQ(wheel_.count(), 1u);
+
+    advanceTicks(5);
+    EXPECT_EQ(called, 0);
+
+    advanceTicks(1);
+    EXPECT_EQ(called, 1);
+    EXPECT_FALSE(timer.isActive());
+    EXPECT_EQ(wheel_.count(), 0u);
+
+    advanceTicks(1000);
+    EXPECT_EQ(called, 1);
+}
+
+TEST_F(TimingWheelTest, Stop)
+{
+    TimingWheel::Timer timer(&wheel_);
+    bool called = false;
+
+    timer.start(TimingWheel::Milliseconds(300), [&]() { called = true; });
+    advanceTicks(2);
+
+    timer.stop();
+    EXPECT_FALSE(timer.isActive());
+    EXPECT_EQ(wheel_.count(), 0u);
+
+    advanceTicks(10);
+    EXPECT_FALSE(called);
+}
+
+TEST_F(TimingWheelTest, StopOnDestroy)
+{
+    {
+        TimingWheel::Timer timer(&wheel_);
+        timer.start(TimingWheel::Milliseconds(300), []() { FAIL(); });
+        EXPECT_EQ(wheel_.count(), 1u);
+    }
+
+    EXPECT_EQ(wheel_.count(), 0u);
+    advanceTicks(10);
+}
+
+TEST_F(TimingWheelTest, Restart)
+{
+    TimingWheel::Timer timer(&wheel_);
+    int called = 0;
+
+    timer.start(TimingWheel::Milliseconds(300), [&]() { ++called; });
+    advanceTicks(2);
+
+    timer.start(TimingWheel::Milliseconds(300), [&]() { called += 10; });
+    EXPECT_EQ(wheel_.count(), 1u);
+
+    advanceTicks(3);
+    EXPECT_EQ(called, 0);
+
+    advanceTicks(1);
+    EXPECT_EQ(called, 10);
+}
+
+TEST_F(TimingWheelTest, RestartFromCallback)
+{
+    TimingWheel::Timer timer(&wheel_);
+    int called = 0;
+
+    std::function<void()> callback = [&]()
+    {
+        if (++called < 3)
+            timer.start(kTick * 10, callback);
+    };
+
+    timer.start(kTick * 10, callback);
+    advanceTicks(100);
+
+    EXPECT_EQ(called, 3);
+    EXPECT_FALSE(timer.isActive());
+}
+
+TEST_F(TimingWheelTest, StopOtherFromCallback)
+{
+    TimingWheel::Timer first(&wheel_);
+    TimingWheel::Timer second(&wheel_);
+    bool second_called = false;
+
+    // Both timers expire at the same tick.
+    first.start(kTick * 5, [&]() { second.stop(); });
+    second.start(kTick * 5, [&]() { second_called = true; });
+
+    EXPECT_EQ(advanceTicks(10), 1u);
+    EXPECT_FALSE(second_called);
+}
+
+TEST_F(TimingWheelTest, LongDelays)
+{
+    // Delays that are served by each level of the wheel.
+    const uint64_t delays[] = { 1, 255, 256, 257, 65535, 65536, 70000, 16777217 };
+
+    for (uint64_t delay : delays)
+    {
+        TimingWheel::Timer timer(&wheel_);
+        bool called = false;
+
+        timer.start(kTick * static_cast<int64_t>(delay), [&]() { called = true; });
+
+        // Large steps are used to go close to the expiration time quickly.
+        current_time_ += kTick * static_cast<int64_t>(delay - 1);
+        wheel_.advance(current_time_);
+        EXPECT_FALSE(called) << "delay: " << delay;
+
+        advanceTicks(2);
+        EXPECT_TRUE(called) << "delay: " << delay;
+    }
+}
+
+TEST_F(TimingWheelTest, ManyTimers)
+{
+    const int kTimerCount = 10000;
+    const uint64_t kMaxDelay = 100000;
+
+    std::mt19937 generator(12345);
+    std::uniform_int_distribution<uint64_t> distribution(0, kMaxDelay);
+
+    std::vector<std::unique_ptr<TimingWheel::Timer>> timers;
+    std::vector<uint64_t> expected(kTimerCount);
+    std::vector<uint64_t> actual(kTimerCount, 0);
+
+    uint64_t tick = 0;
+
+    for (int i = 0; i < kTimerCount; ++i)
+    {
+        timers.emplace_back(std::make_unique<TimingWheel::Timer>(&wheel_));
+
+        uint64_t delay = distribution(generator);
+        expected[i] = delay + 1;
+
+        timers.back()->start(kTick * static_cast<int64_t>(delay), [&, i]() { actual[i] = tick; });
+    }
+
+    EXPECT_EQ(wheel_.count(), static_cast<size_t>(kTimerCount));
+
+    for (tick = 1; tick <= kMaxDelay + 1; ++tick)
+    {
+        current_time_ += kTick;
+        wheel_.advance(current_time_);
+    }
+
+    EXPECT_EQ(wheel_.count(), 0u);
+
+    for (int i = 0; i < kTimerCount; ++i)
+        EXPECT_EQ(actual[i], expected[i]) << "timer: " << i;
+}
+
+TEST_F(TimingWheelTest, SkipsIdleTime)
+{
+    // The wheel is empty for a long time and then a timer is started.
+    current_time_ += std::chrono::hours(24);
+    wheel_.advance(current_time_);
+
+    TimingWheel::Timer timer(&wheel_);
+    bool called = false;
+
+    timer.start(kTick * 3, [&]() { called = true; });
+
+    advanceTicks(3);
+    EXPECT_FALSE(called);
+
+    advanceTicks(1);
+    EXPECT_TRUE(called);
+}
+
+} // namespace base
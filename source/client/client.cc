@@ -20,6 +20,7 @@
 
 #include "base/logging.h"
 #include "base/task_runner.h"
+#include "base/memory/buffer_pool.h"
 #include "base/strings/strcat.h"
 #include "base/strings/string_number_conversions.h"
 #include "build/build_config.h"
@@ -47,6 +48,9 @@ Client::~Client()
     DCHECK(io_task_runner_->belongsToCurrentThread());
     stop();
 
+    // The buffers of the session are not needed anymore.
+    base::BufferPool::trim();
+
 #if defined(OS_MAC)
     base::releaseAppNapBlock();
 #endif // defined(OS_MAC)
@@ -144,7 +148,7 @@ void Client::sendMessage(const google::protobuf::MessageLite& message)
         return;
     }
 
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 int64_t Client::totalRx() const
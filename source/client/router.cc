@@ -25,6 +25,13 @@
 
 namespace client {
 
+namespace {
+
+// Keeps the messages small even with a large number of hosts.
+const uint32_t kSessionListPageSize = 500;
+
+} // namespace
+
 Router::Router(std::shared_ptr<RouterWindowProxy> window_proxy,
                std::shared_ptr<base::TaskRunner> io_task_runner)
     : io_task_runner_(io_task_runner),
@@ -54,13 +61,21 @@ void Router::connectToRouter(std::u16string_view address, uint16_t port)
     channel_->connect(address, port);
 }
 
-void Router::refreshSessionList()
+void Router::refreshSessionList(int64_t cursor)
 {
-    LOG(LS_INFO) << "Sending session list request";
+    LOG(LS_INFO) << "Sending session list request (cursor: " << cursor << ")";
 
     proto::AdminToRouter message;
-    message.mutable_session_list_request()->set_dummy(1);
-    channel_->send(base::serialize(message));
+
+    // The manager shows only hosts and relays.
+    proto::SessionListRequest* request = message.mutable_session_list_request();
+    request->set_dummy(1);
+    request->set_session_types(proto::ROUTER_SESSION_HOST | proto::ROUTER_SESSION_RELAY);
+    request->set_cursor(cursor);
+    request->set_page_size(kSessionListPageSize);
+    request->set_subscribe(true);
+
+    channel_->send(message);
 }
 
 void Router::stopSession(int64_t session_id)
@@ -73,7 +88,7 @@ void Router::stopSession(int64_t session_id)
     request->set_type(proto::SESSION_REQUEST_DISCONNECT);
     request->set_session_id(session_id);
 
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void Router::refreshUserList()
@@ -82,7 +97,7 @@ void Router::refreshUserList()
 
     proto::AdminToRouter message;
     message.mutable_user_list_request()->set_dummy(1);
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void Router::addUser(const proto::User& user)
@@ -96,7 +111,7 @@ void Router::addUser(const proto::User& user)
     request->set_type(proto::USER_REQUEST_ADD);
     request->mutable_user()->CopyFrom(user);
 
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void Router::modifyUser(const proto::User& user)
@@ -110,7 +125,7 @@ void Router::modifyUser(const proto::User& user)
     request->set_type(proto::USER_REQUEST_MODIFY);
     request->mutable_user()->CopyFrom(user);
 
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void Router::deleteUser(int64_t entry_id)
@@ -123,7 +138,7 @@ void Router::deleteUser(int64_t entry_id)
     request->set_type(proto::USER_REQUEST_DELETE);
     request->mutable_user()->set_entry_id(entry_id);
 
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void Router::onConnected()
@@ -178,6 +193,11 @@ void Router::onMessageReceived(const base::ByteArray& buffer)
         window_proxy_->onSessionList(
             std::shared_ptr<proto::SessionList>(message.release_session_list()));
     }
+    else if (message.has_session_list_update())
+    {
+        window_proxy_->onSessionListUpdate(
+            std::shared_ptr<proto::SessionListUpdate>(message.release_session_list_update()));
+    }
     else if (message.has_session_result())
     {
         LOG(LS_INFO) << "Session result received with code: "
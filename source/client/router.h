@@ -44,7 +44,9 @@ public:
 
     void connectToRouter(std::u16string_view address, uint16_t port);
 
-    void refreshSessionList();
+    // Requests the page of the session list after |cursor|. The request for the first page
+    // (|cursor| is 0) also subscribes to the changes of the list.
+    void refreshSessionList(int64_t cursor);
     void stopSession(int64_t session_id);
 
     void refreshUserList();
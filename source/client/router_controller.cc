@@ -82,7 +82,7 @@ void RouterController::onConnected()
             // Send connection request.
             proto::PeerToRouter message;
             message.mutable_connection_request()->set_host_id(host_id_);
-            channel_->send(base::serialize(message));
+            channel_->send(message);
         }
         else
         {
@@ -32,7 +32,7 @@ public:
 
     void connectToRouter(const std::u16string& address, uint16_t port);
     void disconnectFromRouter();
-    void refreshSessionList();
+    void refreshSessionList(int64_t cursor);
     void stopSession(int64_t session_id);
     void refreshUserList();
     void addUser(const proto::User& user);
@@ -84,16 +84,17 @@ void RouterProxy::Impl::disconnectFromRouter()
     router_.reset();
 }
 
-void RouterProxy::Impl::refreshSessionList()
+void RouterProxy::Impl::refreshSessionList(int64_t cursor)
 {
     if (!io_task_runner_->belongsToCurrentThread())
     {
-        io_task_runner_->postTask(std::bind(&Impl::refreshSessionList, shared_from_this()));
+        io_task_runner_->postTask(
+            std::bind(&Impl::refreshSessionList, shared_from_this(), cursor));
         return;
     }
 
     if (router_)
-        router_->refreshSessionList();
+        router_->refreshSessionList(cursor);
 }
 
 void RouterProxy::Impl::stopSession(int64_t session_id)
@@ -178,9 +179,9 @@ void RouterProxy::disconnectFromRouter()
     impl_->disconnectFromRouter();
 }
 
-void RouterProxy::refreshSessionList()
+void RouterProxy::refreshSessionList(int64_t cursor)
 {
-    impl_->refreshSessionList();
+    impl_->refreshSessionList(cursor);
 }
 
 void RouterProxy::stopSession(int64_t session_id)
@@ -46,7 +46,8 @@ public:
 
     void connectToRouter(const std::u16string& address, uint16_t port);
     void disconnectFromRouter();
-    void refreshSessionList();
+    // Requests the page of the session list after |cursor|. 0 means the first page.
+    void refreshSessionList(int64_t cursor = 0);
     void stopSession(int64_t session_id);
     void refreshUserList();
     void addUser(const proto::User& user);
@@ -96,6 +96,20 @@ void RouterWindowProxy::onSessionList(std::shared_ptr<proto::SessionList> sessio
         router_window_->onSessionList(session_list);
 }
 
+void RouterWindowProxy::onSessionListUpdate(
+    std::shared_ptr<proto::SessionListUpdate> session_list_update)
+{
+    if (!ui_task_runner_->belongsToCurrentThread())
+    {
+        ui_task_runner_->postTask(std::bind(&RouterWindowProxy::onSessionListUpdate,
+                                            shared_from_this(), session_list_update));
+        return;
+    }
+
+    if (router_window_)
+        router_window_->onSessionListUpdate(session_list_update);
+}
+
 void RouterWindowProxy::onSessionResult(std::shared_ptr<proto::SessionResult> session_result)
 {
     if (!ui_task_runner_->belongsToCurrentThread())
@@ -40,6 +40,7 @@ public:
     void onDisconnected(base::NetworkChannel::ErrorCode error_code);
     void onAccessDenied(base::ClientAuthenticator::ErrorCode error_code);
     void onSessionList(std::shared_ptr<proto::SessionList> session_list);
+    void onSessionListUpdate(std::shared_ptr<proto::SessionListUpdate> session_list_update);
     void onSessionResult(std::shared_ptr<proto::SessionResult> session_result);
     void onUserList(std::shared_ptr<proto::UserList> user_list);
     void onUserResult(std::shared_ptr<proto::UserResult> user_result);
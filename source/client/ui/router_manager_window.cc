@@ -40,8 +40,16 @@ class HostTreeItem : public QTreeWidgetItem
 {
 public:
     explicit HostTreeItem(const proto::Session& session)
-        : session(session)
     {
+        update(session);
+    }
+
+    ~HostTreeItem() = default;
+
+    void update(const proto::Session& new_session)
+    {
+        session = new_session;
+
         QString time = QLocale::system().toString(
             QDateTime::fromTime_t(session.timepoint()), QLocale::ShortFormat);
 
@@ -50,8 +58,6 @@ public:
         setText(2, time);
     }
 
-    ~HostTreeItem() = default;
-
     proto::Session session;
 
 private:
@@ -62,6 +68,11 @@ class RelayTreeItem : public QTreeWidgetItem
 {
 public:
     explicit RelayTreeItem(const proto::Session& session)
+    {
+        update(session);
+    }
+
+    void update(const proto::Session& session)
     {
         QString time = QLocale::system().toString(
             QDateTime::fromTime_t(session.timepoint()), QLocale::ShortFormat);
@@ -194,6 +205,7 @@ void RouterManagerWindow::onConnected(const base::Version& peer_version)
 
     if (router_proxy_)
     {
+        is_first_page_ = true;
         router_proxy_->refreshSessionList();
         router_proxy_->refreshUserList();
     }
@@ -297,40 +309,27 @@ void RouterManagerWindow::onSessionList(std::shared_ptr<proto::SessionList> sess
     QTreeWidget* tree_hosts = ui->tree_hosts;
     QTreeWidget* tree_relay = ui->tree_relay;
 
-    tree_hosts->clear();
-    tree_relay->clear();
+    if (is_first_page_)
+    {
+        is_first_page_ = false;
 
-    int host_count = 0;
-    int relay_count = 0;
+        session_items_.clear();
+        tree_hosts->clear();
+        tree_relay->clear();
+    }
 
     for (int i = 0; i < session_list->session_size(); ++i)
-    {
-        const proto::Session& session = session_list->session(i);
+        addSession(session_list->session(i));
 
-        switch (session.session_type())
-        {
-            case proto::ROUTER_SESSION_HOST:
-            {
-                tree_hosts->addTopLevelItem(new HostTreeItem(session_list->session(i)));
-                ++host_count;
-            }
-            break;
+    updateSessionCount();
 
-            case proto::ROUTER_SESSION_RELAY:
-            {
-                tree_relay->addTopLevelItem(new RelayTreeItem(session_list->session(i)));
-                ++relay_count;
-            }
-            break;
-
-            default:
-                break;
-        }
+    if (session_list->next_cursor() && router_proxy_)
+    {
+        // The list is received in pages. The window stays locked until the last page.
+        router_proxy_->refreshSessionList(session_list->next_cursor());
+        return;
     }
 
-    ui->label_hosts_conn_count->setText(QString::number(host_count));
-    ui->label_relay_conn_count->setText(QString::number(relay_count));
-
     for (int i = 0; i < tree_hosts->columnCount(); ++i)
         tree_hosts->resizeColumnToContents(i);
 
@@ -340,6 +339,18 @@ void RouterManagerWindow::onSessionList(std::shared_ptr<proto::SessionList> sess
     afterRequest();
 }
 
+void RouterManagerWindow::onSessionListUpdate(
+    std::shared_ptr<proto::SessionListUpdate> session_list_update)
+{
+    for (int i = 0; i < session_list_update->session_size(); ++i)
+        addSession(session_list_update->session(i));
+
+    for (int i = 0; i < session_list_update->removed_session_id_size(); ++i)
+        removeSession(session_list_update->removed_session_id(i));
+
+    updateSessionCount();
+}
+
 void RouterManagerWindow::onSessionResult(std::shared_ptr<proto::SessionResult> session_result)
 {
     if (session_result->error_code() != proto::SessionResult::SUCCESS)
@@ -368,7 +379,7 @@ void RouterManagerWindow::onSessionResult(std::shared_ptr<proto::SessionResult>
         QMessageBox::warning(this, tr("Warning"), tr(message), QMessageBox::Ok);
     }
 
-    refreshSessionList();
+    // The list is updated by the router.
     afterRequest();
 }
 
@@ -426,10 +437,80 @@ void RouterManagerWindow::refreshSessionList()
     if (router_proxy_)
     {
         beforeRequest();
+        is_first_page_ = true;
         router_proxy_->refreshSessionList();
     }
 }
 
+void RouterManagerWindow::addSession(const proto::Session& session)
+{
+    auto it = session_items_.find(session.session_id());
+    if (it != session_items_.end())
+    {
+        switch (session.session_type())
+        {
+            case proto::ROUTER_SESSION_HOST:
+            {
+                HostTreeItem* item = static_cast<HostTreeItem*>(it->second);
+                item->update(session);
+
+                if (item == ui->tree_hosts->currentItem())
+                    onCurrentHostChanged(item, nullptr);
+            }
+            break;
+
+            case proto::ROUTER_SESSION_RELAY:
+                static_cast<RelayTreeItem*>(it->second)->update(session);
+                break;
+
+            default:
+                break;
+        }
+        return;
+    }
+
+    QTreeWidgetItem* item;
+
+    switch (session.session_type())
+    {
+        case proto::ROUTER_SESSION_HOST:
+        {
+            item = new HostTreeItem(session);
+            ui->tree_hosts->addTopLevelItem(item);
+        }
+        break;
+
+        case proto::ROUTER_SESSION_RELAY:
+        {
+            item = new RelayTreeItem(session);
+            ui->tree_relay->addTopLevelItem(item);
+        }
+        break;
+
+        default:
+            return;
+    }
+
+    session_items_.emplace(session.session_id(), item);
+}
+
+void RouterManagerWindow::removeSession(int64_t session_id)
+{
+    auto it = session_items_.find(session_id);
+    if (it == session_items_.end())
+        return;
+
+    // The item is removed from the tree in the destructor.
+    delete it->second;
+    session_items_.erase(it);
+}
+
+void RouterManagerWindow::updateSessionCount()
+{
+    ui->label_hosts_conn_count->setText(QString::number(ui->tree_hosts->topLevelItemCount()));
+    ui->label_relay_conn_count->setText(QString::number(ui->tree_relay->topLevelItemCount()));
+}
+
 void RouterManagerWindow::disconnectHost()
 {
     HostTreeItem* tree_item = static_cast<HostTreeItem*>(ui->tree_hosts->currentItem());
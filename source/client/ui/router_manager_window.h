@@ -25,6 +25,8 @@
 #include <QMainWindow>
 #include <QPointer>
 
+#include <unordered_map>
+
 namespace Ui {
 class RouterManagerWindow;
 } // namespace Ui
@@ -54,6 +56,8 @@ public:
     void onDisconnected(base::NetworkChannel::ErrorCode error_code) override;
     void onAccessDenied(base::ClientAuthenticator::ErrorCode error_code) override;
     void onSessionList(std::shared_ptr<proto::SessionList> session_list) override;
+    void onSessionListUpdate(
+        std::shared_ptr<proto::SessionListUpdate> session_list_update) override;
     void onSessionResult(std::shared_ptr<proto::SessionResult> session_result) override;
     void onUserList(std::shared_ptr<proto::UserList> user_list) override;
     void onUserResult(std::shared_ptr<proto::UserResult> user_result) override;
@@ -64,6 +68,9 @@ protected:
 
 private:
     void refreshSessionList();
+    void addSession(const proto::Session& session);
+    void removeSession(int64_t session_id);
+    void updateSessionCount();
     void disconnectHost();
     void disconnectAllHosts();
     void refreshUserList();
@@ -86,6 +93,10 @@ private:
     std::shared_ptr<RouterWindowProxy> window_proxy_;
     std::unique_ptr<RouterProxy> router_proxy_;
 
+    // Items of the host and relay trees by session ID.
+    std::unordered_map<int64_t, QTreeWidgetItem*> session_items_;
+    bool is_first_page_ = false;
+
     DISALLOW_COPY_AND_ASSIGN(RouterManagerWindow);
 };
 
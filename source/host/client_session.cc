@@ -126,9 +126,11 @@ std::shared_ptr<base::NetworkChannelProxy> ClientSession::channelProxy()
     return channel_->channelProxy();
 }
 
-void ClientSession::sendMessage(base::ByteArray&& buffer)
+void ClientSession::sendMessage(const google::protobuf::MessageLite& message,
+                                base::NetworkChannel::Priority priority,
+                                bool replace_pending)
 {
-    channel_->send(std::move(buffer));
+    channel_->send(message, priority, replace_pending);
 }
 
 void ClientSession::onConnected()
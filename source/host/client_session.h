@@ -84,7 +84,10 @@ protected:
     virtual void onStarted() = 0;
 
     std::shared_ptr<base::NetworkChannelProxy> channelProxy();
-    void sendMessage(base::ByteArray&& buffer);
+    void sendMessage(const google::protobuf::MessageLite& message,
+                     base::NetworkChannel::Priority priority =
+                         base::NetworkChannel::Priority::REALTIME,
+                     bool replace_pending = false);
 
     // base::NetworkChannel::Listener implementation.
     void onConnected() override;
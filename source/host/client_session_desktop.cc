@@ -143,7 +143,7 @@ void ClientSessionDesktop::onStarted()
     LOG(LS_INFO) << "Supported audio encodings: " << request->audio_encodings();
 
     // Send the request.
-    sendMessage(base::serialize(*outgoing_message_));
+    sendMessage(*outgoing_message_);
 }
 
 void ClientSessionDesktop::encodeScreen(const base::Frame* frame, const base::MouseCursor* cursor)
@@ -206,14 +206,24 @@ void ClientSessionDesktop::encodeScreen(const base::Frame* frame, const base::Mo
         }
     }
 
-    if (cursor && cursor_encoder_)
+    if (outgoing_message_->has_video_packet())
     {
-        if (!cursor_encoder_->encode(*cursor, outgoing_message_->mutable_cursor_shape()))
-            outgoing_message_->clear_cursor_shape();
+        // A packet with the format starts a key frame. The client does not need the video packets
+        // that are still waiting in the queue before it.
+        const bool key_frame = outgoing_message_->video_packet().has_format();
+
+        sendMessage(*outgoing_message_, base::NetworkChannel::Priority::VIDEO, key_frame);
     }
 
-    if (outgoing_message_->has_video_packet() || outgoing_message_->has_cursor_shape())
-        sendMessage(base::serialize(*outgoing_message_));
+    // The cursor shape is sent in a separate message, so it is not delayed by video packets and
+    // is never dropped with them.
+    if (cursor && cursor_encoder_)
+    {
+        outgoing_message_->Clear();
+
+        if (cursor_encoder_->encode(*cursor, outgoing_message_->mutable_cursor_shape()))
+            sendMessage(*outgoing_message_);
+    }
 }
 
 void ClientSessionDesktop::encodeAudio(const proto::AudioPacket& audio_packet)
@@ -226,7 +236,7 @@ void ClientSessionDesktop::encodeAudio(const proto::AudioPacket& audio_packet)
     if (!audio_encoder_->encode(audio_packet, outgoing_message_->mutable_audio_packet()))
         return;
 
-    sendMessage(base::serialize(*outgoing_message_));
+    sendMessage(*outgoing_message_, base::NetworkChannel::Priority::AUDIO);
 }
 
 void ClientSessionDesktop::setScreenList(const proto::ScreenList& list)
@@ -237,7 +247,7 @@ void ClientSessionDesktop::setScreenList(const proto::ScreenList& list)
     extension->set_name(common::kSelectScreenExtension);
     extension->set_data(list.SerializeAsString());
 
-    sendMessage(base::serialize(*outgoing_message_));
+    sendMessage(*outgoing_message_);
 }
 
 void ClientSessionDesktop::injectClipboardEvent(const proto::ClipboardEvent& event)
@@ -247,7 +257,7 @@ void ClientSessionDesktop::injectClipboardEvent(const proto::ClipboardEvent& eve
         outgoing_message_->Clear();
 
         outgoing_message_->mutable_clipboard_event()->CopyFrom(event);
-        sendMessage(base::serialize(*outgoing_message_));
+        sendMessage(*outgoing_message_);
     }
 }
 
@@ -353,7 +363,7 @@ void ClientSessionDesktop::readExtension(const proto::DesktopExtension& extensio
         desktop_extension->set_name(common::kSystemInfoExtension);
         desktop_extension->set_data(system_info.SerializeAsString());
 
-        sendMessage(base::serialize(*outgoing_message_));
+        sendMessage(*outgoing_message_);
     }
     else
     {
@@ -153,7 +153,7 @@ void ClientSessionFileTransfer::Worker::postRequest(std::unique_ptr<proto::FileR
     {
         proto::FileReply reply;
         reply.set_error_code(proto::FILE_ERROR_NO_LOGGED_ON_USER);
-        channel_proxy_->send(base::serialize(reply));
+        channel_proxy_->send(reply, base::NetworkChannel::Priority::BULK);
     }
 }
 
@@ -185,7 +185,7 @@ void ClientSessionFileTransfer::Worker::onAfterThreadRunning()
 
 void ClientSessionFileTransfer::Worker::onTaskDone(std::shared_ptr<common::FileTask> task)
 {
-    channel_proxy_->send(base::serialize(task->reply()));
+    channel_proxy_->send(task->reply(), base::NetworkChannel::Priority::BULK);
 }
 
 ClientSessionFileTransfer::ClientSessionFileTransfer(std::unique_ptr<base::NetworkChannel> channel)
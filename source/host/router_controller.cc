@@ -92,7 +92,7 @@ void RouterController::hostIdRequest(const std::string& session_name)
 
     // Send host ID request.
     LOG(LS_INFO) << "Send ID request to router";
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void RouterController::resetHostId(base::HostId host_id)
@@ -107,7 +107,7 @@ void RouterController::resetHostId(base::HostId host_id)
 
     proto::PeerToRouter message;
     message.mutable_reset_host_id()->set_host_id(host_id);
-    channel_->send(base::serialize(message));
+    channel_->send(message);
 }
 
 void RouterController::onConnected()
@@ -23,6 +23,7 @@
 #include "base/task_runner.h"
 #include "base/crypto/password_generator.h"
 #include "base/desktop/frame.h"
+#include "base/memory/buffer_pool.h"
 #include "base/strings/string_number_conversions.h"
 #include "base/strings/string_util.h"
 #include "base/strings/unicode.h"
@@ -442,7 +443,13 @@ void UserSession::onClientSessionFinished()
     delete_finished(&file_transfer_clients_);
 
     if (desktop_clients_.empty())
+    {
         desktop_session_proxy_->control(proto::internal::Control::DISABLE);
+
+        // The video buffers are not needed anymore. They are freed after the sessions are
+        // destroyed.
+        task_runner_->postTask(&base::BufferPool::trim);
+    }
 }
 
 void UserSession::onSessionDettached(const base::Location& location)
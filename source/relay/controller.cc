@@ -24,11 +24,14 @@
 #include "proto/router_common.pb.h"
 #include "relay/settings.h"
 
+#include <algorithm>
+
 namespace relay {
 
 namespace {
 
 const std::chrono::seconds kReconnectTimeout{ 15 };
+const std::chrono::seconds kStatisticsInterval{ 30 };
 
 #if defined(OS_WIN)
 const wchar_t kFirewallRuleName[] = L"Aspia Relay Service";
@@ -64,6 +67,7 @@ private:
 Controller::Controller(std::shared_ptr<base::TaskRunner> task_runner)
     : task_runner_(task_runner),
       reconnect_timer_(base::WaitableTimer::Type::SINGLE_SHOT, task_runner),
+      statistics_timer_(base::WaitableTimer::Type::REPEATED, task_runner),
       shared_pool_(std::make_unique<SharedPool>(this))
 {
     Settings settings;
@@ -82,11 +86,23 @@ Controller::Controller(std::shared_ptr<base::TaskRunner> task_runner)
     peer_port_ = settings.peerPort();
     peer_idle_timeout_ = settings.peerIdleTimeout();
     max_peer_count_ = settings.maxPeerCount();
+    peer_worker_count_ = settings.peerWorkerCount();
+    session_rate_limit_ = settings.sessionRateLimit();
+    total_rate_limit_ = settings.totalRateLimit();
+
+    // Key pool settings.
+    key_pool_target_size_ = settings.keyPoolTargetSize();
+    key_pool_low_water_mark_ = settings.keyPoolLowWaterMark();
 
     LOG(LS_INFO) << "Peer address: " << peer_address_;
     LOG(LS_INFO) << "Peer port: " << peer_port_;
     LOG(LS_INFO) << "Peer idle timeout: " << peer_idle_timeout_.count();
     LOG(LS_INFO) << "Max peer count: " << max_peer_count_;
+    LOG(LS_INFO) << "Peer worker count: " << peer_worker_count_;
+    LOG(LS_INFO) << "Session rate limit: " << session_rate_limit_ << " KB/s";
+    LOG(LS_INFO) << "Total rate limit: " << total_rate_limit_ << " KB/s";
+    LOG(LS_INFO) << "Key pool target size: " << key_pool_target_size_;
+    LOG(LS_INFO) << "Key pool low water mark: " << key_pool_low_water_mark_;
 }
 
 Controller::~Controller() = default;
@@ -132,9 +148,15 @@ bool Controller::start()
     }
 
     sessions_worker_ = std::make_unique<SessionsWorker>(
-        peer_port_, peer_idle_timeout_, shared_pool_->share());
+        peer_port_, peer_idle_timeout_, peer_worker_count_, shared_pool_->share());
+    sessions_worker_->setRateLimits(static_cast<int64_t>(session_rate_limit_) * 1024,
+                                    static_cast<int64_t>(total_rate_limit_) * 1024);
     sessions_worker_->start(task_runner_, this);
 
+    session_statistics_.resize(sessions_worker_->workerCount());
+    session_statistics_updated_.resize(sessions_worker_->workerCount());
+    statistics_timer_.start(kStatisticsInterval, std::bind(&Controller::sendStatistics, this));
+
     connectToRouter();
     return true;
 }
@@ -167,7 +189,9 @@ void Controller::onConnected()
             // Now the session will receive incoming messages.
             channel_->resume();
 
-            sendKeyPool(max_peer_count_);
+            // The router has no keys for this relay after connecting.
+            router_key_count_ = 0;
+            refillKeyPool();
         }
         else
         {
@@ -186,8 +210,9 @@ void Controller::onDisconnected(base::NetworkChannel::ErrorCode error_code)
     LOG(LS_INFO) << "The connection to the router has been lost: "
                  << base::NetworkChannel::errorToString(error_code);
 
-    // Clearing the key pool.
+    // Clearing the key pool. The keys given to peers can no longer be used.
     shared_pool_->clear();
+    used_key_count_ = 0;
 
     // Retrying a connection at a time interval.
     delayedConnectToRouter();
@@ -211,6 +236,14 @@ void Controller::onMessageReceived(const base::ByteArray& buffer)
         // If it is not used during this time, then it will be removed from the pool.
         task_runner_->postDelayedTask(
             std::bind(&KeyDeleter::deleteKey, key_deleter), std::chrono::seconds(30));
+
+        if (router_key_count_)
+            --router_key_count_;
+
+        // Until the peers connect or the key expires, it still takes a place of a session.
+        ++used_key_count_;
+
+        refillKeyPool();
     }
     else
     {
@@ -223,18 +256,56 @@ void Controller::onMessageWritten(size_t /* pending */)
     // Nothing
 }
 
+void Controller::onSessionStarted()
+{
+    ++session_count_;
+
+    if (used_key_count_)
+        --used_key_count_;
+}
+
 void Controller::onSessionFinished()
 {
-    // After disconnecting the peer, one key is released.
-    // Add a new key to the pool and send it to the router.
-    sendKeyPool(1);
+    if (session_count_)
+        --session_count_;
+
+    // After disconnecting the peers, a place for a new session is released. If the pool was
+    // limited by the maximum number of peers, then it can be refilled now.
+    refillKeyPool();
 }
 
-void Controller::onPoolKeyExpired(uint32_t /* key_id */)
+void Controller::onSessionStatistics(size_t worker_index,
+                                     const std::vector<Session::Statistics>& statistics)
 {
-    // The key has expired and has been removed from the pool.
-    // Add a new key to the pool and send it to the router.
-    sendKeyPool(1);
+    if (worker_index >= session_statistics_.size())
+        return;
+
+    session_statistics_[worker_index] = statistics;
+    session_statistics_updated_[worker_index] = true;
+
+    // The load is reported when each worker has sampled its sessions since the last report, so
+    // the router always gets the current throughput.
+    if (std::find(session_statistics_updated_.begin(), session_statistics_updated_.end(), false) !=
+        session_statistics_updated_.end())
+    {
+        return;
+    }
+
+    std::fill(session_statistics_updated_.begin(), session_statistics_updated_.end(), false);
+    sendLoad();
+}
+
+void Controller::onPoolKeyExpired(uint32_t key_id)
+{
+    // The key has expired and has been removed from the pool. The router has already given it
+    // to the peers, so the number of keys in the router does not change.
+    LOG(LS_INFO) << "Key " << key_id << " was not used by peers";
+
+    if (used_key_count_)
+        --used_key_count_;
+
+    // The place reserved for the session of this key is released.
+    refillKeyPool();
 }
 
 void Controller::connectToRouter()
@@ -255,23 +326,20 @@ void Controller::delayedConnectToRouter()
     reconnect_timer_.start(kReconnectTimeout, std::bind(&Controller::connectToRouter, this));
 }
 
-void Controller::sendKeyPool(uint32_t key_count)
+// static
+bool Controller::createKeyPool(SharedPool* shared_pool,
+                               uint32_t key_count,
+                               proto::RelayKeyPool* key_pool)
 {
-    std::unique_ptr<proto::RelayToRouter> message = std::make_unique<proto::RelayToRouter>();
-    proto::RelayKeyPool* relay_key_pool = message->mutable_key_pool();
-
-    relay_key_pool->set_peer_host(base::utf8FromUtf16(peer_address_));
-    relay_key_pool->set_peer_port(peer_port_);
-
     // Add the requested number of keys to the pool.
     for (uint32_t i = 0; i < key_count; ++i)
     {
         SessionKey session_key = SessionKey::create();
         if (!session_key.isValid())
-            return;
+            return false;
 
         // Add the key to the outgoing message.
-        proto::RelayKey* key = relay_key_pool->add_key();
+        proto::RelayKey* key = key_pool->add_key();
 
         key->set_type(proto::RelayKey::TYPE_X25519);
         key->set_encryption(proto::RelayKey::ENCRYPTION_CHACHA20_POLY1305);
@@ -279,11 +347,115 @@ void Controller::sendKeyPool(uint32_t key_count)
         key->set_iv(base::toStdString(session_key.iv()));
 
         // Add the key to the pool.
-        key->set_key_id(shared_pool_->addKey(std::move(session_key)));
+        key->set_key_id(shared_pool->addKey(std::move(session_key)));
     }
 
+    return true;
+}
+
+void Controller::refillKeyPool()
+{
+    if (!channel_ || !channel_->isConnected())
+    {
+        // There is no authenticated connection to the router. The channel is owned by the
+        // authenticator until authentication is completed.
+        return;
+    }
+
+    if (router_key_count_ > key_pool_low_water_mark_)
+        return;
+
+    uint32_t key_count = 0;
+    if (key_pool_target_size_ > router_key_count_)
+        key_count = key_pool_target_size_ - router_key_count_;
+
+    // The number of active sessions and keys available to or taken by peers must not exceed the
+    // maximum number of peers.
+    uint32_t busy_count = session_count_ + router_key_count_ + used_key_count_;
+    uint32_t free_count = max_peer_count_ > busy_count ? max_peer_count_ - busy_count : 0;
+
+    key_count = std::min(key_count, free_count);
+    if (!key_count)
+        return;
+
+    LOG(LS_INFO) << "Refilling key pool (router keys: " << router_key_count_
+                 << ", used keys: " << used_key_count_ << ", sessions: " << session_count_
+                 << ", new keys: " << key_count << ")";
+    sendKeyPool(key_count);
+}
+
+void Controller::sendKeyPool(uint32_t key_count)
+{
+    std::unique_ptr<proto::RelayToRouter> message = std::make_unique<proto::RelayToRouter>();
+    proto::RelayKeyPool* relay_key_pool = message->mutable_key_pool();
+
+    relay_key_pool->set_peer_host(base::utf8FromUtf16(peer_address_));
+    relay_key_pool->set_peer_port(peer_port_);
+
+    if (!createKeyPool(shared_pool_.get(), key_count, relay_key_pool))
+        return;
+
+    router_key_count_ += static_cast<uint32_t>(relay_key_pool->key_size());
+
+    // Send a message to the router.
+    channel_->send(*message);
+}
+
+void Controller::sendStatistics()
+{
+    if (!channel_ || !channel_->isConnected())
+        return;
+
+    std::unique_ptr<proto::RelayToRouter> message = std::make_unique<proto::RelayToRouter>();
+    proto::RelayStat* relay_stat = message->mutable_relay_stat();
+
+    for (const auto& worker_statistics : session_statistics_)
+    {
+        for (const auto& statistics : worker_statistics)
+        {
+            proto::RelayPeerStat* peer_stat = relay_stat->add_peer_stat();
+
+            peer_stat->set_session_id(statistics.session_id);
+            peer_stat->set_duration(static_cast<uint64_t>(statistics.duration.count()));
+            peer_stat->set_rx_bytes(static_cast<uint64_t>(statistics.rx_bytes));
+            peer_stat->set_tx_bytes(static_cast<uint64_t>(statistics.tx_bytes));
+            peer_stat->set_rx_rate(static_cast<uint64_t>(statistics.rx_rate));
+            peer_stat->set_tx_rate(static_cast<uint64_t>(statistics.tx_rate));
+            peer_stat->set_rx_peak_rate(static_cast<uint64_t>(statistics.rx_peak_rate));
+            peer_stat->set_tx_peak_rate(static_cast<uint64_t>(statistics.tx_peak_rate));
+        }
+    }
+
+    // Send a message to the router.
+    channel_->send(*message);
+}
+
+void Controller::sendLoad()
+{
+    if (!channel_ || !channel_->isConnected())
+        return;
+
+    std::unique_ptr<proto::RelayToRouter> message = std::make_unique<proto::RelayToRouter>();
+    proto::RelayLoad* relay_load = message->mutable_relay_load();
+
+    int64_t rx_rate = 0;
+    int64_t tx_rate = 0;
+
+    for (const auto& worker_statistics : session_statistics_)
+    {
+        for (const auto& statistics : worker_statistics)
+        {
+            rx_rate += statistics.rx_rate;
+            tx_rate += statistics.tx_rate;
+        }
+    }
+
+    relay_load->set_active_sessions(session_count_);
+    relay_load->set_rx_rate(static_cast<uint64_t>(rx_rate));
+    relay_load->set_tx_rate(static_cast<uint64_t>(tx_rate));
+
     // Send a message to the router.
-    channel_->send(base::serialize(*message));
+    channel_->send(*message);
 }
 
 } // namespace relay
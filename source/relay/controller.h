@@ -34,7 +34,7 @@ namespace relay {
 
 class Controller
     : public base::NetworkChannel::Listener,
-      public SessionManager::Delegate,
+      public SessionsWorker::Delegate,
       public SharedPool::Delegate
 {
 public:
@@ -43,6 +43,12 @@ public:
 
     bool start();
 
+    // Generates |key_count| new keys, adds them to |shared_pool| and to message |key_pool| in the
+    // form in which they are sent to the router.
+    static bool createKeyPool(SharedPool* shared_pool,
+                              uint32_t key_count,
+                              proto::RelayKeyPool* key_pool);
+
 protected:
     // base::NetworkChannel::Listener implementation.
     void onConnected() override;
@@ -50,8 +56,11 @@ protected:
     void onMessageReceived(const base::ByteArray& buffer) override;
     void onMessageWritten(size_t pending) override;
 
-    // SessionManager::Delegate implementation.
+    // SessionsWorker::Delegate implementation.
+    void onSessionStarted() override;
     void onSessionFinished() override;
+    void onSessionStatistics(size_t worker_index,
+                             const std::vector<Session::Statistics>& statistics) override;
 
     // SharedPool::Delegate implementation.
     void onPoolKeyExpired(uint32_t key_id) override;
@@ -59,7 +68,10 @@ protected:
 private:
     void connectToRouter();
     void delayedConnectToRouter();
+    void refillKeyPool();
     void sendKeyPool(uint32_t key_count);
+    void sendStatistics();
+    void sendLoad();
 
     // Router settings.
     std::u16string router_address_;
@@ -71,9 +83,34 @@ private:
     uint16_t peer_port_ = 0;
     std::chrono::minutes peer_idle_timeout_;
     uint32_t max_peer_count_ = 0;
+    uint32_t peer_worker_count_ = 0;
+
+    // Rate limits in kilobytes per second.
+    uint32_t session_rate_limit_ = 0;
+    uint32_t total_rate_limit_ = 0;
+
+    // Key pool settings.
+    uint32_t key_pool_target_size_ = 0;
+    uint32_t key_pool_low_water_mark_ = 0;
+
+    // Number of keys sent to the router and not yet given to peers.
+    uint32_t router_key_count_ = 0;
+
+    // Number of keys given to peers whose session has not started yet and which have not expired.
+    uint32_t used_key_count_ = 0;
+
+    // Number of active peer sessions.
+    uint32_t session_count_ = 0;
+
+    // The last statistics received from each session worker. Index is the worker index.
+    std::vector<std::vector<Session::Statistics>> session_statistics_;
+
+    // Workers that have sent statistics since the last load report.
+    std::vector<bool> session_statistics_updated_;
 
     std::shared_ptr<base::TaskRunner> task_runner_;
     base::WaitableTimer reconnect_timer_;
+    base::WaitableTimer statistics_timer_;
     std::unique_ptr<base::NetworkChannel> channel_;
     std::unique_ptr<base::ClientAuthenticator> authenticator_;
     std::unique_ptr<SharedPool> shared_pool_;
@@ -0,0 +1,377 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "relay/load_test/load_generator.h"
+
+#include "base/endian_util.h"
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_asio.h"
+#include "base/peer/relay_peer.h"
+#include "base/strings/unicode.h"
+
+#include <asio/read.hpp>
+#include <asio/write.hpp>
+
+namespace relay {
+
+namespace {
+
+// Connections are opened in batches so as not to overflow the listen queue of the relay.
+const size_t kConnectBatchSize = 100;
+const std::chrono::milliseconds kConnectBatchInterval { 10 };
+
+} // namespace
+
+class LoadGenerator::PeerPair
+{
+public:
+    PeerPair(LoadGenerator* generator, const proto::RelayCredentials& credentials);
+    ~PeerPair();
+
+    void start(const asio::ip::tcp::endpoint& endpoint);
+    void stop();
+
+private:
+    enum Side { HOST = 0, CLIENT = 1 };
+    static const int kNumberOfSides = 2;
+
+    void onConnected(int side);
+    void onDataReceived(int side, size_t bytes);
+    void onError(const std::error_code& error_code);
+    void doWrite(int side);
+    void doRead(int side);
+    void doExchange(int side);
+
+    LoadGenerator* generator_;
+    const Pattern pattern_;
+
+    asio::ip::tcp::socket socket_[kNumberOfSides];
+    base::ByteArray auth_message_[kNumberOfSides];
+    uint32_t auth_message_size_[kNumberOfSides];
+
+    base::ByteArray write_buffer_;
+    base::ByteArray read_buffer_[kNumberOfSides];
+
+    Clock::time_point start_time_;
+    bool established_ = false;
+    bool stopped_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(PeerPair);
+};
+
+LoadGenerator::PeerPair::PeerPair(LoadGenerator* generator,
+                                  const proto::RelayCredentials& credentials)
+    : generator_(generator),
+      pattern_(generator->options_.pattern),
+      socket_{ asio::ip::tcp::socket(base::MessageLoop::current()->pumpAsio()->ioContext()),
+               asio::ip::tcp::socket(base::MessageLoop::current()->pumpAsio()->ioContext()) }
+{
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        // Each peer creates its own key pair, as real hosts and clients do.
+        auth_message_[i] =
+            base::RelayPeer::authenticationMessage(credentials.key(), credentials.secret());
+        auth_message_size_[i] =
+            base::EndianUtil::toBig(static_cast<uint32_t>(auth_message_[i].size()));
+        read_buffer_[i].resize(generator->options_.chunk_size);
+    }
+
+    write_buffer_.resize(generator->options_.chunk_size, 0xAA);
+}
+
+LoadGenerator::PeerPair::~PeerPair()
+{
+    stop();
+}
+
+void LoadGenerator::PeerPair::start(const asio::ip::tcp::endpoint& endpoint)
+{
+    start_time_ = Clock::now();
+
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        if (auth_message_[i].empty())
+        {
+            onError(std::error_code());
+            return;
+        }
+
+        socket_[i].async_connect(endpoint, [this, i](const std::error_code& error_code)
+        {
+            if (error_code)
+            {
+                if (error_code != asio::error::operation_aborted)
+                    onError(error_code);
+                return;
+            }
+
+            onConnected(i);
+        });
+    }
+}
+
+void LoadGenerator::PeerPair::stop()
+{
+    if (stopped_)
+        return;
+
+    stopped_ = true;
+
+    std::error_code ignored_code;
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        socket_[i].cancel(ignored_code);
+        socket_[i].close(ignored_code);
+    }
+}
+
+void LoadGenerator::PeerPair::onConnected(int side)
+{
+    std::error_code ignored_code;
+    socket_[side].set_option(asio::ip::tcp::no_delay(true), ignored_code);
+
+    std::array<asio::const_buffer, 2> buffers =
+    {
+        asio::const_buffer(&auth_message_size_[side], sizeof(uint32_t)),
+        asio::const_buffer(auth_message_[side].data(), auth_message_[side].size())
+    };
+
+    asio::async_write(socket_[side], buffers,
+                      [this, side](const std::error_code& error_code, size_t /* bytes */)
+    {
+        if (error_code)
+        {
+            if (error_code != asio::error::operation_aborted)
+                onError(error_code);
+            return;
+        }
+
+        // The relay reads exactly one authentication message. Data written after it stays in
+        // the socket until the opposite peer is connected.
+        switch (pattern_)
+        {
+            case Pattern::BULK:
+                doWrite(side);
+                doRead(side);
+                break;
+
+            case Pattern::STREAM:
+                if (side == HOST)
+                    doWrite(side);
+                else
+                    doRead(side);
+                break;
+
+            case Pattern::INTERACTIVE:
+                if (side == HOST)
+                    doExchange(side);
+                else
+                    doRead(side);
+                break;
+        }
+    });
+}
+
+void LoadGenerator::PeerPair::onDataReceived(int side, size_t bytes)
+{
+    if (side == CLIENT && !established_)
+    {
+        established_ = true;
+        generator_->onPairEstablished(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_time_));
+    }
+
+    generator_->onBytesReceived(bytes);
+}
+
+void LoadGenerator::PeerPair::onError(const std::error_code& error_code)
+{
+    if (stopped_)
+        return;
+
+    LOG(LS_WARNING) << "Peer pair failed: " << base::utf16FromLocal8Bit(error_code.message());
+
+    if (!established_)
+        generator_->onPairFailed();
+
+    stop();
+}
+
+void LoadGenerator::PeerPair::doWrite(int side)
+{
+    asio::async_write(socket_[side], asio::const_buffer(write_buffer_.data(), write_buffer_.size()),
+                      [this, side](const std::error_code& error_code, size_t /* bytes */)
+    {
+        if (error_code)
+        {
+            if (error_code != asio::error::operation_aborted)
+                onError(error_code);
+            return;
+        }
+
+        doWrite(side);
+    });
+}
+
+void LoadGenerator::PeerPair::doRead(int side)
+{
+    base::ByteArray& buffer = read_buffer_[side];
+
+    auto handler = [this, side](const std::error_code& error_code, size_t bytes)
+    {
+        if (error_code)
+        {
+            if (error_code != asio::error::operation_aborted)
+                onError(error_code);
+            return;
+        }
+
+        onDataReceived(side, bytes);
+
+        if (pattern_ == Pattern::INTERACTIVE)
+        {
+            // The client returns each message back to the host.
+            doExchange(side);
+        }
+        else
+        {
+            doRead(side);
+        }
+    };
+
+    if (pattern_ == Pattern::INTERACTIVE)
+        asio::async_read(socket_[side], asio::buffer(buffer.data(), buffer.size()), handler);
+    else
+        socket_[side].async_read_some(asio::buffer(buffer.data(), buffer.size()), handler);
+}
+
+void LoadGenerator::PeerPair::doExchange(int side)
+{
+    asio::async_write(socket_[side], asio::const_buffer(write_buffer_.data(), write_buffer_.size()),
+                      [this, side](const std::error_code& error_code, size_t /* bytes */)
+    {
+        if (error_code)
+        {
+            if (error_code != asio::error::operation_aborted)
+                onError(error_code);
+            return;
+        }
+
+        doRead(side);
+    });
+}
+
+LoadGenerator::LoadGenerator(std::shared_ptr<base::TaskRunner> task_runner,
+                             const Options& options)
+    : task_runner_(std::move(task_runner)),
+      options_(options),
+      endpoint_(asio::ip::address_v4::loopback(), options.port)
+{
+    DCHECK(task_runner_);
+    DCHECK(options_.port);
+    DCHECK(options_.chunk_size);
+}
+
+LoadGenerator::~LoadGenerator() = default;
+
+void LoadGenerator::start(std::vector<proto::RelayCredentials>&& credentials,
+                          FinishCallback callback)
+{
+    credentials_ = std::move(credentials);
+    callback_ = std::move(callback);
+
+    DCHECK(callback_);
+
+    LOG(LS_INFO) << "Starting " << credentials_.size() << " peer pairs";
+    startNextBatch();
+}
+
+// static
+bool LoadGenerator::parsePattern(std::u16string_view name, Pattern* pattern)
+{
+    if (name == u"bulk")
+        *pattern = Pattern::BULK;
+    else if (name == u"stream")
+        *pattern = Pattern::STREAM;
+    else if (name == u"interactive")
+        *pattern = Pattern::INTERACTIVE;
+    else
+        return false;
+
+    return true;
+}
+
+void LoadGenerator::startNextBatch()
+{
+    size_t count = std::min(kConnectBatchSize, credentials_.size() - next_pair_);
+
+    for (size_t i = 0; i < count; ++i, ++next_pair_)
+    {
+        pairs_.emplace_back(std::make_unique<PeerPair>(this, credentials_[next_pair_]));
+        pairs_.back()->start(endpoint_);
+    }
+
+    if (next_pair_ < credentials_.size())
+    {
+        task_runner_->postDelayedTask(
+            std::bind(&LoadGenerator::startNextBatch, this), kConnectBatchInterval);
+        return;
+    }
+
+    // All connections are started. Traffic is measured from this moment.
+    traffic_start_time_ = Clock::now();
+    report_.bytes_received = 0;
+
+    task_runner_->postDelayedTask(
+        std::bind(&LoadGenerator::onTrafficFinished, this), options_.duration);
+}
+
+void LoadGenerator::onPairEstablished(const std::chrono::microseconds& setup_time)
+{
+    ++report_.established_count;
+    report_.setup_latency.emplace_back(setup_time);
+}
+
+void LoadGenerator::onPairFailed()
+{
+    ++report_.failed_count;
+}
+
+void LoadGenerator::onBytesReceived(size_t bytes)
+{
+    report_.bytes_received += bytes;
+}
+
+void LoadGenerator::onTrafficFinished()
+{
+    if (finished_)
+        return;
+
+    finished_ = true;
+    report_.traffic_time =
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - traffic_start_time_);
+
+    for (auto& pair : pairs_)
+        pair->stop();
+
+    callback_();
+}
+
+} // namespace relay
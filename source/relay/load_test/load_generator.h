@@ -0,0 +1,108 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef RELAY__LOAD_TEST__LOAD_GENERATOR_H
+#define RELAY__LOAD_TEST__LOAD_GENERATOR_H
+
+#include "base/macros_magic.h"
+#include "proto/router_common.pb.h"
+
+#include <asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace base {
+class TaskRunner;
+} // namespace base
+
+namespace relay {
+
+// Opens pairs of peer connections to a relay over loopback and pushes traffic through them.
+class LoadGenerator
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Pattern
+    {
+        BULK,       // Both peers send data continuously.
+        STREAM,     // Only the first peer sends data continuously (like a desktop stream).
+        INTERACTIVE // Peers exchange small messages in turn (ping-pong).
+    };
+
+    struct Options
+    {
+        uint16_t port = 0;
+        Pattern pattern = Pattern::BULK;
+        size_t chunk_size = 16 * 1024;
+        std::chrono::seconds duration { 10 };
+    };
+
+    struct Report
+    {
+        size_t established_count = 0;
+        size_t failed_count = 0;
+        uint64_t bytes_received = 0;
+        std::chrono::microseconds traffic_time { 0 };
+        std::vector<std::chrono::microseconds> setup_latency;
+    };
+
+    using FinishCallback = std::function<void()>;
+
+    LoadGenerator(std::shared_ptr<base::TaskRunner> task_runner, const Options& options);
+    ~LoadGenerator();
+
+    // Starts connecting pairs of peers using |credentials| (one entry per pair). When the traffic
+    // time has elapsed, all connections are closed and |callback| is called.
+    void start(std::vector<proto::RelayCredentials>&& credentials, FinishCallback callback);
+
+    const Report& report() const { return report_; }
+
+    static bool parsePattern(std::u16string_view name, Pattern* pattern);
+
+private:
+    class PeerPair;
+    friend class PeerPair;
+
+    void startNextBatch();
+    void onPairEstablished(const std::chrono::microseconds& setup_time);
+    void onPairFailed();
+    void onBytesReceived(size_t bytes);
+    void onTrafficFinished();
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options options_;
+    asio::ip::tcp::endpoint endpoint_;
+
+    std::vector<proto::RelayCredentials> credentials_;
+    std::vector<std::unique_ptr<PeerPair>> pairs_;
+    size_t next_pair_ = 0;
+
+    Clock::time_point traffic_start_time_;
+    bool finished_ = false;
+    FinishCallback callback_;
+    Report report_;
+
+    DISALLOW_COPY_AND_ASSIGN(LoadGenerator);
+};
+
+} // namespace relay
+
+#endif // RELAY__LOAD_TEST__LOAD_GENERATOR_H
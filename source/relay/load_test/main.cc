@@ -0,0 +1,288 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/crypto/random.h"
+#include "base/crypto/scoped_crypto_initializer.h"
+#include "base/message_loop/message_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/unicode.h"
+#include "build/build_config.h"
+#include "proto/router_relay.pb.h"
+#include "relay/controller.h"
+#include "relay/sessions_worker.h"
+#include "relay/shared_pool.h"
+#include "relay/load_test/load_generator.h"
+
+#if defined(OS_WIN)
+#include <Windows.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+const uint16_t kDefaultPort = 18999;
+const uint32_t kDefaultPairCount = 1000;
+
+class RelayDelegate
+    : public relay::SharedPool::Delegate,
+      public relay::SessionsWorker::Delegate
+{
+public:
+    RelayDelegate() = default;
+    ~RelayDelegate() = default;
+
+    // relay::SharedPool::Delegate implementation.
+    void onPoolKeyExpired(uint32_t /* key_id */) override {}
+
+    // relay::SessionsWorker::Delegate implementation.
+    void onSessionStarted() override {}
+    void onSessionFinished() override {}
+    void onSessionStatistics(
+        size_t /* worker_index */,
+        const std::vector<relay::Session::Statistics>& /* statistics */) override {}
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(RelayDelegate);
+};
+
+#if defined(OS_WIN)
+std::chrono::microseconds fileTimeToMicroseconds(const FILETIME& file_time)
+{
+    ULARGE_INTEGER value;
+    value.LowPart = file_time.dwLowDateTime;
+    value.HighPart = file_time.dwHighDateTime;
+    return std::chrono::microseconds(value.QuadPart / 10);
+}
+#endif // defined(OS_WIN)
+
+// Returns user + kernel CPU time consumed by the whole process.
+std::chrono::microseconds processCpuTime()
+{
+#if defined(OS_WIN)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+        return std::chrono::microseconds(0);
+    return fileTimeToMicroseconds(kernel_time) + fileTimeToMicroseconds(user_time);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return std::chrono::microseconds(0);
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+#endif
+}
+
+// Returns user + kernel CPU time consumed by the calling thread.
+std::chrono::microseconds threadCpuTime()
+{
+#if defined(OS_WIN)
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+        return std::chrono::microseconds(0);
+    return fileTimeToMicroseconds(kernel_time) + fileTimeToMicroseconds(user_time);
+#else
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+        return std::chrono::microseconds(0);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_nsec / 1000);
+#endif
+}
+
+uint32_t uintSwitch(const base::CommandLine& command_line, std::u16string_view name,
+                    uint32_t default_value)
+{
+    if (!command_line.hasSwitch(name))
+        return default_value;
+
+    unsigned int value;
+    if (!base::stringToUint(command_line.switchValue(name), &value))
+    {
+        std::cout << "Invalid value for switch: " << base::utf8FromUtf16(name) << std::endl;
+        return default_value;
+    }
+
+    return value;
+}
+
+std::chrono::microseconds percentile(
+    const std::vector<std::chrono::microseconds>& sorted_values, double percent)
+{
+    if (sorted_values.empty())
+        return std::chrono::microseconds(0);
+
+    size_t index = static_cast<size_t>(percent / 100.0 * (sorted_values.size() - 1) + 0.5);
+    return sorted_values[std::min(index, sorted_values.size() - 1)];
+}
+
+void printReport(const relay::LoadGenerator::Report& report,
+                 const std::chrono::microseconds& relay_cpu_time)
+{
+    std::vector<std::chrono::microseconds> latency = report.setup_latency;
+    std::sort(latency.begin(), latency.end());
+
+    double seconds = static_cast<double>(report.traffic_time.count()) / 1000000.0;
+    double megabytes = static_cast<double>(report.bytes_received) / (1024.0 * 1024.0);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Pairs established: " << report.established_count
+              << ", failed: " << report.failed_count << std::endl
+              << "Setup latency (ms): p50 " << percentile(latency, 50).count() / 1000.0
+              << ", p90 " << percentile(latency, 90).count() / 1000.0
+              << ", p99 " << percentile(latency, 99).count() / 1000.0
+              << ", max " << percentile(latency, 100).count() / 1000.0 << std::endl
+              << "Relayed: " << megabytes << " MB in " << seconds << " s ("
+              << (seconds > 0 ? megabytes / seconds : 0) << " MB/s)" << std::endl
+              << "Relay CPU time: " << relay_cpu_time.count() / 1000.0 << " ms";
+
+    if (report.bytes_received)
+    {
+        std::cout << " (" << static_cast<double>(relay_cpu_time.count()) * 1000.0 /
+                             static_cast<double>(report.bytes_received) << " ns/byte)";
+    }
+
+    std::cout << std::endl;
+}
+
+void showHelp()
+{
+    std::cout << "aspia_relay_load_test [switches]" << std::endl
+        << "Available switches:" << std::endl
+        << '\t' << "--pairs=<count>"      << '\t' << "Number of peer pairs (default: "
+                                              << kDefaultPairCount << ")" << std::endl
+        << '\t' << "--port=<port>"        << '\t' << "Relay peer port (default: "
+                                              << kDefaultPort << ")" << std::endl
+        << '\t' << "--workers=<count>"    << '\t' << "Relay session workers (0 - number of cores)"
+                                              << std::endl
+        << '\t' << "--pattern=<name>"     << '\t' << "Traffic pattern: bulk, stream, interactive"
+                                              << std::endl
+        << '\t' << "--chunk-size=<bytes>" << '\t' << "Size of one write" << std::endl
+        << '\t' << "--duration=<seconds>" << '\t' << "Traffic time" << std::endl
+        << '\t' << "--help"               << '\t' << "Show help" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine::init(argc, argv);
+    const base::CommandLine& command_line = *base::CommandLine::forCurrentProcess();
+
+    if (command_line.hasSwitch(u"help"))
+    {
+        showHelp();
+        return 0;
+    }
+
+    base::LoggingSettings logging_settings;
+    logging_settings.min_log_level = base::LOG_LS_WARNING;
+    base::initLogging(logging_settings);
+
+    base::ScopedCryptoInitializer crypto_initializer;
+
+    relay::LoadGenerator::Options options;
+    options.port = static_cast<uint16_t>(uintSwitch(command_line, u"port", kDefaultPort));
+    options.chunk_size = uintSwitch(command_line, u"chunk-size", options.chunk_size);
+    options.duration = std::chrono::seconds(
+        uintSwitch(command_line, u"duration", options.duration.count()));
+
+    if (command_line.hasSwitch(u"pattern") &&
+        !relay::LoadGenerator::parsePattern(command_line.switchValue(u"pattern"), &options.pattern))
+    {
+        std::cout << "Unknown traffic pattern" << std::endl;
+        return 1;
+    }
+
+    uint32_t pair_count = uintSwitch(command_line, u"pairs", kDefaultPairCount);
+    uint32_t worker_count = uintSwitch(command_line, u"workers", 0);
+
+    std::unique_ptr<base::MessageLoop> message_loop =
+        std::make_unique<base::MessageLoop>(base::MessageLoop::Type::ASIO);
+    std::shared_ptr<base::TaskRunner> task_runner = message_loop->taskRunner();
+
+    // The relay under test. It is started in the same way as relay::Controller does it.
+    RelayDelegate relay_delegate;
+    std::unique_ptr<relay::SharedPool> shared_pool =
+        std::make_unique<relay::SharedPool>(&relay_delegate);
+    std::unique_ptr<relay::SessionsWorker> sessions_worker =
+        std::make_unique<relay::SessionsWorker>(
+            options.port, std::chrono::minutes(5), worker_count, shared_pool->share());
+    sessions_worker->start(task_runner, &relay_delegate);
+
+    // Act as a router: receive the key pool from the relay and give out one key to each pair of
+    // peers.
+    proto::RelayToRouter relay_message;
+    if (!relay::Controller::createKeyPool(
+            shared_pool.get(), pair_count, relay_message.mutable_key_pool()))
+    {
+        std::cout << "Unable to create key pool" << std::endl;
+        return 1;
+    }
+
+    proto::RelayToRouter router_message;
+    if (!base::parse(base::serialize(relay_message), &router_message))
+    {
+        std::cout << "Unable to parse key pool" << std::endl;
+        return 1;
+    }
+
+    std::vector<proto::RelayCredentials> credentials;
+    for (const auto& key : router_message.key_pool().key())
+    {
+        proto::RelayCredentials pair_credentials;
+        pair_credentials.set_host("127.0.0.1");
+        pair_credentials.set_port(options.port);
+        pair_credentials.mutable_key()->CopyFrom(key);
+        pair_credentials.set_secret(base::Random::string(16));
+
+        credentials.emplace_back(std::move(pair_credentials));
+    }
+
+    std::cout << "Relay workers: " << sessions_worker->workerCount()
+              << ", peer pairs: " << credentials.size() << std::endl;
+
+    relay::LoadGenerator generator(task_runner, options);
+
+    // The generator runs on this thread, the relay on the worker threads. The relay CPU time is
+    // the process time without the time of this thread.
+    std::chrono::microseconds process_start_time = processCpuTime();
+    std::chrono::microseconds thread_start_time = threadCpuTime();
+
+    generator.start(std::move(credentials), [task_runner]() { task_runner->postQuit(); });
+    message_loop->run();
+
+    std::chrono::microseconds relay_cpu_time =
+        (processCpuTime() - process_start_time) - (threadCpuTime() - thread_start_time);
+
+    printReport(generator.report(), relay_cpu_time);
+
+    sessions_worker.reset();
+    shared_pool.reset();
+    message_loop.reset();
+
+    base::shutdownLogging();
+    return 0;
+}
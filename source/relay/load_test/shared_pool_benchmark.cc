@@ -0,0 +1,147 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/logging.h"
+#include "base/crypto/key_pair.h"
+#include "base/crypto/scoped_crypto_initializer.h"
+#include "relay/shared_pool.h"
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <thread>
+
+namespace {
+
+const uint32_t kKeyCount = 10000;
+const std::chrono::seconds kRunTime { 2 };
+
+class PoolDelegate : public relay::SharedPool::Delegate
+{
+public:
+    PoolDelegate() = default;
+    ~PoolDelegate() = default;
+
+    // relay::SharedPool::Delegate implementation.
+    void onPoolKeyExpired(uint32_t /* key_id */) override {}
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(PoolDelegate);
+};
+
+// Measures the number of SharedPool::key() calls per second made by |thread_count| threads while
+// another thread adds and removes keys as relay::Controller does. If |hit| is false, then only
+// missing keys are requested and the result shows the cost of the pool itself without key
+// agreement.
+uint64_t runBenchmark(relay::SharedPool* pool, const std::vector<uint32_t>& key_ids,
+                      const std::string& peer_public_key, size_t thread_count, bool hit)
+{
+    std::atomic_bool stop = false;
+    std::atomic_uint64_t lookups = 0;
+
+    std::thread writer([&]()
+    {
+        std::vector<relay::SessionKey> keys;
+        for (int i = 0; i < 100; ++i)
+            keys.emplace_back(relay::SessionKey::create());
+
+        size_t index = 0;
+        while (!stop)
+        {
+            uint32_t key_id = pool->addKey(std::move(keys[index]));
+            pool->removeKey(key_id);
+
+            keys[index] = relay::SessionKey::create();
+            index = (index + 1) % keys.size();
+        }
+    });
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        readers.emplace_back([&, i]()
+        {
+            std::mt19937 random(static_cast<uint32_t>(i));
+            std::uniform_int_distribution<size_t> distribution(0, key_ids.size() - 1);
+            uint64_t count = 0;
+
+            while (!stop)
+            {
+                uint32_t key_id = key_ids[distribution(random)];
+                if (!hit)
+                    key_id += kKeyCount * 1000;
+
+                pool->key(key_id, peer_public_key);
+                ++count;
+            }
+
+            lookups += count;
+        });
+    }
+
+    std::this_thread::sleep_for(kRunTime);
+    stop = true;
+
+    for (auto& reader : readers)
+        reader.join();
+    writer.join();
+
+    return lookups / kRunTime.count();
+}
+
+} // namespace
+
+int main(int /* argc */, const char* const* /* argv */)
+{
+    base::LoggingSettings logging_settings;
+    logging_settings.min_log_level = base::LOG_LS_ERROR;
+    base::initLogging(logging_settings);
+
+    base::ScopedCryptoInitializer crypto_initializer;
+
+    PoolDelegate delegate;
+    relay::SharedPool pool(&delegate);
+
+    std::vector<uint32_t> key_ids;
+    for (uint32_t i = 0; i < kKeyCount; ++i)
+        key_ids.emplace_back(pool.addKey(relay::SessionKey::create()));
+
+    base::KeyPair peer_key_pair = base::KeyPair::create(base::KeyPair::Type::X25519);
+    std::string peer_public_key = base::toStdString(peer_key_pair.publicKey());
+
+    size_t max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+    for (bool hit : { false, true })
+    {
+        std::cout << (hit ? "Lookups with key agreement:" : "Lookups of missing keys:")
+                  << std::endl;
+
+        for (size_t threads = 1; threads <= max_threads; threads *= 2)
+        {
+            uint64_t lookups_per_second =
+                runBenchmark(&pool, key_ids, peer_public_key, threads, hit);
+
+            std::cout << '\t' << threads << " threads: " << lookups_per_second
+                      << " lookups/s (" << lookups_per_second / threads << " per thread)"
+                      << std::endl;
+        }
+    }
+
+    base::shutdownLogging();
+    return 0;
+}
@@ -21,6 +21,8 @@
 #include "base/endian_util.h"
 #include "base/location.h"
 #include "base/logging.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_asio.h"
 #include "base/strings/unicode.h"
 
 #include <asio/read.hpp>
@@ -34,11 +36,9 @@ constexpr uint32_t kMaxMessageSize = 1 * 1024 * 1024; // 1 MB
 
 } // namespace
 
-PendingSession::PendingSession(std::shared_ptr<base::TaskRunner> task_runner,
-                               asio::ip::tcp::socket&& socket,
-                               Delegate* delegate)
+PendingSession::PendingSession(asio::ip::tcp::socket&& socket, Delegate* delegate)
     : delegate_(delegate),
-      timer_(base::WaitableTimer::Type::SINGLE_SHOT, std::move(task_runner)),
+      timer_(&base::MessageLoop::current()->pumpAsio()->timingWheel()),
       socket_(std::move(socket))
 {
     // Nothing
@@ -68,6 +68,14 @@ void PendingSession::start()
     PendingSession::doReadMessage(this);
 }
 
+void PendingSession::startTransferred()
+{
+    LOG(LS_INFO) << "Starting transferred pending session";
+
+    timer_.start(kTimeout, std::bind(
+        &PendingSession::onErrorOccurred, this, FROM_HERE, std::error_code()));
+}
+
 void PendingSession::stop()
 {
     if (!delegate_)
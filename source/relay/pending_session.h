@@ -19,7 +19,7 @@
 #ifndef RELAY__PENDING_SESSION_H
 #define RELAY__PENDING_SESSION_H
 
-#include "base/waitable_timer.h"
+#include "base/timing_wheel.h"
 #include "base/memory/byte_array.h"
 #include "base/peer/host_id.h"
 #include "proto/relay_peer.pb.h"
@@ -28,7 +28,6 @@
 
 namespace base {
 class Location;
-class TaskRunner;
 } // namespace base
 
 namespace relay {
@@ -49,9 +48,7 @@ public:
         virtual void onPendingSessionFailed(PendingSession* session) = 0;
     };
 
-    PendingSession(std::shared_ptr<base::TaskRunner> task_runner,
-                   asio::ip::tcp::socket&& socket,
-                   Delegate* delegate);
+    PendingSession(asio::ip::tcp::socket&& socket, Delegate* delegate);
     ~PendingSession();
 
     // Starts a session. This starts the timer. If the peer does not send authentication data or if
@@ -59,12 +56,19 @@ public:
     // will be called.
     void start();
 
+    // Starts a session whose authentication data has already been received by another worker.
+    // Only the timer is started, no data is read from the peer.
+    void startTransferred();
+
     // Stops a session. No notifications will not come after calling this method.
     void stop();
 
     // Sets session credentials.
     void setIdentify(uint32_t key_id, const base::ByteArray& secret);
 
+    uint32_t keyId() const { return key_id_; }
+    const base::ByteArray& secret() const { return secret_; }
+
     // Returns true if the other session is a pair and false otherwise.
     bool isPeerFor(const PendingSession& other) const;
 
@@ -78,7 +82,7 @@ private:
 
     Delegate* delegate_;
 
-    base::WaitableTimer timer_;
+    base::TimingWheel::Timer timer_;
     asio::ip::tcp::socket socket_;
 
     uint32_t buffer_size_ = 0;
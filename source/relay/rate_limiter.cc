@@ -0,0 +1,109 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "relay/rate_limiter.h"
+
+#include <algorithm>
+
+namespace relay {
+
+namespace {
+
+// The bucket holds the traffic of this period. It limits the size of a burst after an idle time.
+const int64_t kBurstDivider = 4; // 250 ms.
+
+// The bucket must hold at least one minimal read, otherwise a slow session never gets data.
+const int64_t kMinCapacity = 8 * 1024;
+
+} // namespace
+
+RateLimiter::RateLimiter(int64_t rate)
+    : rate_(std::max(rate, int64_t(0))),
+      capacity_(std::max(rate_ / kBurstDivider, kMinCapacity)),
+      fill_time_(rate_ ? capacity_ * 1000000 / rate_ + 1 : 0),
+      tokens_(capacity_),
+      last_refill_time_(Clock::now())
+{
+    // Nothing
+}
+
+RateLimiter::~RateLimiter() = default;
+
+size_t RateLimiter::acquire(size_t wanted, const TimePoint& current_time)
+{
+    if (!isEnabled())
+        return wanted;
+
+    refill(current_time);
+
+    size_t allowed = std::min(wanted, static_cast<size_t>(tokens_));
+    tokens_ -= static_cast<int64_t>(allowed);
+    return allowed;
+}
+
+void RateLimiter::release(size_t bytes)
+{
+    if (!isEnabled())
+        return;
+
+    tokens_ = std::min(tokens_ + static_cast<int64_t>(bytes), capacity_);
+}
+
+void RateLimiter::refill(const TimePoint& current_time)
+{
+    if (current_time <= last_refill_time_)
+        return;
+
+    // A longer pause can not add more than the capacity of the bucket. The limit also keeps the
+    // product below from overflowing after a long idle period.
+    const int64_t elapsed = std::min(std::chrono::duration_cast<std::chrono::microseconds>(
+        current_time - last_refill_time_).count(), fill_time_);
+
+    const int64_t tokens = rate_ * elapsed / 1000000;
+    if (!tokens)
+    {
+        // Less than one byte has accumulated. The time is not updated so that the fraction is not
+        // lost at a high call rate.
+        return;
+    }
+
+    tokens_ = std::min(tokens_ + tokens, capacity_);
+    last_refill_time_ = current_time;
+}
+
+SharedRateLimiter::SharedRateLimiter(int64_t rate)
+    : limiter_(rate)
+{
+    // Nothing
+}
+
+SharedRateLimiter::~SharedRateLimiter() = default;
+
+size_t SharedRateLimiter::acquire(size_t wanted, const RateLimiter::TimePoint& current_time)
+{
+    std::scoped_lock lock(lock_);
+    return limiter_.acquire(wanted, current_time);
+}
+
+void SharedRateLimiter::release(size_t bytes)
+{
+    std::scoped_lock lock(lock_);
+    limiter_.release(bytes);
+}
+
+} // namespace relay
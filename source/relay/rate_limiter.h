@@ -0,0 +1,82 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef RELAY__RATE_LIMITER_H
+#define RELAY__RATE_LIMITER_H
+
+#include "base/macros_magic.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace relay {
+
+// Token bucket. The bucket is refilled when tokens are requested, so the limiter does not need a
+// timer of its own.
+class RateLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
+    // |rate| is the number of bytes per second. If it is 0, then the limiter is disabled.
+    explicit RateLimiter(int64_t rate = 0);
+    ~RateLimiter();
+
+    bool isEnabled() const { return rate_ != 0; }
+    int64_t rate() const { return rate_; }
+
+    // Takes up to |wanted| bytes from the bucket and returns the number of bytes taken. Returns 0
+    // if the bucket is empty.
+    size_t acquire(size_t wanted, const TimePoint& current_time);
+
+    // Returns bytes that were acquired but not transferred.
+    void release(size_t bytes);
+
+private:
+    void refill(const TimePoint& current_time);
+
+    int64_t rate_;
+    int64_t capacity_;
+    int64_t fill_time_; // Microseconds needed to fill an empty bucket.
+    int64_t tokens_;
+    TimePoint last_refill_time_;
+
+    DISALLOW_COPY_AND_ASSIGN(RateLimiter);
+};
+
+// Thread-safe limiter for the traffic of the whole relay. It is shared by all session workers.
+class SharedRateLimiter
+{
+public:
+    explicit SharedRateLimiter(int64_t rate);
+    ~SharedRateLimiter();
+
+    size_t acquire(size_t wanted, const RateLimiter::TimePoint& current_time);
+    void release(size_t bytes);
+
+private:
+    std::mutex lock_;
+    RateLimiter limiter_;
+
+    DISALLOW_COPY_AND_ASSIGN(SharedRateLimiter);
+};
+
+} // namespace relay
+
+#endif // RELAY__RATE_LIMITER_H
@@ -0,0 +1,79 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include "relay/rate_limiter.h"
+
+#include <gtest/gtest.h>
+
+namespace relay {
+
+namespace {
+
+const int64_t kRate = 100 * 1024 * 1024; // 100 MB/s.
+const size_t kCapacity = kRate / 4;
+
+} // namespace
+
+TEST(RateLimiterTest, Disabled)
+{
+    RateLimiter limiter;
+    EXPECT_FALSE(limiter.isEnabled());
+
+    const RateLimiter::TimePoint now = RateLimiter::Clock::now();
+    EXPECT_EQ(limiter.acquire(1000000000, now), 1000000000U);
+}
+
+TEST(RateLimiterTest, Refill)
+{
+    RateLimiter limiter(kRate);
+    const RateLimiter::TimePoint start_time = RateLimiter::Clock::now();
+
+    EXPECT_EQ(limiter.acquire(kCapacity * 2, start_time), kCapacity);
+    EXPECT_EQ(limiter.acquire(1, start_time), 0U);
+
+    // 10 ms of traffic.
+    const RateLimiter::TimePoint time = start_time + std::chrono::milliseconds(10);
+    EXPECT_EQ(limiter.acquire(kCapacity, time), static_cast<size_t>(kRate / 100));
+    EXPECT_EQ(limiter.acquire(1, time), 0U);
+
+    limiter.release(1000);
+    EXPECT_EQ(limiter.acquire(kCapacity, time), 1000U);
+}
+
+TEST(RateLimiterTest, LongIdle)
+{
+    RateLimiter limiter(kRate);
+    RateLimiter::TimePoint time = RateLimiter::Clock::now();
+
+    EXPECT_EQ(limiter.acquire(kCapacity, time), kCapacity);
+
+    // The product of the rate and the idle time in microseconds does not fit into 64 bits.
+    time += std::chrono::hours(30);
+
+    EXPECT_EQ(limiter.acquire(kCapacity * 2, time), kCapacity);
+    EXPECT_EQ(limiter.acquire(1, time), 0U);
+
+    time += std::chrono::hours(30);
+    limiter.release(kCapacity);
+
+    EXPECT_EQ(limiter.acquire(kCapacity * 2, time), kCapacity);
+    EXPECT_EQ(limiter.acquire(1, time), 0U);
+}
+
+} // namespace relay
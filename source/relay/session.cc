@@ -20,22 +20,70 @@
 
 #include "base/location.h"
 #include "base/logging.h"
+#include "base/memory/buffer_pool.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_pump_asio.h"
 #include "base/strings/unicode.h"
 
 #include <asio/write.hpp>
 
+#include <algorithm>
+
+#if defined(OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif // defined(OS_LINUX)
+
 namespace relay {
 
-Session::Session(std::pair<asio::ip::tcp::socket, asio::ip::tcp::socket>&& sockets)
-    : socket_{ std::move(sockets.first), std::move(sockets.second) }
+namespace {
+
+// The session is closed after at most (idle timeout + idle timeout / kIdleCheckCount) of
+// inactivity.
+const int kIdleCheckCount = 4;
+
+// Limits of the adaptive buffer size.
+const size_t kMinBufferSize = 8 * 1024;
+const size_t kMaxBufferSize = 256 * 1024;
+
+#if defined(OS_LINUX)
+// Maximum number of bytes moved by one splice() call. Matches the default pipe capacity.
+const size_t kSpliceSize = 64 * 1024;
+
+std::error_code lastError()
 {
-    for (size_t i = 0; i < kNumberOfSides; ++i)
-        std::fill(buffer_[i].begin(), buffer_[i].end(), 0);
+    return std::error_code(errno, std::system_category());
+}
+#endif // defined(OS_LINUX)
+
+} // namespace
+
+Session::Session(uint64_t session_id,
+                 std::pair<asio::ip::tcp::socket, asio::ip::tcp::socket>&& sockets,
+                 const std::chrono::milliseconds& idle_timeout,
+                 int64_t rate_limit,
+                 SharedRateLimiter* total_rate_limiter)
+    : session_id_(session_id),
+      idle_timeout_(idle_timeout),
+      idle_timer_(&base::MessageLoop::current()->pumpAsio()->timingWheel()),
+      rate_limiter_{ RateLimiter(rate_limit), RateLimiter(rate_limit) },
+      total_rate_limiter_(total_rate_limiter),
+      socket_{ std::move(sockets.first), std::move(sockets.second) },
+      buffer_size_{ kMinBufferSize, kMinBufferSize }
+{
+    // Nothing
 }
 
 Session::~Session()
 {
     stop();
+
+    for (int i = 0; i < kNumberOfSides; ++i)
+        releaseBuffer(i);
+
+#if defined(OS_LINUX)
+    closePipes();
+#endif // defined(OS_LINUX)
 }
 
 void Session::start(Delegate* delegate)
@@ -43,10 +91,30 @@ void Session::start(Delegate* delegate)
     LOG(LS_INFO) << "Starting peers session";
 
     start_time_ = Clock::now();
+    sample_time_ = start_time_;
     delegate_ = delegate;
 
+    idle_timer_.start(idle_timeout_ / kIdleCheckCount, std::bind(&Session::onIdleCheck, this));
+
+#if defined(OS_LINUX)
+    if (startSplice())
+        return;
+
+    LOG(LS_WARNING) << "Zero-copy forwarding is not available. Using buffered forwarding";
+#endif // defined(OS_LINUX)
+
     for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        std::error_code error_code;
+        socket_[i].non_blocking(true, error_code);
+        if (error_code)
+        {
+            LOG(LS_WARNING) << "Unable to set non-blocking mode: "
+                            << base::utf16FromLocal8Bit(error_code.message());
+        }
+
         Session::doReadSome(this, i);
+    }
 }
 
 void Session::stop()
@@ -55,6 +123,7 @@ void Session::stop()
         return;
 
     delegate_ = nullptr;
+    idle_timer_.stop();
 
     std::error_code ignored_code;
     for (int i = 0; i < kNumberOfSides; ++i)
@@ -67,15 +136,28 @@ void Session::stop()
                  << " seconds, bytes transferred: " << bytesTransferred() << ")";
 }
 
-std::chrono::seconds Session::idleTime(const TimePoint& current_time) const
+void Session::resume()
 {
-    if (start_idle_time_ == TimePoint())
+    if (!delegate_)
+        return;
+
+    for (int i = 0; i < kNumberOfSides; ++i)
     {
-        start_idle_time_ = current_time;
-        return std::chrono::seconds(0);
-    }
+        if (!paused_[i])
+            continue;
 
-    return std::chrono::duration_cast<std::chrono::seconds>(current_time - start_idle_time_);
+        paused_[i] = false;
+
+#if defined(OS_LINUX)
+        if (pipe_[i].read_fd != -1)
+        {
+            doWaitReadable(this, i);
+            continue;
+        }
+#endif // defined(OS_LINUX)
+
+        doReadSome(this, i);
+    }
 }
 
 std::chrono::seconds Session::duration() const
@@ -85,44 +167,350 @@ std::chrono::seconds Session::duration() const
 
 int64_t Session::bytesTransferred() const
 {
-    return bytes_transferred_;
+    return bytes_received_[0] + bytes_received_[1];
+}
+
+Session::MemoryUsage Session::memoryUsage() const
+{
+    MemoryUsage usage;
+
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        usage.buffer_bytes += buffer_[i].capacity();
+
+#if defined(OS_LINUX)
+        if (pipe_[i].read_fd != -1)
+        {
+            ++usage.pipe_count;
+            usage.pipe_bytes += pipe_[i].pending;
+        }
+#endif // defined(OS_LINUX)
+    }
+
+    return usage;
+}
+
+Session::Statistics Session::sampleStatistics(const TimePoint& current_time)
+{
+    const int64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        current_time - sample_time_).count();
+
+    int64_t rate[kNumberOfSides] = { 0, 0 };
+
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        if (elapsed_ms > 0)
+            rate[i] = (bytes_received_[i] - sample_bytes_[i]) * 1000 / elapsed_ms;
+
+        peak_rate_[i] = std::max(peak_rate_[i], rate[i]);
+        sample_bytes_[i] = bytes_received_[i];
+    }
+
+    sample_time_ = current_time;
+
+    Statistics statistics;
+    statistics.session_id = session_id_;
+    statistics.duration = std::chrono::duration_cast<std::chrono::seconds>(
+        current_time - start_time_);
+    statistics.rx_bytes = bytes_received_[0];
+    statistics.tx_bytes = bytes_received_[1];
+    statistics.rx_rate = rate[0];
+    statistics.tx_rate = rate[1];
+    statistics.rx_peak_rate = peak_rate_[0];
+    statistics.tx_peak_rate = peak_rate_[1];
+    return statistics;
 }
 
 // static
 void Session::doReadSome(Session* session, int source)
 {
-    session->socket_[source].async_read_some(
-        asio::buffer(session->buffer_[source].data(), session->buffer_[source].size()),
-        [session, source](const std::error_code& error_code, size_t bytes_transferred)
+    // Wait for incoming data without holding a buffer.
+    session->socket_[source].async_wait(asio::ip::tcp::socket::wait_read,
+                                        [session, source](const std::error_code& error_code)
+    {
+        if (error_code)
+        {
+            if (error_code != asio::error::operation_aborted)
+                session->onErrorOccurred(FROM_HERE, error_code);
+            return;
+        }
+
+        base::ByteArray& buffer = session->buffer_[source];
+        size_t& buffer_size = session->buffer_size_[source];
+
+        size_t quota = session->acquireQuota(source, buffer_size);
+        if (!quota)
+            return;
+
+        buffer = base::BufferPool::acquire(buffer_size);
+
+        std::error_code read_error_code;
+        size_t bytes_transferred = session->socket_[source].read_some(
+            asio::buffer(buffer.data(), std::min(quota, buffer.size())), read_error_code);
+        if (read_error_code)
+        {
+            session->releaseQuota(source, quota);
+            session->releaseBuffer(source);
+
+            if (read_error_code == asio::error::would_block)
+                doReadSome(session, source);
+            else
+                session->onErrorOccurred(FROM_HERE, read_error_code);
+            return;
+        }
+
+        // If the buffer was filled completely, then the next read uses a larger buffer. If it is
+        // mostly empty, then the next buffer is smaller.
+        if (bytes_transferred == buffer.size() && buffer_size < kMaxBufferSize)
+            buffer_size = buffer.size() * 2;
+        else if (bytes_transferred < buffer.size() / 4 && buffer_size > kMinBufferSize)
+            buffer_size = buffer.size() / 2;
+
+        session->releaseQuota(source, quota - bytes_transferred);
+        session->addTransferred(source, bytes_transferred);
+
+        asio::async_write(
+            session->socket_[(source + kNumberOfSides - 1) % kNumberOfSides],
+            asio::const_buffer(buffer.data(), bytes_transferred),
+            [session, source](const std::error_code& error_code, size_t /* bytes_transferred */)
+        {
+            if (error_code)
+            {
+                if (error_code != asio::error::operation_aborted)
+                    session->onErrorOccurred(FROM_HERE, error_code);
+            }
+            else
+            {
+                // The data has been sent. The buffer is returned to the pool until new data
+                // arrives.
+                session->releaseBuffer(source);
+                doReadSome(session, source);
+            }
+        });
+    });
+}
+
+void Session::releaseBuffer(int source)
+{
+    base::BufferPool::release(std::move(buffer_[source]));
+}
+
+size_t Session::acquireQuota(int source, size_t wanted)
+{
+    RateLimiter& rate_limiter = rate_limiter_[source];
+
+    if (!rate_limiter.isEnabled() && !total_rate_limiter_)
+        return wanted;
+
+    const RateLimiter::TimePoint current_time = RateLimiter::Clock::now();
+
+    size_t quota = rate_limiter.acquire(wanted, current_time);
+    if (quota && total_rate_limiter_)
+    {
+        size_t total_quota = total_rate_limiter_->acquire(quota, current_time);
+        rate_limiter.release(quota - total_quota);
+        quota = total_quota;
+    }
+
+    if (!quota)
+    {
+        // The data stays in the socket buffer. TCP flow control slows down the sender until the
+        // reading is resumed.
+        paused_[source] = true;
+
+        if (delegate_)
+            delegate_->onSessionThrottled(this);
+    }
+
+    return quota;
+}
+
+void Session::releaseQuota(int source, size_t bytes)
+{
+    if (!bytes)
+        return;
+
+    rate_limiter_[source].release(bytes);
+
+    if (total_rate_limiter_)
+        total_rate_limiter_->release(bytes);
+}
+
+void Session::addTransferred(int source, size_t bytes)
+{
+    bytes_received_[source] += static_cast<int64_t>(bytes);
+}
+
+void Session::onIdleCheck()
+{
+    const int64_t bytes_transferred = bytesTransferred();
+
+    if (bytes_transferred != idle_check_bytes_)
+    {
+        idle_check_bytes_ = bytes_transferred;
+        idle_check_count_ = 0;
+    }
+    else if (++idle_check_count_ >= kIdleCheckCount)
+    {
+        LOG(LS_INFO) << "Session ended by idle timeout";
+
+        if (delegate_)
+            delegate_->onSessionFinished(this);
+
+        stop();
+        return;
+    }
+
+    idle_timer_.start(idle_timeout_ / kIdleCheckCount, std::bind(&Session::onIdleCheck, this));
+}
+
+#if defined(OS_LINUX)
+bool Session::startSplice()
+{
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+        {
+            LOG(LS_ERROR) << "pipe2 failed: " << base::utf16FromLocal8Bit(lastError().message());
+            closePipes();
+            return false;
+        }
+
+        pipe_[i].read_fd = fds[0];
+        pipe_[i].write_fd = fds[1];
+    }
+
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        std::error_code error_code;
+        socket_[i].native_non_blocking(true, error_code);
+        if (error_code)
+        {
+            LOG(LS_ERROR) << "Unable to set non-blocking mode: "
+                          << base::utf16FromLocal8Bit(error_code.message());
+            closePipes();
+            return false;
+        }
+    }
+
+    for (int i = 0; i < kNumberOfSides; ++i)
+        Session::doWaitReadable(this, i);
+
+    return true;
+}
+
+void Session::closePipes()
+{
+    for (int i = 0; i < kNumberOfSides; ++i)
+    {
+        if (pipe_[i].read_fd != -1)
+            close(pipe_[i].read_fd);
+        if (pipe_[i].write_fd != -1)
+            close(pipe_[i].write_fd);
+
+        pipe_[i] = Pipe();
+    }
+}
+
+// static
+void Session::doWaitReadable(Session* session, int source)
+{
+    session->socket_[source].async_wait(asio::ip::tcp::socket::wait_read,
+                                        [session, source](const std::error_code& error_code)
     {
         if (error_code)
         {
             if (error_code != asio::error::operation_aborted)
                 session->onErrorOccurred(FROM_HERE, error_code);
+            return;
         }
+
+        doSpliceToPipe(session, source);
+    });
+}
+
+// static
+void Session::doSpliceToPipe(Session* session, int source)
+{
+    Pipe& pipe = session->pipe_[source];
+
+    size_t quota = session->acquireQuota(source, kSpliceSize);
+    if (!quota)
+        return;
+
+    ssize_t ret = splice(session->socket_[source].native_handle(), nullptr,
+                         pipe.write_fd, nullptr, quota,
+                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (ret <= 0)
+        session->releaseQuota(source, quota);
+
+    if (ret < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            doWaitReadable(session, source);
         else
+            session->onErrorOccurred(FROM_HERE, lastError());
+        return;
+    }
+
+    if (ret == 0)
+    {
+        session->onErrorOccurred(FROM_HERE, asio::error::eof);
+        return;
+    }
+
+    pipe.pending += static_cast<size_t>(ret);
+    session->releaseQuota(source, quota - static_cast<size_t>(ret));
+    session->addTransferred(source, static_cast<size_t>(ret));
+
+    doSpliceFromPipe(session, source);
+}
+
+// static
+void Session::doSpliceFromPipe(Session* session, int source)
+{
+    Pipe& pipe = session->pipe_[source];
+    const int target = (source + kNumberOfSides - 1) % kNumberOfSides;
+
+    while (pipe.pending)
+    {
+        ssize_t ret = splice(pipe.read_fd, nullptr,
+                             session->socket_[target].native_handle(), nullptr, pipe.pending,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (ret < 0)
         {
-            session->bytes_transferred_ += bytes_transferred;
-            session->start_idle_time_ = TimePoint();
+            if (errno == EINTR)
+                continue;
+
+            if (errno != EAGAIN)
+            {
+                session->onErrorOccurred(FROM_HERE, lastError());
+                return;
+            }
 
-            asio::async_write(
-                session->socket_[(source + kNumberOfSides - 1) % kNumberOfSides],
-                asio::const_buffer(session->buffer_[source].data(), bytes_transferred),
-                [session, source](const std::error_code& error_code, size_t bytes_transferred)
+            // The target socket is not ready for writing. We are waiting for it.
+            session->socket_[target].async_wait(asio::ip::tcp::socket::wait_write,
+                                                [session, source](const std::error_code& error_code)
             {
                 if (error_code)
                 {
                     if (error_code != asio::error::operation_aborted)
                         session->onErrorOccurred(FROM_HERE, error_code);
+                    return;
                 }
-                else
-                {
-                    doReadSome(session, source);
-                }
+
+                doSpliceFromPipe(session, source);
             });
+            return;
         }
-    });
+
+        pipe.pending -= static_cast<size_t>(ret);
+    }
+
+    doWaitReadable(session, source);
 }
+#endif // defined(OS_LINUX)
 
 void Session::onErrorOccurred(const base::Location& location, const std::error_code& error_code)
 {
@@ -20,6 +20,10 @@
 #define RELAY__SESSION_H
 
 #include "base/macros_magic.h"
+#include "base/timing_wheel.h"
+#include "base/memory/byte_array.h"
+#include "build/build_config.h"
+#include "relay/rate_limiter.h"
 
 #include <asio/ip/tcp.hpp>
 
@@ -32,7 +36,14 @@ namespace relay {
 class Session
 {
 public:
-    explicit Session(std::pair<asio::ip::tcp::socket, asio::ip::tcp::socket>&& sockets);
+    // The session is finished if no data is transferred during |idle_timeout|.
+    // |rate_limit| is the limit for each direction in bytes per second (0 means no limit).
+    // |total_rate_limiter| limits the traffic of the whole relay and can be null.
+    Session(uint64_t session_id,
+            std::pair<asio::ip::tcp::socket, asio::ip::tcp::socket>&& sockets,
+            const std::chrono::milliseconds& idle_timeout,
+            int64_t rate_limit,
+            SharedRateLimiter* total_rate_limiter);
     ~Session();
 
     using Clock = std::chrono::high_resolution_clock;
@@ -44,28 +55,112 @@ public:
         virtual ~Delegate() = default;
 
         virtual void onSessionFinished(Session* session) = 0;
+
+        // Called when the session has exceeded its rate limit and has stopped reading. The
+        // delegate must call resume() later.
+        virtual void onSessionThrottled(Session* session) = 0;
+    };
+
+    // "rx" is the traffic received from the first peer, "tx" is the traffic sent to it. Rates are
+    // in bytes per second and are calculated between two calls of sampleStatistics().
+    struct Statistics
+    {
+        uint64_t session_id = 0;
+        std::chrono::seconds duration;
+        int64_t rx_bytes = 0;
+        int64_t tx_bytes = 0;
+        int64_t rx_rate = 0;
+        int64_t tx_rate = 0;
+        int64_t rx_peak_rate = 0;
+        int64_t tx_peak_rate = 0;
+    };
+
+    // Memory held by the session. On Linux the data is forwarded through pipes, and buffers are
+    // used only if the pipes can not be created.
+    struct MemoryUsage
+    {
+        size_t buffer_bytes = 0; // Capacity of the buffers taken from base::BufferPool.
+        size_t pipe_count = 0;   // Number of open pipes.
+        size_t pipe_bytes = 0;   // Data in the pipes that has not been sent yet.
     };
 
     void start(Delegate* delegate);
     void stop();
 
-    std::chrono::seconds idleTime(const TimePoint& current_time) const;
+    // Continues reading in the directions that were stopped by the rate limit.
+    void resume();
+
     std::chrono::seconds duration() const;
     int64_t bytesTransferred() const;
+    uint64_t sessionId() const { return session_id_; }
+
+    MemoryUsage memoryUsage() const;
+
+    Statistics sampleStatistics(const TimePoint& current_time);
 
 private:
     static void doReadSome(Session* session, int source);
+    void releaseBuffer(int source);
+
+    // Returns the number of bytes (not more than |wanted|) that can be read from |source| now.
+    // If it is 0, then the direction is paused until resume() is called.
+    size_t acquireQuota(int source, size_t wanted);
+    void releaseQuota(int source, size_t bytes);
+    void addTransferred(int source, size_t bytes);
+    void onIdleCheck();
+
+#if defined(OS_LINUX)
+    // Zero-copy forwarding path. Data is moved from one socket to the other through a pipe
+    // with splice() and never copied into user space.
+    bool startSplice();
+    void closePipes();
+    static void doWaitReadable(Session* session, int source);
+    static void doSpliceToPipe(Session* session, int source);
+    static void doSpliceFromPipe(Session* session, int source);
+#endif // defined(OS_LINUX)
     void onErrorOccurred(const base::Location& location, const std::error_code& error_code);
 
+    static const int kNumberOfSides = 2;
+
+    const uint64_t session_id_;
     TimePoint start_time_;
-    mutable TimePoint start_idle_time_;
-    int64_t bytes_transferred_ = 0;
 
-    static const int kNumberOfSides = 2;
-    static const int kBufferSize = 8192;
+    // Activity is checked several times per idle timeout. A read does not touch the timer.
+    const std::chrono::milliseconds idle_timeout_;
+    base::TimingWheel::Timer idle_timer_;
+    int64_t idle_check_bytes_ = 0;
+    int idle_check_count_ = 0;
+
+    // Number of bytes received from each side.
+    int64_t bytes_received_[kNumberOfSides] = { 0, 0 };
+
+    TimePoint sample_time_;
+    int64_t sample_bytes_[kNumberOfSides] = { 0, 0 };
+    int64_t peak_rate_[kNumberOfSides] = { 0, 0 };
+
+    // Limiter for each direction. Index is the source socket.
+    RateLimiter rate_limiter_[kNumberOfSides];
+    SharedRateLimiter* total_rate_limiter_;
+    bool paused_[kNumberOfSides] = { false, false };
 
     asio::ip::tcp::socket socket_[kNumberOfSides];
-    std::array<uint8_t, kBufferSize> buffer_[kNumberOfSides];
+
+    // The buffer is taken from base::BufferPool only while data is being transferred. An idle
+    // session does not hold any buffers. The size of the buffer depends on the observed throughput.
+    base::ByteArray buffer_[kNumberOfSides];
+    size_t buffer_size_[kNumberOfSides];
+
+#if defined(OS_LINUX)
+    struct Pipe
+    {
+        int read_fd = -1;
+        int write_fd = -1;
+        size_t pending = 0; // Number of bytes in the pipe that have not been sent yet.
+    };
+
+    // Pipe for each direction. Index is the source socket.
+    Pipe pipe_[kNumberOfSides];
+#endif // defined(OS_LINUX)
 
     Delegate* delegate_ = nullptr;
 
@@ -20,17 +20,28 @@
 
 #include "base/logging.h"
 #include "base/task_runner.h"
+#include "base/memory/buffer_pool.h"
 #include "base/message_loop/message_loop.h"
 #include "base/message_loop/message_pump_asio.h"
 #include "base/crypto/message_decryptor_openssl.h"
 #include "base/peer/host_id.h"
 #include "base/strings/unicode.h"
+#include "build/build_config.h"
 
 namespace relay {
 
 namespace {
 
-const std::chrono::minutes kIdleTimerInterval { 1 };
+const std::chrono::minutes kPoolStatisticsInterval { 1 };
+const std::chrono::milliseconds kThrottleTimerInterval { 10 };
+// The relay controller reports the load to the router after each sample.
+const std::chrono::seconds kStatisticsTimerInterval { 5 };
+
+#if defined(OS_LINUX)
+// Allows several acceptors (one per worker) to listen on the same port. The kernel distributes
+// incoming connections between them.
+using ReusePortOption = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif // defined(OS_LINUX)
 
 // Decrypts an encrypted pair of peer identifiers using key |session_key|.
 base::ByteArray decryptSecret(const proto::PeerToRelay& message, const SharedPool::Key& key)
@@ -70,43 +81,41 @@ base::ByteArray decryptSecret(const proto::PeerToRelay& message, const SharedPoo
 
 // Removes a session from the list and returns a pointer to it.
 template<class T>
-std::unique_ptr<T> removeSessionT(std::vector<std::unique_ptr<T>>* session_list, T* session)
+std::unique_ptr<T> removeSessionT(std::unordered_map<T*, std::unique_ptr<T>>* session_list,
+                                  T* session)
 {
     session->stop();
 
-    auto it = session_list->begin();
-    while (it != session_list->end())
-    {
-        if (it->get() == session)
-            break;
-
-        ++it;
-    }
-
-    if (it != session_list->end())
-    {
-        std::unique_ptr<T> result = std::move(*it);
-        session_list->erase(it);
-        return result;
-    }
+    auto it = session_list->find(session);
+    if (it == session_list->end())
+        return nullptr;
 
-    return nullptr;
+    std::unique_ptr<T> result = std::move(it->second);
+    session_list->erase(it);
+    return result;
 }
 
 } // namespace
 
 SessionManager::SessionManager(std::shared_ptr<base::TaskRunner> task_runner,
                                uint16_t port,
-                               const std::chrono::minutes& idle_timeout)
+                               const std::chrono::minutes& idle_timeout,
+                               size_t worker_index,
+                               size_t worker_count)
     : task_runner_(std::move(task_runner)),
-      acceptor_(base::MessageLoop::current()->pumpAsio()->ioContext(),
-                asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)),
+      port_(port),
+      worker_index_(worker_index),
+      worker_count_(worker_count),
+      acceptor_(base::MessageLoop::current()->pumpAsio()->ioContext()),
       idle_timeout_(idle_timeout),
-      idle_timer_(base::MessageLoop::current()->pumpAsio()->ioContext())
+      pool_statistics_timer_(base::MessageLoop::current()->pumpAsio()->ioContext()),
+      throttle_timer_(base::MessageLoop::current()->pumpAsio()->ioContext()),
+      statistics_timer_(base::MessageLoop::current()->pumpAsio()->ioContext())
 {
     DCHECK(task_runner_);
+    DCHECK(worker_count_ && worker_index_ < worker_count_);
 
-    LOG(LS_INFO) << "Session manager port: " << port;
+    LOG(LS_INFO) << "Session manager #" << worker_index_ << " port: " << port_;
 }
 
 SessionManager::~SessionManager()
@@ -114,7 +123,16 @@ SessionManager::~SessionManager()
     std::error_code ignored_code;
     acceptor_.cancel(ignored_code);
     acceptor_.close(ignored_code);
-    idle_timer_.cancel();
+    pool_statistics_timer_.cancel();
+    throttle_timer_.cancel();
+    statistics_timer_.cancel();
+}
+
+void SessionManager::setRateLimits(int64_t session_rate_limit,
+                                   std::shared_ptr<SharedRateLimiter> total_rate_limiter)
+{
+    session_rate_limit_ = session_rate_limit;
+    total_rate_limiter_ = std::move(total_rate_limiter);
 }
 
 void SessionManager::start(std::unique_ptr<SharedPool> shared_pool, Delegate* delegate)
@@ -126,10 +144,40 @@ void SessionManager::start(std::unique_ptr<SharedPool> shared_pool, Delegate* de
 
     DCHECK(delegate_ && shared_pool_);
 
-    idle_timer_.expires_after(kIdleTimerInterval);
-    idle_timer_.async_wait(std::bind(&SessionManager::doIdleTimeout, this, std::placeholders::_1));
+    pool_statistics_timer_.expires_after(kPoolStatisticsInterval);
+    pool_statistics_timer_.async_wait(
+        std::bind(&SessionManager::doPoolStatisticsTimeout, this, std::placeholders::_1));
+
+    statistics_timer_.expires_after(kStatisticsTimerInterval);
+    statistics_timer_.async_wait(
+        std::bind(&SessionManager::doStatisticsTimeout, this, std::placeholders::_1));
 
-    SessionManager::doAccept(this);
+    if (port_ && listen())
+        SessionManager::doAccept(this);
+}
+
+void SessionManager::addPendingSession(asio::ip::tcp::socket::native_handle_type socket,
+                                       const proto::PeerToRelay& message)
+{
+    asio::ip::tcp::socket peer_socket(base::MessageLoop::current()->pumpAsio()->ioContext());
+
+    std::error_code error_code;
+    peer_socket.assign(asio::ip::tcp::v4(), socket, error_code);
+    if (error_code)
+    {
+        LOG(LS_ERROR) << "Unable to adopt transferred socket: "
+                      << base::utf16FromLocal8Bit(error_code.message());
+        return;
+    }
+
+    std::unique_ptr<PendingSession> pending_session =
+        std::make_unique<PendingSession>(std::move(peer_socket), this);
+
+    PendingSession* session = pending_session.get();
+    pending_sessions_.emplace(session, std::move(pending_session));
+    session->startTransferred();
+
+    onPendingSessionReady(session, message);
 }
 
 void SessionManager::onPendingSessionReady(
@@ -137,6 +185,14 @@ void SessionManager::onPendingSessionReady(
 {
     LOG(LS_INFO) << "Pending session ready for key_id: " << message.key_id();
 
+    // Both peers with the same key must be paired on the same worker.
+    size_t owner_index = message.key_id() % worker_count_;
+    if (owner_index != worker_index_)
+    {
+        transferPendingSession(owner_index, session, message);
+        return;
+    }
+
     // Looking for a key with the specified identifier.
     std::optional<SharedPool::Key> key = shared_pool_->key(message.key_id(), message.public_key());
     if (key.has_value())
@@ -149,25 +205,41 @@ void SessionManager::onPendingSessionReady(
             session->setIdentify(message.key_id(), secret);
 
             // Trying to find a peer that wants to be connected.
-            for (auto& other_session : pending_sessions_)
+            auto result = pending_index_.try_emplace(
+                PeerIdentify{ message.key_id(), secret }, session);
+            if (!result.second)
             {
-                if (session->isPeerFor(*other_session))
-                {
-                    LOG(LS_INFO) << "Both peers are connected with key " << message.key_id();
-
-                    // Delete the key from the pool. It can no longer be used.
-                    shared_pool_->removeKey(message.key_id());
-
-                    // Now the opposite peer is found, start the data transfer between them.
-                    active_sessions_.emplace_back(std::make_unique<Session>(
-                        std::make_pair(session->takeSocket(), other_session->takeSocket())));
-                    active_sessions_.back()->start(this);
-
-                    // Pending sessions are no longer needed, remove them.
-                    removePendingSession(other_session.get());
-                    removePendingSession(session);
-                    return;
-                }
+                PendingSession* other_session = result.first->second;
+                DCHECK(session->isPeerFor(*other_session));
+
+                LOG(LS_INFO) << "Both peers are connected with key " << message.key_id();
+
+                // Delete the key from the pool. It can no longer be used.
+                shared_pool_->removeKey(message.key_id());
+
+                // Now the opposite peer is found, start the data transfer between them.
+                // Session identifiers are unique within the relay: each worker uses its own
+                // residue class.
+                uint64_t session_id = session_count_++ * worker_count_ + worker_index_;
+
+                std::unique_ptr<Session> active_session = std::make_unique<Session>(
+                    session_id,
+                    std::make_pair(session->takeSocket(), other_session->takeSocket()),
+                    idle_timeout_,
+                    session_rate_limit_,
+                    total_rate_limiter_.get());
+
+                Session* active_session_ptr = active_session.get();
+                active_sessions_.emplace(active_session_ptr, std::move(active_session));
+                active_session_ptr->start(this);
+
+                if (delegate_)
+                    delegate_->onSessionStarted();
+
+                // Pending sessions are no longer needed, remove them.
+                removePendingSession(other_session);
+                removePendingSession(session);
+                return;
             }
 
             LOG(LS_INFO) << "Second peer has not connected yet";
@@ -197,6 +269,70 @@ void SessionManager::onSessionFinished(Session* session)
     removeSession(session);
 }
 
+void SessionManager::onSessionThrottled(Session* session)
+{
+    if (!throttled_sessions_.insert(session).second || throttled_sessions_.size() != 1)
+    {
+        // The timer is already running.
+        return;
+    }
+
+    throttle_timer_.expires_after(kThrottleTimerInterval);
+    throttle_timer_.async_wait(
+        std::bind(&SessionManager::doThrottleTimeout, this, std::placeholders::_1));
+}
+
+bool SessionManager::listen()
+{
+    asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port_);
+    std::error_code error_code;
+
+    acceptor_.open(endpoint.protocol(), error_code);
+    if (error_code)
+    {
+        LOG(LS_ERROR) << "acceptor.open failed: " << base::utf16FromLocal8Bit(error_code.message());
+        return false;
+    }
+
+    acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true), error_code);
+    if (error_code)
+    {
+        LOG(LS_ERROR) << "acceptor.set_option failed: "
+                      << base::utf16FromLocal8Bit(error_code.message());
+        return false;
+    }
+
+#if defined(OS_LINUX)
+    if (worker_count_ > 1)
+    {
+        acceptor_.set_option(ReusePortOption(true), error_code);
+        if (error_code)
+        {
+            LOG(LS_ERROR) << "acceptor.set_option failed: "
+                          << base::utf16FromLocal8Bit(error_code.message());
+            return false;
+        }
+    }
+#endif // defined(OS_LINUX)
+
+    acceptor_.bind(endpoint, error_code);
+    if (error_code)
+    {
+        LOG(LS_ERROR) << "acceptor.bind failed: " << base::utf16FromLocal8Bit(error_code.message());
+        return false;
+    }
+
+    acceptor_.listen(asio::socket_base::max_listen_connections, error_code);
+    if (error_code)
+    {
+        LOG(LS_ERROR) << "acceptor.listen failed: "
+                      << base::utf16FromLocal8Bit(error_code.message());
+        return false;
+    }
+
+    return true;
+}
+
 // static
 void SessionManager::doAccept(SessionManager* self)
 {
@@ -209,9 +345,12 @@ void SessionManager::doAccept(SessionManager* self)
                 socket.remote_endpoint().address().to_string());
 
             // A new peer is connected. Create and start the pending session.
-            self->pending_sessions_.emplace_back(std::make_unique<PendingSession>(
-                self->task_runner_, std::move(socket), self));
-            self->pending_sessions_.back()->start();
+            std::unique_ptr<PendingSession> pending_session =
+                std::make_unique<PendingSession>(std::move(socket), self);
+
+            PendingSession* session = pending_session.get();
+            self->pending_sessions_.emplace(session, std::move(pending_session));
+            session->start();
         }
         else
         {
@@ -228,53 +367,119 @@ void SessionManager::doAccept(SessionManager* self)
 }
 
 // static
-void SessionManager::doIdleTimeout(SessionManager* self, const std::error_code& error_code)
+void SessionManager::doPoolStatisticsTimeout(SessionManager* self,
+                                             const std::error_code& error_code)
 {
     if (error_code == asio::error::operation_aborted)
         return;
 
-    self->doIdleTimeoutImpl(error_code);
+    Session::MemoryUsage total;
+    for (const auto& session : self->active_sessions_)
+    {
+        Session::MemoryUsage usage = session.first->memoryUsage();
+        total.buffer_bytes += usage.buffer_bytes;
+        total.pipe_count += usage.pipe_count;
+        total.pipe_bytes += usage.pipe_bytes;
+    }
+
+    // The counters of the pool are shared by all workers of the process.
+    const base::BufferPool::Stat stat = base::BufferPool::stat();
+    LOG(LS_INFO) << "Sessions: " << self->active_sessions_.size() << ", buffers: "
+                 << total.buffer_bytes << " bytes, pipes: " << total.pipe_count << " ("
+                 << total.pipe_bytes << " bytes pending). Buffer pool: "
+                 << stat.allocated << " allocated, " << stat.reused << " reused, "
+                 << stat.recycled << " recycled, " << stat.dropped << " dropped";
+
+    self->pool_statistics_timer_.expires_after(kPoolStatisticsInterval);
+    self->pool_statistics_timer_.async_wait(
+        std::bind(&SessionManager::doPoolStatisticsTimeout, self, std::placeholders::_1));
 }
 
-void SessionManager::doIdleTimeoutImpl(const std::error_code& error_code)
+// static
+void SessionManager::doThrottleTimeout(SessionManager* self, const std::error_code& error_code)
 {
-    if (!error_code)
-    {
-        auto current_time = Session::Clock::now();
-        auto it = active_sessions_.begin();
-        int count = 0;
+    if (error_code == asio::error::operation_aborted)
+        return;
 
-        while (it != active_sessions_.end())
-        {
-            if ((*it)->idleTime(current_time) >= idle_timeout_)
-            {
-                it = active_sessions_.erase(it);
-                ++count;
-            }
-            else
-            {
-                ++it;
-            }
-        }
+    // Sessions that are still over the limit are added to the list again.
+    std::unordered_set<Session*> sessions;
+    sessions.swap(self->throttled_sessions_);
 
-        LOG(LS_INFO) << "Sessions ended by timeout: " << count;
-    }
-    else
+    for (Session* session : sessions)
+        session->resume();
+}
+
+// static
+void SessionManager::doStatisticsTimeout(SessionManager* self, const std::error_code& error_code)
+{
+    if (error_code == asio::error::operation_aborted)
+        return;
+
+    const Session::TimePoint current_time = Session::Clock::now();
+
+    std::vector<Session::Statistics> statistics;
+    statistics.reserve(self->active_sessions_.size());
+
+    for (const auto& session : self->active_sessions_)
+        statistics.emplace_back(session.second->sampleStatistics(current_time));
+
+    if (self->delegate_)
+        self->delegate_->onSessionStatistics(self->worker_index_, statistics);
+
+    self->statistics_timer_.expires_after(kStatisticsTimerInterval);
+    self->statistics_timer_.async_wait(
+        std::bind(&SessionManager::doStatisticsTimeout, self, std::placeholders::_1));
+}
+
+size_t SessionManager::PeerIdentifyHash::operator()(const PeerIdentify& identify) const
+{
+    std::string_view secret(reinterpret_cast<const char*>(identify.secret.data()),
+                            identify.secret.size());
+    return std::hash<std::string_view>()(secret) ^ std::hash<uint32_t>()(identify.key_id);
+}
+
+void SessionManager::transferPendingSession(size_t worker_index,
+                                            PendingSession* session,
+                                            const proto::PeerToRelay& message)
+{
+    asio::ip::tcp::socket socket = session->takeSocket();
+    removePendingSession(session);
+
+    std::error_code error_code;
+    asio::ip::tcp::socket::native_handle_type native_socket = socket.release(error_code);
+    if (error_code)
     {
-        LOG(LS_ERROR) << "Error in idle timer: " << base::utf16FromLocal8Bit(error_code.message());
+        LOG(LS_ERROR) << "Unable to release socket: "
+                      << base::utf16FromLocal8Bit(error_code.message());
+        return;
     }
 
-    idle_timer_.expires_after(kIdleTimerInterval);
-    idle_timer_.async_wait(std::bind(&SessionManager::doIdleTimeout, this, std::placeholders::_1));
+    LOG(LS_INFO) << "Pending session with key " << message.key_id()
+                 << " transferred to worker #" << worker_index;
+
+    if (delegate_)
+        delegate_->onPendingSessionTransfer(worker_index, native_socket, message);
 }
 
 void SessionManager::removePendingSession(PendingSession* session)
 {
+    removeFromIndex(session);
     task_runner_->deleteSoon(removeSessionT(&pending_sessions_, session));
 }
 
+void SessionManager::removeFromIndex(PendingSession* session)
+{
+    if (session->secret().empty())
+        return;
+
+    auto it = pending_index_.find(PeerIdentify{ session->keyId(), session->secret() });
+    if (it != pending_index_.end() && it->second == session)
+        pending_index_.erase(it);
+}
+
 void SessionManager::removeSession(Session* session)
 {
+    throttled_sessions_.erase(session);
     task_runner_->deleteSoon(removeSessionT(&active_sessions_, session));
 
     if (delegate_)
@@ -21,11 +21,15 @@
 
 #include "proto/relay_peer.pb.h"
 #include "relay/pending_session.h"
+#include "relay/rate_limiter.h"
 #include "relay/session.h"
 #include "relay/shared_pool.h"
 
 #include <asio/high_resolution_timer.hpp>
 
+#include <unordered_map>
+#include <unordered_set>
+
 namespace base {
 class TaskRunner;
 } // namespace base
@@ -42,16 +46,44 @@ public:
     public:
         virtual ~Delegate() = default;
 
+        virtual void onSessionStarted() = 0;
         virtual void onSessionFinished() = 0;
+
+        // Called when a peer has sent credentials for a key that is served by another worker.
+        // The socket is released from the session manager and must be adopted by the worker
+        // with index |worker_index|.
+        virtual void onPendingSessionTransfer(size_t worker_index,
+                                              asio::ip::tcp::socket::native_handle_type socket,
+                                              const proto::PeerToRelay& message) = 0;
+
+        // Called periodically with the traffic statistics of all active sessions of the worker.
+        virtual void onSessionStatistics(size_t worker_index,
+                                         const std::vector<Session::Statistics>& statistics) = 0;
     };
 
+    // If |port| is 0, then the manager does not accept incoming connections and serves only
+    // sessions transferred from other workers. Pending sessions are paired on the worker with
+    // index (key_id % |worker_count|).
     SessionManager(std::shared_ptr<base::TaskRunner> task_runner,
                    uint16_t port,
-                   const std::chrono::minutes& idle_timeout);
+                   const std::chrono::minutes& idle_timeout,
+                   size_t worker_index = 0,
+                   size_t worker_count = 1);
     ~SessionManager();
 
+    // Sets the limit for each direction of each session in bytes per second (0 means no limit)
+    // and the limiter for the traffic of the whole relay (can be null). Must be called before
+    // start().
+    void setRateLimits(int64_t session_rate_limit,
+                       std::shared_ptr<SharedRateLimiter> total_rate_limiter);
+
     void start(std::unique_ptr<SharedPool> shared_pool, Delegate* delegate);
 
+    // Adopts a socket of a pending session that has already sent its credentials to another
+    // worker.
+    void addPendingSession(asio::ip::tcp::socket::native_handle_type socket,
+                           const proto::PeerToRelay& message);
+
 protected:
     // PendingSession::Delegate implementation.
     void onPendingSessionReady(
@@ -60,23 +92,65 @@ protected:
 
     // Session::Delegate implementation.
     void onSessionFinished(Session* session) override;
+    void onSessionThrottled(Session* session) override;
 
 private:
+    bool listen();
     static void doAccept(SessionManager* self);
-    static void doIdleTimeout(SessionManager* self, const std::error_code& error_code);
-    void doIdleTimeoutImpl(const std::error_code& error_code);
+    static void doPoolStatisticsTimeout(SessionManager* self, const std::error_code& error_code);
+    static void doThrottleTimeout(SessionManager* self, const std::error_code& error_code);
+    static void doStatisticsTimeout(SessionManager* self, const std::error_code& error_code);
 
+    void transferPendingSession(size_t worker_index,
+                                PendingSession* session,
+                                const proto::PeerToRelay& message);
     void removePendingSession(PendingSession* sessions);
+    void removeFromIndex(PendingSession* session);
     void removeSession(Session* session);
 
     std::shared_ptr<base::TaskRunner> task_runner_;
 
+    const uint16_t port_;
+    const size_t worker_index_;
+    const size_t worker_count_;
+
     asio::ip::tcp::acceptor acceptor_;
-    std::vector<std::unique_ptr<PendingSession>> pending_sessions_;
-    std::vector<std::unique_ptr<Session>> active_sessions_;
+
+    std::unordered_map<PendingSession*, std::unique_ptr<PendingSession>> pending_sessions_;
+    std::unordered_map<Session*, std::unique_ptr<Session>> active_sessions_;
+
+    // Identity of a peer that is waiting for the opposite peer.
+    struct PeerIdentify
+    {
+        uint32_t key_id;
+        base::ByteArray secret;
+
+        bool operator==(const PeerIdentify& other) const
+        {
+            return key_id == other.key_id && base::equals(secret, other.secret);
+        }
+    };
+
+    struct PeerIdentifyHash
+    {
+        size_t operator()(const PeerIdentify& identify) const;
+    };
+
+    // Pending sessions that have sent their credentials, indexed by key and secret.
+    std::unordered_map<PeerIdentify, PendingSession*, PeerIdentifyHash> pending_index_;
 
     const std::chrono::minutes idle_timeout_;
-    asio::high_resolution_timer idle_timer_;
+    asio::high_resolution_timer pool_statistics_timer_;
+
+    int64_t session_rate_limit_ = 0;
+    std::shared_ptr<SharedRateLimiter> total_rate_limiter_;
+
+    // Sessions that have exceeded the rate limit. One timer resumes all of them.
+    std::unordered_set<Session*> throttled_sessions_;
+    asio::high_resolution_timer throttle_timer_;
+
+    uint64_t session_count_ = 0;
+    asio::high_resolution_timer statistics_timer_;
 
     std::unique_ptr<SharedPool> shared_pool_;
     Delegate* delegate_ = nullptr;
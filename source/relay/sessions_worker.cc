@@ -19,27 +19,167 @@
 #include "relay/sessions_worker.h"
 
 #include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/threading/thread.h"
+#include "build/build_config.h"
+
+#include <thread>
 
 namespace relay {
 
+namespace {
+
+size_t calculateWorkerCount(size_t worker_count)
+{
+#if defined(OS_WIN)
+    // A socket associated with one I/O completion port cannot be moved to another. Pending
+    // sessions cannot be transferred between workers.
+    if (worker_count != 1)
+        LOG(LS_INFO) << "Multiple session workers are not supported on this platform";
+    return 1;
+#else
+    if (!worker_count)
+        worker_count = std::max(std::thread::hardware_concurrency(), 1U);
+    return worker_count;
+#endif
+}
+
+} // namespace
+
+class SessionsWorker::Worker : public base::Thread::Delegate
+{
+public:
+    Worker(size_t worker_index,
+           size_t worker_count,
+           uint16_t peer_port,
+           const std::chrono::minutes& peer_idle_timeout,
+           SessionManager::Delegate* delegate)
+        : worker_index_(worker_index),
+          worker_count_(worker_count),
+          peer_port_(peer_port),
+          peer_idle_timeout_(peer_idle_timeout),
+          delegate_(delegate)
+    {
+        DCHECK(delegate_);
+    }
+
+    ~Worker()
+    {
+        thread_.stop();
+    }
+
+    void start()
+    {
+        thread_.start(base::MessageLoop::Type::ASIO, this);
+        task_runner_ = thread_.taskRunner();
+        DCHECK(task_runner_);
+    }
+
+    void stop()
+    {
+        thread_.stop();
+    }
+
+    void startSessionManager(std::unique_ptr<SharedPool> shared_pool,
+                             int64_t session_rate_limit,
+                             std::shared_ptr<SharedRateLimiter> total_rate_limiter)
+    {
+        shared_pool_ = std::move(shared_pool);
+
+        task_runner_->postTask([this, session_rate_limit, total_rate_limiter]()
+        {
+            session_manager_->setRateLimits(session_rate_limit, total_rate_limiter);
+            session_manager_->start(std::move(shared_pool_), delegate_);
+        });
+    }
+
+    void addPendingSession(asio::ip::tcp::socket::native_handle_type socket,
+                           const proto::PeerToRelay& message)
+    {
+        task_runner_->postTask([this, socket, message]()
+        {
+            session_manager_->addPendingSession(socket, message);
+        });
+    }
+
+protected:
+    // base::Thread::Delegate implementation.
+    void onBeforeThreadRunning() override
+    {
+        session_manager_ = std::make_unique<SessionManager>(
+            thread_.taskRunner(), peer_port_, peer_idle_timeout_, worker_index_, worker_count_);
+    }
+
+    void onAfterThreadRunning() override
+    {
+        session_manager_.reset();
+    }
+
+private:
+    const size_t worker_index_;
+    const size_t worker_count_;
+    const uint16_t peer_port_;
+    const std::chrono::minutes peer_idle_timeout_;
+    SessionManager::Delegate* delegate_;
+
+    base::Thread thread_;
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    std::unique_ptr<SharedPool> shared_pool_;
+    std::unique_ptr<SessionManager> session_manager_;
+
+    DISALLOW_COPY_AND_ASSIGN(Worker);
+};
+
 SessionsWorker::SessionsWorker(uint16_t peer_port,
                                const std::chrono::minutes& peer_idle_timeout,
+                               size_t worker_count,
                                std::unique_ptr<SharedPool> shared_pool)
-    : peer_port_(peer_port),
-      peer_idle_timeout_(peer_idle_timeout),
-      shared_pool_(std::move(shared_pool)),
-      thread_(std::make_unique<base::Thread>())
+    : shared_pool_(std::move(shared_pool))
 {
-    DCHECK(peer_port_ && shared_pool_);
+    DCHECK(peer_port && shared_pool_);
+
+    worker_count = calculateWorkerCount(worker_count);
+
+    LOG(LS_INFO) << "Session workers: " << worker_count;
+
+    for (size_t i = 0; i < worker_count; ++i)
+    {
+#if defined(OS_LINUX)
+        // Each worker has its own acceptor on the same port (SO_REUSEPORT).
+        uint16_t accept_port = peer_port;
+#else
+        // Only the first worker accepts connections. Paired sessions are still distributed
+        // between workers by key.
+        uint16_t accept_port = (i == 0) ? peer_port : 0;
+#endif // defined(OS_LINUX)
+
+        workers_.emplace_back(std::make_unique<Worker>(
+            i, worker_count, accept_port, peer_idle_timeout, this));
+    }
 }
 
 SessionsWorker::~SessionsWorker()
 {
-    thread_->stop();
+    // All threads must be stopped before any worker is destroyed, because workers can post
+    // tasks to each other.
+    for (auto& worker : workers_)
+        worker->stop();
+
+    workers_.clear();
+}
+
+void SessionsWorker::setRateLimits(int64_t session_rate_limit, int64_t total_rate_limit)
+{
+    session_rate_limit_ = session_rate_limit;
+
+    if (total_rate_limit > 0)
+        total_rate_limiter_ = std::make_shared<SharedRateLimiter>(total_rate_limit);
+    else
+        total_rate_limiter_.reset();
 }
 
 void SessionsWorker::start(std::shared_ptr<base::TaskRunner> caller_task_runner,
-                           SessionManager::Delegate* delegate)
+                           Delegate* delegate)
 {
     caller_task_runner_ = std::move(caller_task_runner);
     delegate_ = delegate;
@@ -47,22 +187,27 @@ void SessionsWorker::start(std::shared_ptr<base::TaskRunner> caller_task_runner,
     DCHECK(caller_task_runner_);
     DCHECK(delegate_);
 
-    thread_->start(base::MessageLoop::Type::ASIO, this);
-}
-
-void SessionsWorker::onBeforeThreadRunning()
-{
-    self_task_runner_ = thread_->taskRunner();
-    DCHECK(self_task_runner_);
+    for (auto& worker : workers_)
+        worker->start();
 
-    session_manager_ = std::make_unique<SessionManager>(
-        self_task_runner_, peer_port_, peer_idle_timeout_);
-    session_manager_->start(std::move(shared_pool_), this);
+    // Session managers start accepting connections only when all threads are running.
+    for (auto& worker : workers_)
+    {
+        worker->startSessionManager(
+            shared_pool_->share(), session_rate_limit_, total_rate_limiter_);
+    }
 }
 
-void SessionsWorker::onAfterThreadRunning()
+void SessionsWorker::onSessionStarted()
 {
-    session_manager_.reset();
+    if (!caller_task_runner_->belongsToCurrentThread())
+    {
+        caller_task_runner_->postTask(std::bind(&SessionsWorker::onSessionStarted, this));
+        return;
+    }
+
+    if (delegate_)
+        delegate_->onSessionStarted();
 }
 
 void SessionsWorker::onSessionFinished()
@@ -77,4 +222,26 @@ void SessionsWorker::onSessionFinished()
         delegate_->onSessionFinished();
 }
 
+void SessionsWorker::onSessionStatistics(size_t worker_index,
+                                         const std::vector<Session::Statistics>& statistics)
+{
+    if (!caller_task_runner_->belongsToCurrentThread())
+    {
+        caller_task_runner_->postTask(
+            std::bind(&SessionsWorker::onSessionStatistics, this, worker_index, statistics));
+        return;
+    }
+
+    if (delegate_)
+        delegate_->onSessionStatistics(worker_index, statistics);
+}
+
+void SessionsWorker::onPendingSessionTransfer(size_t worker_index,
+                                              asio::ip::tcp::socket::native_handle_type socket,
+                                              const proto::PeerToRelay& message)
+{
+    DCHECK_LT(worker_index, workers_.size());
+    workers_[worker_index]->addPendingSession(socket, message);
+}
+
 } // namespace relay
@@ -19,45 +19,63 @@
 #ifndef RELAY__SESSIONS_WORKER_H
 #define RELAY__SESSIONS_WORKER_H
 
-#include "base/threading/thread.h"
 #include "relay/session_manager.h"
 
 namespace relay {
 
 class SharedPool;
 
-class SessionsWorker
-    : public base::Thread::Delegate,
-      public SessionManager::Delegate
+class SessionsWorker : public SessionManager::Delegate
 {
 public:
+    class Delegate
+    {
+    public:
+        virtual ~Delegate() = default;
+
+        virtual void onSessionStarted() = 0;
+        virtual void onSessionFinished() = 0;
+        virtual void onSessionStatistics(size_t worker_index,
+                                         const std::vector<Session::Statistics>& statistics) = 0;
+    };
+
+    // Creates a pool of |worker_count| threads. Each thread has its own io_context and its own
+    // session manager. If |worker_count| is 0, then the number of processor cores is used.
     SessionsWorker(uint16_t peer_port,
                    const std::chrono::minutes& peer_idle_timeout,
+                   size_t worker_count,
                    std::unique_ptr<SharedPool> shared_pool);
     ~SessionsWorker();
 
-    void start(std::shared_ptr<base::TaskRunner> caller_task_runner,
-               SessionManager::Delegate* delegate);
+    // Sets the limit for each direction of each session and the limit for the traffic of the
+    // whole relay in bytes per second. 0 means no limit. Must be called before start().
+    void setRateLimits(int64_t session_rate_limit, int64_t total_rate_limit);
 
-protected:
-    // base::Thread::Delegate implementation.
-    void onBeforeThreadRunning() override;
-    void onAfterThreadRunning() override;
+    void start(std::shared_ptr<base::TaskRunner> caller_task_runner, Delegate* delegate);
 
+    size_t workerCount() const { return workers_.size(); }
+
+protected:
     // SessionManager::Delegate implementation.
+    void onSessionStarted() override;
     void onSessionFinished() override;
+    void onPendingSessionTransfer(size_t worker_index,
+                                  asio::ip::tcp::socket::native_handle_type socket,
+                                  const proto::PeerToRelay& message) override;
+    void onSessionStatistics(size_t worker_index,
+                             const std::vector<Session::Statistics>& statistics) override;
 
 private:
-    const uint16_t peer_port_;
-    const std::chrono::minutes peer_idle_timeout_;
+    class Worker;
 
     std::unique_ptr<SharedPool> shared_pool_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    int64_t session_rate_limit_ = 0;
+    std::shared_ptr<SharedRateLimiter> total_rate_limiter_;
 
-    std::unique_ptr<base::Thread> thread_;
     std::shared_ptr<base::TaskRunner> caller_task_runner_;
-    std::shared_ptr<base::TaskRunner> self_task_runner_;
-    std::unique_ptr<SessionManager> session_manager_;
-    SessionManager::Delegate* delegate_ = nullptr;
+    Delegate* delegate_ = nullptr;
 
     DISALLOW_COPY_AND_ASSIGN(SessionsWorker);
 };
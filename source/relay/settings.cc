@@ -54,6 +54,11 @@ void Settings::reset()
     setPeerPort(DEFAULT_RELAY_PEER_TCP_PORT);
     setPeerIdleTimeout(std::chrono::minutes(5));
     setMaxPeerCount(100);
+    setKeyPoolTargetSize(100);
+    setKeyPoolLowWaterMark(25);
+    setPeerWorkerCount(0);
+    setSessionRateLimit(0);
+    setTotalRateLimit(0);
     setMinLogLevel(1);
 }
 
@@ -132,6 +137,56 @@ uint32_t Settings::maxPeerCount() const
     return impl_.get<uint32_t>("MaxPeerCount", 100);
 }
 
+void Settings::setKeyPoolTargetSize(uint32_t size)
+{
+    impl_.set<uint32_t>("KeyPoolTargetSize", size);
+}
+
+uint32_t Settings::keyPoolTargetSize() const
+{
+    return impl_.get<uint32_t>("KeyPoolTargetSize", 100);
+}
+
+void Settings::setKeyPoolLowWaterMark(uint32_t count)
+{
+    impl_.set<uint32_t>("KeyPoolLowWaterMark", count);
+}
+
+uint32_t Settings::keyPoolLowWaterMark() const
+{
+    return impl_.get<uint32_t>("KeyPoolLowWaterMark", 25);
+}
+
+void Settings::setPeerWorkerCount(uint32_t count)
+{
+    impl_.set<uint32_t>("PeerWorkerCount", count);
+}
+
+uint32_t Settings::peerWorkerCount() const
+{
+    return impl_.get<uint32_t>("PeerWorkerCount", 0);
+}
+
+void Settings::setSessionRateLimit(uint32_t limit)
+{
+    impl_.set<uint32_t>("SessionRateLimit", limit);
+}
+
+uint32_t Settings::sessionRateLimit() const
+{
+    return impl_.get<uint32_t>("SessionRateLimit", 0);
+}
+
+void Settings::setTotalRateLimit(uint32_t limit)
+{
+    impl_.set<uint32_t>("TotalRateLimit", limit);
+}
+
+uint32_t Settings::totalRateLimit() const
+{
+    return impl_.get<uint32_t>("TotalRateLimit", 0);
+}
+
 void Settings::setMinLogLevel(int level)
 {
     impl_.set<int>("MinLogLevel", level);
@@ -57,6 +57,27 @@ public:
     void setMaxPeerCount(uint32_t count);
     uint32_t maxPeerCount() const;
 
+    // Number of unused keys that the router should have for this relay.
+    void setKeyPoolTargetSize(uint32_t size);
+    uint32_t keyPoolTargetSize() const;
+
+    // When the number of unused keys in the router falls to this value, the pool is refilled up
+    // to the target size with one message.
+    void setKeyPoolLowWaterMark(uint32_t count);
+    uint32_t keyPoolLowWaterMark() const;
+
+    // Number of threads serving peer sessions. If 0, then the number of processor cores is used.
+    void setPeerWorkerCount(uint32_t count);
+    uint32_t peerWorkerCount() const;
+
+    // Limit for each direction of a peer session in kilobytes per second. 0 means no limit.
+    void setSessionRateLimit(uint32_t limit);
+    uint32_t sessionRateLimit() const;
+
+    // Limit for the traffic of the whole relay in kilobytes per second. 0 means no limit.
+    void setTotalRateLimit(uint32_t limit);
+    uint32_t totalRateLimit() const;
+
     void setMinLogLevel(int level);
     int minLogLevel() const;
 
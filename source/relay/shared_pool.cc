@@ -20,7 +20,10 @@
 
 #include "base/logging.h"
 
-#include <mutex>
+#include <array>
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace relay {
 
@@ -39,11 +42,23 @@ public:
     void clear();
 
 private:
-    Delegate* delegate_;
+    // Keys are distributed between shards by identifier. Lookups take only a shared lock of one
+    // shard, so they do not block each other and do not wait for writers to other shards.
+    static const size_t kShardCount = 16;
 
-    mutable std::mutex pool_lock_;
-    std::map<uint32_t, SessionKey> map_;
-    uint32_t current_key_id_ = 0;
+    struct Shard
+    {
+        mutable std::shared_mutex lock;
+        std::unordered_map<uint32_t, std::shared_ptr<const SessionKey>> map;
+    };
+
+    Shard& shard(uint32_t key_id) { return shards_[key_id % kShardCount]; }
+    const Shard& shard(uint32_t key_id) const { return shards_[key_id % kShardCount]; }
+
+    std::atomic<Delegate*> delegate_;
+
+    std::array<Shard, kShardCount> shards_;
+    std::atomic_uint32_t current_key_id_ = 0;
 
     DISALLOW_COPY_AND_ASSIGN(Pool);
 };
@@ -61,10 +76,14 @@ void SharedPool::Pool::dettach()
 
 uint32_t SharedPool::Pool::addKey(SessionKey&& session_key)
 {
-    std::scoped_lock lock(pool_lock_);
-
+    std::shared_ptr<const SessionKey> key = std::make_shared<SessionKey>(std::move(session_key));
     uint32_t key_id = current_key_id_++;
-    map_.emplace(key_id, std::move(session_key));
+
+    Shard& key_shard = shard(key_id);
+    {
+        std::unique_lock lock(key_shard.lock);
+        key_shard.map.emplace(key_id, std::move(key));
+    }
 
     LOG(LS_INFO) << "Key with id " << key_id << " added to pool";
     return key_id;
@@ -72,18 +91,23 @@ uint32_t SharedPool::Pool::addKey(SessionKey&& session_key)
 
 bool SharedPool::Pool::removeKey(uint32_t key_id)
 {
-    std::scoped_lock lock(pool_lock_);
+    std::shared_ptr<const SessionKey> key;
 
-    auto result = map_.find(key_id);
-    if (result != map_.end())
+    Shard& key_shard = shard(key_id);
     {
-        map_.erase(result);
+        std::unique_lock lock(key_shard.lock);
 
-        LOG(LS_INFO) << "Key with id " << key_id << " removed from pool";
-        return true;
+        auto result = key_shard.map.find(key_id);
+        if (result == key_shard.map.end())
+            return false;
+
+        // The key is destroyed outside the lock.
+        key = std::move(result->second);
+        key_shard.map.erase(result);
     }
 
-    return false;
+    LOG(LS_INFO) << "Key with id " << key_id << " removed from pool";
+    return true;
 }
 
 void SharedPool::Pool::setKeyExpired(uint32_t key_id)
@@ -92,30 +116,41 @@ void SharedPool::Pool::setKeyExpired(uint32_t key_id)
     {
         LOG(LS_INFO) << "Key with ID " << key_id << " expired. It has been removed";
 
-        if (delegate_)
-            delegate_->onPoolKeyExpired(key_id);
+        Delegate* delegate = delegate_;
+        if (delegate)
+            delegate->onPoolKeyExpired(key_id);
     }
 }
 
 std::optional<SharedPool::Key> SharedPool::Pool::key(
     uint32_t key_id, std::string_view peer_public_key) const
 {
-    std::scoped_lock lock(pool_lock_);
+    std::shared_ptr<const SessionKey> session_key;
+
+    const Shard& key_shard = shard(key_id);
+    {
+        std::shared_lock lock(key_shard.lock);
 
-    auto result = map_.find(key_id);
-    if (result == map_.end())
-        return std::nullopt;
+        auto result = key_shard.map.find(key_id);
+        if (result == key_shard.map.end())
+            return std::nullopt;
 
-    const SessionKey& session_key = result->second;
-    return std::make_pair(session_key.sessionKey(peer_public_key), session_key.iv());
+        session_key = result->second;
+    }
+
+    // Key agreement is performed without holding the lock.
+    return std::make_pair(session_key->sessionKey(peer_public_key), session_key->iv());
 }
 
 void SharedPool::Pool::clear()
 {
-    std::scoped_lock lock(pool_lock_);
+    for (auto& key_shard : shards_)
+    {
+        std::unique_lock lock(key_shard.lock);
+        key_shard.map.clear();
+    }
 
     LOG(LS_INFO) << "Key pool cleared";
-    map_.clear();
 }
 
 SharedPool::SharedPool(Delegate* delegate)
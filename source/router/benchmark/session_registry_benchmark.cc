@@ -0,0 +1,156 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/logging.h"
+#include "router/session_registry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+
+const size_t kHostCount = 100000;
+const size_t kLookupCount = 1000000;
+const size_t kReconnectCount = 10000;
+const size_t kShardCount = 8;
+
+// The linear search is slow, so it is measured with fewer lookups.
+const size_t kLinearLookupCount = 1000;
+
+using Clock = std::chrono::steady_clock;
+
+double nanosecondsPerOperation(const Clock::time_point& start_time, size_t count)
+{
+    std::chrono::nanoseconds elapsed = Clock::now() - start_time;
+    return static_cast<double>(elapsed.count()) / static_cast<double>(count);
+}
+
+} // namespace
+
+int main(int /* argc */, const char* const* /* argv */)
+{
+    base::LoggingSettings logging_settings;
+    logging_settings.min_log_level = base::LOG_LS_ERROR;
+    base::initLogging(logging_settings);
+
+    router::SessionRegistry registry;
+
+    std::vector<router::Session::SessionId> session_ids;
+    std::vector<base::HostId> host_ids;
+    size_t checksum = 0;
+
+    // Every host has one ID, every tenth host has two IDs.
+    Clock::time_point start_time = Clock::now();
+    base::HostId next_host_id = 1;
+
+    router::Session::SessionId next_session_id = 1;
+
+    for (size_t i = 0; i < kHostCount; ++i)
+    {
+        router::Session::SessionId session_id = next_session_id++;
+
+        session_ids.emplace_back(session_id);
+        registry.add(session_id, i % kShardCount);
+
+        for (size_t j = 0; j < ((i % 10 == 0) ? 2 : 1); ++j)
+        {
+            host_ids.emplace_back(next_host_id);
+            registry.addHostId(session_id, next_host_id++);
+        }
+    }
+
+    std::cout << "Register " << kHostCount << " hosts (" << host_ids.size() << " IDs): "
+              << nanosecondsPerOperation(start_time, kHostCount) << " ns/host" << std::endl;
+
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<size_t> host_distribution(0, host_ids.size() - 1);
+    std::uniform_int_distribution<size_t> session_distribution(0, session_ids.size() - 1);
+
+    // Lookups made for each ConnectionRequest from a client.
+    start_time = Clock::now();
+    for (size_t i = 0; i < kLookupCount; ++i)
+        checksum += registry.hostSession(host_ids[host_distribution(random)]).has_value();
+
+    std::cout << "Host lookup: " << nanosecondsPerOperation(start_time, kLookupCount)
+              << " ns" << std::endl;
+
+    start_time = Clock::now();
+    for (size_t i = 0; i < kLookupCount; ++i)
+        checksum += registry.shard(session_ids[session_distribution(random)]).has_value();
+
+    std::cout << "Session lookup: " << nanosecondsPerOperation(start_time, kLookupCount)
+              << " ns" << std::endl;
+
+    // Hosts reconnect with the same ID. The new session takes the ID and the previous session is
+    // removed.
+    start_time = Clock::now();
+    for (size_t i = 0; i < kReconnectCount; ++i)
+    {
+        base::HostId host_id = host_ids[host_distribution(random)];
+
+        router::Session::SessionId session_id = next_session_id++;
+        registry.add(session_id, i % kShardCount);
+
+        std::optional<router::Session::SessionId> previous_session =
+            registry.addHostId(session_id, host_id);
+        if (previous_session.has_value())
+            checksum += registry.remove(*previous_session);
+    }
+
+    std::cout << "Reconnect: " << nanosecondsPerOperation(start_time, kReconnectCount)
+              << " ns" << std::endl;
+
+    // The previous implementation for comparison: a walk over all sessions and over the IDs of
+    // each session.
+    std::vector<std::pair<router::Session::SessionId, std::vector<base::HostId>>> linear_list;
+    next_host_id = 1;
+    for (size_t i = 0; i < kHostCount; ++i)
+    {
+        linear_list.emplace_back(static_cast<router::Session::SessionId>(i),
+                                 std::vector<base::HostId>());
+
+        for (size_t j = 0; j < ((i % 10 == 0) ? 2 : 1); ++j)
+            linear_list.back().second.emplace_back(next_host_id++);
+    }
+
+    start_time = Clock::now();
+    for (size_t i = 0; i < kLinearLookupCount; ++i)
+    {
+        base::HostId host_id = host_ids[host_distribution(random)];
+
+        for (const auto& entry : linear_list)
+        {
+            if (std::find(entry.second.begin(), entry.second.end(), host_id) != entry.second.end())
+            {
+                ++checksum;
+                break;
+            }
+        }
+    }
+
+    std::cout << "Host lookup (linear search): "
+              << nanosecondsPerOperation(start_time, kLinearLookupCount) << " ns" << std::endl;
+
+    std::cout << "Sessions: " << registry.count() << ", host IDs: " << registry.hostIdCount()
+              << " (checksum " << checksum << ")" << std::endl;
+
+    base::shutdownLogging();
+    return 0;
+}
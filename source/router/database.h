@@ -29,6 +29,12 @@ class Database
 public:
     virtual ~Database() = default;
 
+    struct HostEntry
+    {
+        base::ByteArray key_hash;
+        base::HostId host_id;
+    };
+
     virtual std::vector<base::User> userList() const = 0;
     virtual bool addUser(const base::User& user) = 0;
     virtual bool modifyUser(const base::User& user) = 0;
@@ -36,6 +42,9 @@ public:
     virtual base::User findUser(std::u16string_view username) = 0;
     virtual base::HostId hostId(const base::ByteArray& keyHash) const = 0;
     virtual bool addHost(const base::ByteArray& keyHash) = 0;
+
+    // Returns up to |max_count| hosts, the most recently added first.
+    virtual std::vector<HostEntry> hostList(size_t max_count) const = 0;
 };
 
 } // namespace router
@@ -20,20 +20,151 @@
 
 #include "router/database_sqlite.h"
 
+#include "base/logging.h"
+#include "router/host_id_cache.h"
+
 namespace router {
 
-DatabaseFactorySqlite::DatabaseFactorySqlite() = default;
+class DatabaseFactorySqlite::Connection
+{
+public:
+    explicit Connection(std::unique_ptr<DatabaseSqlite> db)
+        : db(std::move(db))
+    {
+        DCHECK(this->db);
+    }
+
+    // Prepared statements of the connection can not be used by several threads at once.
+    std::mutex lock;
+    std::unique_ptr<DatabaseSqlite> db;
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(Connection);
+};
+
+class DatabaseFactorySqlite::Handle : public Database
+{
+public:
+    Handle(std::shared_ptr<Connection> connection, std::shared_ptr<HostIdCache> host_id_cache)
+        : connection_(std::move(connection)),
+          host_id_cache_(std::move(host_id_cache))
+    {
+        DCHECK(connection_);
+    }
+
+    ~Handle() override = default;
+
+    // Database implementation.
+    std::vector<base::User> userList() const override
+    {
+        std::scoped_lock lock(connection_->lock);
+        return connection_->db->userList();
+    }
+
+    bool addUser(const base::User& user) override
+    {
+        std::scoped_lock lock(connection_->lock);
+        return connection_->db->addUser(user);
+    }
+
+    bool modifyUser(const base::User& user) override
+    {
+        std::scoped_lock lock(connection_->lock);
+        return connection_->db->modifyUser(user);
+    }
+
+    bool removeUser(int64_t entry_id) override
+    {
+        std::scoped_lock lock(connection_->lock);
+        return connection_->db->removeUser(entry_id);
+    }
+
+    base::User findUser(std::u16string_view username) override
+    {
+        std::scoped_lock lock(connection_->lock);
+        return connection_->db->findUser(username);
+    }
+
+    base::HostId hostId(const base::ByteArray& keyHash) const override
+    {
+        if (host_id_cache_)
+        {
+            base::HostId host_id = host_id_cache_->find(keyHash);
+            if (host_id != base::kInvalidHostId)
+                return host_id;
+        }
+
+        base::HostId host_id;
+        {
+            std::scoped_lock lock(connection_->lock);
+            host_id = connection_->db->hostId(keyHash);
+        }
+
+        if (host_id_cache_)
+            host_id_cache_->add(keyHash, host_id);
+
+        return host_id;
+    }
+
+    bool addHost(const base::ByteArray& keyHash) override
+    {
+        base::HostId host_id;
+        {
+            std::scoped_lock lock(connection_->lock);
+            if (!connection_->db->addHost(keyHash))
+                return false;
+
+            host_id = static_cast<base::HostId>(connection_->db->lastInsertRowId());
+        }
+
+        if (host_id_cache_)
+            host_id_cache_->add(keyHash, host_id);
+
+        return true;
+    }
+
+    std::vector<HostEntry> hostList(size_t max_count) const override
+    {
+        std::scoped_lock lock(connection_->lock);
+        return connection_->db->hostList(max_count);
+    }
+
+private:
+    std::shared_ptr<Connection> connection_;
+    std::shared_ptr<HostIdCache> host_id_cache_;
+
+    DISALLOW_COPY_AND_ASSIGN(Handle);
+};
+
+DatabaseFactorySqlite::DatabaseFactorySqlite(std::shared_ptr<HostIdCache> host_id_cache,
+                                             const std::filesystem::path& file_path)
+    : host_id_cache_(std::move(host_id_cache)),
+      file_path_(file_path.empty() ? DatabaseSqlite::filePath() : file_path)
+{
+    // Nothing
+}
 
 DatabaseFactorySqlite::~DatabaseFactorySqlite() = default;
 
 std::unique_ptr<Database> DatabaseFactorySqlite::createDatabase() const
 {
-    return DatabaseSqlite::create();
+    return DatabaseSqlite::create(file_path_);
 }
 
 std::unique_ptr<Database> DatabaseFactorySqlite::openDatabase() const
 {
-    return DatabaseSqlite::open();
+    std::scoped_lock lock(connection_lock_);
+
+    if (!connection_)
+    {
+        std::unique_ptr<DatabaseSqlite> db = DatabaseSqlite::open(file_path_);
+        if (!db)
+            return nullptr;
+
+        connection_ = std::make_shared<Connection>(std::move(db));
+    }
+
+    return std::make_unique<Handle>(connection_, host_id_cache_);
 }
 
 } // namespace router
@@ -22,18 +22,38 @@
 #include "base/macros_magic.h"
 #include "router/database_factory.h"
 
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
 namespace router {
 
+class HostIdCache;
+
 class DatabaseFactorySqlite : public DatabaseFactory
 {
 public:
-    DatabaseFactorySqlite();
+    // If |host_id_cache| is not null, host ID lookups are served from it first and new hosts are
+    // written through to it. If |file_path| is empty, the database in the default location is used.
+    explicit DatabaseFactorySqlite(std::shared_ptr<HostIdCache> host_id_cache = nullptr,
+                                   const std::filesystem::path& file_path = std::filesystem::path());
     ~DatabaseFactorySqlite();
 
     std::unique_ptr<Database> createDatabase() const override;
+    // Returns a handle to the connection owned by the factory. The connection is opened on first
+    // use and kept open (together with its prepared statements) until the factory is destroyed.
     std::unique_ptr<Database> openDatabase() const override;
 
 private:
+    class Connection;
+    class Handle;
+
+    std::shared_ptr<HostIdCache> host_id_cache_;
+    const std::filesystem::path file_path_;
+
+    mutable std::mutex connection_lock_;
+    mutable std::shared_ptr<Connection> connection_;
+
     DISALLOW_COPY_AND_ASSIGN(DatabaseFactorySqlite);
 };
 
@@ -29,6 +29,34 @@ namespace router {
 
 namespace {
 
+const char* kCachedQueries[] =
+{
+    "SELECT * FROM users WHERE name=?",                 // STATEMENT_FIND_USER
+    "SELECT * FROM hosts WHERE key=?",                  // STATEMENT_HOST_ID
+    "INSERT INTO hosts ('id', 'key') VALUES (NULL, ?)"  // STATEMENT_ADD_HOST
+};
+
+// Returns the cached statement to its initial state when the query is completed.
+class ScopedStatementReset
+{
+public:
+    explicit ScopedStatementReset(sqlite3_stmt* statement)
+        : statement_(statement)
+    {
+        DCHECK(statement_);
+    }
+
+    ~ScopedStatementReset()
+    {
+        sqlite3_reset(statement_);
+        sqlite3_clear_bindings(statement_);
+    }
+
+private:
+    sqlite3_stmt* statement_;
+    DISALLOW_COPY_AND_ASSIGN(ScopedStatementReset);
+};
+
 bool writeText(sqlite3_stmt* statement, const std::string& text, int column)
 {
     int error_code = sqlite3_bind_text(
@@ -230,13 +258,28 @@ DatabaseSqlite::DatabaseSqlite(sqlite3* db)
 
 DatabaseSqlite::~DatabaseSqlite()
 {
+    for (size_t i = 0; i < std::size(statements_); ++i)
+        sqlite3_finalize(statements_[i]);
+
     sqlite3_close(db_);
 }
 
 // static
 std::unique_ptr<DatabaseSqlite> DatabaseSqlite::create()
 {
-    std::filesystem::path dir_path = databaseDirectory();
+    return create(filePath());
+}
+
+// static
+std::unique_ptr<DatabaseSqlite> DatabaseSqlite::create(const std::filesystem::path& file_path)
+{
+    if (file_path.empty())
+    {
+        LOG(LS_WARNING) << "Invalid file path";
+        return nullptr;
+    }
+
+    std::filesystem::path dir_path = file_path.parent_path();
     if (dir_path.empty())
     {
         LOG(LS_WARNING) << "Invalid directory path";
@@ -264,20 +307,13 @@ std::unique_ptr<DatabaseSqlite> DatabaseSqlite::create()
         }
     }
 
-    std::filesystem::path file_path = filePath();
-    if (file_path.empty())
-    {
-        LOG(LS_WARNING) << "Invalid file path";
-        return nullptr;
-    }
-
     if (std::filesystem::exists(file_path, error_code))
     {
         LOG(LS_WARNING) << "Database file already exists";
         return nullptr;
     }
 
-    std::unique_ptr<DatabaseSqlite> db = open();
+    std::unique_ptr<DatabaseSqlite> db = open(file_path);
     if (!db)
         return nullptr;
 
@@ -311,7 +347,12 @@ std::unique_ptr<DatabaseSqlite> DatabaseSqlite::create()
 // static
 std::unique_ptr<DatabaseSqlite> DatabaseSqlite::open()
 {
-    std::filesystem::path file_path = filePath();
+    return open(filePath());
+}
+
+// static
+std::unique_ptr<DatabaseSqlite> DatabaseSqlite::open(const std::filesystem::path& file_path)
+{
     if (file_path.empty())
     {
         LOG(LS_WARNING) << "Invalid file path";
@@ -327,6 +368,13 @@ std::unique_ptr<DatabaseSqlite> DatabaseSqlite::open()
     if (error_code != SQLITE_OK)
     {
         LOG(LS_WARNING) << "sqlite3_open failed: " << sqlite3_errstr(error_code);
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    if (!applyPragmas(db))
+    {
+        sqlite3_close(db);
         return nullptr;
     }
 
@@ -526,16 +574,11 @@ bool DatabaseSqlite::removeUser(int64_t entry_id)
 
 base::User DatabaseSqlite::findUser(std::u16string_view username)
 {
-    const char kQuery[] = "SELECT * FROM users WHERE name=?";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = cachedStatement(STATEMENT_FIND_USER);
+    if (!statement)
         return base::User::kInvalidUser;
-    }
 
+    ScopedStatementReset statement_reset(statement);
     std::string username_utf8 = base::utf8FromUtf16(username);
     std::optional<base::User> user;
 
@@ -551,7 +594,6 @@ base::User DatabaseSqlite::findUser(std::u16string_view username)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return user.value_or(base::User::kInvalidUser);
 }
 
@@ -563,16 +605,11 @@ base::HostId DatabaseSqlite::hostId(const base::ByteArray& keyHash) const
         return base::kInvalidHostId;
     }
 
-    const char kQuery[] = "SELECT * FROM hosts WHERE key=?";
-
-    sqlite3_stmt* statement;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = cachedStatement(STATEMENT_HOST_ID);
+    if (!statement)
         return base::kInvalidHostId;
-    }
 
+    ScopedStatementReset statement_reset(statement);
     base::HostId result = base::kInvalidHostId;
 
     do
@@ -580,7 +617,8 @@ base::HostId DatabaseSqlite::hostId(const base::ByteArray& keyHash) const
         if (!writeBlob(statement, keyHash, 1))
             break;
 
-        if (sqlite3_step(statement) != SQLITE_ROW)
+        int error_code = sqlite3_step(statement);
+        if (error_code != SQLITE_ROW)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code);
             break;
@@ -597,7 +635,6 @@ base::HostId DatabaseSqlite::hostId(const base::ByteArray& keyHash) const
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
@@ -609,16 +646,11 @@ bool DatabaseSqlite::addHost(const base::ByteArray& keyHash)
         return false;
     }
 
-    const char kQuery[] = "INSERT INTO hosts ('id', 'key') VALUES (NULL, ?)";
-
-    sqlite3_stmt* statement = nullptr;
-    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
-    if (error_code != SQLITE_OK)
-    {
-        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+    sqlite3_stmt* statement = cachedStatement(STATEMENT_ADD_HOST);
+    if (!statement)
         return false;
-    }
 
+    ScopedStatementReset statement_reset(statement);
     bool result = false;
 
     do
@@ -626,7 +658,7 @@ bool DatabaseSqlite::addHost(const base::ByteArray& keyHash)
         if (!writeBlob(statement, keyHash, 1))
             break;
 
-        error_code = sqlite3_step(statement);
+        int error_code = sqlite3_step(statement);
         if (error_code != SQLITE_DONE)
         {
             LOG(LS_ERROR) << "sqlite3_step failed: " << sqlite3_errstr(error_code)
@@ -638,10 +670,91 @@ bool DatabaseSqlite::addHost(const base::ByteArray& keyHash)
     }
     while (false);
 
-    sqlite3_finalize(statement);
     return result;
 }
 
+std::vector<Database::HostEntry> DatabaseSqlite::hostList(size_t max_count) const
+{
+    static const char kQuery[] = "SELECT * FROM hosts ORDER BY id DESC LIMIT ?";
+
+    sqlite3_stmt* statement = nullptr;
+    int error_code = sqlite3_prepare(db_, kQuery, std::size(kQuery), &statement, nullptr);
+    if (error_code != SQLITE_OK)
+    {
+        LOG(LS_ERROR) << "sqlite3_prepare failed: " << sqlite3_errstr(error_code);
+        return std::vector<HostEntry>();
+    }
+
+    std::vector<HostEntry> hosts;
+
+    if (writeInt64(statement, static_cast<int64_t>(max_count), 1))
+    {
+        while (sqlite3_step(statement) == SQLITE_ROW)
+        {
+            std::optional<int64_t> entry_id = readInteger<int64_t>(statement, 0);
+            std::optional<base::ByteArray> key_hash = readBlob(statement, 1);
+
+            if (!entry_id.has_value() || !key_hash.has_value())
+                continue;
+
+            hosts.push_back({ std::move(key_hash.value()), entry_id.value() });
+        }
+    }
+
+    sqlite3_finalize(statement);
+    return hosts;
+}
+
+int64_t DatabaseSqlite::lastInsertRowId() const
+{
+    return sqlite3_last_insert_rowid(db_);
+}
+
+// static
+bool DatabaseSqlite::applyPragmas(sqlite3* db)
+{
+    // The router keeps a single long-lived connection. WAL allows readers to proceed while a host
+    // is being added, and NORMAL synchronization is durable enough in WAL mode.
+    const char kSql[] =
+        "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;"
+        "PRAGMA temp_store=MEMORY;"
+        "PRAGMA cache_size=-8192;";
+
+    char* error_string = nullptr;
+    int error_code = sqlite3_exec(db, kSql, nullptr, nullptr, &error_string);
+    if (error_code != SQLITE_OK)
+    {
+        LOG(LS_ERROR) << "sqlite3_exec failed: " << (error_string ? error_string : "");
+        sqlite3_free(error_string);
+        return false;
+    }
+
+    // Wait for a concurrent writer (for example, the console utility) instead of failing.
+    sqlite3_busy_timeout(db, 5000);
+    return true;
+}
+
+sqlite3_stmt* DatabaseSqlite::cachedStatement(Statement id) const
+{
+    static_assert(std::size(kCachedQueries) == STATEMENT_COUNT);
+    DCHECK_LT(id, STATEMENT_COUNT);
+
+    sqlite3_stmt*& statement = statements_[id];
+    if (statement)
+        return statement;
+
+    int error_code = sqlite3_prepare_v2(db_, kCachedQueries[id], -1, &statement, nullptr);
+    if (error_code != SQLITE_OK)
+    {
+        LOG(LS_ERROR) << "sqlite3_prepare_v2 failed: " << sqlite3_errstr(error_code);
+        statement = nullptr;
+        return nullptr;
+    }
+
+    return statement;
+}
+
 // static
 std::filesystem::path DatabaseSqlite::databaseDirectory()
 {
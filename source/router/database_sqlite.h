@@ -37,6 +37,10 @@ public:
     static std::unique_ptr<DatabaseSqlite> open();
     static std::filesystem::path filePath();
 
+    // The same as above, but for the database at |file_path| instead of the default location.
+    static std::unique_ptr<DatabaseSqlite> create(const std::filesystem::path& file_path);
+    static std::unique_ptr<DatabaseSqlite> open(const std::filesystem::path& file_path);
+
     // Database implementation.
     std::vector<base::User> userList() const override;
     bool addUser(const base::User& user) override;
@@ -45,12 +49,30 @@ public:
     base::User findUser(std::u16string_view username) override;
     base::HostId hostId(const base::ByteArray& keyHash) const override;
     bool addHost(const base::ByteArray& keyHash) override;
+    std::vector<HostEntry> hostList(size_t max_count) const override;
+
+    // Returns the row ID of the most recent successful INSERT on the connection.
+    int64_t lastInsertRowId() const;
 
 private:
+    // Statements that are executed for every host and client connection. They are prepared once
+    // on first use and kept for the lifetime of the connection.
+    enum Statement
+    {
+        STATEMENT_FIND_USER = 0,
+        STATEMENT_HOST_ID   = 1,
+        STATEMENT_ADD_HOST  = 2,
+        STATEMENT_COUNT     = 3
+    };
+
     explicit DatabaseSqlite(sqlite3* db);
     static std::filesystem::path databaseDirectory();
+    static bool applyPragmas(sqlite3* db);
+
+    sqlite3_stmt* cachedStatement(Statement id) const;
 
     sqlite3* db_;
+    mutable sqlite3_stmt* statements_[STATEMENT_COUNT] = { nullptr };
 
     DISALLOW_COPY_AND_ASSIGN(DatabaseSqlite);
 };
@@ -0,0 +1,100 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/host_id_cache.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace router {
+
+HostIdCache::HostIdCache(size_t capacity)
+    : capacity_(capacity)
+{
+    DCHECK_GT(capacity_, 0U);
+    index_.reserve(capacity_);
+}
+
+HostIdCache::~HostIdCache() = default;
+
+base::HostId HostIdCache::find(const base::ByteArray& key_hash)
+{
+    std::scoped_lock lock(lock_);
+
+    auto result = index_.find(&key_hash);
+    if (result == index_.end())
+    {
+        ++misses_;
+        return base::kInvalidHostId;
+    }
+
+    ++hits_;
+
+    // Move the entry to the front of the list.
+    entries_.splice(entries_.begin(), entries_, result->second);
+    return result->second->second;
+}
+
+void HostIdCache::add(const base::ByteArray& key_hash, base::HostId host_id)
+{
+    if (key_hash.empty() || host_id == base::kInvalidHostId)
+        return;
+
+    std::scoped_lock lock(lock_);
+
+    auto result = index_.find(&key_hash);
+    if (result != index_.end())
+    {
+        result->second->second = host_id;
+        entries_.splice(entries_.begin(), entries_, result->second);
+        return;
+    }
+
+    if (index_.size() >= capacity_)
+    {
+        index_.erase(&entries_.back().first);
+        entries_.pop_back();
+    }
+
+    entries_.emplace_front(key_hash, host_id);
+    index_.emplace(&entries_.front().first, entries_.begin());
+}
+
+HostIdCache::Stat HostIdCache::stat() const
+{
+    std::scoped_lock lock(lock_);
+
+    Stat stat;
+    stat.size = index_.size();
+    stat.capacity = capacity_;
+    stat.hits = hits_;
+    stat.misses = misses_;
+
+    return stat;
+}
+
+size_t HostIdCache::KeyHash::operator()(const base::ByteArray* key_hash) const
+{
+    size_t result = 0;
+    memcpy(&result, key_hash->data(), std::min(key_hash->size(), sizeof(result)));
+    return result;
+}
+
+} // namespace router
@@ -0,0 +1,90 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__HOST_ID_CACHE_H
+#define ROUTER__HOST_ID_CACHE_H
+
+#include "base/macros_magic.h"
+#include "base/memory/byte_array.h"
+#include "base/peer/host_id.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace router {
+
+// Bounded LRU cache from the hash of a host key to the host ID. Host IDs never change once they
+// are assigned, so entries do not need to be invalidated. The class is thread-safe.
+class HostIdCache
+{
+public:
+    explicit HostIdCache(size_t capacity);
+    ~HostIdCache();
+
+    struct Stat
+    {
+        size_t size = 0;
+        size_t capacity = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // Returns the host ID for |key_hash| or base::kInvalidHostId if there is no such entry.
+    base::HostId find(const base::ByteArray& key_hash);
+
+    // Adds or refreshes the entry. If the cache is full, the least recently used entry is removed.
+    void add(const base::ByteArray& key_hash, base::HostId host_id);
+
+    Stat stat() const;
+
+private:
+    // The index points to the key hashes stored in the list, so each hash is kept only once. The
+    // key is an output of a cryptographic hash function, so its first bytes are already uniformly
+    // distributed.
+    struct KeyHash
+    {
+        size_t operator()(const base::ByteArray* key_hash) const;
+    };
+
+    struct KeyEqual
+    {
+        bool operator()(const base::ByteArray* first, const base::ByteArray* second) const
+        {
+            return *first == *second;
+        }
+    };
+
+    using Entry = std::pair<base::ByteArray, base::HostId>;
+    using EntryList = std::list<Entry>;
+
+    const size_t capacity_;
+
+    mutable std::mutex lock_;
+    EntryList entries_; // Most recently used entries first.
+    std::unordered_map<const base::ByteArray*, EntryList::iterator, KeyHash, KeyEqual> index_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(HostIdCache);
+};
+
+} // namespace router
+
+#endif // ROUTER__HOST_ID_CACHE_H
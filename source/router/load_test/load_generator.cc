@@ -0,0 +1,478 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/load_test/load_generator.h"
+
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/crypto/random.h"
+#include "base/net/network_channel.h"
+#include "base/peer/client_authenticator.h"
+#include "proto/router_peer.pb.h"
+#include "proto/router_relay.pb.h"
+
+namespace router {
+
+namespace {
+
+// Keys given to the router by the relay at start. After that the relay returns the used keys in
+// batches, as a real relay does.
+const size_t kInitialKeyCount = 10000;
+const size_t kKeyBatchSize = 100;
+
+std::chrono::microseconds elapsedTime(const LoadGenerator::Clock::time_point& start_time)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        LoadGenerator::Clock::now() - start_time);
+}
+
+} // namespace
+
+class LoadGenerator::Peer : public base::NetworkChannel::Listener
+{
+public:
+    enum class Type { RELAY, HOST, CLIENT };
+    enum class State { CONNECTING, READY, FAILED };
+
+    Peer(LoadGenerator* generator, Type type);
+    ~Peer();
+
+    Type type() const { return type_; }
+    State state() const { return state_; }
+    void setState(State state) { state_ = state; }
+
+    void start();
+    void sendKeyPool(size_t key_count);
+    void sendHostIdRequest();
+    void sendConnectionRequest(base::HostId host_id);
+
+protected:
+    // base::NetworkChannel::Listener implementation.
+    void onConnected() override;
+    void onDisconnected(base::NetworkChannel::ErrorCode error_code) override;
+    void onMessageReceived(const base::ByteArray& buffer) override;
+    void onMessageWritten(size_t pending) override;
+
+private:
+    void onAuthenticated();
+    void onRelayMessage(const base::ByteArray& buffer);
+    void onPeerMessage(const base::ByteArray& buffer);
+
+    LoadGenerator* generator_;
+    const Type type_;
+    State state_ = State::CONNECTING;
+
+    std::unique_ptr<base::NetworkChannel> channel_;
+    std::unique_ptr<base::ClientAuthenticator> authenticator_;
+
+    Clock::time_point start_time_;
+    Clock::time_point request_time_;
+    uint32_t next_key_id_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(Peer);
+};
+
+LoadGenerator::Peer::Peer(LoadGenerator* generator, Type type)
+    : generator_(generator),
+      type_(type)
+{
+    // Nothing
+}
+
+LoadGenerator::Peer::~Peer() = default;
+
+void LoadGenerator::Peer::start()
+{
+    start_time_ = Clock::now();
+
+    channel_ = std::make_unique<base::NetworkChannel>();
+    channel_->setListener(this);
+    channel_->connect(u"127.0.0.1", generator_->options_.port);
+}
+
+void LoadGenerator::Peer::sendKeyPool(size_t key_count)
+{
+    proto::RelayToRouter message;
+    proto::RelayKeyPool* key_pool = message.mutable_key_pool();
+
+    // Offers are not used to connect to the relay, so the address is not checked.
+    key_pool->set_peer_host("127.0.0.1");
+    key_pool->set_peer_port(8000);
+
+    for (size_t i = 0; i < key_count; ++i)
+    {
+        proto::RelayKey* key = key_pool->add_key();
+        key->set_key_id(next_key_id_++);
+        key->set_type(proto::RelayKey::TYPE_X25519);
+        key->set_encryption(proto::RelayKey::ENCRYPTION_CHACHA20_POLY1305);
+        key->set_public_key(base::Random::string(32));
+        key->set_iv(base::Random::string(12));
+    }
+
+    channel_->send(message);
+}
+
+void LoadGenerator::Peer::sendHostIdRequest()
+{
+    proto::PeerToRouter message;
+    message.mutable_host_id_request()->set_type(proto::HostIdRequest::NEW_ID);
+
+    request_time_ = Clock::now();
+    channel_->send(message);
+}
+
+void LoadGenerator::Peer::sendConnectionRequest(base::HostId host_id)
+{
+    proto::PeerToRouter message;
+    message.mutable_connection_request()->set_host_id(host_id);
+
+    request_time_ = Clock::now();
+    channel_->send(message);
+}
+
+void LoadGenerator::Peer::onConnected()
+{
+    channel_->setNoDelay(true);
+
+    authenticator_ = std::make_unique<base::ClientAuthenticator>(generator_->task_runner_);
+    authenticator_->setPeerPublicKey(generator_->options_.router_public_key);
+
+    switch (type_)
+    {
+        case Type::RELAY:
+            authenticator_->setIdentify(proto::IDENTIFY_ANONYMOUS);
+            authenticator_->setSessionType(proto::ROUTER_SESSION_RELAY);
+            break;
+
+        case Type::HOST:
+            authenticator_->setIdentify(proto::IDENTIFY_ANONYMOUS);
+            authenticator_->setSessionType(proto::ROUTER_SESSION_HOST);
+            break;
+
+        case Type::CLIENT:
+            authenticator_->setIdentify(proto::IDENTIFY_SRP);
+            authenticator_->setUserName(generator_->options_.user_name);
+            authenticator_->setPassword(generator_->options_.password);
+            authenticator_->setSessionType(proto::ROUTER_SESSION_CLIENT);
+            break;
+    }
+
+    authenticator_->start(std::move(channel_),
+                          [this](base::ClientAuthenticator::ErrorCode error_code)
+    {
+        if (error_code == base::ClientAuthenticator::ErrorCode::SUCCESS)
+        {
+            channel_ = authenticator_->takeChannel();
+            channel_->setListener(this);
+            channel_->resume();
+
+            onAuthenticated();
+        }
+        else
+        {
+            LOG(LS_WARNING) << "Authentication failed: "
+                            << base::ClientAuthenticator::errorToString(error_code);
+            generator_->onPeerFailed(this);
+        }
+
+        // Authenticator is no longer needed.
+        generator_->task_runner_->deleteSoon(std::move(authenticator_));
+    });
+}
+
+void LoadGenerator::Peer::onDisconnected(base::NetworkChannel::ErrorCode error_code)
+{
+    LOG(LS_WARNING) << "Connection lost: " << base::NetworkChannel::errorToString(error_code);
+    generator_->onPeerFailed(this);
+}
+
+void LoadGenerator::Peer::onMessageReceived(const base::ByteArray& buffer)
+{
+    if (type_ == Type::RELAY)
+        onRelayMessage(buffer);
+    else
+        onPeerMessage(buffer);
+}
+
+void LoadGenerator::Peer::onMessageWritten(size_t /* pending */)
+{
+    // Nothing
+}
+
+void LoadGenerator::Peer::onAuthenticated()
+{
+    generator_->onPeerAuthenticated(this, elapsedTime(start_time_));
+}
+
+void LoadGenerator::Peer::onRelayMessage(const base::ByteArray& buffer)
+{
+    proto::RouterToRelay message;
+    if (!base::parse(buffer, &message))
+    {
+        LOG(LS_ERROR) << "Invalid message from router";
+        return;
+    }
+
+    if (message.has_key_used())
+        generator_->onKeyUsed();
+}
+
+void LoadGenerator::Peer::onPeerMessage(const base::ByteArray& buffer)
+{
+    proto::RouterToPeer message;
+    if (!base::parse(buffer, &message))
+    {
+        LOG(LS_ERROR) << "Invalid message from router";
+        return;
+    }
+
+    if (message.has_host_id_response())
+    {
+        generator_->onHostIdReceived(
+            this, message.host_id_response().host_id(), elapsedTime(request_time_));
+    }
+    else if (message.has_connection_offer())
+    {
+        if (type_ == Type::HOST)
+        {
+            generator_->onHostOfferReceived();
+        }
+        else
+        {
+            bool success =
+                message.connection_offer().error_code() == proto::ConnectionOffer::SUCCESS;
+            generator_->onOfferReceived(this, success, elapsedTime(request_time_));
+        }
+    }
+}
+
+LoadGenerator::LoadGenerator(std::shared_ptr<base::TaskRunner> task_runner,
+                             const Options& options)
+    : task_runner_(task_runner),
+      options_(options),
+      random_(12345),
+      duration_timer_(base::WaitableTimer::Type::SINGLE_SHOT, task_runner)
+{
+    DCHECK(task_runner_);
+}
+
+LoadGenerator::~LoadGenerator() = default;
+
+void LoadGenerator::connectHosts(FinishCallback callback)
+{
+    DCHECK(stage_ == Stage::IDLE);
+
+    callback_ = std::move(callback);
+    stage_ = Stage::RELAY;
+
+    relay_ = std::make_unique<Peer>(this, Peer::Type::RELAY);
+    relay_->start();
+}
+
+void LoadGenerator::runClients(FinishCallback callback)
+{
+    if (stage_ != Stage::HOSTS)
+    {
+        // The relay is not connected, there is nothing to test.
+        task_runner_->postTask(std::move(callback));
+        return;
+    }
+
+    callback_ = std::move(callback);
+    stage_ = Stage::CLIENTS;
+    next_peer_ = 0;
+    pending_peers_ = 0;
+    ready_peers_ = 0;
+
+    brokering_start_time_ = Clock::now();
+    duration_timer_.start(options_.duration, std::bind(&LoadGenerator::onBrokeringFinished, this));
+
+    connectNextPeers();
+}
+
+void LoadGenerator::connectNextPeers()
+{
+    bool is_hosts = stage_ == Stage::HOSTS;
+
+    std::vector<std::unique_ptr<Peer>>& peers = is_hosts ? hosts_ : clients_;
+    size_t peer_count = is_hosts ? options_.host_count : options_.client_count;
+
+    while (pending_peers_ < options_.max_pending_connections && next_peer_ < peer_count)
+    {
+        peers.emplace_back(std::make_unique<Peer>(
+            this, is_hosts ? Peer::Type::HOST : Peer::Type::CLIENT));
+        peers.back()->start();
+
+        ++pending_peers_;
+        ++next_peer_;
+    }
+
+    if (is_hosts && next_peer_ == peer_count && !pending_peers_)
+    {
+        // The callback may start the next stage, so it is not called from a peer notification.
+        task_runner_->postTask(std::move(callback_));
+    }
+}
+
+void LoadGenerator::onRelayReady()
+{
+    stage_ = Stage::HOSTS;
+    next_peer_ = 0;
+    pending_peers_ = 0;
+
+    connectNextPeers();
+}
+
+void LoadGenerator::onPeerAuthenticated(Peer* peer, const std::chrono::microseconds& latency)
+{
+    switch (peer->type())
+    {
+        case Peer::Type::RELAY:
+            peer->setState(Peer::State::READY);
+            peer->sendKeyPool(kInitialKeyCount);
+            onRelayReady();
+            break;
+
+        case Peer::Type::HOST:
+            report_.host_auth_latency.emplace_back(latency);
+            peer->sendHostIdRequest();
+            break;
+
+        case Peer::Type::CLIENT:
+        {
+            report_.client_auth_latency.emplace_back(latency);
+            ++report_.clients_connected;
+
+            peer->setState(Peer::State::READY);
+            onPeerReady();
+
+            if (stage_ == Stage::CLIENTS)
+                sendConnectionRequest(peer);
+        }
+        break;
+    }
+}
+
+void LoadGenerator::onPeerFailed(Peer* peer)
+{
+    if (stage_ == Stage::FINISHED || peer->state() == Peer::State::FAILED)
+        return;
+
+    ++report_.connections_failed;
+
+    Peer::State previous_state = peer->state();
+    peer->setState(Peer::State::FAILED);
+
+    if (peer->type() == Peer::Type::RELAY)
+    {
+        LOG(LS_ERROR) << "Relay connection failed";
+
+        if (previous_state == Peer::State::CONNECTING)
+        {
+            stage_ = Stage::FINISHED;
+            task_runner_->postTask(std::move(callback_));
+        }
+        return;
+    }
+
+    if (previous_state == Peer::State::CONNECTING)
+        onPeerReady();
+}
+
+void LoadGenerator::onHostIdReceived(Peer* peer, base::HostId host_id,
+                                     const std::chrono::microseconds& latency)
+{
+    if (peer->state() != Peer::State::CONNECTING)
+        return;
+
+    if (host_id == base::kInvalidHostId)
+    {
+        onPeerFailed(peer);
+        return;
+    }
+
+    report_.host_id_latency.emplace_back(latency);
+    ++report_.hosts_connected;
+    host_ids_.emplace_back(host_id);
+
+    peer->setState(Peer::State::READY);
+    onPeerReady();
+}
+
+void LoadGenerator::onOfferReceived(Peer* peer, bool success,
+                                    const std::chrono::microseconds& latency)
+{
+    report_.brokering_latency.emplace_back(latency);
+
+    if (success)
+        ++report_.offers_received;
+    else
+        ++report_.offers_failed;
+
+    if (stage_ == Stage::CLIENTS)
+        sendConnectionRequest(peer);
+}
+
+void LoadGenerator::onHostOfferReceived()
+{
+    ++report_.host_offers_received;
+}
+
+void LoadGenerator::onKeyUsed()
+{
+    ++report_.keys_used;
+
+    if (relay_ && relay_->state() == Peer::State::READY && report_.keys_used % kKeyBatchSize == 0)
+        relay_->sendKeyPool(kKeyBatchSize);
+}
+
+void LoadGenerator::onPeerReady()
+{
+    DCHECK_GT(pending_peers_, 0u);
+    --pending_peers_;
+
+    if (stage_ == Stage::HOSTS || stage_ == Stage::CLIENTS)
+        connectNextPeers();
+}
+
+void LoadGenerator::sendConnectionRequest(Peer* peer)
+{
+    base::HostId host_id = base::kInvalidHostId;
+
+    if (!host_ids_.empty())
+    {
+        std::uniform_int_distribution<size_t> distribution(0, host_ids_.size() - 1);
+        host_id = host_ids_[distribution(random_)];
+    }
+
+    peer->sendConnectionRequest(host_id);
+}
+
+void LoadGenerator::onBrokeringFinished()
+{
+    stage_ = Stage::FINISHED;
+    report_.brokering_time = elapsedTime(brokering_start_time_);
+
+    clients_.clear();
+    hosts_.clear();
+    relay_.reset();
+
+    task_runner_->postTask(std::move(callback_));
+}
+
+} // namespace router
@@ -0,0 +1,145 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__LOAD_TEST__LOAD_GENERATOR_H
+#define ROUTER__LOAD_TEST__LOAD_GENERATOR_H
+
+#include "base/waitable_timer.h"
+#include "base/memory/byte_array.h"
+#include "base/peer/host_id.h"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace base {
+class TaskRunner;
+} // namespace base
+
+namespace router {
+
+// Simulates a relay, hosts and clients connected to a router over loopback. The relay fills the
+// key pool of the router, the hosts receive IDs and then the clients send connection requests to
+// random hosts until the time is up.
+class LoadGenerator
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        uint16_t port = 0;
+        base::ByteArray router_public_key;
+
+        // The user for client connections.
+        std::u16string user_name;
+        std::u16string password;
+
+        size_t host_count = 1000;
+        size_t client_count = 100;
+
+        // Number of connections that are being established at the same time.
+        size_t max_pending_connections = 100;
+
+        // Time during which the clients send connection requests.
+        std::chrono::seconds duration { 30 };
+    };
+
+    struct Report
+    {
+        size_t hosts_connected = 0;
+        size_t clients_connected = 0;
+        size_t connections_failed = 0;
+
+        size_t offers_received = 0; // Offers with relay credentials received by clients.
+        size_t offers_failed = 0; // Offers with an error code received by clients.
+        size_t host_offers_received = 0;
+        size_t keys_used = 0; // Key usage notifications received by the relay.
+        std::chrono::microseconds brokering_time { 0 };
+
+        // Time from the start of the connection to the end of authentication.
+        std::vector<std::chrono::microseconds> host_auth_latency;
+        std::vector<std::chrono::microseconds> client_auth_latency;
+
+        // Round trip time of HostIdRequest -> HostIdResponse.
+        std::vector<std::chrono::microseconds> host_id_latency;
+
+        // Round trip time of ConnectionRequest -> ConnectionOffer.
+        std::vector<std::chrono::microseconds> brokering_latency;
+    };
+
+    using FinishCallback = std::function<void()>;
+
+    LoadGenerator(std::shared_ptr<base::TaskRunner> task_runner, const Options& options);
+    ~LoadGenerator();
+
+    // Connects the relay and then the hosts. |callback| is called when each host has received an
+    // ID or failed.
+    void connectHosts(FinishCallback callback);
+
+    // Connects the clients, which send connection requests for the duration of the test. Then all
+    // connections are closed and |callback| is called.
+    void runClients(FinishCallback callback);
+
+    const Report& report() const { return report_; }
+
+private:
+    class Peer;
+    friend class Peer;
+
+    enum class Stage { IDLE, RELAY, HOSTS, CLIENTS, FINISHED };
+
+    void connectNextPeers();
+    void onRelayReady();
+    void onPeerAuthenticated(Peer* peer, const std::chrono::microseconds& latency);
+    void onPeerFailed(Peer* peer);
+    void onHostIdReceived(Peer* peer, base::HostId host_id,
+                          const std::chrono::microseconds& latency);
+    void onOfferReceived(Peer* peer, bool success, const std::chrono::microseconds& latency);
+    void onHostOfferReceived();
+    void onKeyUsed();
+    void onPeerReady();
+    void sendConnectionRequest(Peer* peer);
+    void onBrokeringFinished();
+
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    const Options options_;
+
+    Stage stage_ = Stage::IDLE;
+    std::unique_ptr<Peer> relay_;
+    std::vector<std::unique_ptr<Peer>> hosts_;
+    std::vector<std::unique_ptr<Peer>> clients_;
+    std::vector<base::HostId> host_ids_;
+    std::mt19937 random_;
+
+    size_t next_peer_ = 0;
+    size_t pending_peers_ = 0;
+    size_t ready_peers_ = 0;
+
+    base::WaitableTimer duration_timer_;
+    Clock::time_point brokering_start_time_;
+    FinishCallback callback_;
+    Report report_;
+
+    DISALLOW_COPY_AND_ASSIGN(LoadGenerator);
+};
+
+} // namespace router
+
+#endif // ROUTER__LOAD_TEST__LOAD_GENERATOR_H
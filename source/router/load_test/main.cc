@@ -0,0 +1,416 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/command_line.h"
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/crypto/key_pair.h"
+#include "base/crypto/random.h"
+#include "base/crypto/scoped_crypto_initializer.h"
+#include "base/message_loop/message_loop.h"
+#include "base/peer/user.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/unicode.h"
+#include "base/threading/thread.h"
+#include "build/build_config.h"
+#include "router/database_sqlite.h"
+#include "router/server.h"
+#include "router/load_test/load_generator.h"
+
+#if defined(OS_WIN)
+#include <Windows.h>
+#include <psapi.h>
+#elif defined(OS_LINUX)
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+const uint16_t kDefaultPort = 18998;
+const uint32_t kDefaultHostCount = 1000;
+const uint32_t kDefaultClientCount = 100;
+const uint32_t kDefaultPendingCount = 100;
+const uint32_t kDefaultDuration = 30; // In seconds.
+
+const char16_t kUserName[] = u"load_test";
+const char16_t kPassword[] = u"load_test_password";
+
+uint32_t uintSwitch(const base::CommandLine& command_line, std::u16string_view name,
+                    uint32_t default_value)
+{
+    if (!command_line.hasSwitch(name))
+        return default_value;
+
+    unsigned int value;
+    if (!base::stringToUint(command_line.switchValue(name), &value))
+    {
+        std::cout << "Invalid value for switch: " << base::utf8FromUtf16(name) << std::endl;
+        return default_value;
+    }
+
+    return value;
+}
+
+std::chrono::microseconds percentile(
+    const std::vector<std::chrono::microseconds>& sorted_values, double percent)
+{
+    if (sorted_values.empty())
+        return std::chrono::microseconds(0);
+
+    size_t index = static_cast<size_t>(percent / 100.0 * (sorted_values.size() - 1) + 0.5);
+    return sorted_values[std::min(index, sorted_values.size() - 1)];
+}
+
+void printLatency(const char* name, std::vector<std::chrono::microseconds> latency)
+{
+    std::sort(latency.begin(), latency.end());
+
+    std::cout << name << " (ms): p50 " << percentile(latency, 50).count() / 1000.0
+              << ", p99 " << percentile(latency, 99).count() / 1000.0
+              << ", max " << percentile(latency, 100).count() / 1000.0
+              << " (" << latency.size() << " samples)" << std::endl;
+}
+
+// Creates a database with one user for client connections.
+bool createDatabase(const std::filesystem::path& file_path)
+{
+    std::unique_ptr<router::DatabaseSqlite> database = router::DatabaseSqlite::create(file_path);
+    if (!database)
+        return false;
+
+    base::User user = base::User::create(kUserName, kPassword);
+    if (!user.isValid())
+        return false;
+
+    user.sessions = proto::ROUTER_SESSION_CLIENT;
+    user.flags = base::User::ENABLED;
+
+    return database->addUser(user);
+}
+
+// The router under test. On Linux it runs in a child process, so its memory is not mixed with
+// the memory of the simulated peers. On other platforms it runs in a thread of this process.
+class RouterRunner
+{
+public:
+    RouterRunner() = default;
+    ~RouterRunner() { stop(); }
+
+    bool start(const router::Server::Options& options);
+    void stop();
+
+    // Returns the resident memory of the router in bytes.
+    size_t residentMemory() const;
+
+    // Returns true if the memory of the router is measured separately from the simulated peers.
+    static bool isMemoryIsolated();
+
+private:
+#if defined(OS_LINUX)
+    pid_t pid_ = -1;
+#else
+    std::unique_ptr<base::Thread> thread_;
+    std::unique_ptr<router::Server> server_;
+#endif
+
+    DISALLOW_COPY_AND_ASSIGN(RouterRunner);
+};
+
+bool RouterRunner::start(const router::Server::Options& options)
+{
+#if defined(OS_LINUX)
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+        return false;
+
+    // No threads are started before the fork.
+    pid_ = fork();
+    if (pid_ < 0)
+    {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return false;
+    }
+
+    if (pid_ == 0)
+    {
+        close(pipe_fds[0]);
+
+        std::unique_ptr<base::MessageLoop> message_loop =
+            std::make_unique<base::MessageLoop>(base::MessageLoop::Type::ASIO);
+        std::unique_ptr<router::Server> server =
+            std::make_unique<router::Server>(message_loop->taskRunner());
+
+        char started = server->start(options) ? 1 : 0;
+        if (write(pipe_fds[1], &started, sizeof(started)) != sizeof(started))
+            started = 0;
+        close(pipe_fds[1]);
+
+        // The process is stopped by the parent.
+        if (started)
+            message_loop->run();
+
+        _exit(started ? 0 : 1);
+    }
+
+    close(pipe_fds[1]);
+
+    char started = 0;
+    if (read(pipe_fds[0], &started, sizeof(started)) != sizeof(started))
+        started = 0;
+    close(pipe_fds[0]);
+
+    if (!started)
+    {
+        stop();
+        return false;
+    }
+
+    return true;
+#else
+    thread_ = std::make_unique<base::Thread>();
+    thread_->start(base::MessageLoop::Type::ASIO);
+
+    server_ = std::make_unique<router::Server>(thread_->taskRunner());
+    return server_->start(options);
+#endif
+}
+
+void RouterRunner::stop()
+{
+#if defined(OS_LINUX)
+    if (pid_ <= 0)
+        return;
+
+    kill(pid_, SIGTERM);
+    waitpid(pid_, nullptr, 0);
+    pid_ = -1;
+#else
+    // The thread is stopped first, so the server does not receive notifications during
+    // destruction.
+    if (thread_)
+        thread_->stop();
+
+    server_.reset();
+    thread_.reset();
+#endif
+}
+
+size_t RouterRunner::residentMemory() const
+{
+#if defined(OS_LINUX)
+    std::ifstream stream("/proc/" + std::to_string(pid_) + "/statm");
+
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(stream >> total_pages >> resident_pages))
+        return 0;
+
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#elif defined(OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.WorkingSetSize;
+#else
+    return 0;
+#endif
+}
+
+// static
+bool RouterRunner::isMemoryIsolated()
+{
+#if defined(OS_LINUX)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void printReport(const router::LoadGenerator::Report& report,
+                 size_t memory_before, size_t memory_after)
+{
+    double seconds = static_cast<double>(report.brokering_time.count()) / 1000000.0;
+    size_t requests = report.offers_received + report.offers_failed;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Hosts connected: " << report.hosts_connected
+              << ", clients connected: " << report.clients_connected
+              << ", failed connections: " << report.connections_failed << std::endl;
+
+    printLatency("Host authentication (anonymous)", report.host_auth_latency);
+    printLatency("Client authentication (SRP)", report.client_auth_latency);
+    printLatency("Host ID request", report.host_id_latency);
+    printLatency("Connection request", report.brokering_latency);
+
+    std::cout << "Connection offers: " << report.offers_received << " with credentials, "
+              << report.offers_failed << " with error, " << report.host_offers_received
+              << " received by hosts" << std::endl
+              << "Brokering rate: " << (seconds > 0 ? requests / seconds : 0)
+              << " requests/s in " << seconds << " s" << std::endl
+              << "Relay keys used: " << report.keys_used << std::endl;
+
+    if (memory_after && report.hosts_connected)
+    {
+        double bytes_per_host = (static_cast<double>(memory_after) -
+            static_cast<double>(memory_before)) / static_cast<double>(report.hosts_connected);
+
+        std::cout << "Router memory: " << memory_after / (1024 * 1024) << " MB, "
+                  << bytes_per_host / 1024.0 << " KB per connected host";
+
+        if (!RouterRunner::isMemoryIsolated())
+            std::cout << " (includes the simulated peers)";
+
+        std::cout << std::endl;
+    }
+}
+
+void showHelp()
+{
+    std::cout << "aspia_router_load_test [switches]" << std::endl
+        << "Available switches:" << std::endl
+        << '\t' << "--hosts=<count>"      << '\t' << "Number of hosts (default: "
+                                               << kDefaultHostCount << ")" << std::endl
+        << '\t' << "--clients=<count>"    << '\t' << "Number of clients (default: "
+                                               << kDefaultClientCount << ")" << std::endl
+        << '\t' << "--pending=<count>"    << '\t' << "Connections established at once (default: "
+                                               << kDefaultPendingCount << ")" << std::endl
+        << '\t' << "--duration=<seconds>" << '\t' << "Time of sending connection requests"
+                                               << std::endl
+        << '\t' << "--port=<port>"        << '\t' << "Router port (default: "
+                                               << kDefaultPort << ")" << std::endl
+        << '\t' << "--shards=<count>"     << '\t' << "Router network threads (0 - number of cores)"
+                                               << std::endl
+        << '\t' << "--workers=<count>"    << '\t' << "Router worker threads (0 - number of cores)"
+                                               << std::endl
+        << '\t' << "--help"               << '\t' << "Show help" << std::endl
+        << "Each host and client uses a file descriptor. Raise the limit (ulimit -n) for "
+           "thousands of connections." << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char* const* argv)
+{
+    base::CommandLine::init(argc, argv);
+    const base::CommandLine& command_line = *base::CommandLine::forCurrentProcess();
+
+    if (command_line.hasSwitch(u"help"))
+    {
+        showHelp();
+        return 0;
+    }
+
+    base::LoggingSettings logging_settings;
+    logging_settings.min_log_level = base::LOG_LS_ERROR;
+    base::initLogging(logging_settings);
+
+    base::ScopedCryptoInitializer crypto_initializer;
+
+    base::KeyPair key_pair = base::KeyPair::create(base::KeyPair::Type::X25519);
+    if (!key_pair.isValid())
+    {
+        std::cout << "Failed to generate keys" << std::endl;
+        return 1;
+    }
+
+    std::error_code error_code;
+    std::filesystem::path temp_dir = std::filesystem::temp_directory_path(error_code);
+    temp_dir.append("aspia_router_load_test_" + std::to_string(base::Random::number32()));
+
+    router::Server::Options router_options;
+    router_options.private_key = key_pair.privateKey();
+    router_options.port = static_cast<uint16_t>(uintSwitch(command_line, u"port", kDefaultPort));
+    router_options.shard_count = uintSwitch(command_line, u"shards", 0);
+    router_options.worker_thread_count = uintSwitch(command_line, u"workers", 0);
+    router_options.database_path = temp_dir / "router.db3";
+
+    // All peers of the test connect from one address.
+    router_options.handshakes_per_minute = 0;
+    router_options.max_pending_handshakes = 0;
+    router_options.max_address_handshakes = 0;
+
+    if (!createDatabase(router_options.database_path))
+    {
+        std::cout << "Unable to create database" << std::endl;
+        std::filesystem::remove_all(temp_dir, error_code);
+        return 1;
+    }
+
+    router::LoadGenerator::Options options;
+    options.port = router_options.port;
+    options.router_public_key = key_pair.publicKey();
+    options.user_name = kUserName;
+    options.password = kPassword;
+    options.host_count = uintSwitch(command_line, u"hosts", kDefaultHostCount);
+    options.client_count = uintSwitch(command_line, u"clients", kDefaultClientCount);
+    options.max_pending_connections =
+        std::max(uintSwitch(command_line, u"pending", kDefaultPendingCount), 1U);
+    options.duration = std::chrono::seconds(
+        uintSwitch(command_line, u"duration", kDefaultDuration));
+
+    RouterRunner router;
+    if (!router.start(router_options))
+    {
+        std::cout << "Unable to start router" << std::endl;
+        std::filesystem::remove_all(temp_dir, error_code);
+        return 1;
+    }
+
+    std::cout << "Hosts: " << options.host_count << ", clients: " << options.client_count
+              << ", duration: " << options.duration.count() << " s" << std::endl;
+
+    std::unique_ptr<base::MessageLoop> message_loop =
+        std::make_unique<base::MessageLoop>(base::MessageLoop::Type::ASIO);
+    std::shared_ptr<base::TaskRunner> task_runner = message_loop->taskRunner();
+
+    size_t memory_before = router.residentMemory();
+    size_t memory_after = 0;
+
+    router::LoadGenerator generator(task_runner, options);
+
+    generator.connectHosts([&]()
+    {
+        memory_after = router.residentMemory();
+
+        std::cout << "Hosts connected: " << generator.report().hosts_connected
+                  << ". Sending connection requests..." << std::endl;
+
+        generator.runClients([task_runner]() { task_runner->postQuit(); });
+    });
+
+    message_loop->run();
+
+    printReport(generator.report(), memory_before, memory_after);
+
+    router.stop();
+    message_loop.reset();
+
+    std::filesystem::remove_all(temp_dir, error_code);
+
+    base::shutdownLogging();
+    return 0;
+}
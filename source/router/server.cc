@@ -21,60 +21,100 @@
 #include "base/logging.h"
 #include "base/stl_util.h"
 #include "base/task_runner.h"
-#include "base/crypto/key_pair.h"
-#include "base/files/base_paths.h"
-#include "base/files/file_util.h"
-#include "base/net/network_channel.h"
+#include "base/crypto/random.h"
+#include "base/peer/handshake_limiter.h"
+#include "base/threading/worker_pool.h"
 #include "router/database_factory_sqlite.h"
 #include "router/database_sqlite.h"
-#include "router/session_admin.h"
-#include "router/session_client.h"
-#include "router/session_host.h"
-#include "router/session_relay.h"
+#include "router/host_id_cache.h"
 #include "router/settings.h"
-#include "router/user_list_db.h"
+#include "router/shard.h"
+
+#include <algorithm>
+#include <thread>
 
 namespace router {
 
 namespace {
 
-const char* sessionTypeToString(proto::RouterSession session_type)
+// Each entry takes about 200 bytes with the heap overhead, so the cache uses up to 20 MB of memory.
+const size_t kHostIdCacheSize = 100000;
+
+// Interval of sending the changes of the session list to subscribed admins.
+const std::chrono::seconds kSessionListUpdateInterval { 1 };
+
+void printWhiteList(const char* name, const std::vector<std::u16string>& list)
 {
-    switch (session_type)
+    if (list.empty())
     {
-        case proto::ROUTER_SESSION_CLIENT:
-            return "ROUTER_SESSION_CLIENT";
-
-        case proto::ROUTER_SESSION_HOST:
-            return "ROUTER_SESSION_HOST";
+        LOG(LS_INFO) << "Empty " << name << " white list. Connections from all "
+                     << name << "s will be allowed";
+    }
+    else
+    {
+        LOG(LS_INFO) << "The " << name << " white list is not empty. Allowed " << name << "s:";
 
-        case proto::ROUTER_SESSION_ADMIN:
-            return "ROUTER_SESSION_ADMIN";
+        for (size_t i = 0; i < list.size(); ++i)
+            LOG(LS_INFO) << "#" << (i + 1) << ": " << list[i];
+    }
+}
 
-        case proto::ROUTER_SESSION_RELAY:
-            return "ROUTER_SESSION_RELAY";
+bool isAllowed(const std::vector<std::u16string>& white_list, const std::u16string& address)
+{
+    return white_list.empty() || base::contains(white_list, address);
+}
 
-        default:
-            return "ROUTER_SESSION_UNKNOWN";
-    }
+bool isSessionTypeMatched(uint32_t session_types, proto::RouterSession session_type)
+{
+    return !session_types || (session_types & session_type);
 }
 
 } // namespace
 
 Server::Server(std::shared_ptr<base::TaskRunner> task_runner)
     : task_runner_(std::move(task_runner)),
-      database_factory_(std::make_shared<DatabaseFactorySqlite>())
+      host_id_cache_(std::make_shared<HostIdCache>(kHostIdCacheSize)),
+      update_timer_(base::WaitableTimer::Type::REPEATED, task_runner_)
 {
     DCHECK(task_runner_);
 }
 
-Server::~Server() = default;
+Server::~Server()
+{
+    // The shard threads are stopped before the data they refer to is destroyed.
+    for (auto& shard : shards_)
+        shard->stop();
+}
 
 bool Server::start()
 {
-    if (server_)
+    Settings settings;
+
+    Options options;
+    options.private_key = settings.privateKey();
+    options.port = settings.port();
+    options.client_white_list = settings.clientWhiteList();
+    options.host_white_list = settings.hostWhiteList();
+    options.admin_white_list = settings.adminWhiteList();
+    options.relay_white_list = settings.relayWhiteList();
+    options.worker_thread_count = settings.workerThreadCount();
+    options.worker_queue_size = settings.workerQueueSize();
+    options.shard_count = settings.shardCount();
+    options.max_pending_handshakes = settings.maxPendingHandshakes();
+    options.handshakes_per_minute = settings.handshakesPerMinute();
+    options.max_address_handshakes = settings.maxAddressHandshakes();
+
+    return start(options);
+}
+
+bool Server::start(const Options& options)
+{
+    if (!shards_.empty())
         return false;
 
+    database_factory_ =
+        std::make_shared<DatabaseFactorySqlite>(host_id_cache_, options.database_path);
+
     std::unique_ptr<Database> database = database_factory_->openDatabase();
     if (!database)
     {
@@ -82,314 +122,531 @@ bool Server::start()
         return false;
     }
 
-    Settings settings;
+    // After a restart of the router all hosts reconnect at once. Their IDs are loaded in advance,
+    // so that the lookups do not go to the database. The most recently added hosts are added last
+    // to stay in the cache longer.
+    std::vector<Database::HostEntry> hosts = database->hostList(kHostIdCacheSize);
+    for (auto it = hosts.rbegin(); it != hosts.rend(); ++it)
+        host_id_cache_->add(it->key_hash, it->host_id);
+
+    LOG(LS_INFO) << "Host IDs loaded into the cache: " << hosts.size();
 
-    base::ByteArray private_key = settings.privateKey();
-    if (private_key.empty())
+    if (options.private_key.empty())
     {
         LOG(LS_INFO) << "The private key is not specified in the configuration file";
         return false;
     }
 
-    uint16_t port = settings.port();
-    if (!port)
+    if (!options.port)
     {
         LOG(LS_ERROR) << "Invalid port specified in configuration file";
         return false;
     }
 
-    client_white_list_ = settings.clientWhiteList();
-    if (client_white_list_.empty())
+    client_white_list_ = options.client_white_list;
+    printWhiteList("client", client_white_list_);
+
+    host_white_list_ = options.host_white_list;
+    printWhiteList("host", host_white_list_);
+
+    admin_white_list_ = options.admin_white_list;
+    printWhiteList("admin", admin_white_list_);
+
+    relay_white_list_ = options.relay_white_list;
+    printWhiteList("relay", relay_white_list_);
+
+    uint32_t worker_thread_count = options.worker_thread_count;
+    if (!worker_thread_count)
+        worker_thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+    uint32_t worker_queue_size = std::max(options.worker_queue_size, 1U);
+
+    LOG(LS_INFO) << "Worker threads: " << worker_thread_count
+                 << " (queue size: " << worker_queue_size << ")";
+
+    worker_pool_ = std::make_shared<base::WorkerPool>(worker_thread_count, worker_queue_size);
+
+#if defined(OS_LINUX)
+    uint32_t shard_count = options.shard_count;
+    if (!shard_count)
+        shard_count = std::max(std::thread::hardware_concurrency(), 1U);
+#else
+    // Without SO_REUSEPORT the connections can not be distributed between the acceptors.
+    uint32_t shard_count = 1;
+#endif
+
+    LOG(LS_INFO) << "Network threads: " << shard_count;
+
+    // The limiter is shared by the shards, so the limits apply to the whole router.
+    base::HandshakeLimiter::Options limiter_options;
+    limiter_options.max_pending = options.max_pending_handshakes;
+    limiter_options.max_address_pending = options.max_address_handshakes;
+    limiter_options.address_rate = static_cast<double>(options.handshakes_per_minute) / 60.0;
+
+    LOG(LS_INFO) << "Max pending handshakes: " << options.max_pending_handshakes
+                 << " (per address: " << options.max_address_handshakes << ", "
+                 << options.handshakes_per_minute << " per minute)";
+
+    handshake_limiter_ = std::make_shared<base::HandshakeLimiter>(limiter_options);
+
+    relay_key_pool_ = std::make_unique<SharedKeyPool>(this);
+
+    for (uint32_t i = 0; i < shard_count; ++i)
     {
-        LOG(LS_INFO) << "Empty client white list. Connections from all clients will be allowed";
+        shards_.emplace_back(std::make_unique<Shard>(
+            i, shard_count > 1, options.port, options.private_key, this, database_factory_,
+            worker_pool_, handshake_limiter_));
     }
-    else
+
+    for (auto& shard : shards_)
+        shard->start();
+
+    LOG(LS_INFO) << "Server started";
+    return true;
+}
+
+bool Server::isSessionAllowed(
+    proto::RouterSession session_type, const std::u16string& address) const
+{
+    switch (session_type)
     {
-        LOG(LS_INFO) << "Client white list is not empty. Allowed clients:";
+        case proto::ROUTER_SESSION_CLIENT:
+            return isAllowed(client_white_list_, address);
 
-        for (size_t i = 0; i < client_white_list_.size(); ++i)
-            LOG(LS_INFO) << "#" << (i + 1) << ": " << client_white_list_[i];
+        case proto::ROUTER_SESSION_HOST:
+            return isAllowed(host_white_list_, address);
+
+        case proto::ROUTER_SESSION_ADMIN:
+            return isAllowed(admin_white_list_, address);
+
+        case proto::ROUTER_SESSION_RELAY:
+            return isAllowed(relay_white_list_, address);
+
+        default:
+            return false;
     }
+}
 
-    host_white_list_ = settings.hostWhiteList();
-    if (host_white_list_.empty())
+void Server::onSessionStarted(size_t shard_index, Session::SessionId session_id)
+{
+    if (!task_runner_->belongsToCurrentThread())
     {
-        LOG(LS_INFO) << "Empty host white list. Connections from all hosts will be allowed";
+        task_runner_->postTask(
+            std::bind(&Server::onSessionStarted, this, shard_index, session_id));
+        return;
     }
-    else
-    {
-        LOG(LS_INFO) << "Host white list is not empty. Allowed hosts:";
 
-        for (size_t i = 0; i < host_white_list_.size(); ++i)
-            LOG(LS_INFO) << "#" << (i + 1) << ": " << host_white_list_[i];
-    }
+    sessions_.add(session_id, shard_index);
+}
 
-    admin_white_list_ = settings.adminWhiteList();
-    if (admin_white_list_.empty())
+void Server::onSessionRemoved(Session::SessionId session_id, proto::RouterSession session_type)
+{
+    if (!task_runner_->belongsToCurrentThread())
     {
-        LOG(LS_INFO) << "Empty admin white list. Connections from all admins will be allowed";
+        task_runner_->postTask(
+            std::bind(&Server::onSessionRemoved, this, session_id, session_type));
+        return;
     }
-    else
-    {
-        LOG(LS_INFO) << "Admin white list is not empty. Allowed admins:";
 
-        for (size_t i = 0; i < admin_white_list_.size(); ++i)
-            LOG(LS_INFO) << "#" << (i + 1) << ": " << admin_white_list_[i];
+    sessions_.remove(session_id);
+
+    if (session_type == proto::ROUTER_SESSION_RELAY)
+    {
+        relay_key_pool_->removeKeysForRelay(session_id);
+        relay_peers_.erase(session_id);
     }
 
-    relay_white_list_ = settings.relayWhiteList();
-    if (relay_white_list_.empty())
+    if (session_type == proto::ROUTER_SESSION_ADMIN)
     {
-        LOG(LS_INFO) << "Empty relay white list. Connections from all relays will be allowed";
+        proto::SessionListRequest request;
+        setSubscription(session_id, request);
     }
-    else
+
+    for (auto& subscriber : subscribers_)
     {
-        LOG(LS_INFO) << "Relay white list is not empty. Allowed relays:";
+        if (isSessionTypeMatched(subscriber.second.session_types, session_type))
+            subscriber.second.pending_update.add_removed_session_id(session_id);
+    }
+}
 
-        for (size_t i = 0; i < relay_white_list_.size(); ++i)
-            LOG(LS_INFO) << "#" << (i + 1) << ": " << relay_white_list_[i];
+void Server::onHostSessionWithId(Session::SessionId session_id, base::HostId host_id)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(
+            std::bind(&Server::onHostSessionWithId, this, session_id, host_id));
+        return;
     }
 
-    std::unique_ptr<base::UserListBase> user_list = UserListDb::open(*database_factory_);
+    if (!sessions_.shard(session_id).has_value())
+    {
+        // The session was closed while the request was on the way.
+        return;
+    }
 
-    authenticator_manager_ =
-        std::make_unique<base::ServerAuthenticatorManager>(task_runner_, this);
-    authenticator_manager_->setPrivateKey(private_key);
-    authenticator_manager_->setUserList(std::move(user_list));
-    authenticator_manager_->setAnonymousAccess(
-        base::ServerAuthenticator::AnonymousAccess::ENABLE,
-        proto::ROUTER_SESSION_HOST | proto::ROUTER_SESSION_RELAY);
+    std::optional<Session::SessionId> previous_session = sessions_.addHostId(session_id, host_id);
+    if (previous_session.has_value())
+    {
+        LOG(LS_INFO) << "Detected previous connection with ID " << host_id;
 
-    relay_key_pool_ = std::make_unique<SharedKeyPool>(this);
+        Shard* shard = shardForSession(*previous_session);
+        if (shard)
+            shard->stopSession(*previous_session);
+    }
+}
 
-    server_ = std::make_unique<base::NetworkServer>();
-    server_->start(port, this);
+void Server::onHostSessionIdReset(Session::SessionId session_id, base::HostId host_id)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(
+            std::bind(&Server::onHostSessionIdReset, this, session_id, host_id));
+        return;
+    }
 
-    LOG(LS_INFO) << "Server started";
-    return true;
+    sessions_.removeHostId(session_id, host_id);
 }
 
-std::unique_ptr<proto::SessionList> Server::sessionList() const
+void Server::onConnectionRequest(Session::SessionId client_session_id, base::HostId host_id)
 {
-    std::unique_ptr<proto::SessionList> result = std::make_unique<proto::SessionList>();
-
-    for (const auto& session : sessions_)
+    if (!task_runner_->belongsToCurrentThread())
     {
-        proto::Session* item = result->add_session();
+        task_runner_->postTask(
+            std::bind(&Server::onConnectionRequest, this, client_session_id, host_id));
+        return;
+    }
 
-        item->set_session_id(session->sessionId());
-        item->set_session_type(session->sessionType());
-        item->set_timepoint(session->startTime());
-        item->set_ip_address(session->address());
-        item->mutable_version()->CopyFrom(session->version().toProto());
-        item->set_os_name(session->osName());
-        item->set_computer_name(session->computerName());
+    proto::ConnectionOffer offer;
+
+    std::optional<Session::SessionId> host_session_id = sessions_.hostSession(host_id);
+    if (!host_session_id.has_value())
+    {
+        LOG(LS_WARNING) << "Host with id " << host_id << " NOT found!";
+        offer.set_error_code(proto::ConnectionOffer::PEER_NOT_FOUND);
+    }
+    else
+    {
+        LOG(LS_INFO) << "Host with id " << host_id << " found";
 
-        switch (session->sessionType())
+        std::optional<SharedKeyPool::Credentials> credentials = relay_key_pool_->takeCredentials();
+        if (!credentials.has_value())
+        {
+            LOG(LS_WARNING) << "Empty key pool";
+            offer.set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
+        }
+        else
         {
-            case proto::ROUTER_SESSION_HOST:
+            auto peer_data = relay_peers_.find(credentials->session_id);
+            if (peer_data == relay_peers_.end())
             {
-                proto::HostSessionData session_data;
+                LOG(LS_ERROR) << "No peer data for relay with session id "
+                              << credentials->session_id;
+                offer.set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
+            }
+            else
+            {
+                offer.set_error_code(proto::ConnectionOffer::SUCCESS);
 
-                for (const auto& host_id : static_cast<SessionHost*>(session.get())->hostIdList())
-                    session_data.add_host_id(host_id);
+                proto::RelayCredentials* offer_credentials = offer.mutable_relay();
 
-                item->set_session_data(session_data.SerializeAsString());
-            }
-            break;
+                offer_credentials->set_host(peer_data->second.first);
+                offer_credentials->set_port(peer_data->second.second);
+                offer_credentials->mutable_key()->Swap(&credentials->key);
+                offer_credentials->set_secret(base::Random::string(16));
 
-            case proto::ROUTER_SESSION_RELAY:
-            {
-                proto::RelaySessionData session_data;
-                session_data.set_pool_size(relay_key_pool_->countForRelay(session->sessionId()));
-                item->set_session_data(session_data.SerializeAsString());
+                Shard* host_shard = shardForSession(*host_session_id);
+                if (host_shard)
+                {
+                    LOG(LS_INFO) << "Sending connection offer to host";
+                    offer.set_peer_role(proto::ConnectionOffer::HOST);
+                    host_shard->sendConnectionOffer(*host_session_id, offer);
+                }
             }
-            break;
-
-            default:
-                break;
         }
     }
 
-    result->set_error_code(proto::SessionList::SUCCESS);
-    return result;
+    Shard* client_shard = shardForSession(client_session_id);
+    if (!client_shard)
+        return;
+
+    LOG(LS_INFO) << "Sending connection offer to client";
+    offer.set_peer_role(proto::ConnectionOffer::CLIENT);
+    client_shard->sendConnectionOffer(client_session_id, offer);
 }
 
-bool Server::stopSession(Session::SessionId session_id)
+void Server::onRelayKeyPool(Session::SessionId session_id, const proto::RelayKeyPool& key_pool)
 {
-    for (auto it = sessions_.begin(); it != sessions_.end(); ++it)
+    if (!task_runner_->belongsToCurrentThread())
     {
-        if (it->get()->sessionId() == session_id)
-        {
-            sessions_.erase(it);
-            return true;
-        }
+        task_runner_->postTask(std::bind(&Server::onRelayKeyPool, this, session_id, key_pool));
+        return;
     }
 
-    return false;
+    if (!sessions_.shard(session_id).has_value())
+        return;
+
+    relay_peers_[session_id] =
+        std::make_pair(key_pool.peer_host(), static_cast<uint16_t>(key_pool.peer_port()));
+
+    for (int i = 0; i < key_pool.key_size(); ++i)
+        relay_key_pool_->addKey(session_id, key_pool.key(i));
 }
 
-void Server::onHostSessionWithId(SessionHost* session)
+void Server::onRelayLoad(Session::SessionId session_id, const SharedKeyPool::Load& load)
 {
-    for (auto it = sessions_.begin(); it != sessions_.end();)
+    if (!task_runner_->belongsToCurrentThread())
     {
-        if (it->get()->sessionType() == proto::ROUTER_SESSION_HOST)
-        {
-            SessionHost* other_session = reinterpret_cast<SessionHost*>(it->get());
-            if (other_session != session)
-            {
-                for (const auto& host_id : session->hostIdList())
-                {
-                    if (other_session->hasHostId(host_id))
-                    {
-                        LOG(LS_INFO) << "Detected previous connection with ID " << host_id;
-
-                        it = sessions_.erase(it);
-                        continue;
-                    }
-                }
-            }
-        }
-
-        ++it;
+        task_runner_->postTask(std::bind(&Server::onRelayLoad, this, session_id, load));
+        return;
     }
+
+    relay_key_pool_->setRelayLoad(session_id, load);
 }
 
-SessionHost* Server::hostSessionById(base::HostId host_id)
+void Server::onSessionListRequest(Session::SessionId admin_session_id,
+                                  const proto::SessionListRequest& request)
 {
-    for (auto it = sessions_.begin(); it != sessions_.end(); ++it)
+    if (!task_runner_->belongsToCurrentThread())
     {
-        Session* entry = it->get();
-
-        if (entry->sessionType() == proto::ROUTER_SESSION_HOST &&
-            static_cast<SessionHost*>(entry)->hasHostId(host_id))
-        {
-            return static_cast<SessionHost*>(entry);
-        }
+        task_runner_->postTask(
+            std::bind(&Server::onSessionListRequest, this, admin_session_id, request));
+        return;
     }
 
-    return nullptr;
+    // The subscription starts before the sessions are collected, so no change is lost. The
+    // changes are not sent until the page is sent.
+    if (!request.cursor())
+        setSubscription(admin_session_id, request);
+
+    uint64_t request_id = ++last_request_id_;
+
+    SessionListRequest& list_request = session_list_requests_[request_id];
+    list_request.admin_session_id = admin_session_id;
+    list_request.pending_shards = shards_.size();
+    list_request.page_size = static_cast<int>(request.page_size());
+    list_request.has_more = false;
+    list_request.session_list = std::make_shared<proto::SessionList>();
+
+    for (auto& shard : shards_)
+        shard->collectSessionList(request_id, request);
 }
 
-Session* Server::sessionById(Session::SessionId session_id)
+void Server::onShardSessionList(
+    uint64_t request_id, std::shared_ptr<proto::SessionList> session_list)
 {
-    for (auto& session : sessions_)
+    if (!task_runner_->belongsToCurrentThread())
     {
-        if (session->sessionId() == session_id)
-            return session.get();
+        task_runner_->postTask(std::bind(
+            &Server::onShardSessionList, this, request_id, std::move(session_list)));
+        return;
     }
 
-    return nullptr;
+    auto it = session_list_requests_.find(request_id);
+    if (it == session_list_requests_.end())
+        return;
+
+    SessionListRequest& request = it->second;
+    auto* sessions = request.session_list->mutable_session();
+
+    for (int i = 0; i < session_list->session_size(); ++i)
+        sessions->Add()->Swap(session_list->mutable_session(i));
+
+    if (session_list->next_cursor())
+        request.has_more = true;
+
+    DCHECK_GT(request.pending_shards, 0u);
+    if (--request.pending_shards == 0)
+        completeSessionList(request_id);
 }
 
-void Server::onNewConnection(std::unique_ptr<base::NetworkChannel> channel)
+void Server::onStopSessionRequest(
+    Session::SessionId admin_session_id, Session::SessionId session_id)
 {
-    LOG(LS_INFO) << "New connection: " << channel->peerAddress();
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(
+            std::bind(&Server::onStopSessionRequest, this, admin_session_id, session_id));
+        return;
+    }
+
+    proto::SessionResult result;
+    result.set_type(proto::SESSION_REQUEST_DISCONNECT);
 
-    channel->setOwnKeepAlive(true);
-    channel->setNoDelay(true);
+    Shard* shard = shardForSession(session_id);
+    if (!shard)
+    {
+        LOG(LS_WARNING) << "Session not found: " << session_id;
+        result.set_error_code(proto::SessionResult::INVALID_SESSION_ID);
+    }
+    else
+    {
+        LOG(LS_INFO) << "Session '" << session_id << "' disconnected by admin";
+        shard->stopSession(session_id);
+        result.set_error_code(proto::SessionResult::SUCCESS);
+    }
 
-    if (authenticator_manager_)
-        authenticator_manager_->addNewChannel(std::move(channel));
+    Shard* admin_shard = shardForSession(admin_session_id);
+    if (admin_shard)
+        admin_shard->sendSessionResult(admin_session_id, result);
 }
 
 void Server::onPoolKeyUsed(Session::SessionId session_id, uint32_t key_id)
 {
-    for (const auto& session : sessions_)
-    {
-        SessionRelay* relay_session = static_cast<SessionRelay*>(session.get());
-        if (relay_session->sessionId() == session_id)
-            relay_session->sendKeyUsed(key_id);
-    }
+    Shard* shard = shardForSession(session_id);
+    if (shard)
+        shard->sendKeyUsed(session_id, key_id);
 }
 
-void Server::onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info)
+Shard* Server::shardForSession(Session::SessionId session_id) const
 {
-    std::u16string address = session_info.channel->peerAddress();
-    proto::RouterSession session_type =
-        static_cast<proto::RouterSession>(session_info.session_type);
+    std::optional<size_t> shard_index = sessions_.shard(session_id);
+    if (!shard_index.has_value() || *shard_index >= shards_.size())
+        return nullptr;
 
-    LOG(LS_INFO) << "New session: " << sessionTypeToString(session_type) << " (" << address << ")";
+    return shards_[*shard_index].get();
+}
 
-    std::unique_ptr<Session> session;
+void Server::completeSessionList(uint64_t request_id)
+{
+    auto it = session_list_requests_.find(request_id);
+    if (it == session_list_requests_.end())
+        return;
 
-    switch (session_info.session_type)
+    Session::SessionId admin_session_id = it->second.admin_session_id;
+    const int page_size = it->second.page_size;
+    bool has_more = it->second.has_more;
+    std::shared_ptr<proto::SessionList> result = std::move(it->second.session_list);
+    session_list_requests_.erase(it);
+
+    // Each shard returns its first sessions after the cursor, so the first sessions of the merged
+    // list are the first sessions of the router.
+    auto* sessions = result->mutable_session();
+    std::sort(sessions->pointer_begin(), sessions->pointer_end(),
+              [](const proto::Session* first, const proto::Session* second)
     {
-        case proto::ROUTER_SESSION_CLIENT:
-        {
-            if (!client_white_list_.empty() && !base::contains(client_white_list_, address))
-                break;
+        return first->session_id() < second->session_id();
+    });
 
-            session = std::make_unique<SessionClient>();
-        }
-        break;
+    if (page_size && sessions->size() > page_size)
+    {
+        sessions->DeleteSubrange(page_size, sessions->size() - page_size);
+        has_more = true;
+    }
 
-        case proto::ROUTER_SESSION_HOST:
-        {
-            if (!host_white_list_.empty() && !base::contains(host_white_list_, address))
-                break;
+    if (has_more && !sessions->empty())
+        result->set_next_cursor(sessions->rbegin()->session_id());
 
-            session = std::make_unique<SessionHost>();
-        }
-        break;
+    HostIdCache::Stat cache_stat = host_id_cache_->stat();
+    proto::HostIdCacheStat* cache_stat_item = result->mutable_host_id_cache_stat();
+    cache_stat_item->set_size(cache_stat.size);
+    cache_stat_item->set_capacity(cache_stat.capacity);
+    cache_stat_item->set_hits(cache_stat.hits);
+    cache_stat_item->set_misses(cache_stat.misses);
 
-        case proto::ROUTER_SESSION_ADMIN:
-        {
-            if (!admin_white_list_.empty() && !base::contains(admin_white_list_, address))
-                break;
+    if (worker_pool_)
+    {
+        base::WorkerPool::Stat pool_stat = worker_pool_->stat();
+        proto::WorkerPoolStat* pool_stat_item = result->mutable_worker_pool_stat();
+        pool_stat_item->set_thread_count(static_cast<uint32_t>(pool_stat.thread_count));
+        pool_stat_item->set_queue_size(pool_stat.queue_size);
+        pool_stat_item->set_peak_queue_size(pool_stat.peak_queue_size);
+        pool_stat_item->set_max_queue_size(pool_stat.max_queue_size);
+        pool_stat_item->set_completed(pool_stat.completed);
+        pool_stat_item->set_rejected(pool_stat.rejected);
+    }
 
-            session = std::make_unique<SessionAdmin>();
-        }
-        break;
+    if (handshake_limiter_)
+    {
+        base::HandshakeLimiter::Stat handshake_stat = handshake_limiter_->stat();
+        proto::HandshakeStat* handshake_stat_item = result->mutable_handshake_stat();
+        handshake_stat_item->set_pending(handshake_stat.pending);
+        handshake_stat_item->set_peak_pending(handshake_stat.peak_pending);
+        handshake_stat_item->set_address_count(handshake_stat.address_count);
+        handshake_stat_item->set_completed(handshake_stat.completed);
+        handshake_stat_item->set_failed(handshake_stat.failed);
+        handshake_stat_item->set_rejected_by_address(handshake_stat.rejected_by_address);
+        handshake_stat_item->set_rejected_by_limit(handshake_stat.rejected_by_limit);
+    }
 
-        case proto::ROUTER_SESSION_RELAY:
-        {
-            if (!relay_white_list_.empty() && !base::contains(relay_white_list_, address))
-                break;
+    result->set_error_code(proto::SessionList::SUCCESS);
 
-            session = std::make_unique<SessionRelay>();
-        }
-        break;
+    Shard* shard = shardForSession(admin_session_id);
+    if (shard)
+        shard->sendSessionList(admin_session_id, std::move(result));
+}
 
-        default:
-        {
-            LOG(LS_ERROR) << "Unsupported session type: "
-                          << static_cast<int>(session_info.session_type);
-        }
-        break;
+void Server::onSessionUpdated(std::shared_ptr<proto::Session> session)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(std::bind(&Server::onSessionUpdated, this, std::move(session)));
+        return;
     }
 
-    if (!session)
-    {
-        LOG(LS_ERROR) << "Connection rejected for '" << address << "'";
+    // The session may be removed while the notification was on the way.
+    if (!sessions_.shard(session->session_id()).has_value())
         return;
+
+    for (auto& subscriber : subscribers_)
+    {
+        if (isSessionTypeMatched(subscriber.second.session_types, session->session_type()))
+            subscriber.second.pending_update.add_session()->CopyFrom(*session);
     }
+}
 
-    session->setChannel(std::move(session_info.channel));
-    session->setDatabaseFactory(database_factory_);
-    session->setServer(this);
-    session->setRelayKeyPool(relay_key_pool_->share());
-    session->setVersion(session_info.version);
-    session->setOsName(session_info.os_name);
-    session->setComputerName(session_info.computer_name);
+void Server::setSubscription(Session::SessionId admin_session_id,
+                             const proto::SessionListRequest& request)
+{
+    if (request.subscribe())
+    {
+        Subscriber& subscriber = subscribers_[admin_session_id];
+        subscriber.session_types = request.session_types();
+        subscriber.pending_update.Clear();
+    }
+    else
+    {
+        subscribers_.erase(admin_session_id);
+    }
+
+    has_subscribers_ = !subscribers_.empty();
 
-    sessions_.emplace_back(std::move(session));
-    sessions_.back()->start(this);
+    if (subscribers_.empty())
+        update_timer_.stop();
+    else if (!update_timer_.isActive())
+        update_timer_.start(kSessionListUpdateInterval,
+                            std::bind(&Server::flushSessionListUpdates, this));
 }
 
-void Server::onSessionFinished(Session::SessionId session_id, proto::RouterSession /* session_type */)
+void Server::flushSessionListUpdates()
 {
-    for (auto it = sessions_.begin(); it != sessions_.end(); ++it)
+    for (auto& subscriber : subscribers_)
     {
-        if (it->get()->sessionId() == session_id)
+        Session::SessionId admin_session_id = subscriber.first;
+        proto::SessionListUpdate& pending_update = subscriber.second.pending_update;
+
+        if (!pending_update.session_size() && !pending_update.removed_session_id_size())
+            continue;
+
+        // The changes must not overtake a page of the list that is being collected.
+        bool has_pending_page = std::any_of(
+            session_list_requests_.cbegin(), session_list_requests_.cend(),
+            [admin_session_id](const auto& request)
         {
-            // Session will be destroyed after completion of the current call.
-            task_runner_->deleteSoon(std::move(*it));
+            return request.second.admin_session_id == admin_session_id;
+        });
 
-            // Delete a session from the list.
-            sessions_.erase(it);
-            break;
-        }
+        if (has_pending_page)
+            continue;
+
+        Shard* shard = shardForSession(admin_session_id);
+        if (!shard)
+            continue;
+
+        std::shared_ptr<proto::SessionListUpdate> update =
+            std::make_shared<proto::SessionListUpdate>();
+        update->Swap(&pending_update);
+
+        shard->sendSessionListUpdate(admin_session_id, std::move(update));
     }
 }
 
@@ -19,66 +19,154 @@
 #ifndef ROUTER__SERVER_H
 #define ROUTER__SERVER_H
 
-#include "base/net/network_server.h"
+#include "base/waitable_timer.h"
 #include "base/peer/host_id.h"
-#include "base/peer/server_authenticator_manager.h"
 #include "build/build_config.h"
 #include "proto/router_admin.pb.h"
+#include "proto/router_relay.pb.h"
 #include "router/session.h"
+#include "router/session_registry.h"
 #include "router/shared_key_pool.h"
 
+#include <atomic>
+#include <filesystem>
+#include <map>
+
+namespace base {
+class HandshakeLimiter;
+class TaskRunner;
+class WorkerPool;
+} // namespace base
+
 namespace router {
 
 class DatabaseFactory;
-class SessionHost;
-class SessionRelay;
-
-class Server
-    : public base::NetworkServer::Delegate,
-      public SharedKeyPool::Delegate,
-      public base::ServerAuthenticatorManager::Delegate,
-      public Session::Delegate
+class HostIdCache;
+class Shard;
+
+// Coordinates the shards of the router. The server runs on the main thread and owns the data
+// shared by all sessions: the directory of sessions and host IDs and the relay key pool. The
+// shards report the events of their sessions with the on* methods, which may be called from any
+// thread, and the server sends the results back to the shards that own the sessions.
+class Server : public SharedKeyPool::Delegate
 {
 public:
     explicit Server(std::shared_ptr<base::TaskRunner> task_runner);
     ~Server();
 
+    struct Options
+    {
+        base::ByteArray private_key;
+        uint16_t port = 0;
+
+        std::vector<std::u16string> client_white_list;
+        std::vector<std::u16string> host_white_list;
+        std::vector<std::u16string> admin_white_list;
+        std::vector<std::u16string> relay_white_list;
+
+        uint32_t worker_thread_count = 0; // 0 - number of processor threads.
+        uint32_t worker_queue_size = 1024;
+        uint32_t shard_count = 0; // 0 - number of processor threads.
+        uint32_t max_pending_handshakes = 256; // 0 - no limit.
+        uint32_t handshakes_per_minute = 120; // Per address, 0 - no limit.
+        uint32_t max_address_handshakes = 8; // 0 - no limit.
+
+        // If empty, the database in the default location is used.
+        std::filesystem::path database_path;
+    };
+
+    // Starts the server with the options from the configuration file.
     bool start();
+    bool start(const Options& options);
 
-    std::unique_ptr<proto::SessionList> sessionList() const;
-    bool stopSession(Session::SessionId session_id);
-    void onHostSessionWithId(SessionHost* session);
+    // Checks the white list for the session type. The lists do not change after start, so the
+    // method may be called from any thread.
+    bool isSessionAllowed(proto::RouterSession session_type, const std::u16string& address) const;
 
-    SessionHost* hostSessionById(base::HostId host_id);
-    Session* sessionById(Session::SessionId session_id);
+    void onSessionStarted(size_t shard_index, Session::SessionId session_id);
+    void onSessionRemoved(Session::SessionId session_id, proto::RouterSession session_type);
 
-protected:
-    // base::NetworkServer::Delegate implementation.
-    void onNewConnection(std::unique_ptr<base::NetworkChannel> channel) override;
+    // Called when |host_id| is assigned to the session. A previous session with the same ID is
+    // stopped.
+    void onHostSessionWithId(Session::SessionId session_id, base::HostId host_id);
 
-    // SharedKeyPool::Delegate implementation.
-    void onPoolKeyUsed(Session::SessionId session_id, uint32_t key_id) override;
+    // Called when the host has reset |host_id|.
+    void onHostSessionIdReset(Session::SessionId session_id, base::HostId host_id);
+
+    // Called when the client requests a connection to |host_id|. The offer is sent to both the
+    // client and the host.
+    void onConnectionRequest(Session::SessionId client_session_id, base::HostId host_id);
+
+    void onRelayKeyPool(Session::SessionId session_id, const proto::RelayKeyPool& key_pool);
+    void onRelayLoad(Session::SessionId session_id, const SharedKeyPool::Load& load);
+
+    void onSessionListRequest(Session::SessionId admin_session_id,
+                              const proto::SessionListRequest& request);
+    void onShardSessionList(uint64_t request_id, std::shared_ptr<proto::SessionList> session_list);
 
-    // base::ServerAuthenticatorManager::Delegate implementation.
-    void onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info) override;
+    // Called by the shards when a session is started or its data has changed. The shards call it
+    // only if there are admins subscribed to the session list.
+    void onSessionUpdated(std::shared_ptr<proto::Session> session);
+    bool hasSessionListSubscribers() const { return has_subscribers_.load(); }
 
-    // Session::Delegate implementation.
-    void onSessionFinished(Session::SessionId session_id,
-                           proto::RouterSession session_type) override;
+    void onStopSessionRequest(Session::SessionId admin_session_id, Session::SessionId session_id);
+
+protected:
+    // SharedKeyPool::Delegate implementation.
+    void onPoolKeyUsed(Session::SessionId session_id, uint32_t key_id) override;
 
 private:
+    Shard* shardForSession(Session::SessionId session_id) const;
+    void completeSessionList(uint64_t request_id);
+    void setSubscription(Session::SessionId admin_session_id,
+                         const proto::SessionListRequest& request);
+    void flushSessionListUpdates();
+
     std::shared_ptr<base::TaskRunner> task_runner_;
+    std::shared_ptr<HostIdCache> host_id_cache_;
     std::shared_ptr<DatabaseFactory> database_factory_;
-    std::unique_ptr<base::NetworkServer> server_;
-    std::unique_ptr<base::ServerAuthenticatorManager> authenticator_manager_;
+    std::shared_ptr<base::WorkerPool> worker_pool_;
+    std::shared_ptr<base::HandshakeLimiter> handshake_limiter_;
     std::unique_ptr<SharedKeyPool> relay_key_pool_;
-    std::vector<std::unique_ptr<Session>> sessions_;
+    SessionRegistry sessions_;
+
+    using PeerData = std::pair<std::string, uint16_t>;
+
+    // Addresses for peers reported by the relays.
+    std::unordered_map<Session::SessionId, PeerData> relay_peers_;
+
+    struct SessionListRequest
+    {
+        Session::SessionId admin_session_id;
+        size_t pending_shards;
+        int page_size;
+        bool has_more;
+        std::shared_ptr<proto::SessionList> session_list;
+    };
+
+    uint64_t last_request_id_ = 0;
+    std::map<uint64_t, SessionListRequest> session_list_requests_;
+
+    // Admins subscribed to the session list. The changes are collected and sent periodically, so
+    // a burst of connections results in one message.
+    struct Subscriber
+    {
+        uint32_t session_types;
+        proto::SessionListUpdate pending_update;
+    };
+
+    std::unordered_map<Session::SessionId, Subscriber> subscribers_;
+    std::atomic<bool> has_subscribers_ = false;
+    base::WaitableTimer update_timer_;
 
     std::vector<std::u16string> client_white_list_;
     std::vector<std::u16string> host_white_list_;
     std::vector<std::u16string> admin_white_list_;
     std::vector<std::u16string> relay_white_list_;
 
+    // Destroyed first, so the sessions never see a partially destroyed server.
+    std::vector<std::unique_ptr<Shard>> shards_;
+
     DISALLOW_COPY_AND_ASSIGN(Server);
 };
 
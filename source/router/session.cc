@@ -21,41 +21,49 @@
 #include "base/logging.h"
 #include "base/net/network_channel.h"
 #include "base/strings/unicode.h"
+#include "base/threading/worker_pool.h"
 #include "router/database.h"
 #include "router/database_factory.h"
-#include "router/shared_key_pool.h"
+
+#include <atomic>
 
 namespace router {
 
 Session::SessionId createSessionId()
 {
-    static Session::SessionId last_session_id = 0;
-    ++last_session_id;
-    return last_session_id;
+    // Sessions are created on several shards.
+    static std::atomic<Session::SessionId> last_session_id = 0;
+    return ++last_session_id;
 }
 
 Session::Session(proto::RouterSession session_type)
     : session_type_(session_type),
-      session_id_(createSessionId())
+      session_id_(createSessionId()),
+      self_(std::make_shared<Session*>(this))
 {
     // Nothing
 }
 
-Session::~Session() = default;
+Session::~Session()
+{
+    *self_ = nullptr;
+}
 
 void Session::setChannel(std::unique_ptr<base::NetworkChannel> channel)
 {
     channel_ = std::move(channel);
 }
 
-void Session::setRelayKeyPool(std::unique_ptr<SharedKeyPool> relay_key_pool)
+void Session::setDatabaseFactory(std::shared_ptr<DatabaseFactory> database_factory)
 {
-    relay_key_pool_ = std::move(relay_key_pool);
+    database_factory_ = std::move(database_factory);
 }
 
-void Session::setDatabaseFactory(std::shared_ptr<DatabaseFactory> database_factory)
+void Session::setWorkerPool(std::shared_ptr<base::TaskRunner> task_runner,
+                            std::shared_ptr<base::WorkerPool> worker_pool)
 {
-    database_factory_ = std::move(database_factory);
+    task_runner_ = std::move(task_runner);
+    worker_pool_ = std::move(worker_pool);
 }
 
 void Session::setServer(Server* server)
@@ -71,12 +79,6 @@ void Session::start(Delegate* delegate)
         return;
     }
 
-    if (!relay_key_pool_)
-    {
-        LOG(LS_FATAL) << "Invalid relay key pool";
-        return;
-    }
-
     if (!database_factory_)
     {
         LOG(LS_FATAL) << "Invalid database factory";
@@ -108,6 +110,73 @@ std::unique_ptr<Database> Session::openDatabase() const
     return database_factory_->openDatabase();
 }
 
+void Session::postBlockingTask(std::function<void()> task, std::function<void()> reply)
+{
+    blocking_tasks_.push({ std::move(task), std::move(reply) });
+
+    if (!blocking_task_running_)
+        runBlockingTasks();
+}
+
+void Session::runBlockingTasks()
+{
+    std::shared_ptr<Session*> self = self_;
+
+    while (!blocking_tasks_.empty())
+    {
+        blocking_task_running_ = true;
+
+        if (blocking_tasks_.front().task && worker_pool_ && task_runner_)
+        {
+            std::function<void()> reply = [self]()
+            {
+                if (*self)
+                    (*self)->onBlockingTaskFinished();
+            };
+
+            if (worker_pool_->postTaskAndReply(
+                    blocking_tasks_.front().task, task_runner_, std::move(reply)))
+            {
+                return;
+            }
+
+            LOG(LS_WARNING) << "Worker pool is overloaded. The task is performed in place";
+        }
+
+        BlockingTask current = std::move(blocking_tasks_.front());
+        blocking_tasks_.pop();
+
+        if (current.task)
+            current.task();
+        current.reply();
+
+        // The reply can destroy the session.
+        if (!*self)
+            return;
+    }
+
+    blocking_task_running_ = false;
+}
+
+void Session::onBlockingTaskFinished()
+{
+    DCHECK(blocking_task_running_);
+    DCHECK(!blocking_tasks_.empty());
+
+    std::shared_ptr<Session*> self = self_;
+
+    BlockingTask current = std::move(blocking_tasks_.front());
+    blocking_tasks_.pop();
+
+    current.reply();
+
+    // The reply can destroy the session.
+    if (!*self)
+        return;
+
+    runBlockingTasks();
+}
+
 void Session::setVersion(const base::Version& version)
 {
     version_ = version;
@@ -140,7 +209,7 @@ std::chrono::seconds Session::duration() const
 void Session::sendMessage(const google::protobuf::MessageLite& message)
 {
     if (channel_)
-        channel_->send(base::serialize(message));
+        channel_->send(message);
 }
 
 void Session::onConnected()
@@ -156,4 +225,10 @@ void Session::onDisconnected(base::NetworkChannel::ErrorCode error_code)
         delegate_->onSessionFinished(session_id_, session_type_);
 }
 
+void Session::notifySessionUpdated()
+{
+    if (delegate_)
+        delegate_->onSessionUpdated(session_id_);
+}
+
 } // namespace router
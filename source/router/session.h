@@ -23,12 +23,19 @@
 #include "base/net/network_channel.h"
 #include "proto/router_common.pb.h"
 
+#include <functional>
+#include <queue>
+
+namespace base {
+class TaskRunner;
+class WorkerPool;
+} // namespace base
+
 namespace router {
 
 class Database;
 class DatabaseFactory;
 class Server;
-class SharedKeyPool;
 
 class Session : public base::NetworkChannel::Listener
 {
@@ -45,11 +52,15 @@ public:
 
         virtual void onSessionFinished(
             SessionId session_id, proto::RouterSession session_type) = 0;
+
+        // Called when the data shown in the session list (for example, host IDs) has changed.
+        virtual void onSessionUpdated(SessionId session_id) = 0;
     };
 
     void setChannel(std::unique_ptr<base::NetworkChannel> channel);
-    void setRelayKeyPool(std::unique_ptr<SharedKeyPool> relay_key_pool);
     void setDatabaseFactory(std::shared_ptr<DatabaseFactory> database_factory);
+    void setWorkerPool(std::shared_ptr<base::TaskRunner> task_runner,
+                       std::shared_ptr<base::WorkerPool> worker_pool);
     void setServer(Server* server);
 
     void start(Delegate* delegate);
@@ -72,6 +83,14 @@ public:
 protected:
     void sendMessage(const google::protobuf::MessageLite& message);
     std::unique_ptr<Database> openDatabase() const;
+    std::shared_ptr<DatabaseFactory> databaseFactory() const { return database_factory_; }
+
+    // Runs |task| in the worker pool and then |reply| on the thread of the session. |reply| is not
+    // called if the session is destroyed in the meantime. |task| must not access the session.
+    // Tasks of one session are run one at a time in the order they are posted, so the replies to
+    // the requests of a peer are sent in the order of the requests. If |task| is empty, then only
+    // |reply| is called after the earlier tasks.
+    void postBlockingTask(std::function<void()> task, std::function<void()> reply);
 
     virtual void onSessionReady() = 0;
 
@@ -79,20 +98,33 @@ protected:
     void onConnected() override;
     void onDisconnected(base::NetworkChannel::ErrorCode error_code) override;
 
-    SharedKeyPool& relayKeyPool() { return *relay_key_pool_; }
-    const SharedKeyPool& relayKeyPool() const { return *relay_key_pool_; }
+    void notifySessionUpdated();
 
     Server& server() { return *server_; }
     const Server& server() const { return *server_; }
 
 private:
+    struct BlockingTask
+    {
+        std::function<void()> task;
+        std::function<void()> reply;
+    };
+
+    void runBlockingTasks();
+    void onBlockingTaskFinished();
+
     const proto::RouterSession session_type_;
     const SessionId session_id_;
     time_t start_time_ = 0;
 
     std::unique_ptr<base::NetworkChannel> channel_;
     std::shared_ptr<DatabaseFactory> database_factory_;
-    std::unique_ptr<SharedKeyPool> relay_key_pool_;
+    std::shared_ptr<base::TaskRunner> task_runner_;
+    std::shared_ptr<base::WorkerPool> worker_pool_;
+    std::shared_ptr<Session*> self_;
+
+    std::queue<BlockingTask> blocking_tasks_;
+    bool blocking_task_running_ = false;
     Server* server_ = nullptr;
 
     std::string address_;
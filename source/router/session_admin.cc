@@ -23,6 +23,7 @@
 #include "base/net/network_channel.h"
 #include "base/peer/user.h"
 #include "router/database.h"
+#include "router/database_factory.h"
 #include "router/server.h"
 
 namespace router {
@@ -79,93 +80,122 @@ void SessionAdmin::onMessageWritten(size_t /* pending */)
 
 void SessionAdmin::doUserListRequest()
 {
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
-    {
-        LOG(LS_ERROR) << "Failed to connect to database";
-        return;
-    }
+    std::shared_ptr<proto::RouterToAdmin> message = std::make_shared<proto::RouterToAdmin>();
 
-    std::unique_ptr<proto::RouterToAdmin> message = std::make_unique<proto::RouterToAdmin>();
-    proto::UserList* list = message->mutable_user_list();
+    postBlockingTask([database_factory = databaseFactory(), message]()
+    {
+        std::unique_ptr<Database> database = database_factory->openDatabase();
+        if (!database)
+        {
+            LOG(LS_ERROR) << "Failed to connect to database";
+            return;
+        }
 
-    std::vector<base::User> users = database->userList();
-    for (const auto& user : users)
-        list->add_user()->CopyFrom(user.serialize());
+        proto::UserList* list = message->mutable_user_list();
 
-    sendMessage(*message);
+        std::vector<base::User> users = database->userList();
+        for (const auto& user : users)
+            list->add_user()->CopyFrom(user.serialize());
+    },
+    [this, message]()
+    {
+        if (message->has_user_list())
+            sendMessage(*message);
+    });
 }
 
 void SessionAdmin::doUserRequest(const proto::UserRequest& request)
 {
-    std::unique_ptr<proto::RouterToAdmin> message = std::make_unique<proto::RouterToAdmin>();
-    proto::UserResult* result = message->mutable_user_result();
-    result->set_type(request.type());
+    if (request.type() != proto::USER_REQUEST_ADD &&
+        request.type() != proto::USER_REQUEST_MODIFY &&
+        request.type() != proto::USER_REQUEST_DELETE)
+    {
+        LOG(LS_ERROR) << "Unknown request type: " << request.type();
+        return;
+    }
+
+    std::shared_ptr<proto::RouterToAdmin> message = std::make_shared<proto::RouterToAdmin>();
 
-    switch (request.type())
+    postBlockingTask([database_factory = databaseFactory(), request, message]()
     {
-        case proto::USER_REQUEST_ADD:
-            result->set_error_code(addUser(request.user()));
-            break;
+        proto::UserResult* result = message->mutable_user_result();
+        result->set_type(request.type());
 
-        case proto::USER_REQUEST_MODIFY:
-            result->set_error_code(modifyUser(request.user()));
-            break;
+        switch (request.type())
+        {
+            case proto::USER_REQUEST_ADD:
+                result->set_error_code(addUser(*database_factory, request.user()));
+                break;
 
-        case proto::USER_REQUEST_DELETE:
-            result->set_error_code(deleteUser(request.user()));
-            break;
+            case proto::USER_REQUEST_MODIFY:
+                result->set_error_code(modifyUser(*database_factory, request.user()));
+                break;
 
-        default:
-            LOG(LS_ERROR) << "Unknown request type: " << request.type();
-            return;
-    }
+            case proto::USER_REQUEST_DELETE:
+                result->set_error_code(deleteUser(*database_factory, request.user()));
+                break;
 
-    sendMessage(*message);
+            default:
+                NOTREACHED();
+                break;
+        }
+    },
+    [this, message]()
+    {
+        sendMessage(*message);
+    });
 }
 
-void SessionAdmin::doSessionListRequest(const proto::SessionListRequest& /* request */)
+void SessionAdmin::sendSessionList(const proto::SessionList& session_list)
 {
     std::unique_ptr<proto::RouterToAdmin> message = std::make_unique<proto::RouterToAdmin>();
+    message->mutable_session_list()->CopyFrom(session_list);
+    sendMessage(*message);
+}
 
-    message->set_allocated_session_list(server().sessionList().release());
-    if (!message->has_session_list())
-        message->mutable_session_list()->set_error_code(proto::SessionList::UNKNOWN_ERROR);
-
+void SessionAdmin::sendSessionListUpdate(const proto::SessionListUpdate& session_list_update)
+{
+    std::unique_ptr<proto::RouterToAdmin> message = std::make_unique<proto::RouterToAdmin>();
+    message->mutable_session_list_update()->CopyFrom(session_list_update);
     sendMessage(*message);
 }
 
-void SessionAdmin::doSessionRequest(const proto::SessionRequest& request)
+void SessionAdmin::sendSessionResult(const proto::SessionResult& session_result)
 {
     std::unique_ptr<proto::RouterToAdmin> message = std::make_unique<proto::RouterToAdmin>();
-    proto::SessionResult* session_result = message->mutable_session_result();
-    session_result->set_type(request.type());
+    message->mutable_session_result()->CopyFrom(session_result);
+    sendMessage(*message);
+}
+
+void SessionAdmin::doSessionListRequest(const proto::SessionListRequest& request)
+{
+    // The sessions are collected from all shards. The server replies with sendSessionList.
+    server().onSessionListRequest(sessionId(), request);
+}
 
+void SessionAdmin::doSessionRequest(const proto::SessionRequest& request)
+{
     if (request.type() == proto::SESSION_REQUEST_DISCONNECT)
     {
-        Session::SessionId session_id = request.session_id();
+        LOG(LS_INFO) << "Disconnect request for session '" << request.session_id()
+                     << "' from " << userName();
 
-        if (!server().stopSession(session_id))
-        {
-            LOG(LS_WARNING) << "Session not found: " << session_id;
-            session_result->set_error_code(proto::SessionResult::INVALID_SESSION_ID);
-        }
-        else
-        {
-            LOG(LS_INFO) << "Session '" << session_id << "' disconnected by " << userName();
-            session_result->set_error_code(proto::SessionResult::SUCCESS);
-        }
-    }
-    else
-    {
-        LOG(LS_WARNING) << "Unknown session request: " << request.type();
-        session_result->set_error_code(proto::SessionResult::INVALID_REQUEST);
+        // The server replies with sendSessionResult.
+        server().onStopSessionRequest(sessionId(), request.session_id());
+        return;
     }
 
-    sendMessage(*message);
+    LOG(LS_WARNING) << "Unknown session request: " << request.type();
+
+    proto::SessionResult session_result;
+    session_result.set_type(request.type());
+    session_result.set_error_code(proto::SessionResult::INVALID_REQUEST);
+    sendSessionResult(session_result);
 }
 
-proto::UserResult::ErrorCode SessionAdmin::addUser(const proto::User& user)
+// static
+proto::UserResult::ErrorCode SessionAdmin::addUser(
+    const DatabaseFactory& database_factory, const proto::User& user)
 {
     LOG(LS_INFO) << "User add request: " << user.name();
 
@@ -182,7 +212,7 @@ proto::UserResult::ErrorCode SessionAdmin::addUser(const proto::User& user)
         return proto::UserResult::INVALID_DATA;
     }
 
-    std::unique_ptr<Database> database = openDatabase();
+    std::unique_ptr<Database> database = database_factory.openDatabase();
     if (!database)
     {
         LOG(LS_ERROR) << "Failed to connect to database";
@@ -195,7 +225,9 @@ proto::UserResult::ErrorCode SessionAdmin::addUser(const proto::User& user)
     return proto::UserResult::SUCCESS;
 }
 
-proto::UserResult::ErrorCode SessionAdmin::modifyUser(const proto::User& user)
+// static
+proto::UserResult::ErrorCode SessionAdmin::modifyUser(
+    const DatabaseFactory& database_factory, const proto::User& user)
 {
     LOG(LS_INFO) << "User modify request: " << user.name();
 
@@ -218,7 +250,7 @@ proto::UserResult::ErrorCode SessionAdmin::modifyUser(const proto::User& user)
         return proto::UserResult::INVALID_DATA;
     }
 
-    std::unique_ptr<Database> database = openDatabase();
+    std::unique_ptr<Database> database = database_factory.openDatabase();
     if (!database)
     {
         LOG(LS_ERROR) << "Failed to connect to database";
@@ -231,9 +263,11 @@ proto::UserResult::ErrorCode SessionAdmin::modifyUser(const proto::User& user)
     return proto::UserResult::SUCCESS;
 }
 
-proto::UserResult::ErrorCode SessionAdmin::deleteUser(const proto::User& user)
+// static
+proto::UserResult::ErrorCode SessionAdmin::deleteUser(
+    const DatabaseFactory& database_factory, const proto::User& user)
 {
-    std::unique_ptr<Database> database = openDatabase();
+    std::unique_ptr<Database> database = database_factory.openDatabase();
     if (!database)
     {
         LOG(LS_ERROR) << "Failed to connect to database";
@@ -32,6 +32,10 @@ public:
     SessionAdmin();
     ~SessionAdmin();
 
+    void sendSessionList(const proto::SessionList& session_list);
+    void sendSessionListUpdate(const proto::SessionListUpdate& session_list_update);
+    void sendSessionResult(const proto::SessionResult& session_result);
+
 protected:
     // Session implementation.
     void onSessionReady() override;
@@ -46,9 +50,13 @@ private:
     void doSessionListRequest(const proto::SessionListRequest& request);
     void doSessionRequest(const proto::SessionRequest& request);
 
-    proto::UserResult::ErrorCode addUser(const proto::User& user);
-    proto::UserResult::ErrorCode modifyUser(const proto::User& user);
-    proto::UserResult::ErrorCode deleteUser(const proto::User& user);
+    // Called in the worker pool.
+    static proto::UserResult::ErrorCode addUser(
+        const DatabaseFactory& database_factory, const proto::User& user);
+    static proto::UserResult::ErrorCode modifyUser(
+        const DatabaseFactory& database_factory, const proto::User& user);
+    static proto::UserResult::ErrorCode deleteUser(
+        const DatabaseFactory& database_factory, const proto::User& user);
 
     DISALLOW_COPY_AND_ASSIGN(SessionAdmin);
 };
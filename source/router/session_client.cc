@@ -19,11 +19,7 @@
 #include "router/session_client.h"
 
 #include "base/logging.h"
-#include "base/crypto/random.h"
-#include "base/strings/unicode.h"
 #include "router/server.h"
-#include "router/session_host.h"
-#include "router/session_relay.h"
 
 namespace router {
 
@@ -64,69 +60,19 @@ void SessionClient::onMessageWritten(size_t /* pending */)
     // Nothing
 }
 
-void SessionClient::readConnectionRequest(const proto::ConnectionRequest& request)
+void SessionClient::sendConnectionOffer(const proto::ConnectionOffer& offer)
 {
-    LOG(LS_INFO) << "New connection request (host_id: " << request.host_id() << ")";
-
     std::unique_ptr<proto::RouterToPeer> message = std::make_unique<proto::RouterToPeer>();
-    proto::ConnectionOffer* offer = message->mutable_connection_offer();
-
-    SessionHost* host = server().hostSessionById(request.host_id());
-    if (!host)
-    {
-        LOG(LS_WARNING) << "Host with id " << request.host_id() << " NOT found!";
-        offer->set_error_code(proto::ConnectionOffer::PEER_NOT_FOUND);
-    }
-    else
-    {
-        LOG(LS_INFO) << "Host with id " << request.host_id() << " found";
-
-        std::optional<SharedKeyPool::Credentials> credentials = relayKeyPool().takeCredentials();
-        if (!credentials.has_value())
-        {
-            LOG(LS_WARNING) << "Empty key pool";
-            offer->set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
-        }
-        else
-        {
-            SessionRelay* relay = static_cast<SessionRelay*>(
-                server().sessionById(credentials->session_id));
-            if (!relay)
-            {
-                LOG(LS_ERROR) << "No relay with session id " << credentials->session_id;
-                offer->set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
-            }
-            else
-            {
-                const std::optional<SessionRelay::PeerData>& peer_data = relay->peerData();
-                if (!peer_data.has_value())
-                {
-                    LOG(LS_ERROR) << "No peer data for relay with session id "
-                                  << credentials->session_id;
-                    offer->set_error_code(proto::ConnectionOffer::KEY_POOL_EMPTY);
-                }
-                else
-                {
-                    offer->set_error_code(proto::ConnectionOffer::SUCCESS);
-
-                    proto::RelayCredentials* offer_credentials = offer->mutable_relay();
-
-                    offer_credentials->set_host(relay->peerData()->first);
-                    offer_credentials->set_port(relay->peerData()->second);
-                    offer_credentials->mutable_key()->Swap(&credentials->key);
-                    offer_credentials->set_secret(base::Random::string(16));
+    message->mutable_connection_offer()->CopyFrom(offer);
+    sendMessage(*message);
+}
 
-                    LOG(LS_INFO) << "Sending connection offer to host";
-                    offer->set_peer_role(proto::ConnectionOffer::HOST);
-                    host->sendConnectionOffer(*offer);
-                }
-            }
-        }
-    }
+void SessionClient::readConnectionRequest(const proto::ConnectionRequest& request)
+{
+    LOG(LS_INFO) << "New connection request (host_id: " << request.host_id() << ")";
 
-    LOG(LS_INFO) << "Sending connection offer to client";
-    offer->set_peer_role(proto::ConnectionOffer::CLIENT);
-    sendMessage(*message);
+    // The host may be served by another shard. The server sends the offer to both peers.
+    server().onConnectionRequest(sessionId(), request.host_id());
 }
 
 } // namespace router
@@ -25,7 +25,6 @@
 namespace router {
 
 class ServerProxy;
-class SharedKeyPool;
 
 class SessionClient : public Session
 {
@@ -33,6 +32,8 @@ public:
     SessionClient();
     ~SessionClient();
 
+    void sendConnectionOffer(const proto::ConnectionOffer& offer);
+
 protected:
     // Session implementation.
     void onSessionReady() override;
@@ -24,6 +24,7 @@
 #include "base/crypto/random.h"
 #include "base/net/network_channel.h"
 #include "router/database.h"
+#include "router/database_factory.h"
 #include "router/server.h"
 
 namespace router {
@@ -32,6 +33,50 @@ namespace {
 
 const size_t kHostKeySize = 512;
 
+// Returns the ID of the host for the request. For a new host, the generated key is stored in |key|.
+base::HostId resolveHostId(const DatabaseFactory& database_factory,
+                           const proto::HostIdRequest& host_id_request,
+                           std::string* key)
+{
+    std::unique_ptr<Database> database = database_factory.openDatabase();
+    if (!database)
+    {
+        LOG(LS_ERROR) << "Failed to connect to database";
+        return base::kInvalidHostId;
+    }
+
+    base::ByteArray key_hash;
+
+    if (host_id_request.type() == proto::HostIdRequest::NEW_ID)
+    {
+        // Generate new key.
+        *key = base::Random::string(kHostKeySize);
+
+        // Calculate hash for key.
+        key_hash = base::GenericHash::hash(base::GenericHash::Type::BLAKE2b512, *key);
+
+        if (!database->addHost(key_hash))
+        {
+            LOG(LS_ERROR) << "Unable to add host";
+            return base::kInvalidHostId;
+        }
+    }
+    else
+    {
+        DCHECK_EQ(host_id_request.type(), proto::HostIdRequest::EXISTING_ID);
+
+        // Using existing key.
+        key_hash = base::GenericHash::hash(
+            base::GenericHash::Type::BLAKE2b512, host_id_request.key());
+    }
+
+    base::HostId host_id = database->hostId(key_hash);
+    if (host_id == base::kInvalidHostId)
+        LOG(LS_ERROR) << "Failed to get host ID";
+
+    return host_id;
+}
+
 } // namespace
 
 SessionHost::SessionHost()
@@ -89,56 +134,48 @@ void SessionHost::onMessageWritten(size_t /* pending */)
 
 void SessionHost::readHostIdRequest(const proto::HostIdRequest& host_id_request)
 {
-    std::unique_ptr<Database> database = openDatabase();
-    if (!database)
+    if (host_id_request.type() != proto::HostIdRequest::NEW_ID &&
+        host_id_request.type() != proto::HostIdRequest::EXISTING_ID)
     {
-        LOG(LS_ERROR) << "Failed to connect to database";
+        LOG(LS_ERROR) << "Unknown request type: " << host_id_request.type();
         return;
     }
 
-    std::unique_ptr<proto::RouterToPeer> message = std::make_unique<proto::RouterToPeer>();
-    proto::HostIdResponse* host_id_response = message->mutable_host_id_response();
-    base::ByteArray key_hash;
-
-    if (host_id_request.type() == proto::HostIdRequest::NEW_ID)
+    struct Result
     {
-        // Generate new key.
-        std::string key = base::Random::string(kHostKeySize);
+        base::HostId host_id = base::kInvalidHostId;
+        std::string key;
+    };
 
-        // Calculate hash for key.
-        key_hash = base::GenericHash::hash(base::GenericHash::Type::BLAKE2b512, key);
+    std::shared_ptr<Result> result = std::make_shared<Result>();
 
-        if (!database->addHost(key_hash))
-        {
-            LOG(LS_ERROR) << "Unable to add host";
-            return;
-        }
-
-        host_id_response->set_key(std::move(key));
-    }
-    else if (host_id_request.type() == proto::HostIdRequest::EXISTING_ID)
+    // Hashing of the key and the database requests are performed outside of the network thread.
+    postBlockingTask([database_factory = databaseFactory(), host_id_request, result]()
     {
-        // Using existing key.
-        key_hash = base::GenericHash::hash(
-            base::GenericHash::Type::BLAKE2b512, host_id_request.key());
-    }
-    else
+        result->host_id = resolveHostId(*database_factory, host_id_request, &result->key);
+    },
+    [this, result]()
     {
-        LOG(LS_ERROR) << "Unknown request type: " << host_id_request.type();
-        return;
-    }
+        onHostIdResolved(result->host_id, std::move(result->key));
+    });
+}
 
-    base::HostId host_id = database->hostId(key_hash);
+void SessionHost::onHostIdResolved(base::HostId host_id, std::string&& key)
+{
     if (host_id == base::kInvalidHostId)
-    {
-        LOG(LS_ERROR) << "Failed to get host ID";
         return;
-    }
 
     host_id_list_.emplace_back(host_id);
 
     // Notify the server that the ID has been assigned.
-    server().onHostSessionWithId(this);
+    server().onHostSessionWithId(sessionId(), host_id);
+    notifySessionUpdated();
+
+    std::unique_ptr<proto::RouterToPeer> message = std::make_unique<proto::RouterToPeer>();
+    proto::HostIdResponse* host_id_response = message->mutable_host_id_response();
+
+    if (!key.empty())
+        host_id_response->set_key(std::move(key));
 
     host_id_response->set_host_id(host_id);
     sendMessage(*message);
@@ -153,6 +190,15 @@ void SessionHost::readResetHostId(const proto::ResetHostId& reset_host_id)
         return;
     }
 
+    // The ID can be added to the list by a host ID request that is still in progress.
+    postBlockingTask(nullptr, [this, host_id]()
+    {
+        resetHostId(host_id);
+    });
+}
+
+void SessionHost::resetHostId(base::HostId host_id)
+{
     if (host_id_list_.empty())
     {
         LOG(LS_ERROR) << "Empty host ID list";
@@ -165,6 +211,8 @@ void SessionHost::readResetHostId(const proto::ResetHostId& reset_host_id)
         {
             LOG(LS_INFO) << "Host ID " << host_id << " remove from list";
             host_id_list_.erase(it);
+            server().onHostSessionIdReset(sessionId(), host_id);
+            notifySessionUpdated();
             return;
         }
     }
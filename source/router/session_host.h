@@ -50,7 +50,9 @@ protected:
 
 private:
     void readHostIdRequest(const proto::HostIdRequest& host_id_request);
+    void onHostIdResolved(base::HostId host_id, std::string&& key);
     void readResetHostId(const proto::ResetHostId& reset_host_id);
+    void resetHostId(base::HostId host_id);
 
     HostIdList host_id_list_;
 
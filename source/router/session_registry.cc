@@ -0,0 +1,122 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/session_registry.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace router {
+
+namespace {
+
+void eraseHostId(std::vector<base::HostId>* host_ids, base::HostId host_id)
+{
+    host_ids->erase(std::remove(host_ids->begin(), host_ids->end(), host_id), host_ids->end());
+}
+
+} // namespace
+
+SessionRegistry::SessionRegistry() = default;
+
+SessionRegistry::~SessionRegistry() = default;
+
+void SessionRegistry::add(Session::SessionId session_id, size_t shard_index)
+{
+    sessions_.emplace(session_id, Entry{ shard_index, {} });
+}
+
+bool SessionRegistry::remove(Session::SessionId session_id)
+{
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end())
+        return false;
+
+    for (const auto& host_id : it->second.host_ids)
+        hosts_.erase(host_id);
+
+    sessions_.erase(it);
+    return true;
+}
+
+std::optional<size_t> SessionRegistry::shard(Session::SessionId session_id) const
+{
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end())
+        return std::nullopt;
+
+    return it->second.shard_index;
+}
+
+std::optional<Session::SessionId> SessionRegistry::hostSession(base::HostId host_id) const
+{
+    auto it = hosts_.find(host_id);
+    if (it == hosts_.end())
+        return std::nullopt;
+
+    return it->second;
+}
+
+std::optional<Session::SessionId> SessionRegistry::addHostId(
+    Session::SessionId session_id, base::HostId host_id)
+{
+    auto entry = sessions_.find(session_id);
+    if (entry == sessions_.end())
+    {
+        LOG(LS_ERROR) << "Session " << session_id << " is not registered";
+        return std::nullopt;
+    }
+
+    std::optional<Session::SessionId> previous_session_id;
+
+    auto result = hosts_.try_emplace(host_id, session_id);
+    if (!result.second)
+    {
+        if (result.first->second == session_id)
+        {
+            // The ID is already bound to this session.
+            return std::nullopt;
+        }
+
+        previous_session_id = result.first->second;
+        result.first->second = session_id;
+
+        auto previous_entry = sessions_.find(*previous_session_id);
+        if (previous_entry != sessions_.end())
+            eraseHostId(&previous_entry->second.host_ids, host_id);
+    }
+
+    entry->second.host_ids.emplace_back(host_id);
+    return previous_session_id;
+}
+
+void SessionRegistry::removeHostId(Session::SessionId session_id, base::HostId host_id)
+{
+    auto it = hosts_.find(host_id);
+    if (it == hosts_.end() || it->second != session_id)
+        return;
+
+    hosts_.erase(it);
+
+    auto entry = sessions_.find(session_id);
+    if (entry != sessions_.end())
+        eraseHostId(&entry->second.host_ids, host_id);
+}
+
+} // namespace router
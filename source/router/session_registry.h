@@ -0,0 +1,77 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__SESSION_REGISTRY_H
+#define ROUTER__SESSION_REGISTRY_H
+
+#include "base/macros_magic.h"
+#include "base/peer/host_id.h"
+#include "router/session.h"
+
+#include <optional>
+#include <unordered_map>
+
+namespace router {
+
+// Index of all router sessions. For each session it keeps the shard that owns the session and,
+// for host sessions, the IDs of hosts. The sessions themselves are owned by the shards. All
+// lookups are O(1).
+class SessionRegistry
+{
+public:
+    SessionRegistry();
+    ~SessionRegistry();
+
+    void add(Session::SessionId session_id, size_t shard_index);
+
+    // Removes the session and all its host IDs from the registry. Returns false if the session is
+    // not found.
+    bool remove(Session::SessionId session_id);
+
+    std::optional<size_t> shard(Session::SessionId session_id) const;
+    std::optional<Session::SessionId> hostSession(base::HostId host_id) const;
+
+    // Binds |host_id| to the session. If the ID was bound to another session, then the ID is moved
+    // and the ID of the previous session is returned.
+    std::optional<Session::SessionId> addHostId(Session::SessionId session_id,
+                                                base::HostId host_id);
+
+    // Removes |host_id| if it is bound to the session.
+    void removeHostId(Session::SessionId session_id, base::HostId host_id);
+
+    size_t count() const { return sessions_.size(); }
+    size_t hostIdCount() const { return hosts_.size(); }
+
+private:
+    struct Entry
+    {
+        size_t shard_index;
+
+        // Host IDs bound to the session. A host has a few IDs, so a vector is enough.
+        std::vector<base::HostId> host_ids;
+    };
+
+    std::unordered_map<Session::SessionId, Entry> sessions_;
+    std::unordered_map<base::HostId, Session::SessionId> hosts_;
+
+    DISALLOW_COPY_AND_ASSIGN(SessionRegistry);
+};
+
+} // namespace router
+
+#endif // ROUTER__SESSION_REGISTRY_H
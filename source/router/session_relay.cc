@@ -19,7 +19,7 @@
 #include "router/session_relay.h"
 
 #include "base/logging.h"
-#include "router/shared_key_pool.h"
+#include "router/server.h"
 
 namespace router {
 
@@ -29,16 +29,16 @@ SessionRelay::SessionRelay()
     // Nothing
 }
 
-SessionRelay::~SessionRelay()
-{
-    relayKeyPool().removeKeysForRelay(sessionId());
-}
+SessionRelay::~SessionRelay() = default;
 
 void SessionRelay::sendKeyUsed(uint32_t key_id)
 {
     std::unique_ptr<proto::RouterToRelay> message = std::make_unique<proto::RouterToRelay>();
     message->mutable_key_used()->set_key_id(key_id);
     sendMessage(*message);
+
+    if (pool_size_ > 0)
+        --pool_size_;
 }
 
 void SessionRelay::onSessionReady()
@@ -60,6 +60,14 @@ void SessionRelay::onMessageReceived(const base::ByteArray& buffer)
     {
         readKeyPool(message->key_pool());
     }
+    else if (message->has_relay_stat())
+    {
+        relay_stat_.Swap(message->mutable_relay_stat());
+    }
+    else if (message->has_relay_load())
+    {
+        readRelayLoad(message->relay_load());
+    }
     else
     {
         LOG(LS_WARNING) << "Unhandled message from relay server";
@@ -73,15 +81,26 @@ void SessionRelay::onMessageWritten(size_t /* pending */)
 
 void SessionRelay::readKeyPool(const proto::RelayKeyPool& key_pool)
 {
-    SharedKeyPool& pool = relayKeyPool();
-
     LOG(LS_INFO) << "Received key pool: " << key_pool.key_size() << " (" << address() << ")";
 
     peer_data_.emplace(std::make_pair(
         key_pool.peer_host(), static_cast<uint16_t>(key_pool.peer_port())));
+    pool_size_ += static_cast<size_t>(key_pool.key_size());
+
+    server().onRelayKeyPool(sessionId(), key_pool);
+    notifySessionUpdated();
+}
+
+void SessionRelay::readRelayLoad(const proto::RelayLoad& relay_load)
+{
+    relay_load_ = relay_load;
+
+    SharedKeyPool::Load load;
+    load.active_sessions = relay_load.active_sessions();
+    load.throughput = relay_load.rx_rate() + relay_load.tx_rate();
 
-    for (int i = 0; i < key_pool.key_size(); ++i)
-        pool.addKey(sessionId(), key_pool.key(i));
+    server().onRelayLoad(sessionId(), load);
+    notifySessionUpdated();
 }
 
 } // namespace router
@@ -34,6 +34,11 @@ public:
     using PeerData = std::pair<std::string, uint16_t>;
 
     const std::optional<PeerData>& peerData() const { return peer_data_; }
+    const proto::RelayStat& relayStat() const { return relay_stat_; }
+    const proto::RelayLoad& relayLoad() const { return relay_load_; }
+
+    // Number of keys of the relay that are in the pool of the server.
+    size_t poolSize() const { return pool_size_; }
     void sendKeyUsed(uint32_t key_id);
 
 protected:
@@ -46,8 +51,16 @@ protected:
 
 private:
     void readKeyPool(const proto::RelayKeyPool& key_pool);
+    void readRelayLoad(const proto::RelayLoad& relay_load);
 
     std::optional<PeerData> peer_data_;
+    size_t pool_size_ = 0;
+
+    // The last statistics of peer sessions received from the relay.
+    proto::RelayStat relay_stat_;
+
+    // The last load reported by the relay.
+    proto::RelayLoad relay_load_;
 
     DISALLOW_COPY_AND_ASSIGN(SessionRelay);
 };
@@ -52,6 +52,11 @@ void Settings::reset()
     setPort(DEFAULT_ROUTER_TCP_PORT);
     setPrivateKey(base::ByteArray());
     setMinLogLevel(1);
+    setWorkerThreadCount(0);
+    setWorkerQueueSize(1024);
+    setMaxPendingHandshakes(256);
+    setHandshakesPerMinute(120);
+    setMaxAddressHandshakes(8);
     setClientWhiteList(WhiteList());
     setHostWhiteList(WhiteList());
     setAdminWhiteList(WhiteList());
@@ -93,6 +98,66 @@ int Settings::minLogLevel() const
     return impl_.get<int>("MinLogLevel", 1);
 }
 
+void Settings::setWorkerThreadCount(uint32_t count)
+{
+    impl_.set<uint32_t>("WorkerThreadCount", count);
+}
+
+uint32_t Settings::workerThreadCount() const
+{
+    return impl_.get<uint32_t>("WorkerThreadCount", 0);
+}
+
+void Settings::setWorkerQueueSize(uint32_t size)
+{
+    impl_.set<uint32_t>("WorkerQueueSize", size);
+}
+
+uint32_t Settings::workerQueueSize() const
+{
+    return impl_.get<uint32_t>("WorkerQueueSize", 1024);
+}
+
+void Settings::setShardCount(uint32_t count)
+{
+    impl_.set<uint32_t>("ShardCount", count);
+}
+
+uint32_t Settings::shardCount() const
+{
+    return impl_.get<uint32_t>("ShardCount", 0);
+}
+
+void Settings::setMaxPendingHandshakes(uint32_t count)
+{
+    impl_.set<uint32_t>("MaxPendingHandshakes", count);
+}
+
+uint32_t Settings::maxPendingHandshakes() const
+{
+    return impl_.get<uint32_t>("MaxPendingHandshakes", 256);
+}
+
+void Settings::setHandshakesPerMinute(uint32_t count)
+{
+    impl_.set<uint32_t>("HandshakesPerMinute", count);
+}
+
+uint32_t Settings::handshakesPerMinute() const
+{
+    return impl_.get<uint32_t>("HandshakesPerMinute", 120);
+}
+
+void Settings::setMaxAddressHandshakes(uint32_t count)
+{
+    impl_.set<uint32_t>("MaxAddressHandshakes", count);
+}
+
+uint32_t Settings::maxAddressHandshakes() const
+{
+    return impl_.get<uint32_t>("MaxAddressHandshakes", 8);
+}
+
 void Settings::setClientWhiteList(const std::vector<std::u16string>& list)
 {
     setWhiteList("ClientWhiteList", list);
@@ -43,6 +43,32 @@ public:
     void setMinLogLevel(int level);
     int minLogLevel() const;
 
+    // Number of threads for database requests and authentication. 0 means the number of
+    // processor threads.
+    void setWorkerThreadCount(uint32_t count);
+    uint32_t workerThreadCount() const;
+
+    void setWorkerQueueSize(uint32_t size);
+    uint32_t workerQueueSize() const;
+
+    // Number of network threads. Each thread accepts connections on its own socket bound to the
+    // same port (SO_REUSEPORT), so it is used only on Linux. 0 means the number of processor
+    // threads.
+    void setShardCount(uint32_t count);
+    uint32_t shardCount() const;
+
+    // Maximum number of authentications in progress for the whole router. 0 means no limit.
+    void setMaxPendingHandshakes(uint32_t count);
+    uint32_t maxPendingHandshakes() const;
+
+    // Number of new connections per minute allowed from one address. 0 means no limit.
+    void setHandshakesPerMinute(uint32_t count);
+    uint32_t handshakesPerMinute() const;
+
+    // Maximum number of authentications in progress from one address. 0 means no limit.
+    void setMaxAddressHandshakes(uint32_t count);
+    uint32_t maxAddressHandshakes() const;
+
     using WhiteList = std::vector<std::u16string>;
 
     void setClientWhiteList(const WhiteList& list);
@@ -0,0 +1,429 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "router/shard.h"
+
+#include "base/logging.h"
+#include "base/task_runner.h"
+#include "base/net/network_channel.h"
+#include "base/peer/user_list_base.h"
+#include "build/build_config.h"
+#include "router/server.h"
+#include "router/session_admin.h"
+#include "router/session_client.h"
+#include "router/session_host.h"
+#include "router/session_relay.h"
+#include "router/user_list_db.h"
+
+namespace router {
+
+namespace {
+
+const char* sessionTypeToString(proto::RouterSession session_type)
+{
+    switch (session_type)
+    {
+        case proto::ROUTER_SESSION_CLIENT:
+            return "ROUTER_SESSION_CLIENT";
+
+        case proto::ROUTER_SESSION_HOST:
+            return "ROUTER_SESSION_HOST";
+
+        case proto::ROUTER_SESSION_ADMIN:
+            return "ROUTER_SESSION_ADMIN";
+
+        case proto::ROUTER_SESSION_RELAY:
+            return "ROUTER_SESSION_RELAY";
+
+        default:
+            return "ROUTER_SESSION_UNKNOWN";
+    }
+}
+
+void sessionToProto(const Session& session, proto::Session* item)
+{
+    item->set_session_id(session.sessionId());
+    item->set_session_type(session.sessionType());
+    item->set_timepoint(session.startTime());
+    item->set_ip_address(session.address());
+    item->mutable_version()->CopyFrom(session.version().toProto());
+    item->set_os_name(session.osName());
+    item->set_computer_name(session.computerName());
+
+    switch (session.sessionType())
+    {
+        case proto::ROUTER_SESSION_HOST:
+        {
+            proto::HostSessionData session_data;
+
+            for (const auto& host_id : static_cast<const SessionHost&>(session).hostIdList())
+                session_data.add_host_id(host_id);
+
+            item->set_session_data(session_data.SerializeAsString());
+        }
+        break;
+
+        case proto::ROUTER_SESSION_RELAY:
+        {
+            const SessionRelay& relay = static_cast<const SessionRelay&>(session);
+
+            proto::RelaySessionData session_data;
+            session_data.set_pool_size(relay.poolSize());
+            session_data.mutable_peer_stat()->CopyFrom(relay.relayStat().peer_stat());
+            session_data.mutable_load()->CopyFrom(relay.relayLoad());
+            item->set_session_data(session_data.SerializeAsString());
+        }
+        break;
+
+        default:
+            break;
+    }
+}
+
+} // namespace
+
+Shard::Shard(size_t shard_index,
+             bool reuse_port,
+             uint16_t port,
+             const base::ByteArray& private_key,
+             Server* server,
+             std::shared_ptr<DatabaseFactory> database_factory,
+             std::shared_ptr<base::WorkerPool> worker_pool,
+             std::shared_ptr<base::HandshakeLimiter> handshake_limiter)
+    : shard_index_(shard_index),
+      reuse_port_(reuse_port),
+      port_(port),
+      private_key_(private_key),
+      server_(server),
+      database_factory_(std::move(database_factory)),
+      worker_pool_(std::move(worker_pool)),
+      handshake_limiter_(std::move(handshake_limiter))
+{
+    DCHECK(server_ && database_factory_ && handshake_limiter_);
+}
+
+Shard::~Shard()
+{
+    thread_.stop();
+}
+
+void Shard::start()
+{
+    thread_.start(base::MessageLoop::Type::ASIO, this);
+    task_runner_ = thread_.taskRunner();
+    DCHECK(task_runner_);
+}
+
+void Shard::stop()
+{
+    thread_.stop();
+}
+
+void Shard::sendConnectionOffer(Session::SessionId session_id,
+                                const proto::ConnectionOffer& offer)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(std::bind(&Shard::sendConnectionOffer, this, session_id, offer));
+        return;
+    }
+
+    Session* target = session(session_id);
+    if (!target)
+    {
+        LOG(LS_WARNING) << "Session " << session_id << " not found. Connection offer dropped";
+        return;
+    }
+
+    switch (target->sessionType())
+    {
+        case proto::ROUTER_SESSION_HOST:
+            static_cast<SessionHost*>(target)->sendConnectionOffer(offer);
+            break;
+
+        case proto::ROUTER_SESSION_CLIENT:
+            static_cast<SessionClient*>(target)->sendConnectionOffer(offer);
+            break;
+
+        default:
+            LOG(LS_ERROR) << "Unexpected session type: " << target->sessionType();
+            break;
+    }
+}
+
+void Shard::sendKeyUsed(Session::SessionId session_id, uint32_t key_id)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(std::bind(&Shard::sendKeyUsed, this, session_id, key_id));
+        return;
+    }
+
+    Session* target = session(session_id);
+    if (target && target->sessionType() == proto::ROUTER_SESSION_RELAY)
+        static_cast<SessionRelay*>(target)->sendKeyUsed(key_id);
+}
+
+void Shard::sendSessionList(Session::SessionId session_id,
+                            std::shared_ptr<proto::SessionList> session_list)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(
+            std::bind(&Shard::sendSessionList, this, session_id, std::move(session_list)));
+        return;
+    }
+
+    Session* target = session(session_id);
+    if (target && target->sessionType() == proto::ROUTER_SESSION_ADMIN)
+        static_cast<SessionAdmin*>(target)->sendSessionList(*session_list);
+}
+
+void Shard::sendSessionListUpdate(Session::SessionId session_id,
+                                  std::shared_ptr<proto::SessionListUpdate> session_list_update)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(std::bind(
+            &Shard::sendSessionListUpdate, this, session_id, std::move(session_list_update)));
+        return;
+    }
+
+    Session* target = session(session_id);
+    if (target && target->sessionType() == proto::ROUTER_SESSION_ADMIN)
+        static_cast<SessionAdmin*>(target)->sendSessionListUpdate(*session_list_update);
+}
+
+void Shard::sendSessionResult(Session::SessionId session_id, const proto::SessionResult& result)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(std::bind(&Shard::sendSessionResult, this, session_id, result));
+        return;
+    }
+
+    Session* target = session(session_id);
+    if (target && target->sessionType() == proto::ROUTER_SESSION_ADMIN)
+        static_cast<SessionAdmin*>(target)->sendSessionResult(result);
+}
+
+void Shard::stopSession(Session::SessionId session_id)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(std::bind(&Shard::stopSession, this, session_id));
+        return;
+    }
+
+    removeSession(session_id);
+}
+
+void Shard::collectSessionList(uint64_t request_id, const proto::SessionListRequest& request)
+{
+    if (!task_runner_->belongsToCurrentThread())
+    {
+        task_runner_->postTask(
+            std::bind(&Shard::collectSessionList, this, request_id, request));
+        return;
+    }
+
+    std::shared_ptr<proto::SessionList> session_list = std::make_shared<proto::SessionList>();
+
+    const uint32_t session_types = request.session_types();
+    const int page_size = static_cast<int>(request.page_size());
+
+    for (auto it = sessions_.upper_bound(request.cursor()); it != sessions_.end(); ++it)
+    {
+        const Session& session = *it->second;
+
+        if (session_types && !(session_types & session.sessionType()))
+            continue;
+
+        if (page_size && session_list->session_size() == page_size)
+        {
+            session_list->set_next_cursor(session_list->session(page_size - 1).session_id());
+            break;
+        }
+
+        sessionToProto(session, session_list->add_session());
+    }
+
+    server_->onShardSessionList(request_id, std::move(session_list));
+}
+
+void Shard::onBeforeThreadRunning()
+{
+    std::shared_ptr<base::TaskRunner> task_runner = thread_.taskRunner();
+
+    authenticator_manager_ = std::make_unique<base::ServerAuthenticatorManager>(task_runner, this);
+    authenticator_manager_->setPrivateKey(private_key_);
+    authenticator_manager_->setUserList(UserListDb::open(*database_factory_));
+    authenticator_manager_->setAnonymousAccess(
+        base::ServerAuthenticator::AnonymousAccess::ENABLE,
+        proto::ROUTER_SESSION_HOST | proto::ROUTER_SESSION_RELAY);
+    authenticator_manager_->setWorkerPool(worker_pool_);
+    authenticator_manager_->setHandshakeLimiter(handshake_limiter_);
+
+    network_server_ = std::make_unique<base::NetworkServer>();
+#if defined(OS_LINUX)
+    network_server_->setReusePort(reuse_port_);
+#else
+    DCHECK(!reuse_port_);
+#endif // defined(OS_LINUX)
+    network_server_->start(port_, this);
+
+    LOG(LS_INFO) << "Shard #" << shard_index_ << " started";
+}
+
+void Shard::onAfterThreadRunning()
+{
+    network_server_.reset();
+    authenticator_manager_.reset();
+
+    // The server is being destroyed, it is not notified about the sessions.
+    sessions_.clear();
+
+    LOG(LS_INFO) << "Shard #" << shard_index_ << " stopped";
+}
+
+void Shard::onNewConnection(std::unique_ptr<base::NetworkChannel> channel)
+{
+    LOG(LS_INFO) << "New connection: " << channel->peerAddress() << " (shard #"
+                 << shard_index_ << ")";
+
+    channel->setOwnKeepAlive(true);
+    channel->setNoDelay(true);
+
+    if (authenticator_manager_)
+        authenticator_manager_->addNewChannel(std::move(channel));
+}
+
+void Shard::onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info)
+{
+    std::u16string address = session_info.channel->peerAddress();
+    proto::RouterSession session_type =
+        static_cast<proto::RouterSession>(session_info.session_type);
+
+    LOG(LS_INFO) << "New session: " << sessionTypeToString(session_type) << " (" << address << ")";
+
+    std::unique_ptr<Session> session;
+
+    if (server_->isSessionAllowed(session_type, address))
+    {
+        switch (session_type)
+        {
+            case proto::ROUTER_SESSION_CLIENT:
+                session = std::make_unique<SessionClient>();
+                break;
+
+            case proto::ROUTER_SESSION_HOST:
+                session = std::make_unique<SessionHost>();
+                break;
+
+            case proto::ROUTER_SESSION_ADMIN:
+                session = std::make_unique<SessionAdmin>();
+                break;
+
+            case proto::ROUTER_SESSION_RELAY:
+                session = std::make_unique<SessionRelay>();
+                break;
+
+            default:
+            {
+                LOG(LS_ERROR) << "Unsupported session type: "
+                              << static_cast<int>(session_info.session_type);
+            }
+            break;
+        }
+    }
+
+    if (!session)
+    {
+        LOG(LS_ERROR) << "Connection rejected for '" << address << "'";
+        return;
+    }
+
+    session->setChannel(std::move(session_info.channel));
+    session->setDatabaseFactory(database_factory_);
+    session->setWorkerPool(thread_.taskRunner(), worker_pool_);
+    session->setServer(server_);
+    session->setVersion(session_info.version);
+    session->setOsName(session_info.os_name);
+    session->setComputerName(session_info.computer_name);
+
+    Session* session_ptr = session.get();
+    Session::SessionId session_id = session->sessionId();
+
+    sessions_.emplace(session_id, std::move(session));
+
+    // The server learns about the session before any request from it.
+    server_->onSessionStarted(shard_index_, session_id);
+    publishSession(*session_ptr);
+    session_ptr->start(this);
+}
+
+void Shard::onSessionFinished(Session::SessionId session_id,
+                              proto::RouterSession /* session_type */)
+{
+    removeSession(session_id);
+}
+
+void Shard::onSessionUpdated(Session::SessionId session_id)
+{
+    Session* target = session(session_id);
+    if (target)
+        publishSession(*target);
+}
+
+Session* Shard::session(Session::SessionId session_id) const
+{
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end())
+        return nullptr;
+
+    return it->second.get();
+}
+
+void Shard::removeSession(Session::SessionId session_id)
+{
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end())
+        return;
+
+    std::unique_ptr<Session> session = std::move(it->second);
+    sessions_.erase(it);
+
+    server_->onSessionRemoved(session_id, session->sessionType());
+
+    // Session will be destroyed after completion of the current call.
+    thread_.taskRunner()->deleteSoon(std::move(session));
+}
+
+void Shard::publishSession(const Session& session)
+{
+    // Most of the time no admin watches the list.
+    if (!server_->hasSessionListSubscribers())
+        return;
+
+    std::shared_ptr<proto::Session> item = std::make_shared<proto::Session>();
+    sessionToProto(session, item.get());
+
+    server_->onSessionUpdated(std::move(item));
+}
+
+} // namespace router
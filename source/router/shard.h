@@ -0,0 +1,126 @@
+//
+// Aspia Project
+// Copyright (C) 2020 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef ROUTER__SHARD_H
+#define ROUTER__SHARD_H
+
+#include "base/net/network_server.h"
+#include "base/peer/server_authenticator_manager.h"
+#include "base/threading/thread.h"
+#include "proto/router_admin.pb.h"
+#include "proto/router_peer.pb.h"
+#include "router/session.h"
+
+#include <map>
+
+namespace base {
+class HandshakeLimiter;
+class WorkerPool;
+} // namespace base
+
+namespace router {
+
+class DatabaseFactory;
+class Server;
+
+// A network thread of the router with its own io_context. The shard accepts and authenticates
+// connections and owns the sessions created for them, so a session is always served by one
+// thread. Sessions of different shards never call each other: requests go to the Server, which
+// runs on the main thread, and the Server posts the results back to the shards.
+//
+// Public methods may be called from any thread.
+class Shard
+    : public base::Thread::Delegate,
+      public base::NetworkServer::Delegate,
+      public base::ServerAuthenticatorManager::Delegate,
+      public Session::Delegate
+{
+public:
+    Shard(size_t shard_index,
+          bool reuse_port,
+          uint16_t port,
+          const base::ByteArray& private_key,
+          Server* server,
+          std::shared_ptr<DatabaseFactory> database_factory,
+          std::shared_ptr<base::WorkerPool> worker_pool,
+          std::shared_ptr<base::HandshakeLimiter> handshake_limiter);
+    ~Shard();
+
+    void start();
+    void stop();
+
+    size_t index() const { return shard_index_; }
+
+    void sendConnectionOffer(Session::SessionId session_id, const proto::ConnectionOffer& offer);
+    void sendKeyUsed(Session::SessionId session_id, uint32_t key_id);
+    void sendSessionList(Session::SessionId session_id,
+                         std::shared_ptr<proto::SessionList> session_list);
+    void sendSessionListUpdate(Session::SessionId session_id,
+                               std::shared_ptr<proto::SessionListUpdate> session_list_update);
+    void sendSessionResult(Session::SessionId session_id, const proto::SessionResult& result);
+    void stopSession(Session::SessionId session_id);
+
+    // Collects a page of sessions of the shard and passes it to Server::onShardSessionList. If the
+    // shard has more sessions than fit in the page, next_cursor of the list is not 0.
+    void collectSessionList(uint64_t request_id, const proto::SessionListRequest& request);
+
+protected:
+    // base::Thread::Delegate implementation.
+    void onBeforeThreadRunning() override;
+    void onAfterThreadRunning() override;
+
+    // base::NetworkServer::Delegate implementation.
+    void onNewConnection(std::unique_ptr<base::NetworkChannel> channel) override;
+
+    // base::ServerAuthenticatorManager::Delegate implementation.
+    void onNewSession(base::ServerAuthenticatorManager::SessionInfo&& session_info) override;
+
+    // Session::Delegate implementation.
+    void onSessionFinished(Session::SessionId session_id,
+                           proto::RouterSession session_type) override;
+    void onSessionUpdated(Session::SessionId session_id) override;
+
+private:
+    Session* session(Session::SessionId session_id) const;
+    void removeSession(Session::SessionId session_id);
+    void publishSession(const Session& session);
+
+    const size_t shard_index_;
+    const bool reuse_port_;
+    const uint16_t port_;
+    const base::ByteArray private_key_;
+    Server* server_;
+    std::shared_ptr<DatabaseFactory> database_factory_;
+    std::shared_ptr<base::WorkerPool> worker_pool_;
+    std::shared_ptr<base::HandshakeLimiter> handshake_limiter_;
+
+    base::Thread thread_;
+    std::shared_ptr<base::TaskRunner> task_runner_;
+
+    // Created and destroyed on the shard thread.
+    std::unique_ptr<base::NetworkServer> network_server_;
+    std::unique_ptr<base::ServerAuthenticatorManager> authenticator_manager_;
+    // Ordered by ID, so a page of the session list starts with a lookup of the cursor.
+    std::map<Session::SessionId, std::unique_ptr<Session>> sessions_;
+
+    DISALLOW_COPY_AND_ASSIGN(Shard);
+};
+
+} // namespace router
+
+#endif // ROUTER__SHARD_H
@@ -21,9 +21,20 @@
 #include "base/logging.h"
 
 #include <map>
+#include <set>
+#include <tuple>
 
 namespace router {
 
+namespace {
+
+// The cost of one session in units of the relay load. The throughput is counted in kilobytes per
+// second, so one session costs as much as 1 MB/s of traffic.
+const uint64_t kSessionCost = 1024;
+const uint64_t kThroughputUnit = 1024;
+
+} // namespace
+
 class SharedKeyPool::Impl
 {
 public:
@@ -34,6 +45,7 @@ public:
 
     void addKey(Session::SessionId session_id, const proto::RelayKey& key);
     std::optional<Credentials> takeCredentials();
+    void setRelayLoad(Session::SessionId session_id, const Load& load);
     void removeKeysForRelay(Session::SessionId session_id);
     void clear();
     size_t countForRelay(Session::SessionId session_id) const;
@@ -43,7 +55,31 @@ public:
 private:
     using Keys = std::vector<proto::RelayKey>;
 
-    std::map<Session::SessionId, Keys> pool_;
+    // Relays are ordered by load, then by the number of keys (more keys first).
+    using Score = std::tuple<uint64_t, int64_t, Session::SessionId>;
+
+    struct Relay
+    {
+        Keys keys;
+        Load load;
+
+        // Keys given out since the last load report. Each of them is likely to become a session
+        // before the next report, so they are counted as sessions.
+        uint32_t pending_sessions = 0;
+
+        // The score under which the relay is in |queue_|. Valid only if the relay has keys.
+        Score score;
+    };
+
+    static Score calculateScore(Session::SessionId session_id, const Relay& relay);
+    void updateScore(Session::SessionId session_id, Relay* relay);
+
+    std::map<Session::SessionId, Relay> pool_;
+
+    // Relays that have at least one key. The first one is the preferred relay.
+    std::set<Score> queue_;
+    size_t key_count_ = 0;
+
     Delegate* delegate_;
 
     DISALLOW_COPY_AND_ASSIGN(Impl);
@@ -66,60 +102,59 @@ void SharedKeyPool::Impl::addKey(Session::SessionId session_id, const proto::Rel
     if (relay == pool_.end())
     {
         LOG(LS_INFO) << "Host not found in pool. It will be added";
-        relay = pool_.emplace(session_id, Keys()).first;
+        relay = pool_.emplace(session_id, Relay()).first;
     }
 
     LOG(LS_INFO) << "Added key with id " << key.key_id() << " for host '" << session_id << "'";
-    relay->second.emplace_back(std::move(key));
+    relay->second.keys.emplace_back(std::move(key));
+    ++key_count_;
+
+    updateScore(session_id, &relay->second);
 }
 
 std::optional<SharedKeyPool::Credentials> SharedKeyPool::Impl::takeCredentials()
 {
-    if (pool_.empty())
+    if (queue_.empty())
     {
         LOG(LS_WARNING) << "Empty key pool";
         return std::nullopt;
     }
 
-    auto preffered_relay = pool_.end();
-    size_t max_count = 0;
+    Session::SessionId session_id = std::get<2>(*queue_.begin());
 
-    for (auto it = pool_.begin(); it != pool_.end(); ++it)
+    auto preffered_relay = pool_.find(session_id);
+    if (preffered_relay == pool_.end() || preffered_relay->second.keys.empty())
     {
-        size_t count = it->second.size();
-        if (count > max_count)
-        {
-            preffered_relay = it;
-            max_count = count;
-        }
-    }
-
-    if (preffered_relay == pool_.end())
-    {
-        LOG(LS_WARNING) << "Empty key pool";
+        LOG(LS_ERROR) << "Empty key pool for relay";
+        queue_.erase(queue_.begin());
         return std::nullopt;
     }
 
-    LOG(LS_INFO) << "Preffered relay: " << preffered_relay->first;
+    LOG(LS_INFO) << "Preffered relay: " << session_id;
 
-    if (preffered_relay->second.empty())
-    {
-        LOG(LS_ERROR) << "Empty key pool for relay";
-        return std::nullopt;
-    }
+    Relay& relay = preffered_relay->second;
 
     Credentials credentials;
-    credentials.session_id = preffered_relay->first;
-    credentials.key = std::move(preffered_relay->second.back());
+    credentials.session_id = session_id;
+    credentials.key = std::move(relay.keys.back());
 
     // Removing the key from the pool.
-    preffered_relay->second.pop_back();
+    relay.keys.pop_back();
+    --key_count_;
+    ++relay.pending_sessions;
 
-    if (preffered_relay->second.empty())
+    if (relay.keys.empty())
     {
-        LOG(LS_INFO) << "Last key in the pool for relay. The relay will be removed from the pool";
-        pool_.erase(preffered_relay->first);
+        LOG(LS_WARNING) << "Last key in the pool for relay " << credentials.session_id
+                        << ". The relay will not be selected until it sends new keys";
     }
+    else
+    {
+        LOG(LS_INFO) << "Keys left for relay " << credentials.session_id << ": "
+                     << relay.keys.size();
+    }
+
+    updateScore(session_id, &relay);
 
     if (delegate_)
         delegate_->onPoolKeyUsed(credentials.session_id, credentials.key.key_id());
@@ -127,16 +162,40 @@ std::optional<SharedKeyPool::Credentials> SharedKeyPool::Impl::takeCredentials()
     return credentials;
 }
 
+void SharedKeyPool::Impl::setRelayLoad(Session::SessionId session_id, const Load& load)
+{
+    auto relay = pool_.find(session_id);
+    if (relay == pool_.end())
+        relay = pool_.emplace(session_id, Relay()).first;
+
+    // The report already includes the sessions started with the keys given out before it.
+    relay->second.load = load;
+    relay->second.pending_sessions = 0;
+
+    updateScore(session_id, &relay->second);
+}
+
 void SharedKeyPool::Impl::removeKeysForRelay(Session::SessionId session_id)
 {
     LOG(LS_INFO) << "All keys for relay '" << session_id << "' removed";
-    pool_.erase(session_id);
+
+    auto relay = pool_.find(session_id);
+    if (relay == pool_.end())
+        return;
+
+    if (!relay->second.keys.empty())
+        queue_.erase(relay->second.score);
+
+    key_count_ -= relay->second.keys.size();
+    pool_.erase(relay);
 }
 
 void SharedKeyPool::Impl::clear()
 {
     LOG(LS_INFO) << "Key pool cleared";
     pool_.clear();
+    queue_.clear();
+    key_count_ = 0;
 }
 
 size_t SharedKeyPool::Impl::countForRelay(Session::SessionId session_id) const
@@ -145,22 +204,40 @@ size_t SharedKeyPool::Impl::countForRelay(Session::SessionId session_id) const
     if (result == pool_.end())
         return 0;
 
-    return result->second.size();
+    return result->second.keys.size();
 }
 
 size_t SharedKeyPool::Impl::count() const
 {
-    size_t result = 0;
+    return key_count_;
+}
+
+bool SharedKeyPool::Impl::isEmpty() const
+{
+    return queue_.empty();
+}
 
-    for (const auto& relay : pool_)
-        result += relay.second.size();
+// static
+SharedKeyPool::Impl::Score SharedKeyPool::Impl::calculateScore(
+    Session::SessionId session_id, const Relay& relay)
+{
+    uint64_t sessions = static_cast<uint64_t>(relay.load.active_sessions) + relay.pending_sessions;
+    uint64_t load = sessions * kSessionCost + relay.load.throughput / kThroughputUnit;
 
-    return result;
+    return Score(load, -static_cast<int64_t>(relay.keys.size()), session_id);
 }
 
-bool SharedKeyPool::Impl::isEmpty() const
+void SharedKeyPool::Impl::updateScore(Session::SessionId session_id, Relay* relay)
 {
-    return pool_.empty();
+    Score score = calculateScore(session_id, *relay);
+
+    // The relay is in the queue only while it has keys. Scores contain the unique session ID, so
+    // erasing a score that is not in the queue does nothing.
+    queue_.erase(relay->score);
+
+    relay->score = score;
+    if (!relay->keys.empty())
+        queue_.emplace(score);
 }
 
 SharedKeyPool::SharedKeyPool(Delegate* delegate)
@@ -198,6 +275,11 @@ std::optional<SharedKeyPool::Credentials> SharedKeyPool::takeCredentials()
     return impl_->takeCredentials();
 }
 
+void SharedKeyPool::setRelayLoad(Session::SessionId session_id, const Load& load)
+{
+    impl_->setRelayLoad(session_id, load);
+}
+
 void SharedKeyPool::removeKeysForRelay(Session::SessionId session_id)
 {
     impl_->removeKeysForRelay(session_id);
@@ -51,8 +51,20 @@ public:
         proto::RelayKey key;
     };
 
+    // The load reported by a relay.
+    struct Load
+    {
+        uint32_t active_sessions = 0;
+        uint64_t throughput = 0; // Bytes per second in both directions.
+    };
+
     void addKey(Session::SessionId session_id, const proto::RelayKey& key);
+
+    // Takes a key of the least loaded relay. The load is estimated from the last report of the
+    // relay, the keys given out since then and the number of remaining keys. O(log n).
     std::optional<Credentials> takeCredentials();
+
+    void setRelayLoad(Session::SessionId session_id, const Load& load);
     void removeKeysForRelay(Session::SessionId session_id);
     void clear();
     size_t countForRelay(Session::SessionId session_id) const;